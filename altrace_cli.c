@@ -6,6 +6,8 @@
  *  This file written by Ryan C. Gordon.
  */
 
+#include <float.h>
+
 #include "altrace_playback.h"
 
 const char *GAppName = "altrace_cli";
@@ -14,8 +16,16 @@ static int dump_calls = 1;
 static int dump_callers = 0;
 static int dump_state_changes = 0;
 static int dump_errors = 0;
+static int dump_perf = 0;
+static int dump_latency = 0;
+static int chart_resources = 0;
+static int frame_stats = 0;
+static int dump_counters = 0;
 static int dumping = 1;
 static int run_calls = 0;
+static int benchmark = 0;
+static int numthreads = 1;
+static TraceReader *reader = NULL;  // for --run to fetch audio data with.
 
 void out_of_memory(void)
 {
@@ -26,6 +36,299 @@ void out_of_memory(void)
 }
 
 
+// Everything we print goes into one big buffer instead of through stdio,
+//  and gets written out a megabyte at a time. The common printf conversions
+//  are done by hand, since a big dump is mostly formatting numbers and
+//  copying strings, and libc was most of the time spent making one.
+typedef struct OutBuffer
+{
+    char *data;
+    size_t len;
+    size_t alloc;
+} OutBuffer;
+
+#define OUTBUFFER_FLUSH_SIZE (1024 * 1024)
+
+static OutBuffer stdout_buffer = { NULL, 0, 0 };
+static __thread OutBuffer *out = &stdout_buffer;  // --threads formats batches into buffers of their own.
+static int flush_every_call = 0;  // someone's watching (a terminal, --attach, --run).
+
+static void out_flush(void)
+{
+    if (out != &stdout_buffer) {
+        return;  // a batch goes out when its turn comes.
+    } else if (stdout_buffer.len) {
+        fwrite(stdout_buffer.data, 1, stdout_buffer.len, stdout);
+        stdout_buffer.len = 0;
+    }
+    fflush(stdout);
+}
+
+// make room for at least `len` more bytes, and return where they go.
+static char *out_reserve(const size_t len)
+{
+    if ((out == &stdout_buffer) && ((out->len + len) > OUTBUFFER_FLUSH_SIZE)) {
+        out_flush();
+    }
+
+    if ((out->len + len) > out->alloc) {
+        size_t newalloc = out->alloc ? out->alloc : OUTBUFFER_FLUSH_SIZE;
+        void *ptr;
+        while (newalloc < (out->len + len)) {
+            newalloc *= 2;
+        }
+        ptr = realloc(out->data, newalloc);
+        if (!ptr) {
+            out_of_memory();
+        }
+        out->data = (char *) ptr;
+        out->alloc = newalloc;
+    }
+    return out->data + out->len;
+}
+
+static void out_write(const char *str, const size_t len)
+{
+    memcpy(out_reserve(len), str, len);
+    out->len += len;
+}
+
+static void out_str(const char *str)
+{
+    out_write(str ? str : "(null)", str ? strlen(str) : 6);
+}
+
+static void out_char(const int ch)
+{
+    *out_reserve(1) = (char) ch;
+    out->len++;
+}
+
+static void out_uint(const uint64 val)
+{
+    char buf[20];
+    char *end = buf + sizeof (buf);
+    char *ptr = format_uint(end, val);
+    out_write(ptr, (size_t) (end - ptr));
+}
+
+static void out_int(const int64 val)
+{
+    if (val < 0) {
+        out_char('-');
+        out_uint(((uint64) -(val + 1)) + 1);  // don't overflow on INT64_MIN.
+    } else {
+        out_uint((uint64) val);
+    }
+}
+
+// Shortest text that reads back as exactly the same float: the fewest
+//  decimal places where the nearest decimal still falls inside the range of
+//  numbers that round to this float. It's all exact integer math, scaled so
+//  that range's ends are whole numbers. Only values in [1e-7, 1e10) go this
+//  way, which keeps everything well inside 128 bits; the rest (and doubles
+//  that aren't really floats, and everything on compilers without 128-bit
+//  integers) ask libc for progressively more digits.
+static size_t format_float(char *buf, const float f)
+{
+    const float absf = (f < 0.0f) ? -f : f;
+    uint32 bits;
+    memcpy(&bits, &f, sizeof (bits));
+
+    if (f != f) {
+        strcpy(buf, "nan");
+    } else if (absf > FLT_MAX) {
+        strcpy(buf, (f < 0.0f) ? "-inf" : "inf");
+    } else if (absf == 0.0f) {
+        strcpy(buf, (bits >> 31) ? "-0.0" : "0.0");
+#ifdef __SIZEOF_INT128__
+    } else if ((absf >= 1e-7f) && (absf < 1e10f)) {
+        typedef unsigned __int128 uint128;
+        const int exponent = (int) ((bits >> 23) & 0xFF);
+        const uint32 mantissa = bits & 0x7FFFFF;
+        const int shift = ((exponent - 150) < 0) ? (150 - exponent) + 2 : 2;  // f == value / 2^shift
+        const int scale = (exponent - 150) + shift;
+        const uint128 value = ((uint128) (mantissa | 0x800000)) << scale;
+        const uint128 halfulp = ((uint128) 1) << (scale - 1);
+        const uint128 hi = value + halfulp;
+        const uint128 lo = value - ((mantissa == 0) ? (halfulp >> 1) : halfulp);  // the float below is closer at a power of two.
+        uint128 pow10 = 1;
+        int places;
+
+        for (places = 0; places <= 17; places++, pow10 *= 10) {
+            const uint128 scaled = value * pow10;
+            const uint128 below = scaled >> shift;
+            const uint128 above = below + 1;
+            const int below_okay = (below << shift) > (lo * pow10);
+            const int above_okay = (above << shift) < (hi * pow10);
+            uint64 digits;
+            char tmp[24];
+            char *end = tmp + sizeof (tmp);
+            char *ptr;
+            char *dst = buf;
+
+            if (!below_okay && !above_okay) {
+                continue;
+            } else if (below_okay && (!above_okay || ((scaled - (below << shift)) <= ((above << shift) - scaled)))) {
+                digits = (uint64) below;
+            } else {
+                digits = (uint64) above;
+            }
+
+            ptr = format_uint(end, digits);
+            while ((end - ptr) <= places) {
+                *(--ptr) = '0';  // make sure there's a digit before the decimal point.
+            }
+
+            if (f < 0.0f) {
+                *(dst++) = '-';
+            }
+            memcpy(dst, ptr, (size_t) ((end - ptr) - places));
+            dst += (end - ptr) - places;
+            *(dst++) = '.';
+            if (places == 0) {
+                *(dst++) = '0';
+            } else {
+                memcpy(dst, end - places, (size_t) places);
+                dst += places;
+            }
+            *dst = '\0';
+            return (size_t) (dst - buf);
+        }
+        snprintf(buf, 32, "%.9g", (double) f);  // shouldn't happen.
+#endif
+    } else {
+        int precision;
+        for (precision = 1; precision < 9; precision++) {
+            snprintf(buf, 32, "%.*g", precision, (double) f);
+            if (strtof(buf, NULL) == f) {
+                break;
+            }
+        }
+        snprintf(buf, 32, "%.*g", precision, (double) f);
+    }
+    return strlen(buf);
+}
+
+static void out_float(const double val)
+{
+    const double absval = (val < 0.0) ? -val : val;
+    const int infinite = (absval > 1.0) && (absval == (absval * 2.0));
+    char buf[32];
+    size_t len;
+    if ((val != val) || infinite || ((absval <= FLT_MAX) && (((double) (float) val) == val))) {
+        len = format_float(buf, (float) val);
+    } else {
+        int precision;
+        for (precision = 15; precision < 17; precision++) {
+            snprintf(buf, sizeof (buf), "%.*g", precision, val);
+            if (strtod(buf, NULL) == val) {
+                break;
+            }
+        }
+        len = (size_t) snprintf(buf, sizeof (buf), "%.*g", precision, val);
+    }
+    out_write(buf, len);
+}
+
+// outf() into the output buffer. %s, %c, %d, %u, %lld, %llu and plain %f
+//  are done by hand (and %f prints the shortest text that reads back as the
+//  same number, not six decimal places); anything with a width or precision
+//  goes through snprintf.
+static void outf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static void outf(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+
+    while (*fmt) {
+        const char *start = fmt;
+        char spec[16];
+        size_t speclen;
+        size_t avail = 64;
+        int rc = 0;
+
+        while (*fmt && (*fmt != '%')) {
+            fmt++;
+        }
+        if (fmt > start) {
+            out_write(start, (size_t) (fmt - start));
+        }
+        if (!*fmt) {
+            break;
+        }
+
+        start = fmt++;
+        switch (*fmt) {
+            case 's': fmt++; out_str(va_arg(ap, const char *)); continue;
+            case 'c': fmt++; out_char(va_arg(ap, int)); continue;
+            case 'd': fmt++; out_int((int64) va_arg(ap, int)); continue;
+            case 'u': fmt++; out_uint((uint64) va_arg(ap, unsigned int)); continue;
+            case 'f': fmt++; out_float(va_arg(ap, double)); continue;
+            case '%': fmt++; out_char('%'); continue;
+            case 'l':
+                if ((fmt[1] == 'l') && (fmt[2] == 'u')) {
+                    fmt += 3; out_uint((uint64) va_arg(ap, unsigned long long)); continue;
+                } else if ((fmt[1] == 'l') && (fmt[2] == 'd')) {
+                    fmt += 3; out_int((int64) va_arg(ap, long long)); continue;
+                }
+                break;
+            default: break;
+        }
+
+        // something fancier; find the end of it and let libc handle it.
+        while (*fmt && strchr("-+ #0123456789.hlz", *fmt)) {
+            fmt++;
+        }
+        if (!*fmt || ((size_t) (fmt - start) >= (sizeof (spec) - 1))) {
+            break;  // bogus format string, shouldn't happen.
+        }
+        fmt++;
+        speclen = (size_t) (fmt - start);
+        memcpy(spec, start, speclen);
+        spec[speclen] = '\0';
+
+        #define OUTF_SNPRINTF(val) { \
+            rc = snprintf(out_reserve(avail), avail, spec, val); \
+            if ((rc >= 0) && ((size_t) rc >= avail)) { \
+                avail = (size_t) rc + 1; \
+                rc = snprintf(out_reserve(avail), avail, spec, val); \
+            } \
+        }
+
+        switch (fmt[-1]) {
+            case 's': {
+                const char *str = va_arg(ap, const char *);
+                OUTF_SNPRINTF(str);
+                break;
+            }
+            case 'f': case 'F': case 'g': case 'G': case 'e': case 'E': {
+                const double val = va_arg(ap, double);
+                OUTF_SNPRINTF(val);
+                break;
+            }
+            default:
+                if (spec[speclen - 2] == 'l') {
+                    const long long val = va_arg(ap, long long);
+                    OUTF_SNPRINTF(val);
+                } else {
+                    const int val = va_arg(ap, int);
+                    OUTF_SNPRINTF(val);
+                }
+                break;
+        }
+
+        #undef OUTF_SNPRINTF
+
+        if (rc > 0) {
+            out->len += (size_t) rc;
+        }
+    }
+
+    va_end(ap);
+}
+
+
 static void wait_until(const uint32 ticks)
 {
     while (now() < ticks) {
@@ -39,42 +342,54 @@ static void wait_until(const uint32 ticks)
 void visit_al_error_event(void *userdata, const ALenum err)
 {
     if (dump_errors) {
-        printf("<<< AL ERROR SET HERE: %s >>>\n", alenumString(err));
+        outf("<<< AL ERROR SET HERE: %s >>>\n", alenumString(err));
     }
 }
 
 void visit_alc_error_event(void *userdata, ALCdevice *device, const ALCenum err)
 {
     if (dump_errors) {
-        printf("<<< ALC ERROR SET HERE: device=%s %s >>>\n", deviceString(device), alcenumString(err));
+        outf("<<< ALC ERROR SET HERE: device=%s %s >>>\n", deviceString(device), alcenumString(err));
     }
 }
 
 void visit_device_state_changed_int(void *userdata, ALCdevice *dev, const ALCenum param, const ALCint newval)
 {
     if (dump_state_changes) {
-        printf("<<< DEVICE STATE CHANGE: dev=%s param=%s value=%d >>>\n", deviceString(dev), alcenumString(param), (int) newval);
+        outf("<<< DEVICE STATE CHANGE: dev=%s param=%s value=%d >>>\n", deviceString(dev), alcenumString(param), (int) newval);
     }
 }
 
 void visit_context_state_changed_enum(void *userdata, ALCcontext *ctx, const ALenum param, const ALenum newval)
 {
     if (dump_state_changes) {
-        printf("<<< CONTEXT STATE CHANGE: ctx=%s param=%s value=%s >>>\n", ctxString(ctx), alenumString(param), alenumString(newval));
+        outf("<<< CONTEXT STATE CHANGE: ctx=%s param=%s value=%s >>>\n", ctxString(ctx), alenumString(param), alenumString(newval));
     }
 }
 
 void visit_context_state_changed_float(void *userdata, ALCcontext *ctx, const ALenum param, const ALfloat newval)
 {
     if (dump_state_changes) {
-        printf("<<< CONTEXT STATE CHANGE: ctx=%s param=%s value=%f >>>\n", ctxString(ctx), alenumString(param), newval);
+        outf("<<< CONTEXT STATE CHANGE: ctx=%s param=%s value=%f >>>\n", ctxString(ctx), alenumString(param), newval);
     }
 }
 
 void visit_context_state_changed_string(void *userdata, ALCcontext *ctx, const ALenum param, const ALchar *newval)
 {
     if (dump_state_changes) {
-        printf("<<< CONTEXT STATE CHANGE: ctx=%s param=%s value=%s >>>\n", ctxString(ctx), alenumString(param), litString(newval));
+        outf("<<< CONTEXT STATE CHANGE: ctx=%s param=%s value=%s >>>\n", ctxString(ctx), alenumString(param), litString(newval));
+    }
+}
+
+void visit_context_attributes(void *userdata, ALCcontext *ctx, const uint32 numattrs, const ALCint *attrs)
+{
+    if (dump_state_changes) {
+        uint32 i;
+        outf("<<< CONTEXT ATTRIBUTES: ctx=%s attrs={", ctxString(ctx));
+        for (i = 0; (i + 1) < numattrs; i += 2) {
+            outf("%s %s=%d", i > 0 ? "," : "", alcenumString(attrs[i]), (int) attrs[i+1]);
+        }
+        outf("%s} >>>\n", numattrs > 0 ? " " : "");
     }
 }
 
@@ -82,60 +397,213 @@ void visit_listener_state_changed_floatv(void *userdata, ALCcontext *ctx, const
 {
     if (dump_state_changes) {
         uint32 i;
-        printf("<<< LISTENER STATE CHANGE: ctx=%s param=%s values={", ctxString(ctx), alenumString(param));
+        outf("<<< LISTENER STATE CHANGE: ctx=%s param=%s values={", ctxString(ctx), alenumString(param));
         for (i = 0; i < numfloats; i++) {
-            printf("%s %f", i > 0 ? "," : "", values[i]);
+            outf("%s %f", i > 0 ? "," : "", values[i]);
         }
-        printf("%s} >>>\n", numfloats > 0 ? " " : "");
+        outf("%s} >>>\n", numfloats > 0 ? " " : "");
     }
 }
 
-void visit_source_state_changed_bool(void *userdata, const ALuint name, const ALenum param, const ALboolean newval)
+void visit_source_state_changed_bool(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALboolean newval)
 {
     if (dump_state_changes) {
-        printf("<<< SOURCE STATE CHANGE: name=%s param=%s value=%s >>>\n", sourceString(name), alenumString(param), alboolString(newval));
+        outf("<<< SOURCE STATE CHANGE: ctx=%s name=%s param=%s value=%s >>>\n", ctxString(ctx), sourceString(name), alenumString(param), alboolString(newval));
     }
 }
 
-void visit_source_state_changed_enum(void *userdata, const ALuint name, const ALenum param, const ALenum newval)
+void visit_source_state_changed_enum(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALenum newval)
 {
     if (dump_state_changes) {
-        printf("<<< SOURCE STATE CHANGE: name=%s param=%s value=%s >>>\n", sourceString(name), alenumString(param), alenumString(newval));
+        outf("<<< SOURCE STATE CHANGE: ctx=%s name=%s param=%s value=%s >>>\n", ctxString(ctx), sourceString(name), alenumString(param), alenumString(newval));
     }
 }
 
-void visit_source_state_changed_int(void *userdata, const ALuint name, const ALenum param, const ALint newval)
+void visit_source_state_changed_int(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALint newval)
 {
     if (dump_state_changes) {
-        printf("<<< SOURCE STATE CHANGE: name=%s param=%s value=%d >>>\n", sourceString(name), alenumString(param), (int) newval);
+        outf("<<< SOURCE STATE CHANGE: ctx=%s name=%s param=%s value=%d >>>\n", ctxString(ctx), sourceString(name), alenumString(param), (int) newval);
     }
 }
 
-void visit_source_state_changed_uint(void *userdata, const ALuint name, const ALenum param, const ALuint newval)
+void visit_source_state_changed_uint(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALuint newval)
 {
     if (dump_state_changes) {
-        printf("<<< SOURCE STATE CHANGE: name=%s param=%s value=%u >>>\n", sourceString(name), alenumString(param), (uint) newval);
+        outf("<<< SOURCE STATE CHANGE: ctx=%s name=%s param=%s value=%u >>>\n", ctxString(ctx), sourceString(name), alenumString(param), (uint) newval);
     }
 }
 
-void visit_source_state_changed_float(void *userdata, const ALuint name, const ALenum param, const ALfloat newval)
+void visit_source_state_changed_float(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat newval)
 {
     if (dump_state_changes) {
-        printf("<<< SOURCE STATE CHANGE: name=%s param=%s value=%f >>>\n", sourceString(name), alenumString(param), newval);
+        outf("<<< SOURCE STATE CHANGE: ctx=%s name=%s param=%s value=%f >>>\n", ctxString(ctx), sourceString(name), alenumString(param), newval);
     }
 }
 
-void visit_source_state_changed_float3(void *userdata, const ALuint name, const ALenum param, const ALfloat newval1, const ALfloat newval2, const ALfloat newval3)
+void visit_source_state_changed_float3(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat newval1, const ALfloat newval2, const ALfloat newval3)
 {
     if (dump_state_changes) {
-        printf("<<< SOURCE STATE CHANGE: name=%s param=%s value={ %f, %f, %f } >>>\n", sourceString(name), alenumString(param), newval1, newval2, newval3);
+        outf("<<< SOURCE STATE CHANGE: ctx=%s name=%s param=%s value={ %f, %f, %f } >>>\n", ctxString(ctx), sourceString(name), alenumString(param), newval1, newval2, newval3);
     }
 }
 
 void visit_buffer_state_changed_int(void *userdata, const ALuint name, const ALenum param, const ALint newval)
 {
     if (dump_state_changes) {
-        printf("<<< BUFFER STATE CHANGE: name=%s param=%s value=%d >>>\n", bufferString(name), alenumString(param), (int) newval);
+        outf("<<< BUFFER STATE CHANGE: name=%s param=%s value=%d >>>\n", bufferString(name), alenumString(param), (int) newval);
+    }
+}
+
+void visit_process_forked(void *userdata, const uint32 ticks, const uint32 parentpid, const uint32 childpid, const char *parentfile, const uint64 parentoffset)
+{
+    if (dumping) {
+        outf("<<< PROCESS %u FORKED FROM PROCESS %u: parent trace=%s offset=%llu >>>\n", (uint) childpid, (uint) parentpid, litString(parentfile), (unsigned long long) parentoffset);
+    }
+}
+
+void visit_checkpoint(void *userdata, const uint64 eventcount, const uint64 offset, const uint32 ticks)
+{
+    // nothing to do with these; they're for --salvage.
+}
+
+void *visit_chunk_begin(void *userdata, const uint64 chunknum)
+{
+    return userdata;  // only --benchmark decodes chunks in parallel, and it has nothing to collect.
+}
+
+void visit_chunk_end(void *userdata, void *chunkdata, const ALboolean keep)
+{
+}
+
+void visit_perf_counters(void *userdata, const uint32 kind, const uint64 value1, const uint64 value2)
+{
+    if (dump_perf) {
+        if (kind == ALTRACE_PERF_CYCLES_INSTRUCTIONS) {
+            outf("<<< PERF: cycles=%llu instructions=%llu >>>\n", (unsigned long long) value1, (unsigned long long) value2);
+        } else if (kind == ALTRACE_PERF_TASKCLOCK_CSWITCHES) {
+            outf("<<< PERF: task-clock=%lluns context-switches=%llu >>>\n", (unsigned long long) value1, (unsigned long long) value2);
+        } else {
+            outf("<<< PERF: unknown counters #%u: %llu, %llu >>>\n", (uint) kind, (unsigned long long) value1, (unsigned long long) value2);
+        }
+    }
+}
+
+// --chart-resources collects the recorder's resource samples, with how much
+//  API activity happened since the previous one, and prints them all at the end.
+typedef struct ResourceSample
+{
+    uint32 ticks;
+    uint64 rss;
+    uint64 usertime;
+    uint64 systime;
+    uint32 threads;
+    uint32 openal_threads;
+    uint64 calls;
+    uint64 upload_bytes;
+} ResourceSample;
+
+static ResourceSample *resource_samples = NULL;
+static uint32 num_resource_samples = 0;
+static uint64 chart_calls = 0;
+static uint64 chart_upload_bytes = 0;
+
+void visit_resource_sample(void *userdata, const uint32 ticks, const uint64 rss, const uint64 usertime, const uint64 systime, const uint32 threads, const uint32 openal_threads)
+{
+    if (chart_resources) {
+        ResourceSample *sample;
+        void *ptr = realloc(resource_samples, (num_resource_samples + 1) * sizeof (ResourceSample));
+        if (!ptr) {
+            out_of_memory();
+        }
+        resource_samples = (ResourceSample *) ptr;
+        sample = &resource_samples[num_resource_samples++];
+        sample->ticks = ticks;
+        sample->rss = rss;
+        sample->usertime = usertime;
+        sample->systime = systime;
+        sample->threads = threads;
+        sample->openal_threads = openal_threads;
+        sample->calls = chart_calls;
+        sample->upload_bytes = chart_upload_bytes;
+        chart_calls = chart_upload_bytes = 0;
+    }
+
+    if (dump_perf) {
+        outf("<<< RESOURCES: rss=%llu user=%lluus system=%lluus threads=%u openal-threads=%u >>>\n",
+               (unsigned long long) rss, (unsigned long long) usertime, (unsigned long long) systime,
+               (uint) threads, (uint) openal_threads);
+    }
+}
+
+static void print_bar(const uint64 value, const uint64 maxvalue)
+{
+    const int width = 20;
+    const int len = maxvalue ? (int) ((value * width) / maxvalue) : 0;
+    int i;
+    for (i = 0; i < width; i++) {
+        out_char((i < len) ? '#' : ' ');
+    }
+}
+
+static void print_resource_chart(void)
+{
+    uint64 peak_rss = 0;
+    uint64 total_uploads = 0;
+    uint64 uploaded = 0;
+    uint32 i;
+
+    if (num_resource_samples == 0) {
+        outf("No resource samples in this trace. Record with ALTRACE_RESOURCE_SAMPLE=<milliseconds> set.\n");
+        return;
+    }
+
+    for (i = 0; i < num_resource_samples; i++) {
+        const ResourceSample *sample = &resource_samples[i];
+        if (sample->rss > peak_rss) {
+            peak_rss = sample->rss;
+        }
+        total_uploads += sample->upload_bytes;
+    }
+
+    outf("%u resource samples, peak RSS %.2f MB, %.2f MB uploaded with alBufferData before the last sample.\n\n",
+           (uint) num_resource_samples, peak_rss / (1024.0 * 1024.0), total_uploads / (1024.0 * 1024.0));
+    outf("    time    rss MB    user s     sys s  threads  al      calls  upload KB  %-20s  uploaded (total)\n", "rss");
+
+    // calls and uploads are the ones made between the previous sample and this one.
+    for (i = 0; i < num_resource_samples; i++) {
+        const ResourceSample *sample = &resource_samples[i];
+        uploaded += sample->upload_bytes;
+        outf("%8.3f  %8.2f  %8.3f  %8.3f  %7u  %2u  %9llu  %9.1f  ",
+               sample->ticks / 1000.0, sample->rss / (1024.0 * 1024.0),
+               sample->usertime / 1000000.0, sample->systime / 1000000.0,
+               (uint) sample->threads, (uint) sample->openal_threads,
+               (unsigned long long) sample->calls, sample->upload_bytes / 1024.0);
+        print_bar(sample->rss, peak_rss);
+        outf("  ");
+        print_bar(uploaded, total_uploads);
+        outf("\n");
+    }
+
+    if (chart_calls) {
+        outf("\n(%llu more calls, uploading %.1f KB, after the last sample.)\n", (unsigned long long) chart_calls, chart_upload_bytes / 1024.0);
+    }
+
+    free(resource_samples);
+    resource_samples = NULL;
+    num_resource_samples = 0;
+}
+
+void visit_device_clock_latency(void *userdata, ALCdevice *device, const uint32 ticks, const int64 clock, const int64 latency)
+{
+    if (dump_latency) {
+        outf("<<< DEVICE CLOCK: device=%s clock=%.6fs latency=%.3fms >>>\n", deviceString(device), clock / 1000000000.0, latency / 1000000.0);
+    }
+}
+
+void visit_source_latency(void *userdata, ALCcontext *ctx, const ALuint name, const int64 offset, const int64 latency)
+{
+    if (dump_latency) {
+        outf("<<< SOURCE LATENCY: ctx=%s name=%s offset=%.3f samples latency=%.3fms >>>\n", ctxString(ctx), sourceString(name), offset / 4294967296.0, latency / 1000000.0);
     }
 }
 
@@ -146,11 +614,12 @@ void visit_eos(void *userdata, const ALboolean okay, const uint32 ticks)
     }
 
     if (!okay) {
+        out_flush();  // so this lands after the last call we dumped.
         fprintf(stderr, "\n<<< UNEXPECTED LOG ENTRY. BUG? NEW LOG VERSION? CORRUPT FILE? >>>\n");
         fflush(stderr);
     } else if (dumping) {
-        printf("\n<<< END OF TRACE FILE >>>\n");
-        fflush(stdout);
+        outf("\n<<< END OF TRACE FILE >>>\n");
+        out_flush();
     }
 }
 
@@ -164,787 +633,859 @@ int visit_progress(void *userdata, const off_t current, const off_t total)
 
 static void dump_alcGetCurrentContext(CallerInfo *callerinfo, ALCcontext *retval)
 {
-    printf("() => %s\n", ctxString(retval));
+    outf("() => %s\n", ctxString(retval));
 }
 
 static void dump_alcGetContextsDevice(CallerInfo *callerinfo, ALCdevice *retval, ALCcontext *context)
 {
-    printf("(%s) => %s\n", ctxString(context), deviceString(retval));
+    outf("(%s) => %s\n", ctxString(context), deviceString(retval));
 }
 
 static void dump_alcIsExtensionPresent(CallerInfo *callerinfo, ALCboolean retval, ALCdevice *device, const ALCchar *extname)
 {
-    printf("(%s, %s) => %s\n", deviceString(device), litString(extname), alcboolString(retval));
+    outf("(%s, %s) => %s\n", deviceString(device), litString(extname), alcboolString(retval));
 }
 
 static void dump_alcGetProcAddress(CallerInfo *callerinfo, void *retval, ALCdevice *device, const ALCchar *funcname)
 {
-    printf("(%s, %s) => %s\n", deviceString(device), litString(funcname), ptrString(retval));
+    outf("(%s, %s) => %s\n", deviceString(device), litString(funcname), ptrString(retval));
 }
 
 static void dump_alcGetEnumValue(CallerInfo *callerinfo, ALCenum retval, ALCdevice *device, const ALCchar *enumname)
 {
-    printf("(%s, %s) => %s\n", deviceString(device), litString(enumname), alcenumString(retval));
+    outf("(%s, %s) => %s\n", deviceString(device), litString(enumname), alcenumString(retval));
 }
 
 static void dump_alcGetString(CallerInfo *callerinfo, const ALCchar *retval, ALCdevice *device, ALCenum param)
 {
-    printf("(%s, %s) => %s\n", deviceString(device), alcenumString(param), litString(retval));
+    outf("(%s, %s) => %s\n", deviceString(device), alcenumString(param), litString(retval));
 }
 
 static void dump_alcCaptureOpenDevice(CallerInfo *callerinfo, ALCdevice *retval, const ALCchar *devicename, ALCuint frequency, ALCenum format, ALCsizei buffersize, ALint major_version, ALint minor_version, const ALCchar *devspec, const ALCchar *extensions)
 {
-    printf("(%s, %u, %s, %u) => %s\n", litString(devicename), (uint) frequency, alcenumString(format), (uint) buffersize, deviceString(retval));
+    outf("(%s, %u, %s, %u) => %s\n", litString(devicename), (uint) frequency, alcenumString(format), (uint) buffersize, deviceString(retval));
     if (retval && dump_state_changes) {
-        printf("<<< CAPTURE DEVICE STATE: alc_version=%d.%d device_specifier=%s extensions=%s >>>\n", (int) major_version, (int) minor_version, litString(devspec), litString(extensions));
+        outf("<<< CAPTURE DEVICE STATE: alc_version=%d.%d device_specifier=%s extensions=%s >>>\n", (int) major_version, (int) minor_version, litString(devspec), litString(extensions));
     }
 }
 
 static void dump_alcCaptureCloseDevice(CallerInfo *callerinfo, ALCboolean retval, ALCdevice *device)
 {
-    printf("(%s) => %s\n", deviceString(device), alcboolString(retval));
+    outf("(%s) => %s\n", deviceString(device), alcboolString(retval));
 }
 
 static void dump_alcOpenDevice(CallerInfo *callerinfo, ALCdevice *retval, const ALCchar *devicename, ALint major_version, ALint minor_version, const ALCchar *devspec, const ALCchar *extensions)
 {
-    printf("(%s) => %s\n", litString(devicename), deviceString(retval));
+    outf("(%s) => %s\n", litString(devicename), deviceString(retval));
     if (retval && dump_state_changes) {
-        printf("<<< PLAYBACK DEVICE STATE: alc_version=%d.%d device_specifier=%s extensions=%s >>>\n", (int) major_version, (int) minor_version, litString(devspec), litString(extensions));
+        outf("<<< PLAYBACK DEVICE STATE: alc_version=%d.%d device_specifier=%s extensions=%s >>>\n", (int) major_version, (int) minor_version, litString(devspec), litString(extensions));
     }
 }
 
 static void dump_alcCloseDevice(CallerInfo *callerinfo, ALCboolean retval, ALCdevice *device)
 {
-    printf("(%s) => %s\n", deviceString(device), alcboolString(retval));
+    outf("(%s) => %s\n", deviceString(device), alcboolString(retval));
 }
 
 static void dump_alcCreateContext(CallerInfo *callerinfo, ALCcontext *retval, ALCdevice *device, const ALCint *origattrlist, uint32 attrcount, const ALCint *attrlist)
 {
-    printf("(%s, %s", deviceString(device), ptrString(origattrlist));
+    outf("(%s, %s", deviceString(device), ptrString(origattrlist));
     if (origattrlist) {
         ALCint i;
-        printf(" {");
+        outf(" {");
         for (i = 0; i < attrcount; i += 2) {
-            printf(" %s, %u,", alcenumString(attrlist[i]), (uint) attrlist[i+1]);
+            outf(" %s, %u,", alcenumString(attrlist[i]), (uint) attrlist[i+1]);
         }
-        printf(" 0 }");
+        outf(" 0 }");
     }
-    printf(") => %s\n", ctxString(retval));
+    outf(") => %s\n", ctxString(retval));
 }
 
 static void dump_alcMakeContextCurrent(CallerInfo *callerinfo, ALCboolean retval, ALCcontext *ctx)
 {
-    printf("(%s) => %s\n", ctxString(ctx), alcboolString(retval));
+    outf("(%s) => %s\n", ctxString(ctx), alcboolString(retval));
 }
 
 static void dump_alcProcessContext(CallerInfo *callerinfo, ALCcontext *ctx)
 {
-    printf("(%s)\n", ctxString(ctx));
+    outf("(%s)\n", ctxString(ctx));
 }
 
 static void dump_alcSuspendContext(CallerInfo *callerinfo, ALCcontext *ctx)
 {
-    printf("(%s)\n", ctxString(ctx));
+    outf("(%s)\n", ctxString(ctx));
 }
 
 static void dump_alcDestroyContext(CallerInfo *callerinfo, ALCcontext *ctx)
 {
-    printf("(%s)\n", ctxString(ctx));
+    outf("(%s)\n", ctxString(ctx));
 }
 
 static void dump_alcGetError(CallerInfo *callerinfo, ALCenum retval, ALCdevice *device)
 {
-    printf("(%s) => %s\n", deviceString(device), alcboolString(retval));
+    outf("(%s) => %s\n", deviceString(device), alcboolString(retval));
 }
 
 static void dump_alcGetIntegerv(CallerInfo *callerinfo, ALCdevice *device, ALCenum param, ALCsizei size, ALCint *origvalues, ALCboolean isbool, ALCint *values)
 {
     ALCsizei i;
-    printf("(%s, %s, %u, %s)", deviceString(device), alcenumString(param), (uint) size, ptrString(origvalues));
+    outf("(%s, %s, %u, %s)", deviceString(device), alcenumString(param), (uint) size, ptrString(origvalues));
     if (origvalues) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < size; i++) {
             if (isbool) {
-                printf("%s %s", i > 0 ? "," : "", alcboolString((ALCenum) values[i]));
+                outf("%s %s", i > 0 ? "," : "", alcboolString((ALCenum) values[i]));
             } else {
-                printf("%s %d", i > 0 ? "," : "", values[i]);
+                outf("%s %d", i > 0 ? "," : "", values[i]);
             }
         }
-        printf("%s}", size > 0 ? " " : "");
+        outf("%s}", size > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alcCaptureStart(CallerInfo *callerinfo, ALCdevice *device)
 {
-    printf("(%s)\n", deviceString(device));
+    outf("(%s)\n", deviceString(device));
 }
 
 static void dump_alcCaptureStop(CallerInfo *callerinfo, ALCdevice *device)
 {
-    printf("(%s)\n", deviceString(device));
+    outf("(%s)\n", deviceString(device));
 }
 
-static void dump_alcCaptureSamples(CallerInfo *callerinfo, ALCdevice *device, ALCvoid *origbuffer, ALCvoid *buffer, ALCsizei bufferlen, ALCsizei samples)
+static void dump_alcCaptureSamples(CallerInfo *callerinfo, ALCdevice *device, ALCvoid *origbuffer, const TraceBlob *buffer, ALCsizei bufferlen, ALCsizei samples)
 {
-    printf("(%s, %s, %u)\n", deviceString(device), ptrString(origbuffer), (uint) samples);
+    outf("(%s, %s, %u)\n", deviceString(device), ptrString(origbuffer), (uint) samples);
 }
 
 static void dump_alDopplerFactor(CallerInfo *callerinfo, ALfloat value)
 {
-    printf("(%f)\n", value);
+    outf("(%f)\n", value);
 }
 
 static void dump_alDopplerVelocity(CallerInfo *callerinfo, ALfloat value)
 {
-    printf("(%f)\n", value);
+    outf("(%f)\n", value);
 }
 
 static void dump_alSpeedOfSound(CallerInfo *callerinfo, ALfloat value)
 {
-    printf("(%f)\n", value);
+    outf("(%f)\n", value);
 }
 
 static void dump_alDistanceModel(CallerInfo *callerinfo, ALenum model)
 {
-    printf("(%s)\n", alenumString(model));
+    outf("(%s)\n", alenumString(model));
 }
 
 static void dump_alEnable(CallerInfo *callerinfo, ALenum capability)
 {
-    printf("(%s)\n", alenumString(capability));
+    outf("(%s)\n", alenumString(capability));
 }
 
 static void dump_alDisable(CallerInfo *callerinfo, ALenum capability)
 {
-    printf("(%s)\n", alenumString(capability));
+    outf("(%s)\n", alenumString(capability));
 }
 
 static void dump_alIsEnabled(CallerInfo *callerinfo, ALboolean retval, ALenum capability)
 {
-    printf("(%s) => %s\n", alenumString(capability), alboolString(retval));
+    outf("(%s) => %s\n", alenumString(capability), alboolString(retval));
 }
 
 static void dump_alGetString(CallerInfo *callerinfo, const ALchar *retval, const ALenum param)
 {
-    printf("(%s) => %s\n", alenumString(param), litString(retval));
+    outf("(%s) => %s\n", alenumString(param), litString(retval));
 }
 
 static void dump_alGetBooleanv(CallerInfo *callerinfo, ALenum param, ALboolean *origvalues, uint32 numvals, ALboolean *values)
 {
     uint32 i;
-    printf("(%s, %s) => {", alenumString(param), ptrString(origvalues));
+    outf("(%s, %s) => {", alenumString(param), ptrString(origvalues));
     for (i = 0; i < numvals; i++) {
-        printf("%s %s", i > 0 ? "," : "", alboolString(values[i]));
+        outf("%s %s", i > 0 ? "," : "", alboolString(values[i]));
     }
-    printf("%s}\n", numvals > 0 ? " " : "");
+    outf("%s}\n", numvals > 0 ? " " : "");
 }
 
 static void dump_alGetIntegerv(CallerInfo *callerinfo, ALenum param, ALint *origvalues, uint32 numvals, ALboolean isenum, ALint *values)
 {
     uint32 i;
-    printf("(%s, %s) => {", alenumString(param), ptrString(origvalues));
+    outf("(%s, %s) => {", alenumString(param), ptrString(origvalues));
     for (i = 0; i < numvals; i++) {
         if (isenum) {
-            printf("%s %s", i > 0 ? "," : "", alenumString((ALenum) values[i]));
+            outf("%s %s", i > 0 ? "," : "", alenumString((ALenum) values[i]));
         } else {
-            printf("%s %d", i > 0 ? "," : "", (int) values[i]);
+            outf("%s %d", i > 0 ? "," : "", (int) values[i]);
         }
     }
-    printf("%s}\n", numvals > 0 ? " " : "");
+    outf("%s}\n", numvals > 0 ? " " : "");
 }
 
 static void dump_alGetFloatv(CallerInfo *callerinfo, ALenum param, ALfloat *origvalues, uint32 numvals, ALfloat *values)
 {
     uint32 i;
-    printf("(%s, %s) => {", alenumString(param), ptrString(origvalues));
+    outf("(%s, %s) => {", alenumString(param), ptrString(origvalues));
     for (i = 0; i < numvals; i++) {
-        printf("%s %f", i > 0 ? "," : "", values[i]);
+        outf("%s %f", i > 0 ? "," : "", values[i]);
     }
-    printf("%s}\n", numvals > 0 ? " " : "");
+    outf("%s}\n", numvals > 0 ? " " : "");
 }
 
 static void dump_alGetDoublev(CallerInfo *callerinfo, ALenum param, ALdouble *origvalues, uint32 numvals, ALdouble *values)
 {
     uint32 i;
-    printf("(%s, %s) => {", alenumString(param), ptrString(origvalues));
+    outf("(%s, %s) => {", alenumString(param), ptrString(origvalues));
     for (i = 0; i < numvals; i++) {
-        printf("%s %f", i > 0 ? "," : "", values[i]);
+        outf("%s %f", i > 0 ? "," : "", values[i]);
     }
-    printf("%s}\n", numvals > 0 ? " " : "");
+    outf("%s}\n", numvals > 0 ? " " : "");
 }
 
 static void dump_alGetBoolean(CallerInfo *callerinfo, ALboolean retval, ALenum param)
 {
-    printf("(%s) => %s\n", alenumString(param), alboolString(retval));
+    outf("(%s) => %s\n", alenumString(param), alboolString(retval));
 }
 
 static void dump_alGetInteger(CallerInfo *callerinfo, ALint retval, ALenum param)
 {
-    printf("(%s) => %d\n", alenumString(param), (int) retval);
+    outf("(%s) => %d\n", alenumString(param), (int) retval);
 }
 
 static void dump_alGetFloat(CallerInfo *callerinfo, ALfloat retval, ALenum param)
 {
-    printf("(%s) => %f\n", alenumString(param), retval);
+    outf("(%s) => %f\n", alenumString(param), retval);
 }
 
 static void dump_alGetDouble(CallerInfo *callerinfo, ALdouble retval, ALenum param)
 {
-    printf("(%s) => %f\n", alenumString(param), retval);
+    outf("(%s) => %f\n", alenumString(param), retval);
 }
 
 static void dump_alIsExtensionPresent(CallerInfo *callerinfo, ALboolean retval, const ALchar *extname)
 {
-    printf("(%s) => %s\n", litString(extname), alboolString(retval));
+    outf("(%s) => %s\n", litString(extname), alboolString(retval));
 }
 
 static void dump_alGetError(CallerInfo *callerinfo, ALenum retval)
 {
-    printf("() => %s\n", alenumString(retval));
+    outf("() => %s\n", alenumString(retval));
 }
 
 static void dump_alGetProcAddress(CallerInfo *callerinfo, void *retval, const ALchar *funcname)
 {
-    printf("(%s) => %s\n", litString(funcname), ptrString(retval));
+    outf("(%s) => %s\n", litString(funcname), ptrString(retval));
 }
 
 static void dump_alGetEnumValue(CallerInfo *callerinfo, ALenum retval, const ALchar *enumname)
 {
-    printf("(%s) => %s\n", litString(enumname), alenumString(retval));
+    outf("(%s) => %s\n", litString(enumname), alenumString(retval));
 }
 
 static void dump_alListenerfv(CallerInfo *callerinfo, ALenum param, const ALfloat *origvalues, uint32 numvals, const ALfloat *values)
 {
     uint32 i;
-    printf("(%s, %s", alenumString(param), ptrString(origvalues));
-    if (origvalues) {
-        printf(" {");
+    outf("(%s, %s", alenumString(param), (origvalues || !values) ? ptrString(origvalues) : "(unrecorded)");  // motion updates don't have the app's pointer.
+    if (origvalues || values) {
+        outf(" {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %f", i > 0 ? "," : "", values[i]);
+            outf("%s %f", i > 0 ? "," : "", values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alListenerf(CallerInfo *callerinfo, ALenum param, ALfloat value)
 {
-    printf("(%s, %f)\n", alenumString(param), value);
+    outf("(%s, %f)\n", alenumString(param), value);
 }
 
 static void dump_alListener3f(CallerInfo *callerinfo, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
 {
-    printf("(%s, %f, %f, %f)\n", alenumString(param), value1, value2, value3);
+    outf("(%s, %f, %f, %f)\n", alenumString(param), value1, value2, value3);
 }
 
 static void dump_alListeneriv(CallerInfo *callerinfo, ALenum param, const ALint *origvalues, uint32 numvals, const ALint *values)
 {
     uint32 i;
-    printf("(%s, %s", alenumString(param), ptrString(origvalues));
+    outf("(%s, %s", alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %d", i > 0 ? "," : "", (int) values[i]);
+            outf("%s %d", i > 0 ? "," : "", (int) values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alListeneri(CallerInfo *callerinfo, ALenum param, ALint value)
 {
-    printf("(%s, %d)\n", alenumString(param), (int) value);
+    outf("(%s, %d)\n", alenumString(param), (int) value);
 }
 
 static void dump_alListener3i(CallerInfo *callerinfo, ALenum param, ALint value1, ALint value2, ALint value3)
 {
-    printf("(%s, %d, %d, %d)\n", alenumString(param), (int) value1, (int) value2, (int) value3);
+    outf("(%s, %d, %d, %d)\n", alenumString(param), (int) value1, (int) value2, (int) value3);
 }
 
 static void dump_alGetListenerfv(CallerInfo *callerinfo, ALenum param, ALfloat *origvalues, uint32 numvals, ALfloat *values)
 {
     uint32 i;
-    printf("(%s, %s)", alenumString(param), ptrString(origvalues));
+    outf("(%s, %s)", alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %f", i > 0 ? "," : "", values[i]);
+            outf("%s %f", i > 0 ? "," : "", values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alGetListenerf(CallerInfo *callerinfo, ALenum param, ALfloat *origvalue, ALfloat value)
 {
-    printf("(%s, %s) => { %f }\n", alenumString(param), ptrString(origvalue), value);
+    outf("(%s, %s) => { %f }\n", alenumString(param), ptrString(origvalue), value);
 }
 
 static void dump_alGetListener3f(CallerInfo *callerinfo, ALenum param, ALfloat *origvalue1, ALfloat *origvalue2, ALfloat *origvalue3, ALfloat value1, ALfloat value2, ALfloat value3)
 {
-    printf("(%s, %s, %s, %s) => { %f, %f, %f }\n", alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), value1, value2, value3);
+    outf("(%s, %s, %s, %s) => { %f, %f, %f }\n", alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), value1, value2, value3);
 }
 
 static void dump_alGetListeneri(CallerInfo *callerinfo, ALenum param, ALint *origvalue, ALint value)
 {
-    printf("(%s, %s) => { %d }\n", alenumString(param), ptrString(origvalue), (int) value);
+    outf("(%s, %s) => { %d }\n", alenumString(param), ptrString(origvalue), (int) value);
 }
 
 static void dump_alGetListeneriv(CallerInfo *callerinfo, ALenum param, ALint *origvalues, uint32 numvals, ALint *values)
 {
     uint32 i;
-    printf("(%s, %s)", alenumString(param), ptrString(origvalues));
+    outf("(%s, %s)", alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %d", i > 0 ? "," : "", (int) values[i]);
+            outf("%s %d", i > 0 ? "," : "", (int) values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alGetListener3i(CallerInfo *callerinfo, ALenum param, ALint *origvalue1, ALint *origvalue2, ALint *origvalue3, ALint value1, ALint value2, ALint value3)
 {
-    printf("(%s, %s, %s, %s) => { %d, %d, %d }\n", alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), (int) value1, (int) value2, (int) value3);
+    outf("(%s, %s, %s, %s) => { %d, %d, %d }\n", alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), (int) value1, (int) value2, (int) value3);
 }
 
 static void dump_alGenSources(CallerInfo *callerinfo, ALsizei n, ALuint *orignames, ALuint *names)
 {
     ALsizei i;
-    printf("(%u, %s)", (uint) n, ptrString(orignames));
+    outf("(%u, %s)", (uint) n, ptrString(orignames));
     if (orignames) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < n; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
+            outf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
         }
-        printf("%s}", n > 0 ? " " : "");
+        outf("%s}", n > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alDeleteSources(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    printf("(%u, %s", (uint) n, ptrString(orignames));
+    outf("(%u, %s", (uint) n, ptrString(orignames));
     if (orignames) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < n; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
+            outf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
         }
-        printf("%s}", n > 0 ? " " : "");
+        outf("%s}", n > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alIsSource(CallerInfo *callerinfo, ALboolean retval, ALuint name)
 {
-    printf("(%s) => %s\n", sourceString(name), alboolString(retval));
+    outf("(%s) => %s\n", sourceString(name), alboolString(retval));
 }
 
 static void dump_alSourcefv(CallerInfo *callerinfo, ALuint name, ALenum param, const ALfloat *origvalues, uint32 numvals, const ALfloat *values)
 {
     uint32 i;
-    printf("(%s, %s, %s", sourceString(name), alenumString(param), ptrString(origvalues));
+    outf("(%s, %s, %s", sourceString(name), alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %f", i > 0 ? "," : "", values[i]);
+            outf("%s %f", i > 0 ? "," : "", values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alSourcef(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat value)
 {
-    printf("(%s, %s, %f)\n", sourceString(name), alenumString(param), value);
+    outf("(%s, %s, %f)\n", sourceString(name), alenumString(param), value);
 }
 
 static void dump_alSource3f(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
 {
-    printf("(%s, %s, %f, %f, %f)\n", sourceString(name), alenumString(param), value1, value2, value3);
+    outf("(%s, %s, %f, %f, %f)\n", sourceString(name), alenumString(param), value1, value2, value3);
 }
 
 static void dump_alSourceiv(CallerInfo *callerinfo, ALuint name, ALenum param, const ALint *origvalues, uint32 numvals, const ALint *values)
 {
     uint32 i;
-    printf("(%s, %s, %s", sourceString(name), alenumString(param), ptrString(origvalues));
+    outf("(%s, %s, %s", sourceString(name), alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %d", i > 0 ? "," : "", (int) values[i]);
+            outf("%s %d", i > 0 ? "," : "", (int) values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alSourcei(CallerInfo *callerinfo, ALuint name, ALenum param, ALint value)
 {
     if (param == AL_BUFFER) {
-        printf("(%s, %s, %s)\n", sourceString(name), alenumString(param), bufferString((ALuint) value));
+        outf("(%s, %s, %s)\n", sourceString(name), alenumString(param), bufferString((ALuint) value));
     } else if (param == AL_LOOPING) {
-        printf("(%s, %s, %s)\n", sourceString(name), alenumString(param), alboolString((ALboolean) value));
+        outf("(%s, %s, %s)\n", sourceString(name), alenumString(param), alboolString((ALboolean) value));
     } else if (param == AL_SOURCE_RELATIVE) {
-        printf("(%s, %s, %s)\n", sourceString(name), alenumString(param), alenumString((ALenum) value));
+        outf("(%s, %s, %s)\n", sourceString(name), alenumString(param), alenumString((ALenum) value));
     } else if (param == AL_SOURCE_TYPE) {
-        printf("(%s, %s, %s)\n", sourceString(name), alenumString(param), alenumString((ALenum) value));
+        outf("(%s, %s, %s)\n", sourceString(name), alenumString(param), alenumString((ALenum) value));
     } else if (param == AL_SOURCE_STATE) {
-        printf("(%s, %s, %s)\n", sourceString(name), alenumString(param), alenumString((ALenum) value));
+        outf("(%s, %s, %s)\n", sourceString(name), alenumString(param), alenumString((ALenum) value));
     } else {
-        printf("(%s, %s, %d)\n", sourceString(name), alenumString(param), (int) value);
+        outf("(%s, %s, %d)\n", sourceString(name), alenumString(param), (int) value);
     }
 }
 
 static void dump_alSource3i(CallerInfo *callerinfo, ALuint name, ALenum param, ALint value1, ALint value2, ALint value3)
 {
-    printf("(%s, %s, %d, %d, %d)\n", sourceString(name), alenumString(param), (int) value1, (int) value2, (int) value3);
+    outf("(%s, %s, %d, %d, %d)\n", sourceString(name), alenumString(param), (int) value1, (int) value2, (int) value3);
 }
 
 static void dump_alGetSourcefv(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat *origvalues, uint32 numvals, ALfloat *values)
 {
     uint32 i;
-    printf("(%s, %s, %s)", sourceString(name), alenumString(param), ptrString(origvalues));
+    outf("(%s, %s, %s)", sourceString(name), alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %f", i > 0 ? "," : "", values[i]);
+            outf("%s %f", i > 0 ? "," : "", values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alGetSourcef(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat *origvalue, ALfloat value)
 {
-    printf("(%s, %s, %s) => { %f }\n", sourceString(name), alenumString(param), ptrString(origvalue), value);
+    outf("(%s, %s, %s) => { %f }\n", sourceString(name), alenumString(param), ptrString(origvalue), value);
 }
 
 static void dump_alGetSource3f(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat *origvalue1, ALfloat *origvalue2, ALfloat *origvalue3, ALfloat value1, ALfloat value2, ALfloat value3)
 {
-    printf("(%s, %s, %s, %s, %s) => { %f, %f, %f }\n", sourceString(name), alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), value1, value2, value3);
+    outf("(%s, %s, %s, %s, %s) => { %f, %f, %f }\n", sourceString(name), alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), value1, value2, value3);
 }
 
 static void dump_alGetSourceiv(CallerInfo *callerinfo, ALuint name, ALenum param, ALboolean isenum, ALint *origvalues, uint32 numvals, ALint *values)
 {
     uint32 i;
-    printf("(%s, %s, %s)", sourceString(name), alenumString(param), ptrString(origvalues));
+    outf("(%s, %s, %s)", sourceString(name), alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < numvals; i++) {
             if (isenum) {
-                printf("%s %s", i > 0 ? "," : "", alenumString((ALenum) values[i]));
+                outf("%s %s", i > 0 ? "," : "", alenumString((ALenum) values[i]));
             } else {
-                printf("%s %d", i > 0 ? "," : "", (int) values[i]);
+                outf("%s %d", i > 0 ? "," : "", (int) values[i]);
             }
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alGetSourcei(CallerInfo *callerinfo, ALuint name, ALenum param, ALboolean isenum, ALint *origvalue, ALint value)
 {
     if (isenum) {
-        printf("(%s, %s, %s) => { %s }\n", sourceString(name), alenumString(param), ptrString(origvalue), alenumString((ALenum) value));
+        outf("(%s, %s, %s) => { %s }\n", sourceString(name), alenumString(param), ptrString(origvalue), alenumString((ALenum) value));
     } else {
-        printf("(%s, %s, %s) => { %d }\n", sourceString(name), alenumString(param), ptrString(origvalue), (int) value);
+        outf("(%s, %s, %s) => { %d }\n", sourceString(name), alenumString(param), ptrString(origvalue), (int) value);
     }
 }
 
 static void dump_alGetSource3i(CallerInfo *callerinfo, ALuint name, ALenum param, ALint *origvalue1, ALint *origvalue2, ALint *origvalue3, ALint value1, ALint value2, ALint value3)
 {
-    printf("(%s, %s, %s, %s, %s) => { %d, %d, %d }\n", sourceString(name), alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), (int) value1, (int) value2, (int) value3);
+    outf("(%s, %s, %s, %s, %s) => { %d, %d, %d }\n", sourceString(name), alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), (int) value1, (int) value2, (int) value3);
 }
 
 static void dump_alSourcePlay(CallerInfo *callerinfo, ALuint name)
 {
-    printf("(%s)\n", sourceString(name));
+    outf("(%s)\n", sourceString(name));
 }
 
 static void dump_alSourcePlayv(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    printf("(%u, %s", (uint) n, ptrString(orignames));
+    outf("(%u, %s", (uint) n, ptrString(orignames));
     if (orignames) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < n; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
+            outf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
         }
-        printf("%s}", n > 0 ? " " : "");
+        outf("%s}", n > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alSourcePause(CallerInfo *callerinfo, ALuint name)
 {
-    printf("(%s)\n", sourceString(name));
+    outf("(%s)\n", sourceString(name));
 }
 
 static void dump_alSourcePausev(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    printf("(%u, %s", (uint) n, ptrString(orignames));
+    outf("(%u, %s", (uint) n, ptrString(orignames));
     if (orignames) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < n; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
+            outf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
         }
-        printf("%s}", n > 0 ? " " : "");
+        outf("%s}", n > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alSourceRewind(CallerInfo *callerinfo, ALuint name)
 {
-    printf("(%s)\n", sourceString(name));
+    outf("(%s)\n", sourceString(name));
 }
 
 static void dump_alSourceRewindv(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    printf("(%u, %s", (uint) n, ptrString(orignames));
+    outf("(%u, %s", (uint) n, ptrString(orignames));
     if (orignames) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < n; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
+            outf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
         }
-        printf("%s}", n > 0 ? " " : "");
+        outf("%s}", n > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alSourceStop(CallerInfo *callerinfo, ALuint name)
 {
-    printf("(%s)\n", sourceString(name));
+    outf("(%s)\n", sourceString(name));
 }
 
 static void dump_alSourceStopv(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    printf("(%u, %s", (uint) n, ptrString(orignames));
+    outf("(%u, %s", (uint) n, ptrString(orignames));
     if (orignames) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < n; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
+            outf("%s %s", i > 0 ? "," : "", sourceString(names[i]));
         }
-        printf("%s}", n > 0 ? " " : "");
+        outf("%s}", n > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alSourceQueueBuffers(CallerInfo *callerinfo, ALuint name, ALsizei nb, const ALuint *origbufnames, const ALuint *bufnames)
 {
     ALsizei i;
-    printf("(%s, %u, %s", sourceString(name), (uint) nb, ptrString(origbufnames));
+    outf("(%s, %u, %s", sourceString(name), (uint) nb, ptrString(origbufnames));
     if (origbufnames) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < nb; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", bufferString(bufnames[i]));
+            outf("%s %s", i > 0 ? "," : "", bufferString(bufnames[i]));
         }
-        printf("%s}", nb > 0 ? " " : "");
+        outf("%s}", nb > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alSourceUnqueueBuffers(CallerInfo *callerinfo, ALuint name, ALsizei nb, ALuint *origbufnames, ALuint *bufnames)
 {
     ALsizei i;
-    printf("(%s, %u, %s", sourceString(name), (uint) nb, ptrString(origbufnames));
+    outf("(%s, %u, %s", sourceString(name), (uint) nb, ptrString(origbufnames));
     if (origbufnames) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < nb; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", bufferString(bufnames[i]));
+            outf("%s %s", i > 0 ? "," : "", bufferString(bufnames[i]));
         }
-        printf("%s}", nb > 0 ? " " : "");
+        outf("%s}", nb > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alGenBuffers(CallerInfo *callerinfo, ALsizei n, ALuint *orignames, ALuint *names)
 {
     ALsizei i;
-    printf("(%u, %s)", (uint) n, ptrString(orignames));
+    outf("(%u, %s)", (uint) n, ptrString(orignames));
     if (orignames) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < n; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", bufferString(names[i]));
+            outf("%s %s", i > 0 ? "," : "", bufferString(names[i]));
         }
-        printf("%s}", n > 0 ? " " : "");
+        outf("%s}", n > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alDeleteBuffers(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    printf("(%u, %s", (uint) n, ptrString(orignames));
+    outf("(%u, %s", (uint) n, ptrString(orignames));
     if (orignames) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < n; i++) {
 #pragma warning can overflow ioblob array
-            printf("%s %s", i > 0 ? "," : "", bufferString(names[i]));
+            outf("%s %s", i > 0 ? "," : "", bufferString(names[i]));
         }
-        printf("%s}", n > 0 ? " " : "");
+        outf("%s}", n > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alIsBuffer(CallerInfo *callerinfo, ALboolean retval, ALuint name)
 {
-    printf("(%s) => %s\n", bufferString(name), alboolString(retval));
+    outf("(%s) => %s\n", bufferString(name), alboolString(retval));
 }
 
-static void dump_alBufferData(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const ALvoid *data, ALsizei size, ALsizei freq)
+static void dump_alBufferData(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const TraceBlob *data, ALsizei size, ALsizei freq)
 {
-    printf("(%s, %s, %s, %u, %u)\n", bufferString(name), alenumString(alfmt), ptrString(origdata), (uint) size, (uint) freq);
+    outf("(%s, %s, %s, %u, %u)\n", bufferString(name), alenumString(alfmt), ptrString(origdata), (uint) size, (uint) freq);
 }
 
 static void dump_alBufferfv(CallerInfo *callerinfo, ALuint name, ALenum param, const ALfloat *origvalues, uint32 numvals, const ALfloat *values)
 {
     uint32 i;
-    printf("(%s, %s, %s", bufferString(name), alenumString(param), ptrString(origvalues));
+    outf("(%s, %s, %s", bufferString(name), alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %f", i > 0 ? "," : "", values[i]);
+            outf("%s %f", i > 0 ? "," : "", values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alBufferf(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat value)
 {
-    printf("(%s, %s, %f)\n", bufferString(name), alenumString(param), value);
+    outf("(%s, %s, %f)\n", bufferString(name), alenumString(param), value);
 }
 
 static void dump_alBuffer3f(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
 {
-    printf("(%s, %s, %f, %f, %f)\n", bufferString(name), alenumString(param), value1, value2, value3);
+    outf("(%s, %s, %f, %f, %f)\n", bufferString(name), alenumString(param), value1, value2, value3);
 }
 
 static void dump_alBufferiv(CallerInfo *callerinfo, ALuint name, ALenum param, const ALint *origvalues, uint32 numvals, const ALint *values)
 {
     uint32 i;
-    printf("(%s, %s, %s", bufferString(name), alenumString(param), ptrString(origvalues));
+    outf("(%s, %s, %s", bufferString(name), alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" {");
+        outf(" {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %d", i > 0 ? "," : "", (int) values[i]);
+            outf("%s %d", i > 0 ? "," : "", (int) values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf(")\n");
+    outf(")\n");
 }
 
 static void dump_alBufferi(CallerInfo *callerinfo, ALuint name, ALenum param, ALint value)
 {
-    printf("(%s, %s, %d)\n", bufferString(name), alenumString(param), (int) value);
+    outf("(%s, %s, %d)\n", bufferString(name), alenumString(param), (int) value);
 }
 
 static void dump_alBuffer3i(CallerInfo *callerinfo, ALuint name, ALenum param, ALint value1, ALint value2, ALint value3)
 {
-    printf("(%s, %s, %d, %d, %d)\n", bufferString(name), alenumString(param), (int) value1, (int) value2, (int) value3);
+    outf("(%s, %s, %d, %d, %d)\n", bufferString(name), alenumString(param), (int) value1, (int) value2, (int) value3);
 }
 
 static void dump_alGetBufferfv(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat *origvalues, uint32 numvals, ALfloat *values)
 {
     uint32 i;
-    printf("(%s, %s, %s)", bufferString(name), alenumString(param), ptrString(origvalues));
+    outf("(%s, %s, %s)", bufferString(name), alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %f", i > 0 ? "," : "", values[i]);
+            outf("%s %f", i > 0 ? "," : "", values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alGetBufferf(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat *origvalue, ALfloat value)
 {
-    printf("(%s, %s, %s) => { %f }\n", bufferString(name), alenumString(param), ptrString(origvalue), value);
+    outf("(%s, %s, %s) => { %f }\n", bufferString(name), alenumString(param), ptrString(origvalue), value);
 }
 
 static void dump_alGetBuffer3f(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat *origvalue1, ALfloat *origvalue2, ALfloat *origvalue3, ALfloat value1, ALfloat value2, ALfloat value3)
 {
-    printf("(%s, %s, %s, %s, %s) => { %f, %f, %f }\n", bufferString(name), alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), value1, value2, value3);
+    outf("(%s, %s, %s, %s, %s) => { %f, %f, %f }\n", bufferString(name), alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), value1, value2, value3);
 }
 
 static void dump_alGetBufferi(CallerInfo *callerinfo, ALuint name, ALenum param, ALint *origvalue, ALint value)
 {
-    printf("(%s, %s, %s) => { %d }\n", bufferString(name), alenumString(param), ptrString(origvalue), (int) value);
+    outf("(%s, %s, %s) => { %d }\n", bufferString(name), alenumString(param), ptrString(origvalue), (int) value);
 }
 
 static void dump_alGetBuffer3i(CallerInfo *callerinfo, ALuint name, ALenum param, ALint *origvalue1, ALint *origvalue2, ALint *origvalue3, ALint value1, ALint value2, ALint value3)
 {
-    printf("(%s, %s, %s, %s, %s) => { %d, %d, %d }\n", bufferString(name), alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), (int) value1, (int) value2, (int) value3);
+    outf("(%s, %s, %s, %s, %s) => { %d, %d, %d }\n", bufferString(name), alenumString(param), ptrString(origvalue1), ptrString(origvalue2), ptrString(origvalue3), (int) value1, (int) value2, (int) value3);
 }
 
 static void dump_alGetBufferiv(CallerInfo *callerinfo, ALuint name, ALenum param, ALint *origvalues, uint32 numvals, ALint *values)
 {
     uint32 i;
-    printf("(%s, %s, %s)", bufferString(name), alenumString(param), ptrString(origvalues));
+    outf("(%s, %s, %s)", bufferString(name), alenumString(param), ptrString(origvalues));
     if (origvalues) {
-        printf(" => {");
+        outf(" => {");
         for (i = 0; i < numvals; i++) {
-            printf("%s %d", i > 0 ? "," : "", (int) values[i]);
+            outf("%s %d", i > 0 ? "," : "", (int) values[i]);
         }
-        printf("%s}", numvals > 0 ? " " : "");
+        outf("%s}", numvals > 0 ? " " : "");
     }
-    printf("\n");
+    outf("\n");
 }
 
 static void dump_alTracePushScope(CallerInfo *callerinfo, const ALchar *str)
 {
-    printf("(%s)\n", litString(str));
+    outf("(%s)\n", litString(str));
 }
 
 static void dump_alTracePopScope(CallerInfo *callerinfo)
 {
-    printf("()\n");
+    outf("()\n");
 }
 
 static void dump_alTraceMessage(CallerInfo *callerinfo, const ALchar *str)
 {
-    printf("(%s)\n", litString(str));
+    outf("(%s)\n", litString(str));
 }
 
 static void dump_alTraceBufferLabel(CallerInfo *callerinfo, ALuint name, const ALchar *str)
 {
-    printf("(%u, %s)\n", (uint) name, litString(str));
+    outf("(%u, %s)\n", (uint) name, litString(str));
 }
 
 static void dump_alTraceSourceLabel(CallerInfo *callerinfo, ALuint name, const ALchar *str)
 {
-    printf("(%u, %s)\n", (uint) name, litString(str));
+    outf("(%u, %s)\n", (uint) name, litString(str));
 }
 
 static void dump_alcTraceDeviceLabel(CallerInfo *callerinfo, ALCdevice *device, const ALCchar *str)
 {
-    printf("(%s, %s)\n", ptrString(device), litString(str));
+    outf("(%s, %s)\n", ptrString(device), litString(str));
 }
 
 static void dump_alcTraceContextLabel(CallerInfo *callerinfo, ALCcontext *ctx, const ALCchar *str)
 {
-    printf("(%s, %s)\n", ptrString(ctx), litString(str));
+    outf("(%s, %s)\n", ptrString(ctx), litString(str));
+}
+
+static void dump_alTraceRegisterZone(CallerInfo *callerinfo, ALuint retval, const ALchar *str)
+{
+    outf("(%s) => %u\n", litString(str), (uint) retval);
+}
+
+static void dump_alTraceZoneBegin(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds)
+{
+    outf("(%s)\n", zoneString(zone));
+}
+
+static void dump_alTraceZoneEnd(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds)
+{
+    outf("(%s)\n", zoneString(zone));
+}
+
+static void dump_alTraceFrameMark(CallerInfo *callerinfo, uint64 nanoseconds)
+{
+    outf("()\n");
+}
+
+static void dump_alTraceRegisterCounter(CallerInfo *callerinfo, ALuint retval, const ALchar *str)
+{
+    outf("(%s) => %u\n", litString(str), (uint) retval);
+}
+
+static void dump_alTraceCounter(CallerInfo *callerinfo, ALuint counter, ALdouble value)
+{
+    outf("(%s, %f)\n", counterString(counter), value);
 }
 
 
 // Visitors for playback on a real OpenAL implementation...
 
+// the names the real implementation gave us for the ones in the log.
+// don't bother doing a full hash map for devices and contexts, since you'll
+//  usually never have more than one or two and they live basically the entire
+//  lifetime of your app.
+static void free_hash_item_device(ALCdevice *from, ALCdevice *to) { /* no-op */ }
+SIMPLE_MAP(device, ALCdevice *, ALCdevice *)
+
+static void free_hash_item_context(ALCcontext *from, ALCcontext *to) { /* no-op */ }
+SIMPLE_MAP(context, ALCcontext *, ALCcontext *)
+
+static void free_hash_item_alname(ALuint from, ALuint to) { /* no-op */ }
+static uint8 hash_alname(const ALuint name) {
+    /* since these are usually small numbers that increment from 0, they distribute pretty well on their own. */
+    return (uint8) (name & 0xFF);
+}
+
+#define free_hash_item_source free_hash_item_alname
+#define hash_source hash_alname
+HASH_MAP(source, ALuint, ALuint)
+
+#define free_hash_item_buffer free_hash_item_alname
+#define hash_buffer hash_alname
+HASH_MAP(buffer, ALuint, ALuint)
+
+#define free_hash_item_zone free_hash_item_alname
+#define hash_zone hash_alname
+HASH_MAP(zone, ALuint, ALuint)
+
+#define free_hash_item_counter free_hash_item_alname
+#define hash_counter hash_alname
+HASH_MAP(counter, ALuint, ALuint)
+
+static void free_run_maps(void)
+{
+    free_device_map();
+    free_context_map();
+    free_source_map();
+    free_buffer_map();
+    free_zone_map();
+    free_counter_map();
+}
+
 static void run_alcGetCurrentContext(CallerInfo *callerinfo, ALCcontext *retval)
 {
     REAL_alcGetCurrentContext();
@@ -1085,9 +1626,10 @@ static void run_alcCaptureStop(CallerInfo *callerinfo, ALCdevice *device)
     REAL_alcCaptureStop(get_mapped_device(device));
 }
 
-static void run_alcCaptureSamples(CallerInfo *callerinfo, ALCdevice *device, ALCvoid *origbuffer, ALCvoid *buffer, ALCsizei bufferlen, ALCsizei samples)
+static void run_alcCaptureSamples(CallerInfo *callerinfo, ALCdevice *device, ALCvoid *origbuffer, const TraceBlob *buffer, ALCsizei bufferlen, ALCsizei samples)
 {
-    REAL_alcCaptureSamples(get_mapped_device(device), buffer, samples);
+    // (buffer) is what was recorded, not somewhere to put it; capture into scratch space.
+    REAL_alcCaptureSamples(get_mapped_device(device), scratch_alloc((size_t) bufferlen), samples);
 }
 
 static void run_alDopplerFactor(CallerInfo *callerinfo, ALfloat value)
@@ -1253,7 +1795,7 @@ static void run_alGetListener3i(CallerInfo *callerinfo, ALenum param, ALint *ori
 static void run_alGenSources(CallerInfo *callerinfo, ALsizei n, ALuint *orignames, ALuint *names)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * n);
     memset(realnames, '\0', sizeof (ALuint) * n);
     REAL_alGenSources(n, realnames);
     for (i = 0; i < n; i++) {
@@ -1269,7 +1811,7 @@ static void run_alGenSources(CallerInfo *callerinfo, ALsizei n, ALuint *origname
 static void run_alDeleteSources(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * n);
     for (i = 0; i < n; i++) {
         realnames[i] = get_mapped_source(names[i]);
     }
@@ -1379,7 +1921,7 @@ static void run_alSourcePlay(CallerInfo *callerinfo, ALuint name)
 static void run_alSourcePlayv(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * n);
     for (i = 0; i < n; i++) {
         realnames[i] = get_mapped_source(names[i]);
     }
@@ -1394,7 +1936,7 @@ static void run_alSourcePause(CallerInfo *callerinfo, ALuint name)
 static void run_alSourcePausev(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * n);
     for (i = 0; i < n; i++) {
         realnames[i] = get_mapped_source(names[i]);
     }
@@ -1409,7 +1951,7 @@ static void run_alSourceRewind(CallerInfo *callerinfo, ALuint name)
 static void run_alSourceRewindv(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * n);
     for (i = 0; i < n; i++) {
         realnames[i] = get_mapped_source(names[i]);
     }
@@ -1424,7 +1966,7 @@ static void run_alSourceStop(CallerInfo *callerinfo, ALuint name)
 static void run_alSourceStopv(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * n);
     for (i = 0; i < n; i++) {
         realnames[i] = get_mapped_source(names[i]);
     }
@@ -1434,7 +1976,7 @@ static void run_alSourceStopv(CallerInfo *callerinfo, ALsizei n, const ALuint *o
 static void run_alSourceQueueBuffers(CallerInfo *callerinfo, ALuint name, ALsizei nb, const ALuint *origbufnames, const ALuint *bufnames)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * nb);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * nb);
     for (i = 0; i < nb; i++) {
         realnames[i] = get_mapped_buffer(bufnames[i]);
     }
@@ -1449,7 +1991,7 @@ static void run_alSourceUnqueueBuffers(CallerInfo *callerinfo, ALuint name, ALsi
 static void run_alGenBuffers(CallerInfo *callerinfo, ALsizei n, ALuint *orignames, ALuint *names)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * n);
     memset(realnames, '\0', sizeof (ALuint) * n);
     REAL_alGenBuffers(n, realnames);
     for (i = 0; i < n; i++) {
@@ -1465,7 +2007,7 @@ static void run_alGenBuffers(CallerInfo *callerinfo, ALsizei n, ALuint *origname
 static void run_alDeleteBuffers(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names)
 {
     ALsizei i;
-    ALuint *realnames = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    ALuint *realnames = (ALuint *) scratch_alloc(sizeof (ALuint) * n);
     for (i = 0; i < n; i++) {
         realnames[i] = get_mapped_source(names[i]);
     }
@@ -1477,9 +2019,9 @@ static void run_alIsBuffer(CallerInfo *callerinfo, ALboolean retval, ALuint name
     REAL_alIsBuffer(get_mapped_buffer(name));
 }
 
-static void run_alBufferData(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const ALvoid *data, ALsizei size, ALsizei freq)
+static void run_alBufferData(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const TraceBlob *data, ALsizei size, ALsizei freq)
 {
-    REAL_alBufferData(get_mapped_buffer(name), alfmt, data, size, freq);
+    REAL_alBufferData(get_mapped_buffer(name), alfmt, altrace_blob_map(reader, data), size, freq);
 }
 
 static void run_alBufferfv(CallerInfo *callerinfo, ALuint name, ALenum param, const ALfloat *origvalues, uint32 numvals, const ALfloat *values)
@@ -1577,6 +2119,36 @@ static void run_alcTraceContextLabel(CallerInfo *callerinfo, ALCcontext *ctx, co
     if (REAL_alcTraceContextLabel) { REAL_alcTraceContextLabel(get_mapped_context(ctx), str); }
 }
 
+static void run_alTraceRegisterZone(CallerInfo *callerinfo, ALuint retval, const ALchar *str)
+{
+    if (REAL_alTraceRegisterZone) { add_zone_to_map(retval, REAL_alTraceRegisterZone(str)); }
+}
+
+static void run_alTraceZoneBegin(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds)
+{
+    if (REAL_alTraceZoneBegin) { REAL_alTraceZoneBegin(get_mapped_zone(zone)); }
+}
+
+static void run_alTraceZoneEnd(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds)
+{
+    if (REAL_alTraceZoneEnd) { REAL_alTraceZoneEnd(get_mapped_zone(zone)); }
+}
+
+static void run_alTraceFrameMark(CallerInfo *callerinfo, uint64 nanoseconds)
+{
+    if (REAL_alTraceFrameMark) { REAL_alTraceFrameMark(); }
+}
+
+static void run_alTraceRegisterCounter(CallerInfo *callerinfo, ALuint retval, const ALchar *str)
+{
+    if (REAL_alTraceRegisterCounter) { add_counter_to_map(retval, REAL_alTraceRegisterCounter(str)); }
+}
+
+static void run_alTraceCounter(CallerInfo *callerinfo, ALuint counter, ALdouble value)
+{
+    if (REAL_alTraceCounter) { REAL_alTraceCounter(get_mapped_counter(counter), value); }
+}
+
 
 
 static void dump_callerinfo(const CallerInfo *callerinfo, const char *fn)
@@ -1587,51 +2159,539 @@ static void dump_callerinfo(const CallerInfo *callerinfo, const char *fn)
         const int frames = callerinfo->num_callstack_frames;
         int framei;
         for (i = 0; i < callerinfo->trace_scope; i++) {
-            printf("    ");
+            outf("    ");
         }
 
-        printf("Call from threadid = %u, stack = {\n", (uint) callerinfo->threadid);
+        outf("Call from threadid = %u", (uint) callerinfo->threadid);
+        if (callerinfo->has_sched_context) {
+            if (callerinfo->cpu == 0xFFFFFFFF) {
+                outf(", cpu = ?");
+            } else {
+                outf(", cpu = %u", (uint) callerinfo->cpu);
+            }
+            outf(", %s priority %u, context switches = +%u voluntary +%u involuntary",
+                   schedPolicyString(callerinfo->sched_policy), (uint) callerinfo->sched_priority,
+                   (uint) callerinfo->voluntary_csw, (uint) callerinfo->involuntary_csw);
+        }
+        outf(", stack = {\n");
 
         for (framei = 0; framei < frames; framei++) {
             void *ptr = callerinfo->callstack[framei].frame;
             const char *str = callerinfo->callstack[framei].sym;
             for (i = 0; i < callerinfo->trace_scope; i++) {
-                printf("    ");
+                outf("    ");
             }
-            printf("    %s\n", str ? str : ptrString(ptr));
+            outf("    %s\n", str ? str : ptrString(ptr));
         }
 
         for (i = 0; i < callerinfo->trace_scope; i++) {
-            printf("    ");
+            outf("    ");
         }
-        printf("}\n");
+        outf("}\n");
     }
 
     if (dump_calls) {
         for (i = 0; i < callerinfo->trace_scope; i++) {
-            printf("    ");
+            outf("    ");
+        }
+        outf("%s", fn);
+    }
+}
+
+// --frame-stats attributes calls to the frames between alTraceFrameMark()
+//  calls, and to whatever zones are open when they're made.
+typedef struct FrameStats
+{
+    uint64 start;
+    uint64 duration;
+    uint64 calls;
+} FrameStats;
+
+typedef struct ZoneStats
+{
+    uint64 count;
+    uint64 total_ns;
+    uint64 calls;
+    uint32 depth;  // zones can nest (or recurse); we time from the outermost begin.
+    uint64 start;
+    char *name;  // the playback code's copy goes away before we print.
+} ZoneStats;
+
+static FrameStats *frames = NULL;
+static uint32 num_frames = 0;
+static int frame_started = 0;
+static uint64 frame_start = 0;
+static uint64 frame_calls = 0;
+static uint64 calls_before_first_frame = 0;
+static ZoneStats *zones = NULL;
+static ALuint num_zones = 0;
+
+static ZoneStats *get_zone_stats(const ALuint zone)
+{
+    if (zone == 0) {
+        return NULL;
+    } else if (zone > num_zones) {
+        void *ptr = realloc(zones, zone * sizeof (ZoneStats));
+        if (!ptr) {
+            out_of_memory();
+        }
+        zones = (ZoneStats *) ptr;
+        memset(zones + num_zones, '\0', (zone - num_zones) * sizeof (ZoneStats));
+        num_zones = zone;
+    }
+    return &zones[zone - 1];
+}
+
+static void print_frame_stats(void)
+{
+    uint64 total_duration = 0;
+    uint64 total_calls = 0;
+    uint32 worst[10];
+    uint32 num_worst = 0;
+    uint32 i, j;
+
+    if (!frame_started) {
+        outf("No frames in this trace. Call alTraceFrameMark() once per frame to get them.\n");
+    } else {
+        // keep the slowest few frames, sorted slowest first.
+        for (i = 0; i < num_frames; i++) {
+            total_duration += frames[i].duration;
+            total_calls += frames[i].calls;
+            for (j = num_worst; (j > 0) && (frames[worst[j-1]].duration < frames[i].duration); j--) {
+                if (j < (sizeof (worst) / sizeof (worst[0]))) {
+                    worst[j] = worst[j-1];
+                }
+            }
+            if (j < (sizeof (worst) / sizeof (worst[0]))) {
+                worst[j] = i;
+                if (num_worst < (sizeof (worst) / sizeof (worst[0]))) {
+                    num_worst++;
+                }
+            }
+        }
+
+        outf("%u complete frames, %llu calls before the first frame, %llu calls after the last.\n",
+               (uint) num_frames, (unsigned long long) calls_before_first_frame, (unsigned long long) frame_calls);
+        if (num_frames) {
+            outf("Average frame: %.3f ms, %.1f calls.\n\n", (total_duration / num_frames) / 1000000.0, ((double) total_calls) / num_frames);
+            outf("Slowest frames:\n");
+            outf("   frame   start s     ms  calls\n");
+            for (i = 0; i < num_worst; i++) {
+                const FrameStats *frame = &frames[worst[i]];
+                outf("%8u  %8.3f  %5.2f  %5llu\n", (uint) worst[i], frame->start / 1000000000.0,
+                       frame->duration / 1000000.0, (unsigned long long) frame->calls);
+            }
+        }
+        outf("\n");
+    }
+
+    if (num_zones) {
+        outf("Zones:\n");
+        outf("   entered   total ms   avg us      calls  zone\n");
+        for (i = 0; i < num_zones; i++) {
+            const ZoneStats *zone = &zones[i];
+            if (zone->count) {
+                outf("%10llu %10.3f %8.1f %10llu  %s\n", (unsigned long long) zone->count,
+                       zone->total_ns / 1000000.0, (zone->total_ns / zone->count) / 1000.0,
+                       (unsigned long long) zone->calls, zone->name ? zone->name : "?");
+            }
+            arena_release(zone->name);
+        }
+    }
+
+    free(frames);
+    frames = NULL;
+    num_frames = 0;
+    free(zones);
+    zones = NULL;
+    num_zones = 0;
+}
+
+// --chart-resources, --frame-stats and --dump-counters tally calls as they go
+//  by. Most entry points just count, but a few need a closer look, so their
+//  generic versions get renamed out of the way.
+static void tally_call(void)
+{
+    ALuint i;
+    chart_calls++;
+    frame_calls++;
+    for (i = 0; i < num_zones; i++) {
+        if (zones[i].depth) {
+            zones[i].calls++;
+        }
+    }
+}
+
+#define tally_alBufferData tally_alBufferData_generic
+#define tally_alTraceRegisterZone tally_alTraceRegisterZone_generic
+#define tally_alTraceZoneBegin tally_alTraceZoneBegin_generic
+#define tally_alTraceZoneEnd tally_alTraceZoneEnd_generic
+#define tally_alTraceFrameMark tally_alTraceFrameMark_generic
+#define tally_alTraceCounter tally_alTraceCounter_generic
+#define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) \
+    static inline void tally_##name visitparams { tally_call(); }
+#include "altrace_entrypoints.h"
+#undef tally_alBufferData
+#undef tally_alTraceRegisterZone
+#undef tally_alTraceZoneBegin
+#undef tally_alTraceZoneEnd
+#undef tally_alTraceFrameMark
+#undef tally_alTraceCounter
+
+static void tally_alBufferData(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const TraceBlob *data, ALsizei size, ALsizei freq)
+{
+    tally_call();
+    chart_upload_bytes += (uint64) size;
+}
+
+static void tally_alTraceRegisterZone(CallerInfo *callerinfo, ALuint retval, const ALchar *str)
+{
+    ZoneStats *stats = get_zone_stats(retval);
+    tally_call();
+    if (stats && !stats->name) {
+        const char *name = zoneString(retval);
+        stats->name = (char *) arena_retain(name, strlen(name) + 1);  // outlives this event.
+    }
+}
+
+static void tally_alTraceZoneBegin(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds)
+{
+    ZoneStats *stats = get_zone_stats(zone);
+    if (stats && (stats->depth++ == 0)) {
+        stats->start = nanoseconds;
+    }
+}
+
+static void tally_alTraceZoneEnd(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds)
+{
+    ZoneStats *stats = get_zone_stats(zone);
+    if (stats && stats->depth && (--stats->depth == 0)) {
+        stats->count++;
+        stats->total_ns += nanoseconds - stats->start;
+    }
+}
+
+static void tally_alTraceFrameMark(CallerInfo *callerinfo, uint64 nanoseconds)
+{
+    if (!frame_started) {
+        calls_before_first_frame = frame_calls;
+        frame_started = 1;
+    } else {
+        FrameStats *frame;
+        void *ptr = realloc(frames, (num_frames + 1) * sizeof (FrameStats));
+        if (!ptr) {
+            out_of_memory();
         }
-        printf("%s", fn);
+        frames = (FrameStats *) ptr;
+        frame = &frames[num_frames++];
+        frame->start = frame_start;
+        frame->duration = nanoseconds - frame_start;
+        frame->calls = frame_calls;
+    }
+    frame_start = nanoseconds;
+    frame_calls = 0;
+}
+
+// --dump-counters writes one tab-separated line per sample, ready to paste
+//  into a spreadsheet or feed to gnuplot.
+static void tally_alTraceCounter(CallerInfo *callerinfo, ALuint counter, ALdouble value)
+{
+    tally_call();
+    if (dump_counters) {
+        const char *name = counterName(counter);
+        outf("%.3f\t%s\t%.15g\n", callerinfo->wait_until / 1000.0, name ? name : counterString(counter), value);
     }
 }
 
 #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) \
     void visit_##name visitparams { \
         dump_callerinfo(callerinfo, #name); \
+        if (chart_resources || frame_stats || dump_counters) { tally_##name visitargs; } \
         if (dump_calls) { dump_##name visitargs; } \
         if (run_calls) { \
             wait_until(callerinfo->wait_until); \
             run_##name visitargs; \
         } \
-        if (dumping) { fflush(stdout); } \
+        if (flush_every_call) { out_flush(); } \
     }
 
 #include "altrace_entrypoints.h"
 
 
+// --benchmark decodes the whole file with nothing to print, to see how fast
+//  the playback code can chew through a log. Add --threads to decode a
+//  chunked log on that many threads.
+static int run_benchmark(const char *fname)
+{
+    struct stat statbuf;
+    uint64 startns, elapsedns;
+    double mb, seconds;
+
+    if (stat(fname, &statbuf) == -1) {
+        fprintf(stderr, "%s: Failed to stat '%s': %s\n", GAppName, fname, strerror(errno));
+        return 1;
+    } else if (!init_clock()) {
+        return 1;
+    }
+
+    dump_calls = dump_callers = dump_errors = dump_state_changes = dump_perf = dump_latency = 0;
+    chart_resources = frame_stats = dump_counters = run_calls = 0;
+    dumping = 0;
+
+    startns = now_ns();
+    if (!process_tracelog_parallel(fname, NULL, numthreads)) {
+        return 1;
+    }
+    elapsedns = now_ns() - startns;
+
+    mb = ((double) statbuf.st_size) / (1024.0 * 1024.0);
+    seconds = ((double) (elapsedns ? elapsedns : 1)) / 1000000000.0;
+    outf("%s: decoded %.2f MB in %.3f seconds: %.1f MB/s\n", fname, mb, seconds, mb / seconds);
+    return 0;
+}
+
+// --threads for dumps: this thread decodes events into batches, in order,
+//  worker threads format whole batches into buffers of their own, and this
+//  thread writes those out in the order they were decoded. Each event keeps
+//  the labels it was decoded with, since a batch can be formatted long after
+//  the reader has moved on; everything else the visitors need (thread ids,
+//  scope depth, callstack symbols) is already in the event.
+#define DUMP_BATCH_EVENTS 1024
+
+typedef struct DumpBatch
+{
+    TraceEvent *events;
+    TraceLabels **labels;  // one for each event, shared between them.
+    uint32 numevents;
+    Arena arena;  // what the events point to.
+    OutBuffer output;
+    int formatted;
+} DumpBatch;
+
+typedef struct DumpPipeline
+{
+    DumpBatch *batches;  // a ring of them, so decoding can't get too far ahead.
+    uint32 numbatches;
+    uint64 submitted;  // batches handed to the workers so far.
+    uint64 next_to_format;
+    uint64 written;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} DumpPipeline;
+
+static void *dump_worker_thread(void *arg)
+{
+    DumpPipeline *dp = (DumpPipeline *) arg;
+    Arena scratch = { NULL, NULL, 0, 0 };
+
+    arena_use(&scratch);
+
+    pthread_mutex_lock(&dp->lock);
+    while (1) {
+        DumpBatch *batch;
+        uint32 i;
+
+        while (!dp->stop && (dp->next_to_format == dp->submitted)) {
+            pthread_cond_wait(&dp->cond, &dp->lock);
+        }
+        if (dp->next_to_format == dp->submitted) {
+            break;  // stopping, and nothing left to do.
+        }
+
+        batch = &dp->batches[dp->next_to_format++ % dp->numbatches];
+        pthread_mutex_unlock(&dp->lock);
+
+        out = &batch->output;
+        for (i = 0; i < batch->numevents; i++) {
+            altrace_use_labels(batch->labels[i]);
+            altrace_visit_event(&batch->events[i], NULL);
+            arena_reset(&scratch);
+        }
+        altrace_use_labels(NULL);
+        out = &stdout_buffer;
+
+        pthread_mutex_lock(&dp->lock);
+        batch->formatted = 1;
+        pthread_cond_broadcast(&dp->cond);
+    }
+    pthread_mutex_unlock(&dp->lock);
+
+    arena_use(NULL);
+    arena_free(&scratch);
+    return NULL;
+}
+
+// write out every formatted batch whose turn it is. If (wait), block until
+//  at least the next one is ready. Call with (dp->lock) held.
+static void write_dump_batches(DumpPipeline *dp, const int wait)
+{
+    while (dp->written < dp->submitted) {
+        DumpBatch *batch = &dp->batches[dp->written % dp->numbatches];
+        uint32 i;
+
+        if (!batch->formatted) {
+            if (!wait) {
+                break;
+            }
+            pthread_cond_wait(&dp->cond, &dp->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&dp->lock);
+        fwrite(batch->output.data, 1, batch->output.len, stdout);
+        batch->output.len = 0;
+        for (i = 0; i < batch->numevents; i++) {
+            altrace_free_labels(batch->labels[i]);
+        }
+        batch->numevents = 0;
+        batch->formatted = 0;
+        arena_free(&batch->arena);
+        pthread_mutex_lock(&dp->lock);
+
+        dp->written++;
+        if (wait == 1) {
+            break;  // made room for one more; back to decoding.
+        }
+    }
+}
+
+static int run_dump_pipeline(TraceReader *reader)
+{
+    DumpPipeline dp;
+    pthread_t *threads;
+    DumpBatch *batch = NULL;
+    TraceEvent *ev;
+    int retval = 0;
+    int i;
+
+    memset(&dp, '\0', sizeof (dp));
+    dp.numbatches = (uint32) numthreads * 2;
+    dp.batches = (DumpBatch *) calloc(dp.numbatches, sizeof (DumpBatch));
+    threads = (pthread_t *) calloc((size_t) numthreads, sizeof (pthread_t));
+    if (!dp.batches || !threads) {
+        out_of_memory();
+    }
+
+    for (i = 0; i < (int) dp.numbatches; i++) {
+        dp.batches[i].events = (TraceEvent *) malloc(sizeof (TraceEvent) * DUMP_BATCH_EVENTS);
+        dp.batches[i].labels = (TraceLabels **) malloc(sizeof (TraceLabels *) * DUMP_BATCH_EVENTS);
+        if (!dp.batches[i].events || !dp.batches[i].labels) {
+            out_of_memory();
+        }
+    }
+
+    pthread_mutex_init(&dp.lock, NULL);
+    pthread_cond_init(&dp.cond, NULL);
+
+    for (i = 0; i < numthreads; i++) {
+        if (pthread_create(&threads[i], NULL, dump_worker_thread, &dp) != 0) {
+            fprintf(stderr, "%s: Failed to create a formatting thread: %s\n", GAppName, strerror(errno));
+            break;
+        }
+    }
+
+    if (i == 0) {
+        retval = altrace_process(reader, NULL);  // no threads at all? Do it the slow way.
+    } else {
+        out_flush();  // anything we printed before starting goes first.
+        altrace_keep_events(reader, 1);
+
+        while (altrace_next_event(reader, &ev)) {
+            if (!batch) {
+                pthread_mutex_lock(&dp.lock);
+                if ((dp.submitted - dp.written) >= dp.numbatches) {
+                    write_dump_batches(&dp, 1);  // out of batches; wait for the oldest to go out.
+                }
+                pthread_mutex_unlock(&dp.lock);
+                batch = &dp.batches[dp.submitted % dp.numbatches];
+            }
+
+            altrace_copy_event(&batch->events[batch->numevents], ev);
+            batch->labels[batch->numevents] = altrace_snapshot_labels(reader);
+            batch->numevents++;
+
+            if (ev->type == ALEE_EOS) {
+                retval = ev->u.eos.okay ? 1 : 0;
+            }
+
+            if ((batch->numevents == DUMP_BATCH_EVENTS) || (ev->type == ALEE_EOS)) {
+                altrace_take_events(reader, &batch->arena);
+                pthread_mutex_lock(&dp.lock);
+                dp.submitted++;
+                pthread_cond_broadcast(&dp.cond);
+                write_dump_batches(&dp, 0);
+                pthread_mutex_unlock(&dp.lock);
+                batch = NULL;
+            }
+        }
+
+        pthread_mutex_lock(&dp.lock);
+        dp.stop = 1;
+        pthread_cond_broadcast(&dp.cond);
+        write_dump_batches(&dp, 2);
+        pthread_mutex_unlock(&dp.lock);
+
+        altrace_keep_events(reader, 0);
+    }
+
+    while (i > 0) {
+        pthread_join(threads[--i], NULL);
+    }
+
+    for (i = 0; i < (int) dp.numbatches; i++) {
+        free(dp.batches[i].events);
+        free(dp.batches[i].labels);
+        free(dp.batches[i].output.data);
+    }
+    free(dp.batches);
+    free(threads);
+    pthread_mutex_destroy(&dp.lock);
+    pthread_cond_destroy(&dp.cond);
+
+    fflush(stdout);
+    return retval;
+}
+
+// Tell the reader about anything we aren't going to look at, so it can skip
+//  right over those events instead of decoding them.
+static void want_events(TraceReader *reader)
+{
+    const int calls = dump_calls || dump_callers || run_calls || chart_resources || frame_stats || dump_counters;
+
+    #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) altrace_want_event(reader, ALEE_##name, calls);
+    #include "altrace_entrypoints.h"
+
+    altrace_want_event(reader, ALEE_ALERROR_TRIGGERED, dump_errors);
+    altrace_want_event(reader, ALEE_ALCERROR_TRIGGERED, dump_errors);
+    altrace_want_event(reader, ALEE_DEVICE_STATE_CHANGED_BOOL, dump_state_changes);
+    altrace_want_event(reader, ALEE_DEVICE_STATE_CHANGED_INT, dump_state_changes);
+    altrace_want_event(reader, ALEE_CONTEXT_STATE_CHANGED_ENUM, dump_state_changes);
+    altrace_want_event(reader, ALEE_CONTEXT_STATE_CHANGED_FLOAT, dump_state_changes);
+    altrace_want_event(reader, ALEE_CONTEXT_STATE_CHANGED_STRING, dump_state_changes);
+    altrace_want_event(reader, ALEE_CONTEXT_ATTRIBUTES, dump_state_changes);
+    altrace_want_event(reader, ALEE_LISTENER_STATE_CHANGED_FLOATV, dump_state_changes);
+    altrace_want_event(reader, ALEE_SOURCE_STATE_CHANGED_BOOL, dump_state_changes);
+    altrace_want_event(reader, ALEE_SOURCE_STATE_CHANGED_ENUM, dump_state_changes);
+    altrace_want_event(reader, ALEE_SOURCE_STATE_CHANGED_INT, dump_state_changes);
+    altrace_want_event(reader, ALEE_SOURCE_STATE_CHANGED_UINT, dump_state_changes);
+    altrace_want_event(reader, ALEE_SOURCE_STATE_CHANGED_FLOAT, dump_state_changes);
+    altrace_want_event(reader, ALEE_SOURCE_STATE_CHANGED_FLOAT3, dump_state_changes);
+    altrace_want_event(reader, ALEE_BUFFER_STATE_CHANGED_INT, dump_state_changes);
+    altrace_want_event(reader, ALEE_PERF_COUNTERS, dump_perf);
+    altrace_want_event(reader, ALEE_RESOURCE_SAMPLE, chart_resources);
+    altrace_want_event(reader, ALEE_DEVICE_CLOCK_LATENCY, dump_latency);
+    altrace_want_event(reader, ALEE_SOURCE_LATENCY, dump_latency);
+}
+
 int main(int argc, char **argv)
 {
     const char *fname = NULL;
+    const char *shmname = NULL;
+    const char *salvagename = NULL;
+    const char *from_event = NULL;
+    const char *from_time = NULL;
+    int build_index = 0;
     int retval = 0;
     int usage = 0;
     int i;
@@ -1654,14 +2714,45 @@ int main(int argc, char **argv)
             dump_state_changes = 1;
         } else if (strcmp(arg, "--no-dump-state-changes") == 0) {
             dump_state_changes = 0;
+        } else if (strcmp(arg, "--dump-perf") == 0) {
+            dump_perf = 1;
+        } else if (strcmp(arg, "--no-dump-perf") == 0) {
+            dump_perf = 0;
+        } else if (strcmp(arg, "--dump-latency") == 0) {
+            dump_latency = 1;
+        } else if (strcmp(arg, "--no-dump-latency") == 0) {
+            dump_latency = 0;
         } else if (strcmp(arg, "--dump-all") == 0) {
-            dump_calls = dump_callers = dump_errors = dump_state_changes = 1;
+            dump_calls = dump_callers = dump_errors = dump_state_changes = dump_perf = dump_latency = 1;
         } else if (strcmp(arg, "--no-dump-all") == 0) {
-            dump_calls = dump_callers = dump_errors = dump_state_changes = 0;
+            dump_calls = dump_callers = dump_errors = dump_state_changes = dump_perf = dump_latency = 0;
+        } else if (strcmp(arg, "--chart-resources") == 0) {
+            chart_resources = 1;
+            dump_calls = 0;
+        } else if (strcmp(arg, "--frame-stats") == 0) {
+            frame_stats = 1;
+            dump_calls = 0;
+        } else if (strcmp(arg, "--dump-counters") == 0) {
+            dump_counters = 1;
+            dump_calls = 0;
+        } else if (strcmp(arg, "--benchmark") == 0) {
+            benchmark = 1;
+        } else if ((strcmp(arg, "--threads") == 0) && (i < (argc-1))) {
+            numthreads = atoi(argv[++i]);
         } else if (strcmp(arg, "--run") == 0) {
             run_calls = 1;
         } else if (strcmp(arg, "--no-run") == 0) {
             run_calls = 0;
+        } else if ((strcmp(arg, "--attach") == 0) && (i < (argc-1))) {
+            shmname = argv[++i];
+        } else if ((strcmp(arg, "--salvage") == 0) && (i < (argc-1))) {
+            salvagename = argv[++i];
+        } else if (strcmp(arg, "--index") == 0) {
+            build_index = 1;
+        } else if ((strcmp(arg, "--from-event") == 0) && (i < (argc-1))) {
+            from_event = argv[++i];
+        } else if ((strcmp(arg, "--from-time") == 0) && (i < (argc-1))) {
+            from_time = argv[++i];
         } else if (strcmp(arg, "--help") == 0) {
             usage = 1;
         } else if (fname == NULL) {
@@ -1671,24 +2762,65 @@ int main(int argc, char **argv)
         }
     }
 
-    if (fname == NULL) {
+    if ((fname == NULL) == (shmname == NULL)) {
+        usage = 1;
+    } else if (salvagename && !fname) {
         usage = 1;
+    } else if (benchmark && !fname) {
+        usage = 1;
+    } else if ((numthreads < 1) || ((numthreads > 1) && !benchmark && (shmname || run_calls || chart_resources || frame_stats || dump_counters))) {
+        usage = 1;  // these all keep track of things from one call to the next, so they can't be split up.
+    } else if (build_index && !fname) {
+        usage = 1;
+    } else if ((from_event || from_time) && (!fname || run_calls || (from_event && from_time))) {
+        usage = 1;  // !!! FIXME: --run could work if we replayed object state up to the seek point.
     }
 
     if (usage) {
         fprintf(stderr, "USAGE: %s [args] <altrace.trace>\n", argv[0]);
+        fprintf(stderr, "       %s [args] --attach <shmname>\n", argv[0]);
+        fprintf(stderr, "       %s --salvage <fixed.trace> <crashed.trace>\n", argv[0]);
+        fprintf(stderr, "       %s --benchmark [--threads <num>] <altrace.trace>\n", argv[0]);
+        fprintf(stderr, "       %s --index <altrace.trace>\n", argv[0]);
         fprintf(stderr, "  args:\n");
         fprintf(stderr, "   --[no-]dump-calls\n");
         fprintf(stderr, "   --[no-]dump-callers\n");
         fprintf(stderr, "   --[no-]dump-errors\n");
         fprintf(stderr, "   --[no-]dump-state-changes\n");
+        fprintf(stderr, "   --[no-]dump-perf\n");
+        fprintf(stderr, "   --[no-]dump-latency\n");
         fprintf(stderr, "   --[no-]dump-all\n");
         fprintf(stderr, "   --[no-]run\n");
+        fprintf(stderr, "   --chart-resources\n");
+        fprintf(stderr, "   --frame-stats\n");
+        fprintf(stderr, "   --dump-counters\n");
+        fprintf(stderr, "   --from-event <eventnum>\n");
+        fprintf(stderr, "   --from-time <seconds>\n");
+        fprintf(stderr, "   --threads <num>\n");
         fprintf(stderr, "\n");
         return 1;
     }
 
-    dumping = dump_calls || dump_callers || dump_errors || dump_state_changes;
+    if (salvagename) {
+        return salvage_tracelog(fname, salvagename) ? 0 : 1;
+    }
+
+    if (benchmark) {
+        retval = run_benchmark(fname);
+        out_flush();
+        return retval;
+    }
+
+    if (build_index) {
+        return build_tracelog_index(fname) ? 0 : 1;
+    }
+
+    dumping = dump_calls || dump_callers || dump_errors || dump_state_changes || dump_perf || dump_latency;
+    flush_every_call = (shmname != NULL) || run_calls || isatty(STDOUT_FILENO);
+
+    if (dump_counters) {
+        outf("seconds\tcounter\tvalue\n");
+    }
 
     if (run_calls) {
         if (!init_clock()) {
@@ -1700,16 +2832,57 @@ int main(int argc, char **argv)
         }
     }
 
-    fprintf(stderr, "\n\n\n%s: Playback OpenAL session from log file '%s'\n\n\n", GAppName, fname);
+    if (shmname) {
+        fprintf(stderr, "\n\n\n%s: Attaching to live OpenAL session on shared memory ring '%s'\n\n\n", GAppName, shmname);
+        reader = altrace_attach(shmname);
+    } else if (from_event) {
+        const unsigned long long eventnum = strtoull(from_event, NULL, 10);
+        fprintf(stderr, "\n\n\n%s: Playback OpenAL session from log file '%s', starting at event %llu\n\n\n", GAppName, fname, eventnum);
+        reader = altrace_open(fname);
+        if (reader && !altrace_seek_event(reader, (uint64) eventnum)) {
+            altrace_close(reader);
+            reader = NULL;
+        }
+    } else if (from_time) {
+        const double seconds = strtod(from_time, NULL);
+        const uint32 ticks = (seconds <= 0.0) ? 0 : (seconds >= 4294967.0) ? 0xFFFFFFFF : (uint32) (seconds * 1000.0);
+        fprintf(stderr, "\n\n\n%s: Playback OpenAL session from log file '%s', starting at %.3f seconds\n\n\n", GAppName, fname, ticks / 1000.0);
+        reader = altrace_open(fname);
+        if (reader && !altrace_seek_time(reader, ticks)) {
+            altrace_close(reader);
+            reader = NULL;
+        }
+    } else {
+        fprintf(stderr, "\n\n\n%s: Playback OpenAL session from log file '%s'\n\n\n", GAppName, fname);
+        reader = altrace_open(fname);
+    }
 
-    if (!process_tracelog(fname, NULL)) {
+    if (!reader) {
         retval = 1;
+    } else {
+        want_events(reader);
+        if (!((numthreads > 1) ? run_dump_pipeline(reader) : altrace_process(reader, NULL))) {
+            retval = 1;
+        }
+        altrace_close(reader);
+    }
+
+    if (chart_resources) {
+        print_resource_chart();
+    }
+
+    if (frame_stats) {
+        print_frame_stats();
     }
 
     if (run_calls) {
+        free_run_maps();
         close_real_openal();
     }
 
+    out_flush();
+    free(stdout_buffer.data);
+
     return retval;
 }
 
@@ -8,62 +8,247 @@
 
 #include "altrace_common.h"
 
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <signal.h>
+#endif
+
+#ifndef ALTRACE_STATIC_RECORDER
 #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) ret (*REAL_##name) params = NULL;
 #include "altrace_entrypoints.h"
+#endif
+
+
+// Arenas hand out memory in big blocks and take it all back at once. Small
+//  allocations are carved out of a shared block; big ones (a huge array of
+//  names, say) get a block of their own, which is freed outright on reset
+//  instead of being kept around forever at its largest size. Every block
+//  starts with this header, so a retained allocation can be freed with just
+//  its pointer.
+struct ArenaBlock
+{
+    ArenaBlock *next;  // newer blocks come first.
+    size_t size;  // bytes of data after the header.
+    size_t used;
+    int dedicated;  // non-zero if this is one big allocation.
+};
 
+#define ARENA_HEADER_LEN ((sizeof (ArenaBlock) + 15) & ~((size_t) 15))
+#define ARENA_BLOCK_SIZE (64 * 1024)
+#define ARENA_BIG_ALLOCATION (ARENA_BLOCK_SIZE / 4)
+#define ARENA_THREAD_LIMIT (16 * 1024 * 1024)
 
-#define MAX_IOBLOBS 256
-static uint8 *ioblobs[MAX_IOBLOBS];
-static size_t ioblobs_len[MAX_IOBLOBS];
-static int next_ioblob = 0;
+// each thread has an arena of its own for when it isn't visiting a reader's
+//  events (the GUI, say, formatting strings for its windows). Nothing ever
+//  resets it, so once it holds ARENA_THREAD_LIMIT bytes, its oldest blocks
+//  get reused, like the ring of buffers this replaced.
+static __thread Arena thread_arena = { NULL, NULL, 0, 1 };
+static __thread Arena *current_arena = NULL;
+
+static uint8 *block_data(ArenaBlock *block)
+{
+    return ((uint8 *) block) + ARENA_HEADER_LEN;
+}
+
+static ArenaBlock *new_block(const size_t size, const int dedicated)
+{
+    ArenaBlock *block = (ArenaBlock *) malloc(ARENA_HEADER_LEN + size);
+    if (!block) {
+        out_of_memory();
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    block->dedicated = dedicated;
+    return block;
+}
 
-void *get_ioblob(const size_t len)
+// drops the oldest blocks (but never the one we're filling, or the one we
+//  just handed out) until we're under the limit again.
+static void arena_recycle(Arena *arena)
 {
-    void *ptr = ioblobs[next_ioblob];
-    if (len > ioblobs_len[next_ioblob]) {
-        //printf("allocating ioblob of %llu bytes...\n", (unsigned long long) len);
-        ptr = realloc(ptr, len);
-        if (!ptr) {
-            out_of_memory();
+    while (arena->held > ARENA_THREAD_LIMIT) {
+        ArenaBlock **victimprev = NULL;
+        ArenaBlock **prev = &arena->blocks;
+        ArenaBlock *block;
+        for (block = arena->blocks; block; prev = &block->next, block = block->next) {
+            if ((block != arena->current) && (block != arena->blocks)) {
+                victimprev = prev;
+            }
+        }
+        if (!victimprev) {
+            break;
         }
-        ioblobs[next_ioblob] = (uint8 *) ptr;
-        ioblobs_len[next_ioblob] = len;
+        block = *victimprev;
+        *victimprev = block->next;
+        arena->held -= block->size;
+        free(block);
     }
-    next_ioblob++;
-    if (next_ioblob >= ((sizeof (ioblobs) / sizeof (ioblobs[0])))) {
-        next_ioblob = 0;
+}
+
+void *arena_alloc(Arena *arena, const size_t _len)
+{
+    const size_t len = (_len + 15) & ~((size_t) 15);  // keep everything aligned.
+    ArenaBlock *block = arena->current;
+    void *retval;
+
+    if (len > ARENA_BIG_ALLOCATION) {
+        block = new_block(len, 1);
+    } else if (block && ((block->size - block->used) >= len)) {
+        retval = block_data(block) + block->used;
+        block->used += len;
+        return retval;
+    } else {
+        block = arena->current = new_block(ARENA_BLOCK_SIZE, 0);
+    }
+
+    block->used = len;
+    block->next = arena->blocks;
+    arena->blocks = block;
+    arena->held += block->size;
+    if (arena->recycle) {
+        arena_recycle(arena);
     }
-    return ptr;
+    return block_data(block);
 }
 
-void free_ioblobs(void)
+void arena_reset(Arena *arena)
 {
-    size_t i;
-    for (i = 0; i < (sizeof (ioblobs) / sizeof (ioblobs[0])); i++) {
-        free(ioblobs[i]);
-        ioblobs[i] = NULL;
-        ioblobs_len[i] = 0;
+    ArenaBlock *keep = arena->current;
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        if (block != keep) {
+            free(block);
+        }
+        block = next;
+    }
+
+    arena->blocks = keep;
+    arena->held = 0;
+    if (keep) {
+        keep->next = NULL;
+        keep->used = 0;
+        arena->held = keep->size;
+    }
+}
+
+void arena_free(Arena *arena)
+{
+    arena_reset(arena);
+    free(arena->current);
+    arena->blocks = arena->current = NULL;
+    arena->held = 0;
+}
+
+void arena_use(Arena *arena)
+{
+    current_arena = arena;
+}
+
+void *scratch_alloc(const size_t len)
+{
+    return arena_alloc(current_arena ? current_arena : &thread_arena, len);
+}
+
+void free_scratch(void)
+{
+    arena_free(&thread_arena);
+}
+
+void *arena_retain(const void *ptr, const size_t len)
+{
+    Arena *arena = current_arena ? current_arena : &thread_arena;
+    ArenaBlock **prev = &arena->blocks;
+    ArenaBlock *block;
+
+    // it has a block of its own? Take that out of the arena instead of copying it.
+    for (block = arena->blocks; block; prev = &block->next, block = block->next) {
+        if (block->dedicated && (block_data(block) == (const uint8 *) ptr)) {
+            *prev = block->next;
+            arena->held -= block->size;
+            return block_data(block);
+        }
     }
-    next_ioblob = 0;
+
+    block = new_block(len, 1);
+    memcpy(block_data(block), ptr, len);
+    return block_data(block);
+}
+
+void arena_release(void *ptr)
+{
+    if (ptr) {
+        free(((uint8 *) ptr) - ARENA_HEADER_LEN);
+    }
+}
+
+// FNV-1a, but a 64-bit word at a time (and mixed a little more to make up
+//  for it), so hashing a big upload doesn't cost much more than copying it.
+uint64 hash_blob(const void *_data, size_t len)
+{
+    const uint8 *data = (const uint8 *) _data;
+    uint64 hash = 0xCBF29CE484222325ull;
+    while (len >= sizeof (uint64)) {
+        uint64 word;
+        memcpy(&word, data, sizeof (word));
+        hash = (hash ^ swap64(word)) * 0x100000001B3ull;
+        hash ^= hash >> 29;
+        data += sizeof (word);
+        len -= sizeof (word);
+    }
+    while (len--) {
+        hash = (hash ^ *(data++)) * 0x100000001B3ull;
+    }
+    return hash;
 }
 
 char *sprintf_alloc(const char *fmt, ...)
 {
+    char buf[256];  // almost everything fits, so we only have to format once.
     va_list ap;
     va_start(ap, fmt);
-    const size_t len = vsnprintf(NULL, 0, fmt, ap);
+    const int rc = vsnprintf(buf, sizeof (buf), fmt, ap);
     va_end(ap);
 
-    char *retval = (char *) get_ioblob(len + 1);
-    va_start(ap, fmt);
-    if (vsnprintf(retval, len + 1, fmt, ap) != len) {
-        retval = NULL;
+    if (rc < 0) {
+        return NULL;
+    }
+
+    const size_t len = (size_t) rc;
+    char *retval = (char *) scratch_alloc(len + 1);
+    if (len < sizeof (buf)) {
+        memcpy(retval, buf, len + 1);
+    } else {
+        va_start(ap, fmt);
+        if (vsnprintf(retval, len + 1, fmt, ap) != rc) {
+            retval = NULL;
+        }
+        va_end(ap);
     }
-    va_end(ap);
 
     return retval;
 }
 
+char *format_uint(char *end, uint64 val)
+{
+    do {
+        *(--end) = (char) ('0' + (val % 10));
+        val /= 10;
+    } while (val);
+    return end;
+}
+
+char *format_hex(char *end, uint64 val, const int uppercase)
+{
+    const char *digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+    do {
+        *(--end) = digits[val & 0xF];
+        val >>= 4;
+    } while (val);
+    return end;
+}
+
 
 static uint64 starttime = 0;
 
@@ -89,6 +274,29 @@ uint32 now(void)
     return (uint32) ( ( (((uint64) ts.tv_sec) * 1000) + (((uint64) ts.tv_nsec) / 1000000) ) - starttime );
 }
 
+// same clock as now(), but in nanoseconds, for things that need to time short spans.
+uint64 now_ns(void)
+{
+#ifdef __APPLE__
+    if (clock_gettime == NULL) {  // not available until 10.12, use gettimeofday if necessary.
+        struct timeval tv;
+        if (gettimeofday(&tv, NULL) == -1) {
+            fprintf(stderr, "%s: Failed to get current clock time: %s\n", GAppName, strerror(errno));
+            return 0;
+        }
+        return ( (((uint64) tv.tv_sec) * 1000000000) + (((uint64) tv.tv_usec) * 1000) ) - (starttime * 1000000);
+    }
+#endif
+
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts) == -1) {
+        fprintf(stderr, "%s: Failed to get current clock time: %s\n", GAppName, strerror(errno));
+        return 0;
+    }
+
+    return ( (((uint64) ts.tv_sec) * 1000000000) + ((uint64) ts.tv_nsec) ) - (starttime * 1000000);
+}
+
 int init_clock(void)
 {
 #ifdef __APPLE__
@@ -116,6 +324,18 @@ int init_clock(void)
     return 1;
 }
 
+#ifdef ALTRACE_STATIC_RECORDER
+// linked directly against the real OpenAL; there's nothing to load.
+int load_real_openal(void)
+{
+    return 1;
+}
+
+void close_real_openal(void)
+{
+}
+
+#else
 static void *realdll = NULL;
 
 // !!! FIXME: we should use al[c]GetProcAddress() and do it _per device_ and
@@ -192,6 +412,7 @@ void close_real_openal(void)
         dlclose(dll);
     }
 }
+#endif
 
 
 // stole this from MojoShader: https://icculus.org/mojoshader
@@ -315,5 +536,352 @@ void stringcache_destroy(StringCache *cache)
     free(cache);
 } // stringcache_destroy
 
+
+// This lives at the start of the shared memory object, followed by the ring
+//  data. The two positions are free-running byte counts (never wrapped), on
+//  their own cache lines since different processes hammer on each of them.
+typedef struct ShmRingHeader
+{
+    uint32 magic;
+    uint32 format;
+    uint64 size;
+    int32 producer_pid;
+    int32 consumer_pid;
+    uint32 session;  // bumped by the producer when it starts a fresh stream for a new consumer.
+    uint8 pad0[64 - 28];
+    uint64 write_pos;
+    uint8 pad1[64 - 8];
+    uint64 read_pos;
+    uint8 pad2[64 - 8];
+} ShmRingHeader;
+
+struct ShmRing
+{
+    char *name;
+    ShmRingHeader *header;
+    uint8 *data;     // ring data, mapped twice in a row.
+    size_t mapsize;  // total address space we reserved.
+    uint64 size;
+    uint64 pos;      // producer: our write cursor. consumer: our read cursor.
+    uint64 released; // consumer: last position we handed back to the producer.
+    int producer;
+    int32 publishing_for;  // producer: pid of the consumer we're currently streaming to, or 0.
+};
+
+#define SHM_LOAD(x) __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define SHM_STORE(x, y) __atomic_store_n(&(x), (y), __ATOMIC_RELEASE)
+
+static void shmring_wait(void)
+{
+    usleep(100);  // !!! FIXME: a futex would be nicer, but this is portable.
+}
+
+static int process_alive(const int32 pid)
+{
+    return (pid != 0) && ((kill((pid_t) pid, 0) == 0) || (errno != ESRCH));
+}
+
+static char *shmring_name(const char *name)
+{
+    // POSIX wants a single leading slash on these names.
+    const size_t len = strlen(name) + 2;
+    char *retval = (char *) malloc(len);
+    if (retval) {
+        snprintf(retval, len, "%s%s", (name[0] == '/') ? "" : "/", name);
+    }
+    return retval;
+}
+
+static ShmRing *shmring_map(const char *name, const int fd, const uint64 size, const int producer)
+{
+    const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+    const size_t mapsize = pagesize + (((size_t) size) * 2);
+    ShmRing *ring = (ShmRing *) calloc(1, sizeof (ShmRing));
+    uint8 *ptr;
+
+    if (!ring) {
+        return NULL;
+    }
+
+    // reserve the whole address range, then map the shared object over it:
+    //  the header page, then the ring data twice so wraparound is seamless.
+    ptr = (uint8 *) mmap(NULL, mapsize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        free(ring);
+        return NULL;
+    }
+
+    if ( (mmap(ptr, pagesize + size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) ||
+         (mmap(ptr + pagesize + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, pagesize) == MAP_FAILED) ) {
+        munmap(ptr, mapsize);
+        free(ring);
+        return NULL;
+    }
+
+    ring->name = strdup(name);
+    ring->header = (ShmRingHeader *) ptr;
+    ring->data = ptr + pagesize;
+    ring->mapsize = mapsize;
+    ring->size = size;
+    ring->producer = producer;
+    return ring;
+}
+
+ShmRing *shmring_create(const char *_name, const uint64 _size)
+{
+    const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+    const uint64 size = ((_size + pagesize - 1) / pagesize) * pagesize;
+    char *name = shmring_name(_name);
+    ShmRing *ring = NULL;
+    int fd;
+
+    if (!name) {
+        return NULL;
+    }
+
+    shm_unlink(name);  // in case a previous run crashed and left it behind.
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1) {
+        fprintf(stderr, "%s: Failed to create shared memory ring '%s': %s\n", GAppName, name, strerror(errno));
+    } else if (ftruncate(fd, (off_t) (pagesize + size)) == -1) {
+        fprintf(stderr, "%s: Failed to size shared memory ring '%s': %s\n", GAppName, name, strerror(errno));
+    } else if ((ring = shmring_map(name, fd, size, 1)) == NULL) {
+        fprintf(stderr, "%s: Failed to map shared memory ring '%s': %s\n", GAppName, name, strerror(errno));
+    } else {
+        ring->header->magic = ALTRACE_SHM_MAGIC;
+        ring->header->format = ALTRACE_LOG_FILE_FORMAT;
+        ring->header->size = size;
+        ring->header->consumer_pid = 0;
+        ring->header->session = 0;
+        ring->header->write_pos = 0;
+        ring->header->read_pos = 0;
+        SHM_STORE(ring->header->producer_pid, (int32) getpid());
+    }
+
+    if (fd != -1) {
+        close(fd);  // the mapping keeps it alive.
+    }
+
+    if (!ring) {
+        shm_unlink(name);
+    }
+
+    free(name);
+    return ring;
+}
+
+// Call this before writing an event, when the output is at an event
+//  boundary. Returns 0 if nothing is listening, 1 if we're streaming, and 2
+//  if a new consumer just showed up; in that case the caller needs to write
+//  a fresh file header, as the consumer sees a brand new stream.
+int shmring_begin_event(ShmRing *ring)
+{
+    ShmRingHeader *header = ring->header;
+    const int32 consumer = SHM_LOAD(header->consumer_pid);
+
+    if (consumer == ring->publishing_for) {
+        return consumer ? 1 : 0;
+    }
+
+    ring->publishing_for = consumer;
+    if (!consumer) {
+        return 0;
+    }
+
+    // throw away anything the last consumer didn't get to.
+    SHM_STORE(header->read_pos, ring->pos);
+    SHM_STORE(header->session, header->session + 1);
+    return 2;
+}
+
+void shmring_write(ShmRing *ring, const void *_data, const size_t len)
+{
+    ShmRingHeader *header = ring->header;
+    const uint8 *data = (const uint8 *) _data;
+    size_t remaining = len;
+
+    while (ring->publishing_for && (remaining > 0)) {
+        const uint64 avail = ring->size - (ring->pos - SHM_LOAD(header->read_pos));
+        if (avail == 0) {
+            // consumer is behind. Block the app until it catches up, unless it went away.
+            const int32 consumer = SHM_LOAD(header->consumer_pid);
+            int32 expected = ring->publishing_for;
+            if ((consumer != expected) || !process_alive(consumer)) {
+                __atomic_compare_exchange_n(&header->consumer_pid, &expected, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+                ring->publishing_for = 0;  // broken stream; we'll start over with the next consumer.
+                break;
+            }
+            shmring_wait();
+        } else {
+            const size_t cpy = (avail < remaining) ? (size_t) avail : remaining;
+            memcpy(ring->data + (ring->pos % ring->size), data, cpy);
+            ring->pos += cpy;
+            data += cpy;
+            remaining -= cpy;
+            SHM_STORE(header->write_pos, ring->pos);
+        }
+    }
+}
+
+ShmRing *shmring_attach(const char *_name)
+{
+    const size_t pagesize = (size_t) sysconf(_SC_PAGESIZE);
+    char *name = shmring_name(_name);
+    ShmRing *ring = NULL;
+    ShmRingHeader *header;
+    struct stat statbuf;
+    uint32 session;
+    int32 mypid = (int32) getpid();
+    int32 consumer;
+    int fd;
+
+    if (!name) {
+        return NULL;
+    }
+
+    fd = shm_open(name, O_RDWR, 0600);
+    if (fd == -1) {
+        fprintf(stderr, "%s: Failed to open shared memory ring '%s': %s\n", GAppName, name, strerror(errno));
+    } else if (fstat(fd, &statbuf) == -1) {
+        fprintf(stderr, "%s: Failed to stat shared memory ring '%s': %s\n", GAppName, name, strerror(errno));
+    } else if ((statbuf.st_size <= (off_t) pagesize) || ((ring = shmring_map(name, fd, (uint64) statbuf.st_size - pagesize, 0)) == NULL)) {
+        fprintf(stderr, "%s: Failed to map shared memory ring '%s': %s\n", GAppName, name, strerror(errno));
+    }
+
+    if (fd != -1) {
+        close(fd);
+    }
+    free(name);
+
+    if (!ring) {
+        return NULL;
+    }
+
+    header = ring->header;
+    if ((header->magic != ALTRACE_SHM_MAGIC) || (header->size != ring->size)) {
+        fprintf(stderr, "%s: Shared memory '%s' does not appear to be an OpenAL trace ring.\n", GAppName, ring->name);
+        shmring_close(ring);
+        return NULL;
+    } else if (header->format < ALTRACE_LOG_FILE_MIN_FORMAT) {
+        fprintf(stderr, "%s: Shared memory ring '%s' is an unsupported log file format version.\n", GAppName, ring->name);
+        shmring_close(ring);
+        return NULL;
+    }
+
+    // only one consumer at a time, but we can take over from a dead one.
+    session = SHM_LOAD(header->session);
+    consumer = SHM_LOAD(header->consumer_pid);
+    if ( (consumer && process_alive(consumer)) ||
+         !__atomic_compare_exchange_n(&header->consumer_pid, &consumer, mypid, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ) {
+        fprintf(stderr, "%s: Another process is already attached to shared memory ring '%s'.\n", GAppName, ring->name);
+        shmring_close(ring);
+        return NULL;
+    }
+
+    // wait for the producer to notice us and start a fresh stream at its next OpenAL call.
+    while (SHM_LOAD(header->session) == session) {
+        if (!process_alive(SHM_LOAD(header->producer_pid))) {
+            fprintf(stderr, "%s: Traced process owning shared memory ring '%s' went away.\n", GAppName, ring->name);
+            shmring_close(ring);
+            return NULL;
+        }
+        shmring_wait();
+    }
+
+    ring->pos = ring->released = SHM_LOAD(header->read_pos);
+    return ring;
+}
+
+// Returns a pointer to the next (len) bytes of the stream, waiting for the
+//  producer if necessary, without copying. The data stays valid until the
+//  next shmring_release(), which is up to the caller, since only it knows
+//  when it's done with everything it peeked. Returns NULL if the producer
+//  went away, or if this wouldn't fit in the ring along with everything
+//  since the last release (the producer could never supply it).
+const uint8 *shmring_peek(ShmRing *ring, const size_t len)
+{
+    ShmRingHeader *header = ring->header;
+    const uint8 *retval;
+
+    if (((ring->pos + len) - ring->released) > ring->size) {
+        return NULL;
+    }
+
+    while ((SHM_LOAD(header->write_pos) - ring->pos) < len) {
+        // check write_pos again after noticing the producer is gone, in case it wrote its last bytes right before quitting.
+        if (!process_alive(SHM_LOAD(header->producer_pid)) && ((SHM_LOAD(header->write_pos) - ring->pos) < len)) {
+            return NULL;
+        }
+        shmring_wait();
+    }
+
+    retval = ring->data + (ring->pos % ring->size);
+    ring->pos += len;
+    return retval;
+}
+
+// shmring_peek(), but copied out; the same limits apply.
+int shmring_read(ShmRing *ring, void *buf, const size_t len)
+{
+    const uint8 *ptr = shmring_peek(ring, len);
+    if (!ptr) {
+        return 0;
+    }
+    memcpy(buf, ptr, len);
+    return 1;
+}
+
+// Tell the producer we're done with everything we've read so far.
+void shmring_release(ShmRing *ring)
+{
+    if (ring->released != ring->pos) {
+        ring->released = ring->pos;
+        SHM_STORE(ring->header->read_pos, ring->pos);
+    }
+}
+
+uint64 shmring_position(const ShmRing *ring)
+{
+    return ring->pos;
+}
+
+uint64 shmring_size(const ShmRing *ring)
+{
+    return ring->size;
+}
+
+uint64 shmring_available(const ShmRing *ring)
+{
+    return SHM_LOAD(ring->header->write_pos) - ring->pos;
+}
+
+// Drop our mapping without telling the other side anything, for a fork()ed
+//  child that inherited the parent's ring.
+void shmring_forget(ShmRing *ring)
+{
+    if (ring) {
+        munmap(ring->header, ring->mapsize);
+        free(ring->name);
+        free(ring);
+    }
+}
+
+void shmring_close(ShmRing *ring)
+{
+    if (ring) {
+        ShmRingHeader *header = ring->header;
+        if (ring->producer) {
+            SHM_STORE(header->producer_pid, 0);
+            shm_unlink(ring->name);  // consumer keeps its mapping, it just can't be found anymore.
+        } else {
+            int32 mypid = (int32) getpid();
+            __atomic_compare_exchange_n(&header->consumer_pid, &mypid, 0, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        }
+        munmap(ring->header, ring->mapsize);
+        free(ring->name);
+        free(ring);
+    }
+}
+
 // end of altrace_common.c ...
 
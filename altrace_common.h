@@ -62,7 +62,9 @@
 #define ALTRACE_VERSION "0.0.1"
 
 #define ALTRACE_LOG_FILE_MAGIC  0x0104E5A1
-#define ALTRACE_LOG_FILE_FORMAT 1
+#define ALTRACE_LOG_FILE_FORMAT 16
+#define ALTRACE_LOG_FILE_MIN_FORMAT 15  /* records are length-prefixed from here on, so newer events can be skipped. */
+#define ALTRACE_CHECKPOINT_MAGIC 0x504B484352544C41ull  /* "ALTRCHKP" */
 
 /* AL_EXT_FLOAT32 support... */
 #ifndef AL_FORMAT_MONO_FLOAT32
@@ -78,6 +80,19 @@
 #define ALC_CONNECTED 0x313
 #endif
 
+/* ALC_SOFT_device_clock support... */
+#ifndef ALC_DEVICE_CLOCK_LATENCY_SOFT
+#define ALC_DEVICE_CLOCK_SOFT 0x1600
+#define ALC_DEVICE_LATENCY_SOFT 0x1601
+#define ALC_DEVICE_CLOCK_LATENCY_SOFT 0x1602
+#endif
+
+/* AL_SOFT_source_latency support... */
+#ifndef AL_SAMPLE_OFFSET_LATENCY_SOFT
+#define AL_SAMPLE_OFFSET_LATENCY_SOFT 0x1200
+#define AL_SEC_OFFSET_LATENCY_SOFT 0x1201
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -89,6 +104,7 @@ typedef uint8_t uint8;
 typedef int16_t int16;
 typedef int32_t int32;
 typedef uint32_t uint32;
+typedef int64_t int64;
 typedef uint64_t uint64;
 typedef unsigned int uint;
 
@@ -154,20 +170,82 @@ typedef enum
     ALEE_SOURCE_STATE_CHANGED_FLOAT,
     ALEE_SOURCE_STATE_CHANGED_FLOAT3,
     ALEE_BUFFER_STATE_CHANGED_INT,
+    ALEE_PROCESS_FORKED,
+    ALEE_CHECKPOINT,
+    ALEE_PERF_COUNTERS,
+    ALEE_SCHED_CONTEXT,
+    ALEE_RESOURCE_SAMPLE,
+    ALEE_DEVICE_CLOCK_LATENCY,
+    ALEE_SOURCE_LATENCY,
+    ALEE_MOTION_CHANNEL,
+    ALEE_MOTION_UPDATE,
+    ALEE_CONTEXT_ATTRIBUTES,
+    ALEE_CHUNK_CONTEXT,
     #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) ALEE_##name,
     #include "altrace_entrypoints.h"
     ALEE_MAX
 } EventEnum;
 
+// what the two values in an ALEE_PERF_COUNTERS event mean.
+typedef enum
+{
+    ALTRACE_PERF_CYCLES_INSTRUCTIONS,  // CPU cycles, instructions retired.
+    ALTRACE_PERF_TASKCLOCK_CSWITCHES   // nanoseconds on-CPU, context switches.
+} PerfCounterKind;
 
+// what an ALEE_MOTION_CHANNEL event's updates apply to.
+typedef enum
+{
+    ALTRACE_MOTION_SOURCE,   // alSource3f(name, param, ...)
+    ALTRACE_MOTION_LISTENER  // alListener3f(param, ...) or alListenerfv(param, ...)
+} MotionTarget;
+
+#ifdef ALTRACE_STATIC_RECORDER
+// The static recorder is linked straight into the app with -Wl,--wrap for
+//  each entry point (see CMakeLists.txt), so our wrappers are __wrap_*, and
+//  the real library's functions are reachable as __real_*. REAL_* are direct
+//  calls, then, not function pointers filled in by load_real_openal().
+#define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) \
+    ret name params __asm__("__wrap_" #name); \
+    extern ret REAL_##name params __asm__("__real_" #name);
+#else
 #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) extern ret (*REAL_##name) params;
+#endif
 #include "altrace_entrypoints.h"
 
-void *get_ioblob(const size_t len);
-void free_ioblobs(void);
+// Scratch memory: what decoding hands out (arrays, strings) and what the
+//  *String() functions format comes out of an arena, which gives it all
+//  back at once when it's reset. Playback gives each reader one, and resets
+//  it before decoding the next event, so whatever visitors were handed is
+//  only good until they return. Anything you want to keep longer than that
+//  has to go through arena_retain(), and back with arena_release().
+typedef struct ArenaBlock ArenaBlock;
+typedef struct Arena
+{
+    ArenaBlock *blocks;
+    ArenaBlock *current;  // where small allocations come from.
+    size_t held;
+    int recycle;  // non-zero to reuse old blocks instead of growing past a limit.
+} Arena;
+
+void *arena_alloc(Arena *arena, const size_t len);
+void arena_reset(Arena *arena);
+void arena_free(Arena *arena);
+void arena_use(Arena *arena);  // where this thread's scratch_alloc() goes; NULL for its own arena.
+void *scratch_alloc(const size_t len);
+void free_scratch(void);  // this thread's own arena, when it's done with it.
+void *arena_retain(const void *ptr, const size_t len);
+void arena_release(void *ptr);
 __attribute__((noreturn)) void out_of_memory(void);
 char *sprintf_alloc(const char *fmt, ...);
+
+// these write backwards from `end` and return where the digits start, with
+//  no terminating null. A uint64 needs at most 20 bytes (16 in hex).
+char *format_uint(char *end, uint64 val);
+char *format_hex(char *end, uint64 val, const int uppercase);
+uint64 hash_blob(const void *data, size_t len);
 uint32 now(void);
+uint64 now_ns(void);
 int init_clock(void);
 int load_real_openal(void);
 void close_real_openal(void);
@@ -177,6 +255,27 @@ const char *stringcache(StringCache *cache, const char *str);
 StringCache *stringcache_create(void);
 void stringcache_destroy(StringCache *cache);
 
+// A POSIX shared memory ring buffer, so a live trace can be streamed to
+//  another process without touching the filesystem. The recorder is the
+//  producer, altrace_cli --attach is the (single) consumer. The data area
+//  is mapped twice back-to-back, so any span of up to the ring's size is
+//  contiguous in memory and can be handed out without copying.
+#define ALTRACE_SHM_MAGIC 0x0104E5A2
+#define ALTRACE_SHM_DEFAULT_SIZE (16 * 1024 * 1024)
+typedef struct ShmRing ShmRing;
+ShmRing *shmring_create(const char *name, const uint64 size);
+int shmring_begin_event(ShmRing *ring);
+void shmring_write(ShmRing *ring, const void *data, const size_t len);
+ShmRing *shmring_attach(const char *name);
+const uint8 *shmring_peek(ShmRing *ring, const size_t len);
+int shmring_read(ShmRing *ring, void *buf, const size_t len);
+void shmring_release(ShmRing *ring);
+uint64 shmring_position(const ShmRing *ring);
+uint64 shmring_size(const ShmRing *ring);
+uint64 shmring_available(const ShmRing *ring);
+void shmring_forget(ShmRing *ring);
+void shmring_close(ShmRing *ring);
+
 #ifdef __cplusplus
 }
 #endif
@@ -293,6 +392,119 @@ void stringcache_destroy(StringCache *cache);
         } \
     }
 
+
+// these make the same maps, but as a type (SimpleMap_x or HashMap_x) you put
+//  wherever you like, so there can be more than one; the functions take a
+//  pointer to the map first. Playback keeps a set in each TraceReader.
+#define OWNED_SIMPLE_MAP(maptype, fromctype, toctype) \
+    typedef struct SimpleMapItem_##maptype { \
+        fromctype from; \
+        toctype to; \
+    } SimpleMapItem_##maptype; \
+    typedef struct SimpleMap_##maptype { \
+        SimpleMapItem_##maptype *items; \
+        uint32 size; \
+    } SimpleMap_##maptype; \
+    static void add_##maptype##_to_map(SimpleMap_##maptype *map, fromctype from, toctype to) { \
+        void *ptr; uint32 i; \
+        for (i = 0; i < map->size; i++) { \
+            if (map->items[i].from == from) { \
+                free_hash_item_##maptype(map->items[i].from, map->items[i].to); \
+                map->items[i].from = from; \
+                map->items[i].to = to; \
+                return; \
+            } \
+        } \
+        ptr = realloc(map->items, (map->size + 1) * sizeof (SimpleMapItem_##maptype)); \
+        if (!ptr) { \
+            out_of_memory(); \
+        } \
+        map->items = (SimpleMapItem_##maptype *) ptr; \
+        map->items[map->size].from = from; \
+        map->items[map->size].to = to; \
+        map->size++; \
+    } \
+    static toctype get_mapped_##maptype(SimpleMap_##maptype *map, fromctype from) { \
+        uint32 i; \
+        for (i = 0; i < map->size; i++) { \
+            if (map->items[i].from == from) { \
+                return map->items[i].to; \
+            } \
+        } \
+        return (toctype) 0; \
+    } \
+    static void free_##maptype##_map(SimpleMap_##maptype *map) { \
+        uint32 i; \
+        for (i = 0; i < map->size; i++) { \
+            free_hash_item_##maptype(map->items[i].from, map->items[i].to); \
+        } \
+        free(map->items); \
+        map->items = NULL; \
+        map->size = 0; \
+    }
+
+#define OWNED_HASH_MAP(maptype, fromctype, toctype) \
+    typedef struct HashMapItem_##maptype { \
+        fromctype from; \
+        toctype to; \
+        struct HashMapItem_##maptype *next; \
+    } HashMapItem_##maptype; \
+    typedef struct HashMap_##maptype { \
+        HashMapItem_##maptype *buckets[256]; \
+    } HashMap_##maptype; \
+    static HashMapItem_##maptype *get_hashitem_##maptype(HashMap_##maptype *map, fromctype from, uint8 *_hash) { \
+        const uint8 hash = hash_##maptype(from); \
+        HashMapItem_##maptype *prev = NULL; \
+        HashMapItem_##maptype *item = map->buckets[hash]; \
+        if (_hash) { *_hash = hash; } \
+        while (item) { \
+            if (item->from == from) { \
+                if (prev) { /* move to front of list */ \
+                    prev->next = item->next; \
+                    item->next = map->buckets[hash]; \
+                    map->buckets[hash] = item; \
+                } \
+                return item; \
+            } \
+            prev = item; \
+            item = item->next; \
+        } \
+        return NULL; \
+    } \
+    static void add_##maptype##_to_map(HashMap_##maptype *map, fromctype from, toctype to) { \
+        uint8 hash; HashMapItem_##maptype *item = get_hashitem_##maptype(map, from, &hash); \
+        if (item) { \
+            free_hash_item_##maptype(item->from, item->to); \
+            item->from = from; \
+            item->to = to; \
+        } else { \
+            item = (HashMapItem_##maptype *) calloc(1, sizeof (HashMapItem_##maptype)); \
+            if (!item) { \
+                out_of_memory(); \
+            } \
+            item->from = from; \
+            item->to = to; \
+            item->next = map->buckets[hash]; \
+            map->buckets[hash] = item; \
+        } \
+    } \
+    static toctype get_mapped_##maptype(HashMap_##maptype *map, fromctype from) { \
+        HashMapItem_##maptype *item = get_hashitem_##maptype(map, from, NULL); \
+        return item ? item->to : (toctype) 0; \
+    } \
+    static void free_##maptype##_map(HashMap_##maptype *map) { \
+        int i; \
+        for (i = 0; i < 256; i++) { \
+            HashMapItem_##maptype *item; HashMapItem_##maptype *next; \
+            for (item = map->buckets[i]; item; item = next) { \
+                free_hash_item_##maptype(item->from, item->to); \
+                next = item->next; \
+                free(item); \
+            } \
+            map->buckets[i] = NULL; \
+        } \
+    }
+
 #endif
 
 // end of altrace_common.h ...
@@ -32,7 +32,7 @@ ENTRYPOINT(ALCenum,alcGetError,(ALCdevice *device),(device),1,(CallerInfo *calle
 ENTRYPOINTVOID(alcGetIntegerv,(ALCdevice *device, ALCenum param, ALCsizei size, ALCint *values),(device,param,size,values),4,(CallerInfo *callerinfo, ALCdevice *device, ALCenum param, ALCsizei size, ALCint *origvalues, ALCboolean isbool, ALCint *values),(callerinfo,device,param,size,origvalues,isbool,values))
 ENTRYPOINTVOID(alcCaptureStart,(ALCdevice *device),(device),1,(CallerInfo *callerinfo, ALCdevice *device),(callerinfo,device))
 ENTRYPOINTVOID(alcCaptureStop,(ALCdevice *device),(device),1,(CallerInfo *callerinfo, ALCdevice *device),(callerinfo,device))
-ENTRYPOINTVOID(alcCaptureSamples,(ALCdevice *device, ALCvoid *buffer, ALCsizei samples),(device,buffer,samples),3,(CallerInfo *callerinfo, ALCdevice *device, ALCvoid *origbuffer, ALCvoid *buffer, ALCsizei bufferlen, ALCsizei samples),(callerinfo,device,origbuffer,buffer,bufferlen,samples))
+ENTRYPOINTVOID(alcCaptureSamples,(ALCdevice *device, ALCvoid *buffer, ALCsizei samples),(device,buffer,samples),3,(CallerInfo *callerinfo, ALCdevice *device, ALCvoid *origbuffer, const TraceBlob *buffer, ALCsizei bufferlen, ALCsizei samples),(callerinfo,device,origbuffer,buffer,bufferlen,samples))
 ENTRYPOINTVOID(alDopplerFactor,(ALfloat value),(value),1,(CallerInfo *callerinfo, ALfloat value),(callerinfo,value))
 ENTRYPOINTVOID(alDopplerVelocity,(ALfloat value),(value),1,(CallerInfo *callerinfo, ALfloat value),(callerinfo,value))
 ENTRYPOINTVOID(alSpeedOfSound,(ALfloat value),(value),1,(CallerInfo *callerinfo, ALfloat value),(callerinfo,value))
@@ -40,7 +40,7 @@ ENTRYPOINTVOID(alDistanceModel,(ALenum model),(model),1,(CallerInfo *callerinfo,
 ENTRYPOINTVOID(alEnable,(ALenum capability),(capability),1,(CallerInfo *callerinfo, ALenum capability),(callerinfo,capability))
 ENTRYPOINTVOID(alDisable,(ALenum capability),(capability),1,(CallerInfo *callerinfo, ALenum capability),(callerinfo,capability))
 ENTRYPOINT(ALboolean,alIsEnabled,(ALenum capability),1,(capability),(CallerInfo *callerinfo, ALboolean retval, ALenum capability),(callerinfo,retval,capability))
-ENTRYPOINT(const ALchar *,alGetString,(const ALenum param),(param),1,(CallerInfo *callerinfo, const ALchar *retval, const ALenum param),(callerinfo,retval,param))
+ENTRYPOINT(const ALchar *,alGetString,(const ALenum param),(param),1,(CallerInfo *callerinfo, const ALchar *retval, ALenum param),(callerinfo,retval,param))
 ENTRYPOINTVOID(alGetBooleanv,(ALenum param, ALboolean *values),(param,values),2,(CallerInfo *callerinfo, ALenum param, ALboolean *origvalues, uint32 numvals, ALboolean *values),(callerinfo,param,origvalues,numvals,values))
 ENTRYPOINTVOID(alGetIntegerv,(ALenum param, ALint *values),(param,values),2,(CallerInfo *callerinfo, ALenum param, ALint *origvalues, uint32 numvals, ALboolean isenum, ALint *values),(callerinfo,param,origvalues,numvals,isenum,values))
 ENTRYPOINTVOID(alGetFloatv,(ALenum param, ALfloat *values),(param,values),2,(CallerInfo *callerinfo, ALenum param, ALfloat *origvalues, uint32 numvals, ALfloat *values),(callerinfo,param,origvalues,numvals,values))
@@ -93,7 +93,7 @@ ENTRYPOINTVOID(alSourceUnqueueBuffers,(ALuint name, ALsizei nb, ALuint *bufnames
 ENTRYPOINTVOID(alGenBuffers,(ALsizei n, ALuint *names),(n,names),2,(CallerInfo *callerinfo, ALsizei n, ALuint *orignames, ALuint *names),(callerinfo,n,orignames,names))
 ENTRYPOINTVOID(alDeleteBuffers,(ALsizei n, const ALuint *names),(n,names),2,(CallerInfo *callerinfo, ALsizei n, const ALuint *orignames, const ALuint *names),(callerinfo,n,orignames,names))
 ENTRYPOINT(ALboolean,alIsBuffer,(ALuint name),(name),1,(CallerInfo *callerinfo, ALboolean retval, ALuint name),(callerinfo,retval,name))
-ENTRYPOINTVOID(alBufferData,(ALuint name, ALenum alfmt, const ALvoid *data, ALsizei size, ALsizei freq),(name,alfmt,data,size,freq),5,(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const ALvoid *data, ALsizei size, ALsizei freq),(callerinfo,name,alfmt,origdata,data,size,freq))
+ENTRYPOINTVOID(alBufferData,(ALuint name, ALenum alfmt, const ALvoid *data, ALsizei size, ALsizei freq),(name,alfmt,data,size,freq),5,(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const TraceBlob *data, ALsizei size, ALsizei freq),(callerinfo,name,alfmt,origdata,data,size,freq))
 ENTRYPOINTVOID(alBufferfv,(ALuint name, ALenum param, const ALfloat *values),(name,param,values),3,(CallerInfo *callerinfo, ALuint name, ALenum param, const ALfloat *origvalues, uint32 numvals, const ALfloat *values),(callerinfo,name,param,origvalues,numvals,values))
 ENTRYPOINTVOID(alBufferf,(ALuint name, ALenum param, ALfloat value),(name,param,value),3,(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat value),(callerinfo,name,param,value))
 ENTRYPOINTVOID(alBuffer3f,(ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3),(name,param,value1,value2,value3),5,(CallerInfo *callerinfo, ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3),(callerinfo,name,param,value1,value2,value3))
@@ -115,6 +115,12 @@ ENTRYPOINTVOID(alTraceBufferLabel,(ALuint name, const ALchar *str),(name,str),2,
 ENTRYPOINTVOID(alTraceSourceLabel,(ALuint name, const ALchar *str),(name,str),2,(CallerInfo *callerinfo, ALuint name, const ALchar *str),(callerinfo,name,str))
 ENTRYPOINTVOID(alcTraceDeviceLabel,(ALCdevice *device, const ALchar *str),(device,str),2,(CallerInfo *callerinfo, ALCdevice *device, const ALCchar *str),(callerinfo,device,str))
 ENTRYPOINTVOID(alcTraceContextLabel,(ALCcontext *ctx, const ALchar *str),(ctx,str),2,(CallerInfo *callerinfo, ALCcontext *ctx, const ALCchar *str),(callerinfo,ctx,str))
+ENTRYPOINT(ALuint,alTraceRegisterZone,(const ALchar *str),(str),1,(CallerInfo *callerinfo, ALuint retval, const ALchar *str),(callerinfo,retval,str))
+ENTRYPOINTVOID(alTraceZoneBegin,(ALuint zone),(zone),1,(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds),(callerinfo,zone,nanoseconds))
+ENTRYPOINTVOID(alTraceZoneEnd,(ALuint zone),(zone),1,(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds),(callerinfo,zone,nanoseconds))
+ENTRYPOINTVOID(alTraceFrameMark,(void),(),0,(CallerInfo *callerinfo, uint64 nanoseconds),(callerinfo,nanoseconds))
+ENTRYPOINT(ALuint,alTraceRegisterCounter,(const ALchar *str),(str),1,(CallerInfo *callerinfo, ALuint retval, const ALchar *str),(callerinfo,retval,str))
+ENTRYPOINTVOID(alTraceCounter,(ALuint counter, ALdouble value),(counter,value),2,(CallerInfo *callerinfo, ALuint counter, ALdouble value),(callerinfo,counter,value))
 
 #undef ENTRYPOINT
 #undef ENTRYPOINTVOID
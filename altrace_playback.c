@@ -8,50 +8,59 @@
 
 #include "altrace_playback.h"
 
-static int logfd = -1;
-static uint32 trace_scope = 0;
-static void *guserdata = NULL;
-
-static void quit_altrace_playback(void);
+#include <sys/mman.h>
 
 // don't bother doing a full hash map for devices and contexts, since you'll
 //  usually never have more than one or two and they live basically the entire
 //  lifetime of your app.
-static void free_hash_item_device(ALCdevice *from, ALCdevice *to) { /* no-op */ }
-SIMPLE_MAP(device, ALCdevice *, ALCdevice *)
-
-static void free_hash_item_context(ALCcontext *from, ALCcontext *to) { /* no-op */ }
-SIMPLE_MAP(context, ALCcontext *, ALCcontext *)
-
 static void free_hash_item_devicelabel(ALCdevice *from, char *to) { free(to); }
-SIMPLE_MAP(devicelabel, ALCdevice *, char *)
+OWNED_SIMPLE_MAP(devicelabel, ALCdevice *, char *)
 
 static void free_hash_item_contextlabel(ALCcontext *from, char *to) { free(to); }
-SIMPLE_MAP(contextlabel, ALCcontext *, char *)
+OWNED_SIMPLE_MAP(contextlabel, ALCcontext *, char *)
 
-static void free_hash_item_alname(ALuint from, ALuint to) { /* no-op */ }
 static uint8 hash_alname(const ALuint name) {
     /* since these are usually small numbers that increment from 0, they distribute pretty well on their own. */
     return (uint8) (name & 0xFF);
 }
 
-#define free_hash_item_source free_hash_item_alname
-#define hash_source hash_alname
-HASH_MAP(source, ALuint, ALuint)
-
-#define free_hash_item_buffer free_hash_item_alname
-#define hash_buffer hash_alname
-HASH_MAP(buffer, ALuint, ALuint)
-
 static void free_hash_item_alname_label(ALuint from, char *to) { free(to); }
 
 #define free_hash_item_sourcelabel free_hash_item_alname_label
 #define hash_sourcelabel hash_alname
-HASH_MAP(sourcelabel, ALuint, char *)
+OWNED_HASH_MAP(sourcelabel, ALuint, char *)
 
 #define free_hash_item_bufferlabel free_hash_item_alname_label
 #define hash_bufferlabel hash_alname
-HASH_MAP(bufferlabel, ALuint, char *)
+OWNED_HASH_MAP(bufferlabel, ALuint, char *)
+
+#define free_hash_item_zonename free_hash_item_alname_label
+#define hash_zonename hash_alname
+OWNED_HASH_MAP(zonename, ALuint, char *)
+
+#define free_hash_item_countername free_hash_item_alname_label
+#define hash_countername hash_alname
+OWNED_HASH_MAP(countername, ALuint, char *)
+
+
+// motion mode turns per-object 3D updates into channels of quantized deltas;
+//  we keep each channel's running value to rebuild the calls.
+typedef struct MotionChannel
+{
+    MotionTarget target;
+    ALCcontext *ctx;
+    ALuint name;
+    ALenum param;
+    uint32 numvals;
+    double quantum;
+    int64 quantized[6];
+    ALfloat values[6];  // last values we reported, to know if state changed.
+    int have_values;
+} MotionChannel;
+
+static void free_hash_item_motion(ALuint from, MotionChannel *to) { free(to); }
+#define hash_motion hash_alname
+OWNED_HASH_MAP(motion, ALuint, MotionChannel *)
 
 
 static void free_hash_item_stackframe(void *from, char *to) { free(to); }
@@ -60,255 +69,727 @@ static uint8 hash_stackframe(void *from) {
     const size_t val = ((size_t) from) / (sizeof (void *));
     return (uint8) (val & 0xFF);  // good enough, I guess.
 }
-HASH_MAP(stackframe, void *, char *)
+OWNED_HASH_MAP(stackframe, void *, char *)
 
 static void free_hash_item_threadid(uint64 from, uint32 to) { /* no-op */ }
-static uint32 next_mapped_threadid = 0;
-SIMPLE_MAP(threadid, uint64, uint32);
+OWNED_SIMPLE_MAP(threadid, uint64, uint32)
+
+// altrace_snapshot_labels() copies the label maps into sorted arrays, since
+//  looking something up in a hash map moves it to the front of its bucket,
+//  and a snapshot gets looked at by several threads at once.
+typedef enum LabelKind
+{
+    LABEL_DEVICE,
+    LABEL_CONTEXT,
+    LABEL_SOURCE,
+    LABEL_BUFFER,
+    LABEL_ZONE,
+    LABEL_COUNTER,
+    LABEL_MAX
+} LabelKind;
+
+typedef struct LabelItem
+{
+    uint64 key;
+    const char *str;
+} LabelItem;
+
+struct TraceLabels
+{
+    int refcount;
+    uint64 generation;
+    LabelItem *items[LABEL_MAX];
+    uint32 numitems[LABEL_MAX];
+    Arena arena;  // the items and their strings.
+};
+
+// Everything decoding a tracefile needs, and everything it learns along the
+//  way, so any number of them can be going at once, on any threads.
+struct TraceReader
+{
+    int logfd;
+    const uint8 *logmap;  // the whole tracefile, if we could mmap() it.
+    size_t logmaplen;
+    size_t logmappos;
+    int borrowed_map;  // (logmap) belongs to someone else; this reader is one of its chunks.
+    off_t logsize;  // size of an unmapped tracefile.
+    uint32 format;  // ALTRACE_LOG_FILE_FORMAT of whatever wrote it.
+    char *filename;  // NULL for live traces and chunks, which can't seek.
+    ShmRing *shmring;
+    off_t chunk_end;  // non-zero if this reader stops at the end of a chunk.
+    off_t *chunks;  // where each chunk starts, plus the end of the file.
+    uint64 numchunks;
+    int found_chunks;
+    TraceEvent events[2];  // a record turns into at most two events; calls always come first.
+    int numevents;
+    int nextevent;
+    int finished;
+    char unwanted[ALEE_MAX];  // altrace_want_event() said not to bother with these.
+    TraceEvent unwanted_event;  // ...so they get decoded into here and dropped.
+    Arena arena;  // everything the current events point to.
+    int keep_events;  // don't reset (arena) until altrace_take_events().
+    EventEnum forget_event;  // a delete whose labels go once its event has been handed out.
+    void *forget_object;
+    const ALuint *forget_names;
+    ALsizei forget_numnames;
+    uint32 trace_scope;
+    uint32 next_mapped_threadid;
+    int io_failure;
+    int validating;  // decoding without visiting anything, for salvage_tracelog().
+    off_t event_offset;  // where the event currently being decoded started.
+    off_t event_end;  // ...and where its record ends.
+    uint32 last_ticks;
+    int have_sched_context;  // ALEE_SCHED_CONTEXT waiting for the next call.
+    uint32 sched_context[4];
+    uint64 events_to_skip;  // decode but don't visit this many more events, after seeking.
+    uint32 event_threadid;  // mapped thread of the event being decoded, 0 if not a call.
+    FILE *indexio;  // non-NULL while build_tracelog_index() is running.
+    uint64 index_numevents;
+    uint64 *index_threads;  // log thread ids, in the order we mapped them.
+    uint32 index_numthreads;
+    SimpleMap_devicelabel devicelabel_map;
+    SimpleMap_contextlabel contextlabel_map;
+    HashMap_sourcelabel sourcelabel_map;
+    HashMap_bufferlabel bufferlabel_map;
+    HashMap_zonename zonename_map;
+    HashMap_countername countername_map;
+    HashMap_motion motion_map;
+    HashMap_stackframe stackframe_map;
+    SimpleMap_threadid threadid_map;
+    uint64 labels_generation;  // goes up whenever a label changes.
+    TraceLabels *labels_snapshot;  // the last one we handed out.
+};
+
+// the reader whose events this thread is visiting, for ctxString(), etc.
+static __thread TraceReader *visiting_reader = NULL;
+static __thread TraceLabels *visiting_labels = NULL;  // ...unless altrace_use_labels() said otherwise.
+
+// anything that changes a label goes through here, so a snapshot of them
+//  knows it's out of date.
+#define SET_LABEL(maptype, key, str) { \
+    if ((str) || get_mapped_##maptype(&r->maptype##_map, key)) { \
+        r->labels_generation++; \
+    } \
+    add_##maptype##_to_map(&r->maptype##_map, key, str); \
+}
+
+#define VISITING (!r->io_failure && !r->validating && !r->events_to_skip)
+
+static TraceEvent *queue_event(TraceReader *r, const EventEnum type)
+{
+    TraceEvent *ev = r->unwanted[type] ? &r->unwanted_event : &r->events[r->numevents++];
+    ev->type = type;
+    ev->offset = r->event_offset;
+    return ev;
+}
+
+// queues up an event for altrace_next_event() to hand out. The arguments
+//  are in the same order the event's visitor takes them.
+#define EVENT(type, name, ...) { const TraceArgs_##name eventargs = { __VA_ARGS__ }; queue_event(r, type)->u.name = eventargs; }
+#define CALL_EVENT(name, ...) EVENT(ALEE_##name, name, __VA_ARGS__)
+
+static void IO_READ_FAIL(TraceReader *r, const int eof)
+{
+    if (!r->io_failure) {
+        if (!r->validating) {
+            fprintf(stderr, "%s: Failed to read from log: %s\n", GAppName, eof ? "end of file" : strerror(errno));
+        }
+        r->io_failure = 1;
+    }
+}
+
+static void readbytes(TraceReader *r, void *buf, const size_t len)
+{
+    if (r->io_failure) {
+        return;
+    } else if (r->logmap) {
+        if (len > (r->logmaplen - r->logmappos)) {
+            r->logmappos = r->logmaplen;
+            IO_READ_FAIL(r, 1);
+        } else {
+            memcpy(buf, r->logmap + r->logmappos, len);
+            r->logmappos += len;
+        }
+    } else if (r->shmring) {
+        if (!shmring_read(r->shmring, buf, len)) {
+            IO_READ_FAIL(r, 1);
+        }
+    } else {
+        const ssize_t br = read(r->logfd, buf, len);
+        if (br != ((ssize_t) len)) {
+            IO_READ_FAIL(r, br >= 0);
+        }
+    }
+}
 
-static int io_failure = 0;
-static void IO_READ_FAIL(const int eof)
+static off_t tell(TraceReader *r)
 {
-    if (!io_failure) {
-        fprintf(stderr, "%s: Failed to read from log: %s\n", GAppName, eof ? "end of file" : strerror(errno));
-        io_failure = 1;
+    if (r->logmap) {
+        return (off_t) r->logmappos;
     }
+    return r->shmring ? (off_t) shmring_position(r->shmring) : lseek(r->logfd, 0, SEEK_CUR);
 }
 
-static uint32 readle32(void)
+static int seek(TraceReader *r, const off_t pos)
 {
-    uint32 retval = 0;
-    if (!io_failure) {
-        const ssize_t br = read(logfd, &retval, sizeof (retval));
-        if (br != ((ssize_t) sizeof (retval))) {
-            IO_READ_FAIL(br >= 0);
+    if (r->logmap) {
+        if ((pos < 0) || (((uint64) pos) > r->logmaplen)) {
+            errno = EINVAL;
+            return 0;
+        }
+        r->logmappos = (size_t) pos;
+        return 1;
+    }
+    return (lseek(r->logfd, pos, SEEK_SET) != -1);
+}
+
+static void skipbytes(TraceReader *r, off_t len)
+{
+    if (r->io_failure || (len <= 0)) {
+        return;
+    } else if (r->logmap) {
+        if (((uint64) len) > (r->logmaplen - r->logmappos)) {
+            r->logmappos = r->logmaplen;
+            IO_READ_FAIL(r, 1);
+        } else {
+            r->logmappos += (size_t) len;
+        }
+    } else if (r->shmring) {
+        if (!shmring_peek(r->shmring, (size_t) len)) {
+            IO_READ_FAIL(r, 1);
         }
+    } else if (lseek(r->logfd, len, SEEK_CUR) == -1) {
+        IO_READ_FAIL(r, 0);
+    }
+}
+
+// these are the hot path: everything in the log is made of them. Mapped
+//  files skip readbytes() and its memcpy().
+static uint32 readle32(TraceReader *r)
+{
+    uint32 retval = 0;
+    if (r->logmap && !r->io_failure && ((r->logmaplen - r->logmappos) >= sizeof (retval))) {
+        const uint8 *ptr = r->logmap + r->logmappos;
+        r->logmappos += sizeof (retval);
+        return ((uint32) ptr[0]) | (((uint32) ptr[1]) << 8) | (((uint32) ptr[2]) << 16) | (((uint32) ptr[3]) << 24);
     }
+    readbytes(r, &retval, sizeof (retval));
     return swap32(retval);
 }
 
-static uint64 readle64(void)
+static uint64 readle64(TraceReader *r)
 {
     uint64 retval = 0;
-    if (!io_failure) {
-        const ssize_t br = read(logfd, &retval, sizeof (retval));
-        if (br != ((ssize_t) sizeof (retval))) {
-            IO_READ_FAIL(br >= 0);
-        }
+    if (r->logmap && !r->io_failure && ((r->logmaplen - r->logmappos) >= sizeof (retval))) {
+        const uint8 *ptr = r->logmap + r->logmappos;
+        r->logmappos += sizeof (retval);
+        return ((uint64) ptr[0]) | (((uint64) ptr[1]) << 8) | (((uint64) ptr[2]) << 16) | (((uint64) ptr[3]) << 24) |
+               (((uint64) ptr[4]) << 32) | (((uint64) ptr[5]) << 40) | (((uint64) ptr[6]) << 48) | (((uint64) ptr[7]) << 56);
     }
+    readbytes(r, &retval, sizeof (retval));
     return swap64(retval);
 }
 
-static int32 IO_INT32(void)
+static int32 IO_INT32(TraceReader *r)
 {
     union { int32 si32; uint32 ui32; } cvt;
-    cvt.ui32 = readle32();
+    cvt.ui32 = readle32(r);
     return cvt.si32;
 }
 
-static uint32 IO_UINT32(void)
+static uint32 IO_UINT32(TraceReader *r)
 {
-    return readle32();
+    return readle32(r);
 }
 
-static uint64 IO_UINT64(void)
+static uint64 IO_UINT64(TraceReader *r)
 {
-    return readle64();
+    return readle64(r);
 }
 
-static ALCsizei IO_ALCSIZEI(void)
+static ALCsizei IO_ALCSIZEI(TraceReader *r)
 {
-    return (ALCsizei) IO_UINT64();
+    return (ALCsizei) IO_UINT64(r);
 }
 
-static ALsizei IO_ALSIZEI(void)
+static ALsizei IO_ALSIZEI(TraceReader *r)
 {
-    return (ALsizei) IO_UINT64();
+    return (ALsizei) IO_UINT64(r);
 }
 
-static float IO_FLOAT(void)
+static float IO_FLOAT(TraceReader *r)
 {
     union { float f; uint32 ui32; } cvt;
-    cvt.ui32 = readle32();
+    cvt.ui32 = readle32(r);
     return cvt.f;
 }
 
-static double IO_DOUBLE(void)
+static double IO_DOUBLE(TraceReader *r)
 {
     union { double d; uint64 ui64; } cvt;
-    cvt.ui64 = readle64();
+    cvt.ui64 = readle64(r);
     return cvt.d;
 }
 
-static uint8 *IO_BLOB(uint64 *_len)
+// zigzag-encoded varint, as motion mode writes them.
+static int64 IO_VARINT(TraceReader *r)
+{
+    uint64 val = 0;
+    int shift;
+    for (shift = 0; shift < 64; shift += 7) {
+        uint8 byte = 0;
+        readbytes(r, &byte, 1);
+        val |= ((uint64) (byte & 0x7F)) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return (int64) ((val >> 1) ^ (~(val & 1) + 1));
+}
+
+// strings are stored with their null terminator (which isn't counted in the
+//  length), so they can be handed out in place, just like blobs.
+static const uint8 *IO_BLOB_INTERNAL(TraceReader *r, uint64 *_len, const int is_string)
 {
-    const uint64 len = IO_UINT64();
+    const uint64 len = IO_UINT64(r);
     const size_t slen = (size_t) len;
-    uint8 *ptr;
-    ssize_t br;
+    const size_t datalen = slen + (is_string ? 1 : 0);
+    const uint8 *ptr;
 
-    if (io_failure) {
+    *_len = 0;
+
+    if (r->io_failure) {
         return NULL;
     }
 
     if (len == 0xFFFFFFFFFFFFFFFFull) {
-        *_len = 0;
+        return NULL;
+    }
+
+    if ((uint64) datalen < len) {  // corrupt length wrapped around?
+        IO_READ_FAIL(r, 1);
         return NULL;
     }
 
     *_len = len;
 
-    ptr = (uint8 *) get_ioblob(slen + 1);
-    br = read(logfd, ptr, slen);
-    if (br != ((ssize_t) slen)) {
-        IO_READ_FAIL(br >= 0);
+    // reading from a mapped file? Hand out a pointer straight into it. It
+    //  stays valid until playback is done.
+    if (r->logmap) {
+        if (datalen > (r->logmaplen - r->logmappos)) {
+            r->logmappos = r->logmaplen;
+            IO_READ_FAIL(r, 1);
+            return NULL;
+        }
+        ptr = r->logmap + r->logmappos;
+        r->logmappos += datalen;
+    // reading from shared memory? Hand out a pointer straight into the ring.
+    //  It stays valid until we move on to the next event.
+    } else if (r->shmring) {
+        ptr = (const uint8 *) shmring_peek(r->shmring, datalen);
+        if (!ptr) {
+            IO_READ_FAIL(r, 1);
+            return NULL;
+        }
+    } else {
+        uint8 *buf = (uint8 *) arena_alloc(&r->arena, slen + 1);
+        readbytes(r, buf, datalen);
+        buf[slen] = '\0';
+        ptr = buf;
+    }
+
+    if (is_string && (ptr[slen] != '\0')) {
+        if (!r->validating) {
+            fprintf(stderr, "%s: Unterminated string at offset %llu, log is probably corrupt.\n", GAppName, (unsigned long long) r->event_offset);
+        }
+        r->io_failure = 1;
+        return NULL;
     }
-    ptr[slen] = '\0';
 
     return ptr;
 }
 
-static const char *IO_STRING(void)
+// audio data is left where it is if we can get back to it later, so nothing
+//  has to touch it unless a visitor asks for it with altrace_blob_map().
+static const TraceBlob *IO_BLOBREF(TraceReader *r)
+{
+    TraceBlob *blob = (TraceBlob *) arena_alloc(&r->arena, sizeof (TraceBlob));
+    const uint64 len = IO_UINT64(r);
+    const size_t slen = (size_t) len;
+
+    if (r->io_failure || (len == 0xFFFFFFFFFFFFFFFFull)) {
+        return NULL;
+    } else if ((uint64) slen != len) {  // corrupt length?
+        IO_READ_FAIL(r, 1);
+        return NULL;
+    }
+
+    blob->offset = tell(r);
+    blob->len = len;
+    blob->data = NULL;
+
+    if (r->shmring && !r->logmap) {  // a live trace won't have it later, so it has to come out now.
+        blob->data = shmring_peek(r->shmring, slen);
+        if (!blob->data) {
+            IO_READ_FAIL(r, 1);
+        }
+    } else {
+        if (r->logmap) {
+            blob->data = r->logmap + r->logmappos;  // doesn't fault anything in until someone looks.
+        }
+        skipbytes(r, (off_t) len);
+    }
+
+    if (r->format >= 16) {
+        blob->hash = IO_UINT64(r);
+    } else {  // older tracefiles don't have it; make one up if it's right here.
+        blob->hash = blob->data ? hash_blob(blob->data, slen) : 0;
+    }
+    return r->io_failure ? NULL : blob;
+}
+
+static const char *IO_STRING(TraceReader *r)
 {
     uint64 len;
-    return (const char *) IO_BLOB(&len);
+    return (const char *) IO_BLOB_INTERNAL(r, &len, 1);
 }
 
-static EventEnum IO_EVENTENUM(void)
+static EventEnum IO_EVENTENUM(TraceReader *r)
 {
-    return (EventEnum) IO_UINT32();
+    return (EventEnum) IO_UINT32(r);
 }
 
-static void *IO_PTR(void)
+static void *IO_PTR(TraceReader *r)
 {
-    return (void *) (size_t) IO_UINT64();  // !!! FIXME: probably need to map this on 32-bit systems.
+    return (void *) (size_t) IO_UINT64(r);  // !!! FIXME: probably need to map this on 32-bit systems.
 }
 
-static ALCenum IO_ALCENUM(void)
+static ALCenum IO_ALCENUM(TraceReader *r)
 {
-    return (ALCenum) IO_UINT32();
+    return (ALCenum) IO_UINT32(r);
 }
 
-static ALenum IO_ENUM(void)
+static ALenum IO_ENUM(TraceReader *r)
 {
-    return (ALenum) IO_UINT32();
+    return (ALenum) IO_UINT32(r);
 }
 
-static ALCboolean IO_ALCBOOLEAN(void)
+static ALCboolean IO_ALCBOOLEAN(TraceReader *r)
 {
-    return (ALCboolean) IO_UINT32();
+    return (ALCboolean) IO_UINT32(r);
 }
 
-static ALboolean IO_BOOLEAN(void)
+static ALboolean IO_BOOLEAN(TraceReader *r)
 {
-    return (ALboolean) IO_UINT32();
+    return (ALboolean) IO_UINT32(r);
 }
 
-static void IO_ENTRYINFO(CallerInfo *callerinfo)
+static void init_callerinfo(TraceReader *r, CallerInfo *callerinfo, const uint32 wait_until, const uint64 logthreadid)
 {
-    const uint32 wait_until = IO_UINT32();
-    const uint64 logthreadid = IO_UINT64();
-    const uint32 frames = IO_UINT32();
     uint32 threadid;
-    uint32 i;
 
-    if (io_failure) {
-        return;
-    }
-
-    threadid = get_mapped_threadid(logthreadid);
+    r->last_ticks = wait_until;
+    threadid = get_mapped_threadid(&r->threadid_map, logthreadid);
 
     if (!threadid) {
-        threadid = ++next_mapped_threadid;
-        add_threadid_to_map(logthreadid, threadid);
+        threadid = ++r->next_mapped_threadid;
+        add_threadid_to_map(&r->threadid_map, logthreadid, threadid);
+        if (r->indexio) {
+            void *ptr = realloc(r->index_threads, sizeof (uint64) * (r->index_numthreads + 1));
+            if (!ptr) {
+                out_of_memory();
+            }
+            r->index_threads = (uint64 *) ptr;
+            r->index_threads[r->index_numthreads++] = logthreadid;
+        }
     }
 
-    callerinfo->num_callstack_frames = (frames < MAX_CALLSTACKS) ? frames : MAX_CALLSTACKS;
+    r->event_threadid = threadid;
+
+    callerinfo->num_callstack_frames = 0;
     callerinfo->threadid = threadid;
-    callerinfo->trace_scope = trace_scope;
+    callerinfo->trace_scope = r->trace_scope;
     callerinfo->wait_until = wait_until;
-    callerinfo->userdata = guserdata;
+    callerinfo->userdata = NULL;  // altrace_process() fills this in.
+
+    callerinfo->has_sched_context = r->have_sched_context;
+    if (r->have_sched_context) {
+        callerinfo->cpu = r->sched_context[0];
+        callerinfo->sched_policy = r->sched_context[1] >> 16;
+        callerinfo->sched_priority = r->sched_context[1] & 0xFFFF;
+        callerinfo->voluntary_csw = r->sched_context[2];
+        callerinfo->involuntary_csw = r->sched_context[3];
+        r->have_sched_context = 0;
+    }
+}
+
+static void IO_ENTRYINFO(TraceReader *r, CallerInfo *callerinfo)
+{
+    const uint32 wait_until = IO_UINT32(r);
+    const uint64 logthreadid = IO_UINT64(r);
+    const uint32 frames = IO_UINT32(r);
+    uint32 i;
+
+    if (r->io_failure) {
+        return;
+    }
+
+    init_callerinfo(r, callerinfo, wait_until, logthreadid);
+    callerinfo->num_callstack_frames = (frames < MAX_CALLSTACKS) ? frames : MAX_CALLSTACKS;
 
     for (i = 0; i < frames; i++) {
-        void *ptr = IO_PTR();
-        if ((!io_failure) && (i < MAX_CALLSTACKS)) {
+        void *ptr = IO_PTR(r);
+        if ((!r->io_failure) && (i < MAX_CALLSTACKS)) {
             callerinfo->callstack[i].frame = ptr;
-            callerinfo->callstack[i].sym = get_mapped_stackframe(ptr);
+            callerinfo->callstack[i].sym = get_mapped_stackframe(&r->stackframe_map, ptr);
         }
     }
 
-    callerinfo->fdoffset = lseek(logfd, 0, SEEK_CUR);
+    callerinfo->fdoffset = tell(r);
+}
+
+// deleted objects lose their labels, but not until the delete has been
+//  handed out, so its visitor can still name them. This holds on to
+//  (names), which has to stay good until the next event is decoded.
+static void forget_labels(TraceReader *r, const EventEnum ev, void *object, const ALuint *names, const ALsizei numnames)
+{
+    r->forget_event = ev;
+    r->forget_object = object;
+    r->forget_names = names;
+    r->forget_numnames = numnames;
+}
+
+static void forget_pending_labels(TraceReader *r)
+{
+    ALsizei i;
+
+    switch (r->forget_event) {
+        case ALEE_alcCaptureCloseDevice:
+        case ALEE_alcCloseDevice:
+            SET_LABEL(devicelabel, (ALCdevice *) r->forget_object, NULL);
+            break;
+        case ALEE_alcDestroyContext:
+            SET_LABEL(contextlabel, (ALCcontext *) r->forget_object, NULL);
+            break;
+        case ALEE_alDeleteSources:
+            for (i = 0; i < r->forget_numnames; i++) {
+                SET_LABEL(sourcelabel, r->forget_names[i], NULL);
+            }
+            break;
+        case ALEE_alDeleteBuffers:
+            for (i = 0; i < r->forget_numnames; i++) {
+                SET_LABEL(bufferlabel, r->forget_names[i], NULL);
+            }
+            break;
+        default: break;
+    }
+
+    r->forget_event = ALEE_EOS;  // nothing pending.
+}
+
+// everything from the last event has been handed out and visited, so it
+//  can go now.
+static void start_event(TraceReader *r)
+{
+    forget_pending_labels(r);
+    if (!r->keep_events) {
+        arena_reset(&r->arena);
+    }
 }
 
-#define IO_START(e) { CallerInfo callerinfo; IO_ENTRYINFO(&callerinfo); if (!io_failure) {
+#define IO_START(e) { CallerInfo *callerinfo = &r->events[0].callerinfo; IO_ENTRYINFO(r, callerinfo); if (!r->io_failure) {
 #define IO_END() } }
 
 
-static int init_altrace_playback(const char *filename, void *userdata)
+// everything decoding has learned about the log.
+static void forget_decoder_state(TraceReader *r)
+{
+    free_stackframe_map(&r->stackframe_map);
+    free_threadid_map(&r->threadid_map);
+    free_devicelabel_map(&r->devicelabel_map);
+    free_contextlabel_map(&r->contextlabel_map);
+    free_sourcelabel_map(&r->sourcelabel_map);
+    free_bufferlabel_map(&r->bufferlabel_map);
+    free_zonename_map(&r->zonename_map);
+    free_countername_map(&r->countername_map);
+    free_motion_map(&r->motion_map);
+    r->labels_generation++;
+    r->next_mapped_threadid = 0;
+    r->trace_scope = 0;
+    r->last_ticks = 0;
+    r->have_sched_context = 0;
+    r->events_to_skip = 0;
+    r->numevents = r->nextevent = 0;
+    r->finished = 0;
+    r->io_failure = 0;
+    r->forget_event = ALEE_EOS;
+    arena_reset(&r->arena);
+}
+
+static TraceReader *new_reader(void)
+{
+    TraceReader *r = (TraceReader *) calloc(1, sizeof (TraceReader));
+    if (!r) {
+        out_of_memory();
+    }
+    r->logfd = -1;
+    return r;
+}
+
+// (shmname) is non-NULL if we're attaching to a live process's shared
+//  memory ring instead of opening a file.
+static TraceReader *open_reader(const char *filename, const char *shmname)
 {
+    TraceReader *r = new_reader();
     int okay = 1;
 
-    io_failure = 0;
-    next_mapped_threadid = 0;
-    trace_scope = 0;
-    guserdata = userdata;
+    if (shmname) {
+        filename = shmname;
+        r->shmring = shmring_attach(shmname);
+        if (!r->shmring) {
+            okay = 0;
+        }
+    } else {
+        r->logfd = open(filename, O_RDONLY);
+        if (r->logfd == -1) {
+            fprintf(stderr, "%s: Failed to open OpenAL log file '%s': %s\n", GAppName, filename, strerror(errno));
+            okay = 0;
+        } else {
+            // map the whole thing, so decoding doesn't need a read() per
+            //  field. If this fails (a pipe, say), we just read() instead.
+            struct stat statbuf;
+            r->filename = strdup(filename);
+            if (!r->filename) {
+                out_of_memory();
+            } else if (fstat(r->logfd, &statbuf) == 0) {
+                r->logsize = statbuf.st_size;
+            }
 
-    logfd = open(filename, O_RDONLY);
-    if (logfd == -1) {
-        fprintf(stderr, "%s: Failed to open OpenAL log file '%s': %s\n", GAppName, filename, strerror(errno));
-        okay = 0;
+            if ((fstat(r->logfd, &statbuf) == 0) && S_ISREG(statbuf.st_mode) && (statbuf.st_size > 0) && ((uint64) statbuf.st_size <= (uint64) SIZE_MAX)) {
+                void *ptr = mmap(NULL, (size_t) statbuf.st_size, PROT_READ, MAP_PRIVATE, r->logfd, 0);
+                if (ptr != MAP_FAILED) {
+                    #ifdef MADV_SEQUENTIAL
+                    madvise(ptr, (size_t) statbuf.st_size, MADV_SEQUENTIAL);
+                    #endif
+                    r->logmap = (const uint8 *) ptr;
+                    r->logmaplen = (size_t) statbuf.st_size;
+                    r->logmappos = 0;
+                }
+            }
+        }
     }
 
     fflush(stderr);
 
+    // newer formats only add events and fields, which we skip, so anything
+    //  since records got their lengths will do.
     if (okay) {
-        if (IO_UINT32() != ALTRACE_LOG_FILE_MAGIC) {
+        if (IO_UINT32(r) != ALTRACE_LOG_FILE_MAGIC) {
             fprintf(stderr, "%s: File '%s' does not appear to be an OpenAL log file.\n", GAppName, filename);
             okay = 0;
-        } else if (IO_UINT32() != ALTRACE_LOG_FILE_FORMAT) {
+        } else if ((r->format = IO_UINT32(r)) < ALTRACE_LOG_FILE_MIN_FORMAT) {
             fprintf(stderr, "%s: File '%s' is an unsupported log file format version.\n", GAppName, filename);
             okay = 0;
         }
     }
 
     if (!okay) {
-        quit_altrace_playback();
+        altrace_close(r);
+        return NULL;
     }
 
-    return okay;
+    return r;
+}
+
+TraceReader *altrace_open(const char *filename)
+{
+    return open_reader(filename, NULL);
 }
 
-static void quit_altrace_playback(void)
+TraceReader *altrace_attach(const char *shmname)
 {
-    const int io = logfd;
+    return open_reader(NULL, shmname);
+}
 
-    logfd = -1;
-    io_failure = 0;
-    next_mapped_threadid = 0;
-    trace_scope = 0;
-    guserdata = NULL;
+void altrace_close(TraceReader *r)
+{
+    if (!r) {
+        return;
+    }
 
     fflush(stdout);
 
-    if ((io != -1) && (close(io) < 0)) {
+    if (visiting_reader == r) {
+        visiting_reader = NULL;
+        arena_use(NULL);
+    }
+
+    if (r->logmap && !r->borrowed_map) {
+        munmap((void *) r->logmap, r->logmaplen);
+    }
+
+    if ((r->logfd != -1) && (close(r->logfd) < 0)) {
         fprintf(stderr, "%s: Failed to close OpenAL log file: %s\n", GAppName, strerror(errno));
     }
 
-    free_device_map();
-    free_context_map();
-    free_source_map();
-    free_buffer_map();
-    free_stackframe_map();
-    free_threadid_map();
-    free_devicelabel_map();
-    free_contextlabel_map();
-    free_sourcelabel_map();
-    free_bufferlabel_map();
-    free_ioblobs();
+    shmring_close(r->shmring);
+    altrace_free_labels(r->labels_snapshot);
+    forget_decoder_state(r);
+    free(r->index_threads);
+    free(r->chunks);
+    free(r->filename);
+    arena_free(&r->arena);
+    free(r);
 
     fflush(stderr);
 }
 
+// The *String() functions get called for nearly every argument of every
+//  call we dump, so the common ones build their strings by hand instead of
+//  going through sprintf_alloc().
+static const char *hexString(const uint64 x, const int uppercase)
+{
+    char buf[18];
+    char *end = buf + sizeof (buf);
+    char *ptr = format_hex(end, x, uppercase);
+    const size_t len = (size_t) (end - ptr);
+    char *retval = (char *) scratch_alloc(len + 3);
+    retval[0] = '0';
+    retval[1] = 'x';
+    memcpy(retval + 2, ptr, len);
+    retval[len + 2] = '\0';
+    return retval;
+}
+
+// "str<label>"
+static const char *labelString(const char *str, const size_t slen, const char *label)
+{
+    const size_t labellen = strlen(label);
+    char *retval = (char *) scratch_alloc(slen + labellen + 3);
+    memcpy(retval, str, slen);
+    retval[slen] = '<';
+    memcpy(retval + slen + 1, label, labellen);
+    retval[slen + labellen + 1] = '>';
+    retval[slen + labellen + 2] = '\0';
+    return retval;
+}
+
+// "name" or "name<label>"
+static const char *nameString(const ALuint name, const char *label)
+{
+    char buf[20];
+    char *end = buf + sizeof (buf);
+    char *ptr = format_uint(end, (uint64) name);
+    char *retval;
+    if (label) {
+        return labelString(ptr, (size_t) (end - ptr), label);
+    }
+    retval = (char *) scratch_alloc((size_t) (end - ptr) + 1);
+    memcpy(retval, ptr, (size_t) (end - ptr));
+    retval[end - ptr] = '\0';
+    return retval;
+}
+
 const char *alcboolString(const ALCboolean x)
 {
     switch (x) {
@@ -317,7 +798,7 @@ const char *alcboolString(const ALCboolean x)
         default: break;
     }
 
-    return sprintf_alloc("0x%X", (uint) x);
+    return hexString((uint64) (uint) x, 1);
 }
 
 const char *alboolString(const ALCboolean x)
@@ -328,7 +809,7 @@ const char *alboolString(const ALCboolean x)
         default: break;
     }
 
-    return sprintf_alloc("0x%X", (uint) x);
+    return hexString((uint64) (uint) x, 1);
 }
 
 const char *alcenumString(const ALCenum x)
@@ -359,11 +840,14 @@ const char *alcenumString(const ALCenum x)
         ENUM_TEST(ALC_DEFAULT_ALL_DEVICES_SPECIFIER);
         ENUM_TEST(ALC_ALL_DEVICES_SPECIFIER);
         ENUM_TEST(ALC_CONNECTED);
+        ENUM_TEST(ALC_DEVICE_CLOCK_SOFT);
+        ENUM_TEST(ALC_DEVICE_LATENCY_SOFT);
+        ENUM_TEST(ALC_DEVICE_CLOCK_LATENCY_SOFT);
         #undef ENUM_TEST
         default: break;
     }
 
-    return sprintf_alloc("0x%X", (uint) x);
+    return hexString((uint64) (uint) x, 1);
 }
 
 const char *alenumString(const ALCenum x)
@@ -434,18 +918,20 @@ const char *alenumString(const ALCenum x)
         ENUM_TEST(AL_EXPONENT_DISTANCE_CLAMPED);
         ENUM_TEST(AL_FORMAT_MONO_FLOAT32);
         ENUM_TEST(AL_FORMAT_STEREO_FLOAT32);
+        ENUM_TEST(AL_SAMPLE_OFFSET_LATENCY_SOFT);
+        ENUM_TEST(AL_SEC_OFFSET_LATENCY_SOFT);
         #undef ENUM_TEST
         default: break;
     }
 
-    return sprintf_alloc("0x%X", (uint) x);
+    return hexString((uint64) (uint) x, 1);
 }
 
 const char *litString(const char *str)
 {
     if (str) {
-        const size_t slen = (strlen(str) + 1) * 2;
-        char *retval = (char *) get_ioblob(slen);
+        const size_t slen = (strlen(str) * 2) + 3;  // every char escaped, plus quotes and null.
+        char *retval = (char *) scratch_alloc(slen);
         char *ptr = retval;
         *(ptr++) = '"';
         while (1) {
@@ -466,223 +952,288 @@ const char *litString(const char *str)
     return "NULL";
 }
 
+// these are the Linux values, since that's where the recorder collects them.
+const char *schedPolicyString(const uint32 policy)
+{
+    switch (policy) {
+        case 0: return "SCHED_OTHER";
+        case 1: return "SCHED_FIFO";
+        case 2: return "SCHED_RR";
+        case 3: return "SCHED_BATCH";
+        case 5: return "SCHED_IDLE";
+        case 6: return "SCHED_DEADLINE";
+        default: break;
+    }
+    return sprintf_alloc("SCHED_<%u>", (uint) policy);
+}
+
 const char *ptrString(const void *ptr)
 {
-    return ptr ? sprintf_alloc("%p", ptr) : "NULL";
+    return ptr ? hexString((uint64) (size_t) ptr, 0) : "NULL";  // the same as glibc's "%p".
+}
+
+static int compare_label_items(const void *a, const void *b)
+{
+    const uint64 key1 = ((const LabelItem *) a)->key;
+    const uint64 key2 = ((const LabelItem *) b)->key;
+    return (key1 < key2) ? -1 : (key1 > key2) ? 1 : 0;
+}
+
+// what the labels were when this thread's event was decoded.
+static const char *find_label(const LabelKind kind, const uint64 key)
+{
+    if (!key) {
+        return NULL;
+    } else if (visiting_labels) {
+        const LabelItem find = { key, NULL };
+        const LabelItem *item = (visiting_labels->numitems[kind] == 0) ? NULL : (const LabelItem *) bsearch(&find, visiting_labels->items[kind], visiting_labels->numitems[kind], sizeof (LabelItem), compare_label_items);
+        return item ? item->str : NULL;
+    } else if (visiting_reader) {
+        TraceReader *r = visiting_reader;
+        switch (kind) {
+            case LABEL_DEVICE: return get_mapped_devicelabel(&r->devicelabel_map, (ALCdevice *) (size_t) key);
+            case LABEL_CONTEXT: return get_mapped_contextlabel(&r->contextlabel_map, (ALCcontext *) (size_t) key);
+            case LABEL_SOURCE: return get_mapped_sourcelabel(&r->sourcelabel_map, (ALuint) key);
+            case LABEL_BUFFER: return get_mapped_bufferlabel(&r->bufferlabel_map, (ALuint) key);
+            case LABEL_ZONE: return get_mapped_zonename(&r->zonename_map, (ALuint) key);
+            case LABEL_COUNTER: return get_mapped_countername(&r->countername_map, (ALuint) key);
+            default: break;
+        }
+    }
+    return NULL;
 }
 
 const char *ctxString(ALCcontext *ctx)
 {
-    char *label = ctx ? get_mapped_contextlabel(ctx) : NULL;
-    return label ? sprintf_alloc("%s<%s>", ptrString(ctx), label) : ptrString(ctx);
+    const char *label = find_label(LABEL_CONTEXT, (uint64) (size_t) ctx);
+    const char *str = ptrString(ctx);
+    return label ? labelString(str, strlen(str), label) : str;
 }
 
 const char *deviceString(ALCdevice *device)
 {
-    char *label = device ? get_mapped_devicelabel(device) : NULL;
-    return label ? sprintf_alloc("%s<%s>", ptrString(device), label) : ptrString(device);
+    const char *label = find_label(LABEL_DEVICE, (uint64) (size_t) device);
+    const char *str = ptrString(device);
+    return label ? labelString(str, strlen(str), label) : str;
 }
 
 const char *sourceString(const ALuint name)
 {
-    char *label = name ? get_mapped_sourcelabel(name) : NULL;
-    return label ? sprintf_alloc("%u<%s>", (uint) name, label) : sprintf_alloc("%u", (uint) name);
+    const char *label = find_label(LABEL_SOURCE, (uint64) name);
+    return nameString(name, label);
+}
+
+const char *zoneString(const ALuint zone)
+{
+    const char *name = find_label(LABEL_ZONE, (uint64) zone);
+    return nameString(zone, name);
+}
+
+const char *counterString(const ALuint counter)
+{
+    const char *name = find_label(LABEL_COUNTER, (uint64) counter);
+    return nameString(counter, name);
+}
+
+const char *counterName(const ALuint counter)
+{
+    return find_label(LABEL_COUNTER, (uint64) counter);
 }
 
 const char *bufferString(const ALuint name)
 {
-    char *label = name ? get_mapped_bufferlabel(name) : NULL;
-    return label ? sprintf_alloc("%u<%s>", (uint) name, label) : sprintf_alloc("%u", (uint) name);
+    const char *label = find_label(LABEL_BUFFER, (uint64) name);
+    return nameString(name, label);
 }
 
 
-static void decode_alcGetCurrentContext(void)
+static void decode_alcGetCurrentContext(TraceReader *r)
 {
     IO_START(alcGetCurrentContext);
-    ALCcontext *retval = (ALCcontext *) IO_PTR();
-    if (!io_failure) visit_alcGetCurrentContext(&callerinfo, retval);
+    ALCcontext *retval = (ALCcontext *) IO_PTR(r);
+    if (VISITING) CALL_EVENT(alcGetCurrentContext, callerinfo, retval);
     IO_END();
 }
 
-static void decode_alcGetContextsDevice(void)
+static void decode_alcGetContextsDevice(TraceReader *r)
 {
     IO_START(alcGetContextsDevice);
-    ALCcontext *context = (ALCcontext *) IO_PTR();
-    ALCdevice *retval = (ALCdevice *) IO_PTR();
-    if (!io_failure) visit_alcGetContextsDevice(&callerinfo, retval, context);
+    ALCcontext *context = (ALCcontext *) IO_PTR(r);
+    ALCdevice *retval = (ALCdevice *) IO_PTR(r);
+    if (VISITING) CALL_EVENT(alcGetContextsDevice, callerinfo, retval, context);
     IO_END();
 }
 
-static void decode_alcIsExtensionPresent(void)
+static void decode_alcIsExtensionPresent(TraceReader *r)
 {
     IO_START(alcIsExtensionPresent);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCchar *extname = (const ALCchar *) IO_STRING();
-    const ALCboolean retval = IO_ALCBOOLEAN();
-    if (!io_failure) visit_alcIsExtensionPresent(&callerinfo, retval, device, extname);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCchar *extname = (const ALCchar *) IO_STRING(r);
+    const ALCboolean retval = IO_ALCBOOLEAN(r);
+    if (VISITING) CALL_EVENT(alcIsExtensionPresent, callerinfo, retval, device, extname);
     IO_END();
 }
 
-static void decode_alcGetProcAddress(void)
+static void decode_alcGetProcAddress(TraceReader *r)
 {
     IO_START(alcGetProcAddress);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCchar *funcname = (const ALCchar *) IO_STRING();
-    void *retval = IO_PTR();
-    if (!io_failure) visit_alcGetProcAddress(&callerinfo, retval, device, funcname);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCchar *funcname = (const ALCchar *) IO_STRING(r);
+    void *retval = IO_PTR(r);
+    if (VISITING) CALL_EVENT(alcGetProcAddress, callerinfo, retval, device, funcname);
     IO_END();
 
 }
 
-static void decode_alcGetEnumValue(void)
+static void decode_alcGetEnumValue(TraceReader *r)
 {
     IO_START(alcGetEnumValue);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCchar *enumname = (const ALCchar *) IO_STRING();
-    const ALCenum retval = IO_ALCENUM();
-    if (!io_failure) visit_alcGetEnumValue(&callerinfo, retval, device, enumname);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCchar *enumname = (const ALCchar *) IO_STRING(r);
+    const ALCenum retval = IO_ALCENUM(r);
+    if (VISITING) CALL_EVENT(alcGetEnumValue, callerinfo, retval, device, enumname);
     IO_END();
 }
 
-static void decode_alcGetString(void)
+static void decode_alcGetString(TraceReader *r)
 {
     IO_START(alcGetEnumValue);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCenum param = IO_ALCENUM();
-    const ALCchar *retval = (const ALCchar *) IO_STRING();
-    if (!io_failure) visit_alcGetString(&callerinfo, retval, device, param);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCenum param = IO_ALCENUM(r);
+    const ALCchar *retval = (const ALCchar *) IO_STRING(r);
+    if (VISITING) CALL_EVENT(alcGetString, callerinfo, retval, device, param);
     IO_END();
 }
 
-static void decode_alcCaptureOpenDevice(void)
+static void decode_alcCaptureOpenDevice(TraceReader *r)
 {
     IO_START(alcCaptureOpenDevice);
-    const ALCchar *devicename = (const ALCchar *) IO_STRING();
-    const ALCuint frequency = IO_UINT32();
-    const ALCenum format = IO_ALCENUM();
-    const ALCsizei buffersize = IO_ALSIZEI();
-    ALCdevice *retval = (ALCdevice *) IO_PTR();
-    const ALint major_version = retval ? IO_INT32() : 0;
-    const ALint minor_version = retval ? IO_INT32() : 0;
-    const ALCchar *devspec = (const ALCchar *) (retval ? IO_STRING() : NULL);
-    const ALCchar *extensions = (const ALCchar *) (retval ? IO_STRING() : NULL);
-    if (!io_failure) visit_alcCaptureOpenDevice(&callerinfo, retval, devicename, frequency, format, buffersize, major_version, minor_version, devspec, extensions);
+    const ALCchar *devicename = (const ALCchar *) IO_STRING(r);
+    const ALCuint frequency = IO_UINT32(r);
+    const ALCenum format = IO_ALCENUM(r);
+    const ALCsizei buffersize = IO_ALSIZEI(r);
+    ALCdevice *retval = (ALCdevice *) IO_PTR(r);
+    const ALint major_version = retval ? IO_INT32(r) : 0;
+    const ALint minor_version = retval ? IO_INT32(r) : 0;
+    const ALCchar *devspec = (const ALCchar *) (retval ? IO_STRING(r) : NULL);
+    const ALCchar *extensions = (const ALCchar *) (retval ? IO_STRING(r) : NULL);
+    if (VISITING) CALL_EVENT(alcCaptureOpenDevice, callerinfo, retval, devicename, frequency, format, buffersize, major_version, minor_version, devspec, extensions);
     IO_END();
 }
 
-static void decode_alcCaptureCloseDevice(void)
+static void decode_alcCaptureCloseDevice(TraceReader *r)
 {
     IO_START(alcCaptureCloseDevice);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCboolean retval = IO_ALCBOOLEAN();
-    if (!io_failure) visit_alcCaptureCloseDevice(&callerinfo, retval, device);
-    add_devicelabel_to_map(device, NULL);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCboolean retval = IO_ALCBOOLEAN(r);
+    if (VISITING) CALL_EVENT(alcCaptureCloseDevice, callerinfo, retval, device);
+    forget_labels(r, ALEE_alcCaptureCloseDevice, device, NULL, 0);
     IO_END();
 }
 
-static void decode_alcOpenDevice(void)
+static void decode_alcOpenDevice(TraceReader *r)
 {
     IO_START(alcOpenDevice);
-    const ALCchar *devicename = IO_STRING();
-    ALCdevice *retval = (ALCdevice *) IO_PTR();
-    const ALint major_version = retval ? IO_INT32() : 0;
-    const ALint minor_version = retval ? IO_INT32() : 0;
-    const ALCchar *devspec = (const ALCchar *) (retval ? IO_STRING() : NULL);
-    const ALCchar *extensions = (const ALCchar *) (retval ? IO_STRING() : NULL);
-    if (!io_failure) visit_alcOpenDevice(&callerinfo, retval, devicename, major_version, minor_version, devspec, extensions);
+    const ALCchar *devicename = IO_STRING(r);
+    ALCdevice *retval = (ALCdevice *) IO_PTR(r);
+    const ALint major_version = retval ? IO_INT32(r) : 0;
+    const ALint minor_version = retval ? IO_INT32(r) : 0;
+    const ALCchar *devspec = (const ALCchar *) (retval ? IO_STRING(r) : NULL);
+    const ALCchar *extensions = (const ALCchar *) (retval ? IO_STRING(r) : NULL);
+    if (VISITING) CALL_EVENT(alcOpenDevice, callerinfo, retval, devicename, major_version, minor_version, devspec, extensions);
     IO_END();
 }
 
-static void decode_alcCloseDevice(void)
+static void decode_alcCloseDevice(TraceReader *r)
 {
     IO_START(alcCloseDevice);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCboolean retval = IO_ALCBOOLEAN();
-    if (!io_failure) visit_alcCloseDevice(&callerinfo, retval, device);
-    add_devicelabel_to_map(device, NULL);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCboolean retval = IO_ALCBOOLEAN(r);
+    if (VISITING) CALL_EVENT(alcCloseDevice, callerinfo, retval, device);
+    forget_labels(r, ALEE_alcCloseDevice, device, NULL, 0);
     IO_END();
 }
 
-static void decode_alcCreateContext(void)
+static void decode_alcCreateContext(TraceReader *r)
 {
     IO_START(alcCreateContext);
     ALCcontext *retval;
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    ALCint *origattrlist = (ALCint *) IO_PTR();
-    const uint32 attrcount = IO_UINT32();
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    ALCint *origattrlist = (ALCint *) IO_PTR(r);
+    const uint32 attrcount = IO_UINT32(r);
     ALCint *attrlist = NULL;
     if (attrcount) {
         ALCint i;
-        attrlist = (ALCint *) get_ioblob(sizeof (ALCint) * attrcount);
+        attrlist = (ALCint *) arena_alloc(&r->arena, sizeof (ALCint) * attrcount);
         for (i = 0; i < attrcount; i++) {
-            attrlist[i] = (ALCint) IO_INT32();
+            attrlist[i] = (ALCint) IO_INT32(r);
         }
     }
-    retval = (ALCcontext *) IO_PTR();
+    retval = (ALCcontext *) IO_PTR(r);
 
-    if (!io_failure) visit_alcCreateContext(&callerinfo, retval, device, origattrlist, attrcount, attrlist);
+    if (VISITING) CALL_EVENT(alcCreateContext, callerinfo, retval, device, origattrlist, attrcount, attrlist);
 
     IO_END();
 
 }
 
-static void decode_alcMakeContextCurrent(void)
+static void decode_alcMakeContextCurrent(TraceReader *r)
 {
     IO_START(alcMakeContextCurrent);
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    const ALCboolean retval = IO_ALCBOOLEAN();
-    if (!io_failure) visit_alcMakeContextCurrent(&callerinfo, retval, ctx);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALCboolean retval = IO_ALCBOOLEAN(r);
+    if (VISITING) CALL_EVENT(alcMakeContextCurrent, callerinfo, retval, ctx);
     IO_END();
 }
 
-static void decode_alcProcessContext(void)
+static void decode_alcProcessContext(TraceReader *r)
 {
     IO_START(alcProcessContext);
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    if (!io_failure) visit_alcProcessContext(&callerinfo, ctx);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    if (VISITING) CALL_EVENT(alcProcessContext, callerinfo, ctx);
     IO_END();
 }
 
-static void decode_alcSuspendContext(void)
+static void decode_alcSuspendContext(TraceReader *r)
 {
     IO_START(alcSuspendContext);
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    if (!io_failure) visit_alcSuspendContext(&callerinfo, ctx);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    if (VISITING) CALL_EVENT(alcSuspendContext, callerinfo, ctx);
     IO_END();
 }
 
-static void decode_alcDestroyContext(void)
+static void decode_alcDestroyContext(TraceReader *r)
 {
     IO_START(alcDestroyContext);
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    if (!io_failure) visit_alcDestroyContext(&callerinfo, ctx);
-    add_contextlabel_to_map(ctx, NULL);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    if (VISITING) CALL_EVENT(alcDestroyContext, callerinfo, ctx);
+    forget_labels(r, ALEE_alcDestroyContext, ctx, NULL, 0);
     IO_END();
 }
 
-static void decode_alcGetError(void)
+static void decode_alcGetError(TraceReader *r)
 {
     IO_START(alcGetError);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCenum retval = IO_ALCENUM();
-    if (!io_failure) visit_alcGetError(&callerinfo, retval, device);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCenum retval = IO_ALCENUM(r);
+    if (VISITING) CALL_EVENT(alcGetError, callerinfo, retval, device);
     IO_END();
 }
 
-static void decode_alcGetIntegerv(void)
+static void decode_alcGetIntegerv(TraceReader *r)
 {
     IO_START(alcGetIntegerv);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCenum param = IO_ALCENUM();
-    const ALCsizei size = IO_ALCSIZEI();
-    ALCint *origvalues = (ALint *) IO_PTR();
-    ALCint *values = (ALCint *) (origvalues ? get_ioblob(size * sizeof (ALCint)) : NULL);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCenum param = IO_ALCENUM(r);
+    const ALCsizei size = IO_ALCSIZEI(r);
+    ALCint *origvalues = (ALint *) IO_PTR(r);
+    ALCint *values = (ALCint *) (origvalues ? arena_alloc(&r->arena, size * sizeof (ALCint)) : NULL);
     ALCsizei i;
     ALCboolean isbool = ALC_FALSE;
 
     if (origvalues) {
         for (i = 0; i < size; i++) {
-            values[i] = IO_INT32();
+            values[i] = IO_INT32(r);
         }
     }
 
@@ -691,135 +1242,134 @@ static void decode_alcGetIntegerv(void)
         default: break;
     }
 
-    if (!io_failure) visit_alcGetIntegerv(&callerinfo, device, param, size, origvalues, isbool, values);
+    if (VISITING) CALL_EVENT(alcGetIntegerv, callerinfo, device, param, size, origvalues, isbool, values);
 
     IO_END();
 }
 
-static void decode_alcCaptureStart(void)
+static void decode_alcCaptureStart(TraceReader *r)
 {
     IO_START(alcCaptureStart);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    if (!io_failure) visit_alcCaptureStart(&callerinfo, device);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    if (VISITING) CALL_EVENT(alcCaptureStart, callerinfo, device);
     IO_END();
 }
 
-static void decode_alcCaptureStop(void)
+static void decode_alcCaptureStop(TraceReader *r)
 {
     IO_START(alcCaptureStop);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    if (!io_failure) visit_alcCaptureStop(&callerinfo, device);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    if (VISITING) CALL_EVENT(alcCaptureStop, callerinfo, device);
     IO_END();
 }
 
-static void decode_alcCaptureSamples(void)
+static void decode_alcCaptureSamples(TraceReader *r)
 {
     IO_START(alcCaptureSamples);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    void *origbuffer = IO_PTR();
-    const ALCsizei samples = IO_ALCSIZEI();
-    uint64 bloblen;
-    uint8 *blob = IO_BLOB(&bloblen);
-    if (!io_failure) visit_alcCaptureSamples(&callerinfo, device, origbuffer, blob, bloblen, samples);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    void *origbuffer = IO_PTR(r);
+    const ALCsizei samples = IO_ALCSIZEI(r);
+    const TraceBlob *blob = IO_BLOBREF(r);
+    if (VISITING) CALL_EVENT(alcCaptureSamples, callerinfo, device, origbuffer, blob, blob ? (ALCsizei) blob->len : 0, samples);
     IO_END();
 }
 
-static void decode_alDopplerFactor(void)
+static void decode_alDopplerFactor(TraceReader *r)
 {
     IO_START(alDopplerFactor);
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alDopplerFactor(&callerinfo, value);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alDopplerFactor, callerinfo, value);
     IO_END();
 }
 
-static void decode_alDopplerVelocity(void)
+static void decode_alDopplerVelocity(TraceReader *r)
 {
     IO_START(alDopplerVelocity);
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alDopplerVelocity(&callerinfo, value);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alDopplerVelocity, callerinfo, value);
     IO_END();
 }
 
-static void decode_alSpeedOfSound(void)
+static void decode_alSpeedOfSound(TraceReader *r)
 {
     IO_START(alSpeedOfSound);
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alSpeedOfSound(&callerinfo, value);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alSpeedOfSound, callerinfo, value);
     IO_END();
 }
 
-static void decode_alDistanceModel(void)
+static void decode_alDistanceModel(TraceReader *r)
 {
     IO_START(alDistanceModel);
-    const ALenum model = IO_ENUM();
-    if (!io_failure) visit_alDistanceModel(&callerinfo, model);
+    const ALenum model = IO_ENUM(r);
+    if (VISITING) CALL_EVENT(alDistanceModel, callerinfo, model);
     IO_END();
 }
 
-static void decode_alEnable(void)
+static void decode_alEnable(TraceReader *r)
 {
     IO_START(alEnable);
-    const ALenum capability = IO_ENUM();
-    if (!io_failure) visit_alEnable(&callerinfo, capability);
+    const ALenum capability = IO_ENUM(r);
+    if (VISITING) CALL_EVENT(alEnable, callerinfo, capability);
     IO_END();
 }
 
-static void decode_alDisable(void)
+static void decode_alDisable(TraceReader *r)
 {
     IO_START(alDisable);
-    const ALenum capability = IO_ENUM();
-    if (!io_failure) visit_alDisable(&callerinfo, capability);
+    const ALenum capability = IO_ENUM(r);
+    if (VISITING) CALL_EVENT(alDisable, callerinfo, capability);
     IO_END();
 }
 
-static void decode_alIsEnabled(void)
+static void decode_alIsEnabled(TraceReader *r)
 {
     IO_START(alIsEnabled);
-    const ALenum capability = IO_ENUM();
-    const ALboolean retval = IO_BOOLEAN();
-    if (!io_failure) visit_alIsEnabled(&callerinfo, retval, capability);
+    const ALenum capability = IO_ENUM(r);
+    const ALboolean retval = IO_BOOLEAN(r);
+    if (VISITING) CALL_EVENT(alIsEnabled, callerinfo, retval, capability);
     IO_END();
 }
 
-static void decode_alGetString(void)
+static void decode_alGetString(TraceReader *r)
 {
     IO_START(alGetString);
-    const ALenum param = IO_ENUM();
-    const ALchar *retval = (const ALchar *) IO_STRING();
-    if (!io_failure) visit_alGetString(&callerinfo, retval, param);
+    const ALenum param = IO_ENUM(r);
+    const ALchar *retval = (const ALchar *) IO_STRING(r);
+    if (VISITING) CALL_EVENT(alGetString, callerinfo, retval, param);
     IO_END();
 }
 
-static void decode_alGetBooleanv(void)
+static void decode_alGetBooleanv(TraceReader *r)
 {
     IO_START(alGetBooleanv);
-    const ALenum param = IO_ENUM();
-    ALboolean *origvalues = (ALboolean *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALboolean *values = (ALboolean *) (numvals ? get_ioblob(numvals * sizeof (ALboolean)) : NULL);
+    const ALenum param = IO_ENUM(r);
+    ALboolean *origvalues = (ALboolean *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALboolean *values = (ALboolean *) (numvals ? arena_alloc(&r->arena, numvals * sizeof (ALboolean)) : NULL);
     ALsizei i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_BOOLEAN();
+        values[i] = IO_BOOLEAN(r);
     }
 
-    if (!io_failure) visit_alGetBooleanv(&callerinfo, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetBooleanv, callerinfo, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alGetIntegerv(void)
+static void decode_alGetIntegerv(TraceReader *r)
 {
     IO_START(alGetIntegerv);
-    const ALenum param = IO_ENUM();
-    ALint *origvalues = (ALint *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALint *values = (ALint *) (numvals ? get_ioblob(numvals * sizeof (ALint)) : NULL);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalues = (ALint *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALint *values = (ALint *) (numvals ? arena_alloc(&r->arena, numvals * sizeof (ALint)) : NULL);
     ALsizei i;
     ALboolean isenum = AL_FALSE;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_INT32();
+        values[i] = IO_INT32(r);
     }
 
     switch (param) {
@@ -827,467 +1377,464 @@ static void decode_alGetIntegerv(void)
         default: break;
     }
 
-    if (!io_failure) visit_alGetIntegerv(&callerinfo, param, origvalues, numvals, isenum, values);
+    if (VISITING) CALL_EVENT(alGetIntegerv, callerinfo, param, origvalues, numvals, isenum, values);
 
     IO_END();
 }
 
-static void decode_alGetFloatv(void)
+static void decode_alGetFloatv(TraceReader *r)
 {
     IO_START(alGetFloatv);
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalues = (ALfloat *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALfloat *values = (ALfloat *) (numvals ? get_ioblob(numvals * sizeof (ALfloat)) : NULL);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalues = (ALfloat *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALfloat *values = (ALfloat *) (numvals ? arena_alloc(&r->arena, numvals * sizeof (ALfloat)) : NULL);
     ALsizei i;
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_FLOAT();
+        values[i] = IO_FLOAT(r);
     }
 
-    if (!io_failure) visit_alGetFloatv(&callerinfo, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetFloatv, callerinfo, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alGetDoublev(void)
+static void decode_alGetDoublev(TraceReader *r)
 {
     IO_START(alGetDoublev);
-    const ALenum param = IO_ENUM();
-    ALdouble *origvalues = (ALdouble *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALdouble *values = (ALdouble *) (numvals ? get_ioblob(numvals * sizeof (ALdouble)) : NULL);
+    const ALenum param = IO_ENUM(r);
+    ALdouble *origvalues = (ALdouble *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALdouble *values = (ALdouble *) (numvals ? arena_alloc(&r->arena, numvals * sizeof (ALdouble)) : NULL);
     ALsizei i;
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_DOUBLE();
+        values[i] = IO_DOUBLE(r);
     }
 
-    if (!io_failure) visit_alGetDoublev(&callerinfo, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetDoublev, callerinfo, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alGetBoolean(void)
+static void decode_alGetBoolean(TraceReader *r)
 {
     IO_START(alGetBoolean);
-    const ALenum param = IO_ENUM();
-    const ALboolean retval = IO_BOOLEAN();
-    if (!io_failure) visit_alGetBoolean(&callerinfo, retval, param);
+    const ALenum param = IO_ENUM(r);
+    const ALboolean retval = IO_BOOLEAN(r);
+    if (VISITING) CALL_EVENT(alGetBoolean, callerinfo, retval, param);
     IO_END();
 }
 
-static void decode_alGetInteger(void)
+static void decode_alGetInteger(TraceReader *r)
 {
     IO_START(alGetInteger);
-    const ALenum param = IO_ENUM();
-    const ALint retval = IO_INT32();
+    const ALenum param = IO_ENUM(r);
+    const ALint retval = IO_INT32(r);
 #warning fixme isenum?
-    if (!io_failure) visit_alGetInteger(&callerinfo, retval, param);
+    if (VISITING) CALL_EVENT(alGetInteger, callerinfo, retval, param);
     IO_END();
 }
 
-static void decode_alGetFloat(void)
+static void decode_alGetFloat(TraceReader *r)
 {
     IO_START(alGetFloat);
-    const ALenum param = IO_ENUM();
-    const ALfloat retval = IO_FLOAT();
-    if (!io_failure) visit_alGetFloat(&callerinfo, retval, param);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat retval = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alGetFloat, callerinfo, retval, param);
     IO_END();
 }
 
-static void decode_alGetDouble(void)
+static void decode_alGetDouble(TraceReader *r)
 {
     IO_START(alGetDouble);
-    const ALenum param = IO_ENUM();
-    const ALdouble retval = IO_DOUBLE();
-    if (!io_failure) visit_alGetDouble(&callerinfo, retval, param);
+    const ALenum param = IO_ENUM(r);
+    const ALdouble retval = IO_DOUBLE(r);
+    if (VISITING) CALL_EVENT(alGetDouble, callerinfo, retval, param);
     IO_END();
 }
 
-static void decode_alIsExtensionPresent(void)
+static void decode_alIsExtensionPresent(TraceReader *r)
 {
     IO_START(alIsExtensionPresent);
-    const ALchar *extname = (const ALchar *) IO_STRING();
-    const ALboolean retval = IO_BOOLEAN();
-    if (!io_failure) visit_alIsExtensionPresent(&callerinfo, retval, extname);
+    const ALchar *extname = (const ALchar *) IO_STRING(r);
+    const ALboolean retval = IO_BOOLEAN(r);
+    if (VISITING) CALL_EVENT(alIsExtensionPresent, callerinfo, retval, extname);
     IO_END();
 }
 
-static void decode_alGetError(void)
+static void decode_alGetError(TraceReader *r)
 {
     IO_START(alGetError);
-    const ALenum retval = IO_ENUM();
-    if (!io_failure) visit_alGetError(&callerinfo, retval);
+    const ALenum retval = IO_ENUM(r);
+    if (VISITING) CALL_EVENT(alGetError, callerinfo, retval);
     IO_END();
 }
 
-static void decode_alGetProcAddress(void)
+static void decode_alGetProcAddress(TraceReader *r)
 {
     IO_START(alGetProcAddress);
-    const ALchar *funcname = (const ALchar *) IO_STRING();
-    void *retval = IO_PTR();
-    if (!io_failure) visit_alGetProcAddress(&callerinfo, retval, funcname);
+    const ALchar *funcname = (const ALchar *) IO_STRING(r);
+    void *retval = IO_PTR(r);
+    if (VISITING) CALL_EVENT(alGetProcAddress, callerinfo, retval, funcname);
     IO_END();
 }
 
-static void decode_alGetEnumValue(void)
+static void decode_alGetEnumValue(TraceReader *r)
 {
     IO_START(alGetProcAddress);
-    const ALchar *enumname = (const ALchar *) IO_STRING();
-    const ALenum retval = IO_ENUM();
-    if (!io_failure) visit_alGetEnumValue(&callerinfo, retval, enumname);
+    const ALchar *enumname = (const ALchar *) IO_STRING(r);
+    const ALenum retval = IO_ENUM(r);
+    if (VISITING) CALL_EVENT(alGetEnumValue, callerinfo, retval, enumname);
     IO_END();
 }
 
-static void decode_alListenerfv(void)
+static void decode_alListenerfv(TraceReader *r)
 {
     IO_START(alListenerfv);
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalues = (ALfloat *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALfloat *values = (ALfloat *) (numvals ? get_ioblob(sizeof (ALfloat) * numvals) : NULL);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalues = (ALfloat *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALfloat *values = (ALfloat *) (numvals ? arena_alloc(&r->arena, sizeof (ALfloat) * numvals) : NULL);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_FLOAT();
+        values[i] = IO_FLOAT(r);
     }
 
-    if (!io_failure) visit_alListenerfv(&callerinfo, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alListenerfv, callerinfo, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alListenerf(void)
+static void decode_alListenerf(TraceReader *r)
 {
     IO_START(alListenerf);
-    const ALenum param = IO_ENUM();
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alListenerf(&callerinfo, param, value);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alListenerf, callerinfo, param, value);
     IO_END();
 }
 
-static void decode_alListener3f(void)
+static void decode_alListener3f(TraceReader *r)
 {
     IO_START(alListener3f);
-    const ALenum param = IO_ENUM();
-    const ALfloat value1 = IO_FLOAT();
-    const ALfloat value2 = IO_FLOAT();
-    const ALfloat value3 = IO_FLOAT();
-    if (!io_failure) visit_alListener3f(&callerinfo, param, value1, value2, value3);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat value1 = IO_FLOAT(r);
+    const ALfloat value2 = IO_FLOAT(r);
+    const ALfloat value3 = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alListener3f, callerinfo, param, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alListeneriv(void)
+static void decode_alListeneriv(TraceReader *r)
 {
     IO_START(alListeneriv);
-    const ALenum param = IO_ENUM();
-    ALint *origvalues = (ALint *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALint *values = (ALint *) (numvals ? get_ioblob(sizeof (ALint) * numvals) : NULL);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalues = (ALint *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALint *values = (ALint *) (numvals ? arena_alloc(&r->arena, sizeof (ALint) * numvals) : NULL);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_INT32();
+        values[i] = IO_INT32(r);
     }
 
-    if (!io_failure) visit_alListeneriv(&callerinfo, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alListeneriv, callerinfo, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alListeneri(void)
+static void decode_alListeneri(TraceReader *r)
 {
     IO_START(alListeneri);
-    const ALenum param = IO_ENUM();
-    const ALint value = IO_INT32();
-    if (!io_failure) visit_alListeneri(&callerinfo, param, value);
+    const ALenum param = IO_ENUM(r);
+    const ALint value = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alListeneri, callerinfo, param, value);
     IO_END();
 }
 
-static void decode_alListener3i(void)
+static void decode_alListener3i(TraceReader *r)
 {
     IO_START(alListener3i);
-    const ALenum param = IO_ENUM();
-    const ALint value1 = IO_INT32();
-    const ALint value2 = IO_INT32();
-    const ALint value3 = IO_INT32();
-    if (!io_failure) visit_alListener3i(&callerinfo, param, value1, value2, value3);
+    const ALenum param = IO_ENUM(r);
+    const ALint value1 = IO_INT32(r);
+    const ALint value2 = IO_INT32(r);
+    const ALint value3 = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alListener3i, callerinfo, param, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alGetListenerfv(void)
+static void decode_alGetListenerfv(TraceReader *r)
 {
     IO_START(alGetListenerfv);
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalues = (ALfloat *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALfloat *values = (ALfloat *) (numvals ? get_ioblob(sizeof (ALfloat) * numvals) : NULL);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalues = (ALfloat *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALfloat *values = (ALfloat *) (numvals ? arena_alloc(&r->arena, sizeof (ALfloat) * numvals) : NULL);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_FLOAT();
+        values[i] = IO_FLOAT(r);
     }
 
-    if (!io_failure) visit_alGetListenerfv(&callerinfo, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetListenerfv, callerinfo, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alGetListenerf(void)
+static void decode_alGetListenerf(TraceReader *r)
 {
     IO_START(alGetListenerf);
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalue = (ALfloat *) IO_PTR();
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alGetListenerf(&callerinfo, param, origvalue, value);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalue = (ALfloat *) IO_PTR(r);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alGetListenerf, callerinfo, param, origvalue, value);
     IO_END();
 }
 
-static void decode_alGetListener3f(void)
+static void decode_alGetListener3f(TraceReader *r)
 {
     IO_START(alGetListener3f);
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalue1 = (ALfloat *) IO_PTR();
-    ALfloat *origvalue2 = (ALfloat *) IO_PTR();
-    ALfloat *origvalue3 = (ALfloat *) IO_PTR();
-    const ALfloat value1 = IO_FLOAT();
-    const ALfloat value2 = IO_FLOAT();
-    const ALfloat value3 = IO_FLOAT();
-    if (!io_failure) visit_alGetListener3f(&callerinfo, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalue1 = (ALfloat *) IO_PTR(r);
+    ALfloat *origvalue2 = (ALfloat *) IO_PTR(r);
+    ALfloat *origvalue3 = (ALfloat *) IO_PTR(r);
+    const ALfloat value1 = IO_FLOAT(r);
+    const ALfloat value2 = IO_FLOAT(r);
+    const ALfloat value3 = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alGetListener3f, callerinfo, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alGetListeneriv(void)
+static void decode_alGetListeneriv(TraceReader *r)
 {
     IO_START(alGetListeneriv);
-    const ALenum param = IO_ENUM();
-    ALint *origvalues = (ALint *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALint *values = (ALint *) (numvals ? get_ioblob(sizeof (ALint) * numvals) : NULL);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalues = (ALint *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALint *values = (ALint *) (numvals ? arena_alloc(&r->arena, sizeof (ALint) * numvals) : NULL);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_INT32();
+        values[i] = IO_INT32(r);
     }
 
-    if (!io_failure) visit_alGetListeneriv(&callerinfo, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetListeneriv, callerinfo, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alGetListeneri(void)
+static void decode_alGetListeneri(TraceReader *r)
 {
     IO_START(alGetListeneri);
-    const ALenum param = IO_ENUM();
-    ALint *origvalue = (ALint *) IO_PTR();
-    const ALint value = IO_INT32();
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalue = (ALint *) IO_PTR(r);
+    const ALint value = IO_INT32(r);
 
-    if (!io_failure) visit_alGetListeneri(&callerinfo, param, origvalue, value);
+    if (VISITING) CALL_EVENT(alGetListeneri, callerinfo, param, origvalue, value);
 
     IO_END();
 }
 
-static void decode_alGetListener3i(void)
+static void decode_alGetListener3i(TraceReader *r)
 {
     IO_START(alGetListener3i);
-    const ALenum param = IO_ENUM();
-    ALint *origvalue1 = (ALint *) IO_PTR();
-    ALint *origvalue2 = (ALint *) IO_PTR();
-    ALint *origvalue3 = (ALint *) IO_PTR();
-    const ALint value1 = IO_INT32();
-    const ALint value2 = IO_INT32();
-    const ALint value3 = IO_INT32();
-    if (!io_failure) visit_alGetListener3i(&callerinfo, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalue1 = (ALint *) IO_PTR(r);
+    ALint *origvalue2 = (ALint *) IO_PTR(r);
+    ALint *origvalue3 = (ALint *) IO_PTR(r);
+    const ALint value1 = IO_INT32(r);
+    const ALint value2 = IO_INT32(r);
+    const ALint value3 = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alGetListener3i, callerinfo, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alGenSources(void)
+static void decode_alGenSources(TraceReader *r)
 {
     IO_START(alGenSources);
-    const ALsizei n = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    const ALsizei n = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * n);
     ALsizei i;
 
     for (i = 0; i < n; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alGenSources(&callerinfo, n, orignames, names);
+    if (VISITING) CALL_EVENT(alGenSources, callerinfo, n, orignames, names);
 
     IO_END();
 }
 
-static void decode_alDeleteSources(void)
+static void decode_alDeleteSources(TraceReader *r)
 {
     IO_START(alDeleteSources);
-    const ALsizei n = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    const ALsizei n = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * n);
     ALsizei i;
 
     for (i = 0; i < n; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alDeleteSources(&callerinfo, n, orignames, names);
-
-    for (i = 0; i < n; i++) {
-        add_sourcelabel_to_map(names[i], NULL);
-    }
+    if (VISITING) CALL_EVENT(alDeleteSources, callerinfo, n, orignames, names);
+    forget_labels(r, ALEE_alDeleteSources, NULL, names, n);
 
     IO_END();
 }
 
-static void decode_alIsSource(void)
+static void decode_alIsSource(TraceReader *r)
 {
     IO_START(alIsSource);
-    const ALuint name = IO_UINT32();
-    const ALboolean retval = IO_BOOLEAN();
-    if (!io_failure) visit_alIsSource(&callerinfo, retval, name);
+    const ALuint name = IO_UINT32(r);
+    const ALboolean retval = IO_BOOLEAN(r);
+    if (VISITING) CALL_EVENT(alIsSource, callerinfo, retval, name);
     IO_END();
 }
 
-static void decode_alSourcefv(void)
+static void decode_alSourcefv(TraceReader *r)
 {
     IO_START(alSourcefv);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALfloat *origvalues = (ALfloat *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALfloat *values = (ALfloat *) get_ioblob(sizeof (ALfloat) * numvals);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat *origvalues = (ALfloat *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALfloat *values = (ALfloat *) arena_alloc(&r->arena, sizeof (ALfloat) * numvals);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_FLOAT();
+        values[i] = IO_FLOAT(r);
     }
 
-    if (!io_failure) visit_alSourcefv(&callerinfo, name, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alSourcefv, callerinfo, name, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alSourcef(void)
+static void decode_alSourcef(TraceReader *r)
 {
     IO_START(alSourcef);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alSourcef(&callerinfo, name, param, value);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alSourcef, callerinfo, name, param, value);
     IO_END();
 }
 
-static void decode_alSource3f(void)
+static void decode_alSource3f(TraceReader *r)
 {
     IO_START(alSource3f);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALfloat value1 = IO_FLOAT();
-    const ALfloat value2 = IO_FLOAT();
-    const ALfloat value3 = IO_FLOAT();
-    if (!io_failure) visit_alSource3f(&callerinfo, name, param, value1, value2, value3);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat value1 = IO_FLOAT(r);
+    const ALfloat value2 = IO_FLOAT(r);
+    const ALfloat value3 = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alSource3f, callerinfo, name, param, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alSourceiv(void)
+static void decode_alSourceiv(TraceReader *r)
 {
     IO_START(alSourceiv);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALint *origvalues = (ALint *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALint *values = (ALint *) get_ioblob(sizeof (ALint) * numvals);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALint *origvalues = (ALint *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALint *values = (ALint *) arena_alloc(&r->arena, sizeof (ALint) * numvals);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_INT32();
+        values[i] = IO_INT32(r);
     }
 
-    if (!io_failure) visit_alSourceiv(&callerinfo, name, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alSourceiv, callerinfo, name, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alSourcei(void)
+static void decode_alSourcei(TraceReader *r)
 {
 #pragma warning AL_LOOPING is bool, others might be enum
     IO_START(alSourcei);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALint value = IO_INT32();
-    if (!io_failure) visit_alSourcei(&callerinfo, name, param, value);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALint value = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alSourcei, callerinfo, name, param, value);
     IO_END();
 }
 
-static void decode_alSource3i(void)
+static void decode_alSource3i(TraceReader *r)
 {
     IO_START(alSource3i);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALint value1 = IO_INT32();
-    const ALint value2 = IO_INT32();
-    const ALint value3 = IO_INT32();
-    if (!io_failure) visit_alSource3i(&callerinfo, name, param, value1, value2, value3);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALint value1 = IO_INT32(r);
+    const ALint value2 = IO_INT32(r);
+    const ALint value3 = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alSource3i, callerinfo, name, param, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alGetSourcefv(void)
+static void decode_alGetSourcefv(TraceReader *r)
 {
     IO_START(alGetSourcefv);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalues = (ALfloat *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALfloat *values = (ALfloat *) (numvals ? get_ioblob(sizeof (ALfloat) * numvals) : NULL);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalues = (ALfloat *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALfloat *values = (ALfloat *) (numvals ? arena_alloc(&r->arena, sizeof (ALfloat) * numvals) : NULL);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_FLOAT();
+        values[i] = IO_FLOAT(r);
     }
 
-    if (!io_failure) visit_alGetSourcefv(&callerinfo, name, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetSourcefv, callerinfo, name, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alGetSourcef(void)
+static void decode_alGetSourcef(TraceReader *r)
 {
     IO_START(alGetSourcef);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalue = (ALfloat *) IO_PTR();
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alGetSourcef(&callerinfo, name, param, origvalue, value);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalue = (ALfloat *) IO_PTR(r);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alGetSourcef, callerinfo, name, param, origvalue, value);
     IO_END();
 }
 
-static void decode_alGetSource3f(void)
+static void decode_alGetSource3f(TraceReader *r)
 {
     IO_START(alGetSource3f);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalue1 = (ALfloat *) IO_PTR();
-    ALfloat *origvalue2 = (ALfloat *) IO_PTR();
-    ALfloat *origvalue3 = (ALfloat *) IO_PTR();
-    const ALfloat value1 = IO_FLOAT();
-    const ALfloat value2 = IO_FLOAT();
-    const ALfloat value3 = IO_FLOAT();
-    if (!io_failure) visit_alGetSource3f(&callerinfo, name, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalue1 = (ALfloat *) IO_PTR(r);
+    ALfloat *origvalue2 = (ALfloat *) IO_PTR(r);
+    ALfloat *origvalue3 = (ALfloat *) IO_PTR(r);
+    const ALfloat value1 = IO_FLOAT(r);
+    const ALfloat value2 = IO_FLOAT(r);
+    const ALfloat value3 = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alGetSource3f, callerinfo, name, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alGetSourceiv(void)
+static void decode_alGetSourceiv(TraceReader *r)
 {
     IO_START(alGetSourceiv);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALint *origvalues = (ALint *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALint *values = (ALint *) (numvals ? get_ioblob(sizeof (ALfloat) * numvals) : NULL);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalues = (ALint *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALint *values = (ALint *) (numvals ? arena_alloc(&r->arena, sizeof (ALfloat) * numvals) : NULL);
     ALboolean isenum = AL_FALSE;
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_INT32();
+        values[i] = IO_INT32(r);
     }
 
     switch (param) {
@@ -1295,18 +1842,18 @@ static void decode_alGetSourceiv(void)
         default: break;
     }
 
-    if (!io_failure) visit_alGetSourceiv(&callerinfo, name, param, isenum, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetSourceiv, callerinfo, name, param, isenum, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alGetSourcei(void)
+static void decode_alGetSourcei(TraceReader *r)
 {
     IO_START(alGetSourcei);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALint *origvalue = (ALint *) IO_PTR();
-    const ALint value = IO_INT32();
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalue = (ALint *) IO_PTR(r);
+    const ALint value = IO_INT32(r);
     ALboolean isenum = AL_FALSE;
 
     switch (param) {
@@ -1314,755 +1861,2069 @@ static void decode_alGetSourcei(void)
         default: break;
     }
 
-    if (!io_failure) visit_alGetSourcei(&callerinfo, name, param, isenum, origvalue, value);
+    if (VISITING) CALL_EVENT(alGetSourcei, callerinfo, name, param, isenum, origvalue, value);
 
     IO_END();
 }
 
-static void decode_alGetSource3i(void)
+static void decode_alGetSource3i(TraceReader *r)
 {
     IO_START(alGetSource3i);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALint *origvalue1 = (ALint *) IO_PTR();
-    ALint *origvalue2 = (ALint *) IO_PTR();
-    ALint *origvalue3 = (ALint *) IO_PTR();
-    const ALint value1 = IO_INT32();
-    const ALint value2 = IO_INT32();
-    const ALint value3 = IO_INT32();
-    if (!io_failure) visit_alGetSource3i(&callerinfo, name, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalue1 = (ALint *) IO_PTR(r);
+    ALint *origvalue2 = (ALint *) IO_PTR(r);
+    ALint *origvalue3 = (ALint *) IO_PTR(r);
+    const ALint value1 = IO_INT32(r);
+    const ALint value2 = IO_INT32(r);
+    const ALint value3 = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alGetSource3i, callerinfo, name, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alSourcePlay(void)
+static void decode_alSourcePlay(TraceReader *r)
 {
     IO_START(alSourcePlay);
-    const ALuint name = IO_UINT32();
-    if (!io_failure) visit_alSourcePlay(&callerinfo, name);
+    const ALuint name = IO_UINT32(r);
+    if (VISITING) CALL_EVENT(alSourcePlay, callerinfo, name);
     IO_END();
 }
 
-static void decode_alSourcePlayv(void)
+static void decode_alSourcePlayv(TraceReader *r)
 {
     IO_START(alSourcePlayv);
-    const ALsizei n = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    const ALsizei n = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * n);
     ALsizei i;
 
     for (i = 0; i < n; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alSourcePlayv(&callerinfo, n, orignames, names);
+    if (VISITING) CALL_EVENT(alSourcePlayv, callerinfo, n, orignames, names);
 
     IO_END();
 }
 
-static void decode_alSourcePause(void)
+static void decode_alSourcePause(TraceReader *r)
 {
     IO_START(alSourcePause);
-    const ALuint name = IO_UINT32();
-    if (!io_failure) visit_alSourcePause(&callerinfo, name);
+    const ALuint name = IO_UINT32(r);
+    if (VISITING) CALL_EVENT(alSourcePause, callerinfo, name);
     IO_END();
 }
 
-static void decode_alSourcePausev(void)
+static void decode_alSourcePausev(TraceReader *r)
 {
     IO_START(alSourcePausev);
-    const ALsizei n = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    const ALsizei n = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * n);
     ALsizei i;
 
     for (i = 0; i < n; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alSourcePausev(&callerinfo, n, orignames, names);
+    if (VISITING) CALL_EVENT(alSourcePausev, callerinfo, n, orignames, names);
 
     IO_END();
 }
 
-static void decode_alSourceRewind(void)
+static void decode_alSourceRewind(TraceReader *r)
 {
     IO_START(alSourceRewind);
-    const ALuint name = IO_UINT32();
-    if (!io_failure) visit_alSourceRewind(&callerinfo, name);
+    const ALuint name = IO_UINT32(r);
+    if (VISITING) CALL_EVENT(alSourceRewind, callerinfo, name);
     IO_END();
 }
 
-static void decode_alSourceRewindv(void)
+static void decode_alSourceRewindv(TraceReader *r)
 {
     IO_START(alSourceRewindv);
-    const ALsizei n = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    const ALsizei n = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * n);
     ALsizei i;
 
     for (i = 0; i < n; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alSourceRewindv(&callerinfo, n, orignames, names);
+    if (VISITING) CALL_EVENT(alSourceRewindv, callerinfo, n, orignames, names);
 
     IO_END();
 }
 
-static void decode_alSourceStop(void)
+static void decode_alSourceStop(TraceReader *r)
 {
     IO_START(alSourceStop);
-    const ALuint name = IO_UINT32();
-    if (!io_failure) visit_alSourceStop(&callerinfo, name);
+    const ALuint name = IO_UINT32(r);
+    if (VISITING) CALL_EVENT(alSourceStop, callerinfo, name);
     IO_END();
 }
 
-static void decode_alSourceStopv(void)
+static void decode_alSourceStopv(TraceReader *r)
 {
     IO_START(alSourceStopv);
-    const ALsizei n = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    const ALsizei n = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * n);
     ALsizei i;
 
     for (i = 0; i < n; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alSourceStopv(&callerinfo, n, orignames, names);
+    if (VISITING) CALL_EVENT(alSourceStopv, callerinfo, n, orignames, names);
 
     IO_END();
 }
 
-static void decode_alSourceQueueBuffers(void)
+static void decode_alSourceQueueBuffers(TraceReader *r)
 {
     IO_START(alSourceQueueBuffers);
-    const ALuint name = IO_UINT32();
-    const ALsizei nb = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * nb);
+    const ALuint name = IO_UINT32(r);
+    const ALsizei nb = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * nb);
     ALsizei i;
 
     for (i = 0; i < nb; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alSourceQueueBuffers(&callerinfo, name, nb, orignames, names);
+    if (VISITING) CALL_EVENT(alSourceQueueBuffers, callerinfo, name, nb, orignames, names);
 
     IO_END();
 }
 
-static void decode_alSourceUnqueueBuffers(void)
+static void decode_alSourceUnqueueBuffers(TraceReader *r)
 {
     IO_START(alSourceUnqueueBuffers);
-    const ALuint name = IO_UINT32();
-    const ALsizei nb = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * nb);
+    const ALuint name = IO_UINT32(r);
+    const ALsizei nb = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * nb);
     ALsizei i;
 
     for (i = 0; i < nb; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alSourceUnqueueBuffers(&callerinfo, name, nb, orignames, names);
+    if (VISITING) CALL_EVENT(alSourceUnqueueBuffers, callerinfo, name, nb, orignames, names);
 
     IO_END();
 }
 
-static void decode_alGenBuffers(void)
+static void decode_alGenBuffers(TraceReader *r)
 {
     IO_START(alGenBuffers);
-    const ALsizei n = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    const ALsizei n = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * n);
     ALsizei i;
 
     for (i = 0; i < n; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alGenBuffers(&callerinfo, n, orignames, names);
+    if (VISITING) CALL_EVENT(alGenBuffers, callerinfo, n, orignames, names);
 
     IO_END();
 }
 
-static void decode_alDeleteBuffers(void)
+static void decode_alDeleteBuffers(TraceReader *r)
 {
     IO_START(alDeleteBuffers);
-    const ALsizei n = IO_ALSIZEI();
-    ALuint *orignames = (ALuint *) IO_PTR();
-    ALuint *names = (ALuint *) get_ioblob(sizeof (ALuint) * n);
+    const ALsizei n = IO_ALSIZEI(r);
+    ALuint *orignames = (ALuint *) IO_PTR(r);
+    ALuint *names = (ALuint *) arena_alloc(&r->arena, sizeof (ALuint) * n);
     ALsizei i;
 
     for (i = 0; i < n; i++) {
-        names[i] = IO_UINT32();
+        names[i] = IO_UINT32(r);
     }
 
-    if (!io_failure) visit_alDeleteBuffers(&callerinfo, n, orignames, names);
-
-    for (i = 0; i < n; i++) {
-        add_bufferlabel_to_map(names[i], NULL);
-    }
+    if (VISITING) CALL_EVENT(alDeleteBuffers, callerinfo, n, orignames, names);
+    forget_labels(r, ALEE_alDeleteBuffers, NULL, names, n);
 
     IO_END();
 }
 
-static void decode_alIsBuffer(void)
+static void decode_alIsBuffer(TraceReader *r)
 {
     IO_START(alIsBuffer);
-    const ALuint name = IO_UINT32();
-    const ALboolean retval = IO_BOOLEAN();
-    if (!io_failure) visit_alIsBuffer(&callerinfo, retval, name);
+    const ALuint name = IO_UINT32(r);
+    const ALboolean retval = IO_BOOLEAN(r);
+    if (VISITING) CALL_EVENT(alIsBuffer, callerinfo, retval, name);
     IO_END();
 }
 
-static void decode_alBufferData(void)
+static void decode_alBufferData(TraceReader *r)
 {
     IO_START(alBufferData);
-    uint64 size = 0;
-    const ALuint name = IO_UINT32();
-    const ALenum alfmt = IO_ENUM();
-    const ALsizei freq = IO_ALSIZEI();
-    const ALvoid *origdata = (const ALvoid *) IO_PTR();
-    const ALvoid *data = (const ALvoid *) IO_BLOB(&size);
-    if (!io_failure) visit_alBufferData(&callerinfo, name, alfmt, origdata, data, (ALsizei) size, freq);
+    const ALuint name = IO_UINT32(r);
+    const ALenum alfmt = IO_ENUM(r);
+    const ALsizei freq = IO_ALSIZEI(r);
+    const ALvoid *origdata = (const ALvoid *) IO_PTR(r);
+    const TraceBlob *data = IO_BLOBREF(r);
+    if (VISITING) CALL_EVENT(alBufferData, callerinfo, name, alfmt, origdata, data, data ? (ALsizei) data->len : 0, freq);
     IO_END();
 }
 
-static void decode_alBufferfv(void)
+static void decode_alBufferfv(TraceReader *r)
 {
     IO_START(alBufferfv);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALfloat *origvalues = (ALfloat *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALfloat *values = (ALfloat *) get_ioblob(sizeof (ALfloat) * numvals);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat *origvalues = (ALfloat *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALfloat *values = (ALfloat *) arena_alloc(&r->arena, sizeof (ALfloat) * numvals);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_INT32();
+        values[i] = IO_INT32(r);
     }
 
-    if (!io_failure) visit_alBufferfv(&callerinfo, name, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alBufferfv, callerinfo, name, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alBufferf(void)
+static void decode_alBufferf(TraceReader *r)
 {
     IO_START(alBufferf);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alBufferf(&callerinfo, name, param, value);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alBufferf, callerinfo, name, param, value);
     IO_END();
 }
 
-static void decode_alBuffer3f(void)
+static void decode_alBuffer3f(TraceReader *r)
 {
     IO_START(alBuffer3f);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALfloat value1 = IO_FLOAT();
-    const ALfloat value2 = IO_FLOAT();
-    const ALfloat value3 = IO_FLOAT();
-    if (!io_failure) visit_alBuffer3f(&callerinfo, name, param, value1, value2, value3);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat value1 = IO_FLOAT(r);
+    const ALfloat value2 = IO_FLOAT(r);
+    const ALfloat value3 = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alBuffer3f, callerinfo, name, param, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alBufferiv(void)
+static void decode_alBufferiv(TraceReader *r)
 {
     IO_START(alBufferiv);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALint *origvalues = (ALint *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALint *values = (ALint *) get_ioblob(sizeof (ALint) * numvals);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALint *origvalues = (ALint *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALint *values = (ALint *) arena_alloc(&r->arena, sizeof (ALint) * numvals);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_INT32();
+        values[i] = IO_INT32(r);
     }
 
-    if (!io_failure) visit_alBufferiv(&callerinfo, name, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alBufferiv, callerinfo, name, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alBufferi(void)
+static void decode_alBufferi(TraceReader *r)
 {
     IO_START(alBufferi);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALint value = IO_INT32();
-    if (!io_failure) visit_alBufferi(&callerinfo, name, param, value);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALint value = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alBufferi, callerinfo, name, param, value);
     IO_END();
 }
 
-static void decode_alBuffer3i(void)
+static void decode_alBuffer3i(TraceReader *r)
 {
     IO_START(alBuffer3i);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALint value1 = IO_INT32();
-    const ALint value2 = IO_INT32();
-    const ALint value3 = IO_INT32();
-    if (!io_failure) visit_alBuffer3i(&callerinfo, name, param, value1, value2, value3);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALint value1 = IO_INT32(r);
+    const ALint value2 = IO_INT32(r);
+    const ALint value3 = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alBuffer3i, callerinfo, name, param, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alGetBufferfv(void)
+static void decode_alGetBufferfv(TraceReader *r)
 {
     IO_START(alGetBufferfv);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalues = (ALfloat *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALfloat *values = (ALfloat *) (numvals ? get_ioblob(sizeof (ALfloat) * numvals) : NULL);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalues = (ALfloat *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALfloat *values = (ALfloat *) (numvals ? arena_alloc(&r->arena, sizeof (ALfloat) * numvals) : NULL);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_FLOAT();
+        values[i] = IO_FLOAT(r);
     }
 
-    if (!io_failure) visit_alGetBufferfv(&callerinfo, name, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetBufferfv, callerinfo, name, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alGetBufferf(void)
+static void decode_alGetBufferf(TraceReader *r)
 {
     IO_START(alGetBufferf);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalue = (ALfloat *) IO_PTR();
-    const ALfloat value = IO_FLOAT();
-    if (!io_failure) visit_alGetBufferf(&callerinfo, name, param, origvalue, value);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalue = (ALfloat *) IO_PTR(r);
+    const ALfloat value = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alGetBufferf, callerinfo, name, param, origvalue, value);
     IO_END();
 }
 
-static void decode_alGetBuffer3f(void)
+static void decode_alGetBuffer3f(TraceReader *r)
 {
     IO_START(alGetBuffer3f);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALfloat *origvalue1 = (ALfloat *) IO_PTR();
-    ALfloat *origvalue2 = (ALfloat *) IO_PTR();
-    ALfloat *origvalue3 = (ALfloat *) IO_PTR();
-    const ALfloat value1 = IO_FLOAT();
-    const ALfloat value2 = IO_FLOAT();
-    const ALfloat value3 = IO_FLOAT();
-    if (!io_failure) visit_alGetBuffer3f(&callerinfo, name, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALfloat *origvalue1 = (ALfloat *) IO_PTR(r);
+    ALfloat *origvalue2 = (ALfloat *) IO_PTR(r);
+    ALfloat *origvalue3 = (ALfloat *) IO_PTR(r);
+    const ALfloat value1 = IO_FLOAT(r);
+    const ALfloat value2 = IO_FLOAT(r);
+    const ALfloat value3 = IO_FLOAT(r);
+    if (VISITING) CALL_EVENT(alGetBuffer3f, callerinfo, name, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alGetBufferi(void)
+static void decode_alGetBufferi(TraceReader *r)
 {
     IO_START(alGetBufferi);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALint *origvalue = (ALint *) IO_PTR();
-    const ALint value = IO_INT32();
-    if (!io_failure) visit_alGetBufferi(&callerinfo, name, param, origvalue, value);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalue = (ALint *) IO_PTR(r);
+    const ALint value = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alGetBufferi, callerinfo, name, param, origvalue, value);
     IO_END();
 }
 
-static void decode_alGetBuffer3i(void)
+static void decode_alGetBuffer3i(TraceReader *r)
 {
     IO_START(alGetBuffer3i);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALint *origvalue1 = (ALint *) IO_PTR();
-    ALint *origvalue2 = (ALint *) IO_PTR();
-    ALint *origvalue3 = (ALint *) IO_PTR();
-    const ALint value1 = IO_INT32();
-    const ALint value2 = IO_INT32();
-    const ALint value3 = IO_INT32();
-    if (!io_failure) visit_alGetBuffer3i(&callerinfo, name, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalue1 = (ALint *) IO_PTR(r);
+    ALint *origvalue2 = (ALint *) IO_PTR(r);
+    ALint *origvalue3 = (ALint *) IO_PTR(r);
+    const ALint value1 = IO_INT32(r);
+    const ALint value2 = IO_INT32(r);
+    const ALint value3 = IO_INT32(r);
+    if (VISITING) CALL_EVENT(alGetBuffer3i, callerinfo, name, param, origvalue1, origvalue2, origvalue3, value1, value2, value3);
     IO_END();
 }
 
-static void decode_alGetBufferiv(void)
+static void decode_alGetBufferiv(TraceReader *r)
 {
     IO_START(alGetBufferiv);
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    ALint *origvalues = (ALint *) IO_PTR();
-    const uint32 numvals = IO_UINT32();
-    ALint *values = (ALint *) (numvals ? get_ioblob(sizeof (ALfloat) * numvals) : NULL);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    ALint *origvalues = (ALint *) IO_PTR(r);
+    const uint32 numvals = IO_UINT32(r);
+    ALint *values = (ALint *) (numvals ? arena_alloc(&r->arena, sizeof (ALfloat) * numvals) : NULL);
     uint32 i;
 
     for (i = 0; i < numvals; i++) {
-        values[i] = IO_INT32();
+        values[i] = IO_INT32(r);
     }
 
-    if (!io_failure) visit_alGetBufferiv(&callerinfo, name, param, origvalues, numvals, values);
+    if (VISITING) CALL_EVENT(alGetBufferiv, callerinfo, name, param, origvalues, numvals, values);
 
     IO_END();
 }
 
-static void decode_alTracePushScope(void)
+static void decode_alTracePushScope(TraceReader *r)
 {
     IO_START(alTracePushScope);
-    const ALchar *str = IO_STRING();
-    if (!io_failure) visit_alTracePushScope(&callerinfo, str);
-    trace_scope++;
+    const ALchar *str = IO_STRING(r);
+    if (VISITING) CALL_EVENT(alTracePushScope, callerinfo, str);
+    r->trace_scope++;
     IO_END();
 }
 
-static void decode_alTracePopScope(void)
+static void decode_alTracePopScope(TraceReader *r)
 {
     IO_START(alTracePopScope);
-    callerinfo.trace_scope--;
-    trace_scope--;
-    if (!io_failure) visit_alTracePopScope(&callerinfo);
+    if (r->trace_scope > 0) {  // unmatched pops (or a live stream that joined partway) stop at zero.
+        r->trace_scope--;
+    }
+    callerinfo->trace_scope = r->trace_scope;
+    if (VISITING) CALL_EVENT(alTracePopScope, callerinfo);
     IO_END();
 }
 
-static void decode_alTraceMessage(void)
+static void decode_alTraceMessage(TraceReader *r)
 {
     IO_START(alTraceMessage);
-    const ALchar *str = IO_STRING();
-    if (!io_failure) visit_alTraceMessage(&callerinfo, str);
+    const ALchar *str = IO_STRING(r);
+    if (VISITING) CALL_EVENT(alTraceMessage, callerinfo, str);
     IO_END();
 }
 
-static void decode_alTraceBufferLabel(void)
+static void decode_alTraceBufferLabel(TraceReader *r)
 {
     IO_START(alTraceBufferLabel);
-    const ALuint name = IO_UINT32();
-    const ALchar *str = IO_STRING();
+    const ALuint name = IO_UINT32(r);
+    const ALchar *str = IO_STRING(r);
     if (name) {
         char *dup = str ? strdup(str) : NULL;
         if (dup || !str) {
-            add_bufferlabel_to_map(name, dup);
+            SET_LABEL(bufferlabel, name, dup);
         }
     }
-    if (!io_failure) visit_alTraceBufferLabel(&callerinfo, name, str);
+    if (VISITING) CALL_EVENT(alTraceBufferLabel, callerinfo, name, str);
     IO_END();
 }
 
-static void decode_alTraceSourceLabel(void)
+static void decode_alTraceSourceLabel(TraceReader *r)
 {
     IO_START(alTraceSourceLabel);
-    const ALuint name = IO_UINT32();
-    const ALchar *str = IO_STRING();
+    const ALuint name = IO_UINT32(r);
+    const ALchar *str = IO_STRING(r);
     if (name) {
         char *dup = str ? strdup(str) : NULL;
         if (dup || !str) {
-            add_sourcelabel_to_map(name, dup);
+            SET_LABEL(sourcelabel, name, dup);
+        }
+    }
+    if (VISITING) CALL_EVENT(alTraceSourceLabel, callerinfo, name, str);
+    IO_END();
+}
+
+static void decode_alTraceRegisterZone(TraceReader *r)
+{
+    IO_START(alTraceRegisterZone);
+    const ALchar *str = IO_STRING(r);
+    const ALuint retval = IO_UINT32(r);
+    if (retval && str) {
+        char *dup = strdup(str);
+        if (dup) {
+            SET_LABEL(zonename, retval, dup);
+        }
+    }
+    if (VISITING) CALL_EVENT(alTraceRegisterZone, callerinfo, retval, str);
+    IO_END();
+}
+
+static void decode_alTraceZoneBegin(TraceReader *r)
+{
+    IO_START(alTraceZoneBegin);
+    const ALuint zone = IO_UINT32(r);
+    const uint64 nanoseconds = IO_UINT64(r);
+    if (VISITING) CALL_EVENT(alTraceZoneBegin, callerinfo, zone, nanoseconds);
+    IO_END();
+}
+
+static void decode_alTraceZoneEnd(TraceReader *r)
+{
+    IO_START(alTraceZoneEnd);
+    const ALuint zone = IO_UINT32(r);
+    const uint64 nanoseconds = IO_UINT64(r);
+    if (VISITING) CALL_EVENT(alTraceZoneEnd, callerinfo, zone, nanoseconds);
+    IO_END();
+}
+
+static void decode_alTraceFrameMark(TraceReader *r)
+{
+    IO_START(alTraceFrameMark);
+    const uint64 nanoseconds = IO_UINT64(r);
+    if (VISITING) CALL_EVENT(alTraceFrameMark, callerinfo, nanoseconds);
+    IO_END();
+}
+
+static void decode_alTraceRegisterCounter(TraceReader *r)
+{
+    IO_START(alTraceRegisterCounter);
+    const ALchar *str = IO_STRING(r);
+    const ALuint retval = IO_UINT32(r);
+    if (retval && str) {
+        char *dup = strdup(str);
+        if (dup) {
+            SET_LABEL(countername, retval, dup);
         }
     }
-    if (!io_failure) visit_alTraceSourceLabel(&callerinfo, name, str);
+    if (VISITING) CALL_EVENT(alTraceRegisterCounter, callerinfo, retval, str);
+    IO_END();
+}
+
+static void decode_alTraceCounter(TraceReader *r)
+{
+    IO_START(alTraceCounter);
+    const ALuint counter = IO_UINT32(r);
+    const ALdouble value = IO_DOUBLE(r);
+    if (VISITING) CALL_EVENT(alTraceCounter, callerinfo, counter, value);
     IO_END();
 }
 
-static void decode_alcTraceDeviceLabel(void)
+static void decode_alcTraceDeviceLabel(TraceReader *r)
 {
     IO_START(alcTraceDeviceLabel);
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCchar *str = IO_STRING();
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCchar *str = IO_STRING(r);
     if (device) {
         char *dup = str ? strdup(str) : NULL;
         if (dup || !str) {
-            add_devicelabel_to_map(device, dup);
+            SET_LABEL(devicelabel, device, dup);
         }
     }
-    if (!io_failure) visit_alcTraceDeviceLabel(&callerinfo, device, str);
+    if (VISITING) CALL_EVENT(alcTraceDeviceLabel, callerinfo, device, str);
     IO_END();
 }
 
-static void decode_alcTraceContextLabel(void)
+static void decode_alcTraceContextLabel(TraceReader *r)
 {
     IO_START(alcTraceContextLabel);
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    const ALCchar *str = IO_STRING();
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALCchar *str = IO_STRING(r);
     if (ctx) {
         char *dup = str ? strdup(str) : NULL;
         if (dup || !str) {
-            add_contextlabel_to_map(ctx, dup);
+            SET_LABEL(contextlabel, ctx, dup);
         }
     }
-    if (!io_failure) visit_alcTraceContextLabel(&callerinfo, ctx, str);
+    if (VISITING) CALL_EVENT(alcTraceContextLabel, callerinfo, ctx, str);
     IO_END();
 }
 
 
+// this one doesn't have a visitor either; it gets attached to the next call's CallerInfo.
+static void decode_sched_context(TraceReader *r)
+{
+    int i;
+    for (i = 0; i < 4; i++) {
+        r->sched_context[i] = IO_UINT32(r);
+    }
+    r->have_sched_context = !r->io_failure;
+}
+
+// this one doesn't have a visitor either; it's what a chunked tracefile
+//  (ALTRACE_CHUNKED) tells us after each checkpoint, so decoding can start
+//  there: thread numbering, labels, zone and counter names, scope depth.
+static void decode_chunk_context(TraceReader *r)
+{
+    const uint32 scope = IO_UINT32(r);
+    uint32 count, i;
+
+    // a live stream gets one of these before anything else when we attach,
+    //  and can number threads like the tracefile does from there. If it got
+    //  calls first, it's already numbering them its own way.
+    const int numbering = !r->shmring || (r->next_mapped_threadid == 0);
+
+    count = IO_UINT32(r);
+    for (i = 0; (i < count) && !r->io_failure; i++) {
+        const uint64 logthreadid = IO_UINT64(r);
+        if (numbering && !r->io_failure) {
+            add_threadid_to_map(&r->threadid_map, logthreadid, i + 1);
+        }
+    }
+    if (numbering && (count > r->next_mapped_threadid)) {
+        r->next_mapped_threadid = count;
+    }
+
+    count = IO_UINT32(r);
+    for (i = 0; (i < count) && !r->io_failure; i++) {
+        const EventEnum kind = IO_EVENTENUM(r);
+        const uint64 key = IO_UINT64(r);
+        const char *str = IO_STRING(r);
+        char *dup = (str && !r->io_failure) ? strdup(str) : NULL;
+        if (!dup) {
+            continue;
+        }
+        switch (kind) {
+            case ALEE_alTraceBufferLabel: SET_LABEL(bufferlabel, (ALuint) key, dup); break;
+            case ALEE_alTraceSourceLabel: SET_LABEL(sourcelabel, (ALuint) key, dup); break;
+            case ALEE_alcTraceDeviceLabel: SET_LABEL(devicelabel, (ALCdevice *) (size_t) key, dup); break;
+            case ALEE_alcTraceContextLabel: SET_LABEL(contextlabel, (ALCcontext *) (size_t) key, dup); break;
+            default: free(dup); break;
+        }
+    }
+
+    count = IO_UINT32(r);
+    for (i = 0; (i < count) && !r->io_failure; i++) {
+        const char *str = IO_STRING(r);
+        char *dup = (str && !r->io_failure) ? strdup(str) : NULL;
+        if (dup) {
+            SET_LABEL(zonename, i + 1, dup);
+        }
+    }
+
+    count = IO_UINT32(r);
+    for (i = 0; (i < count) && !r->io_failure; i++) {
+        const char *str = IO_STRING(r);
+        char *dup = (str && !r->io_failure) ? strdup(str) : NULL;
+        if (dup) {
+            SET_LABEL(countername, i + 1, dup);
+        }
+    }
+
+    if (!r->io_failure) {
+        r->trace_scope = scope;
+    }
+}
+
 // this one doesn't have a visitor; we handle compiling the symbol map here.
-static void decode_callstack_syms_event(void)
+static void decode_callstack_syms_event(TraceReader *r)
 {
-    const uint32 num_new_strings = IO_UINT32();
+    const uint32 num_new_strings = IO_UINT32(r);
     uint32 i;
     for (i = 0; i < num_new_strings; i++) {
-        void *ptr = IO_PTR();
-        const char *str = IO_STRING();
-        if (io_failure) break;
-        if (str) {
+        void *ptr = IO_PTR(r);
+        const char *str = IO_STRING(r);
+        if (r->io_failure) break;
+        // chunked traces send these again at every checkpoint; keep the
+        //  string we already have, since events we handed out may point to it.
+        if (str && ptr && !get_mapped_stackframe(&r->stackframe_map, ptr)) {
             char *dup = strdup(str);
-            if (ptr && dup) {
-                add_stackframe_to_map(ptr, dup);
+            if (dup) {
+                add_stackframe_to_map(&r->stackframe_map, ptr, dup);
             }
         }
     }
 }
 
 
-static void decode_al_error_event(void)
+static void decode_al_error_event(TraceReader *r)
 {
-    const ALenum err = IO_ENUM();
-    if (!io_failure) visit_al_error_event(guserdata, err);
+    const ALenum err = IO_ENUM(r);
+    if (VISITING) EVENT(ALEE_ALERROR_TRIGGERED, al_error_event, err);
 }
 
-static void decode_alc_error_event(void)
+static void decode_alc_error_event(TraceReader *r)
 {
-    ALCdevice *device = (ALCdevice *) IO_PTR();
-    const ALCenum err = IO_ALCENUM();
-    if (!io_failure) visit_alc_error_event(guserdata, device, err);
+    ALCdevice *device = (ALCdevice *) IO_PTR(r);
+    const ALCenum err = IO_ALCENUM(r);
+    if (VISITING) EVENT(ALEE_ALCERROR_TRIGGERED, alc_error_event, device, err);
 }
 
-static void decode_device_state_changed_int(void)
+static void decode_device_state_changed_int(TraceReader *r)
 {
-    ALCdevice *dev = (ALCdevice *) IO_PTR();
-    const ALCenum param = IO_ALCENUM();
-    const ALCint newval = IO_INT32();
-    if (!io_failure) visit_device_state_changed_int(guserdata, dev, param, newval);
+    ALCdevice *dev = (ALCdevice *) IO_PTR(r);
+    const ALCenum param = IO_ALCENUM(r);
+    const ALCint newval = IO_INT32(r);
+    if (VISITING) EVENT(ALEE_DEVICE_STATE_CHANGED_INT, device_state_changed_int, dev, param, newval);
 }
 
-static void decode_context_state_changed_enum(void)
+static void decode_context_state_changed_enum(TraceReader *r)
 {
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    const ALenum param = IO_ENUM();
-    const ALenum newval = IO_ENUM();
-    if (!io_failure) visit_context_state_changed_enum(guserdata, ctx, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALenum param = IO_ENUM(r);
+    const ALenum newval = IO_ENUM(r);
+    if (VISITING) EVENT(ALEE_CONTEXT_STATE_CHANGED_ENUM, context_state_changed_enum, ctx, param, newval);
 }
 
-static void decode_context_state_changed_float(void)
+static void decode_context_state_changed_float(TraceReader *r)
 {
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    const ALenum param = IO_ENUM();
-    const ALfloat newval = IO_FLOAT();
-    if (!io_failure) visit_context_state_changed_float(guserdata, ctx, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat newval = IO_FLOAT(r);
+    if (VISITING) EVENT(ALEE_CONTEXT_STATE_CHANGED_FLOAT, context_state_changed_float, ctx, param, newval);
 }
 
-static void decode_context_state_changed_string(void)
+static void decode_context_state_changed_string(TraceReader *r)
 {
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    const ALenum param = IO_ENUM();
-    const char *newval = IO_STRING();
-    if (!io_failure) visit_context_state_changed_string(guserdata, ctx, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALenum param = IO_ENUM(r);
+    const char *newval = IO_STRING(r);
+    if (VISITING) EVENT(ALEE_CONTEXT_STATE_CHANGED_STRING, context_state_changed_string, ctx, param, newval);
 }
 
-static void decode_listener_state_changed_floatv(void)
+static void decode_context_attributes(TraceReader *r)
 {
-    ALCcontext *ctx = (ALCcontext *) IO_PTR();
-    const ALenum param = IO_ENUM();
-    const uint32 numfloats = IO_UINT32();
-    ALfloat *values = (ALfloat *) get_ioblob(numfloats * sizeof (ALfloat));
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const uint32 numattrs = IO_UINT32(r);
+    ALCint *attrs = (ALCint *) arena_alloc(&r->arena, numattrs * sizeof (ALCint));
     uint32 i;
 
-    for (i = 0; i < numfloats; i++) {
-        values[i] = IO_FLOAT();
+    for (i = 0; i < numattrs; i++) {
+        attrs[i] = IO_INT32(r);
     }
 
-    if (!io_failure) visit_listener_state_changed_floatv(guserdata, ctx, param, numfloats, values);
+    if (VISITING) EVENT(ALEE_CONTEXT_ATTRIBUTES, context_attributes, ctx, numattrs, attrs);
 }
 
-static void decode_source_state_changed_bool(void)
+static void decode_listener_state_changed_floatv(TraceReader *r)
 {
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALboolean newval = IO_BOOLEAN();
-    if (!io_failure) visit_source_state_changed_bool(guserdata, name, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALenum param = IO_ENUM(r);
+    const uint32 numfloats = IO_UINT32(r);
+    ALfloat *values = (ALfloat *) arena_alloc(&r->arena, numfloats * sizeof (ALfloat));
+    uint32 i;
+
+    for (i = 0; i < numfloats; i++) {
+        values[i] = IO_FLOAT(r);
+    }
+
+    if (VISITING) EVENT(ALEE_LISTENER_STATE_CHANGED_FLOATV, listener_state_changed_floatv, ctx, param, numfloats, values);
 }
 
-static void decode_source_state_changed_enum(void)
+static void decode_source_state_changed_bool(TraceReader *r)
 {
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALenum newval = IO_ENUM();
-    if (!io_failure) visit_source_state_changed_enum(guserdata, name, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALboolean newval = IO_BOOLEAN(r);
+    if (VISITING) EVENT(ALEE_SOURCE_STATE_CHANGED_BOOL, source_state_changed_bool, ctx, name, param, newval);
 }
 
-static void decode_source_state_changed_int(void)
+static void decode_source_state_changed_enum(TraceReader *r)
 {
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALint newval = IO_INT32();
-    if (!io_failure) visit_source_state_changed_int(guserdata, name, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALenum newval = IO_ENUM(r);
+    if (VISITING) EVENT(ALEE_SOURCE_STATE_CHANGED_ENUM, source_state_changed_enum, ctx, name, param, newval);
 }
 
-static void decode_source_state_changed_uint(void)
+static void decode_source_state_changed_int(TraceReader *r)
 {
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALuint newval = IO_UINT32();
-    if (!io_failure) visit_source_state_changed_uint(guserdata, name, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALint newval = IO_INT32(r);
+    if (VISITING) EVENT(ALEE_SOURCE_STATE_CHANGED_INT, source_state_changed_int, ctx, name, param, newval);
 }
 
-static void decode_source_state_changed_float(void)
+static void decode_source_state_changed_uint(TraceReader *r)
 {
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALfloat newval = IO_FLOAT();
-    if (!io_failure) visit_source_state_changed_float(guserdata, name, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALuint newval = IO_UINT32(r);
+    if (VISITING) EVENT(ALEE_SOURCE_STATE_CHANGED_UINT, source_state_changed_uint, ctx, name, param, newval);
 }
 
-static void decode_source_state_changed_float3(void)
+static void decode_source_state_changed_float(TraceReader *r)
 {
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALfloat newval1 = IO_FLOAT();
-    const ALfloat newval2 = IO_FLOAT();
-    const ALfloat newval3 = IO_FLOAT();
-    if (!io_failure) visit_source_state_changed_float3(guserdata, name, param, newval1, newval2, newval3);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat newval = IO_FLOAT(r);
+    if (VISITING) EVENT(ALEE_SOURCE_STATE_CHANGED_FLOAT, source_state_changed_float, ctx, name, param, newval);
 }
 
-static void decode_buffer_state_changed_int(void)
+static void decode_source_state_changed_float3(TraceReader *r)
 {
-    const ALuint name = IO_UINT32();
-    const ALenum param = IO_ENUM();
-    const ALint newval = IO_INT32();
-    if (!io_failure) visit_buffer_state_changed_int(guserdata, name, param, newval);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALfloat newval1 = IO_FLOAT(r);
+    const ALfloat newval2 = IO_FLOAT(r);
+    const ALfloat newval3 = IO_FLOAT(r);
+    if (VISITING) EVENT(ALEE_SOURCE_STATE_CHANGED_FLOAT3, source_state_changed_float3, ctx, name, param, newval1, newval2, newval3);
 }
 
-static void decode_eos(void)
+static void decode_buffer_state_changed_int(TraceReader *r)
 {
-    const uint32 ticks = IO_UINT32();
-    if (!io_failure) visit_eos(guserdata, AL_TRUE, ticks);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const ALint newval = IO_INT32(r);
+    if (VISITING) EVENT(ALEE_BUFFER_STATE_CHANGED_INT, buffer_state_changed_int, name, param, newval);
 }
 
-// !!! FIXME: this has some globals, so it's not thread safe (you can't run
-// !!! FIXME:  two logs on two threads at once). But you can run two logs
-// !!! FIXME:  serially, fwiw. I think.
-int process_tracelog(const char *fname, void *userdata)
+static void decode_process_forked(TraceReader *r)
 {
-    int retval = 1;
-    int eos = 0;
-    off_t fdoffset = 0;
-    off_t fdsize = 0;
+    const uint32 ticks = IO_UINT32(r);
+    const uint32 parentpid = IO_UINT32(r);
+    const uint32 childpid = IO_UINT32(r);
+    const char *parentfile = IO_STRING(r);
+    const uint64 parentoffset = IO_UINT64(r);
+    if (VISITING) EVENT(ALEE_PROCESS_FORKED, process_forked, ticks, parentpid, childpid, parentfile, parentoffset);
+}
 
-    if (!init_altrace_playback(fname, userdata)) {
-        return 0;
-    }
+static void decode_checkpoint(TraceReader *r)
+{
+    const uint64 magic = IO_UINT64(r);
+    const uint64 eventcount = IO_UINT64(r);
+    const uint64 offset = IO_UINT64(r);
+    const uint32 ticks = IO_UINT32(r);
 
-    fdoffset = lseek(logfd, 0, SEEK_CUR);
-    fdsize = lseek(logfd, 0, SEEK_END);
-    if ((lseek(logfd, fdoffset, SEEK_SET) == -1) || (fdoffset == -1) || (fdsize == -1)) {
-        fprintf(stderr, "%s: Failed to seek in file: %s\n", GAppName, strerror(errno));
-        io_failure = 1;
+    if (r->io_failure) {
+        return;
     }
 
-    while (!eos) {
-        if (!io_failure) {
-            fdoffset = lseek(logfd, 0, SEEK_CUR);
-            if (fdoffset == -1) {
-                fprintf(stderr, "%s: Failed to get current file offset: %s\n", GAppName, strerror(errno));
-                io_failure = 1;
-            }
+    // the ring doesn't know about file offsets, so only check those in files.
+    if ((magic != ALTRACE_CHECKPOINT_MAGIC) || (!r->shmring && (offset != (uint64) r->event_offset))) {
+        if (!r->validating) {
+            fprintf(stderr, "%s: Bogus checkpoint at offset %llu, log is probably corrupt.\n", GAppName, (unsigned long long) r->event_offset);
         }
+        r->io_failure = 1;
+        return;
+    }
 
-        if (io_failure) {
-            retval = 0;
-            eos = 1;
-            break;
-        }
+    r->last_ticks = ticks;
+    if (VISITING) EVENT(ALEE_CHECKPOINT, checkpoint, eventcount, offset, ticks);
+}
 
-        if (!visit_progress(guserdata, fdoffset, fdsize)) {
-            fprintf(stderr, "%s: Application cancelled file processing!\n", GAppName);
-            visit_eos(guserdata, AL_FALSE, 0);
-            retval = -1;
-            eos = 1;
-            break;
-        }
+static void decode_perf_counters(TraceReader *r)
+{
+    const uint32 kind = IO_UINT32(r);
+    const uint64 value1 = IO_UINT64(r);
+    const uint64 value2 = IO_UINT64(r);
+    if (VISITING) EVENT(ALEE_PERF_COUNTERS, perf_counters, kind, value1, value2);
+}
 
-        switch (IO_EVENTENUM()) {
-            #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) case ALEE_##name: decode_##name(); break;
-            #include "altrace_entrypoints.h"
+static void decode_resource_sample(TraceReader *r)
+{
+    const uint32 ticks = IO_UINT32(r);
+    const uint64 rss = IO_UINT64(r);
+    const uint64 usertime = IO_UINT64(r);
+    const uint64 systime = IO_UINT64(r);
+    const uint32 threads = IO_UINT32(r);
+    const uint32 openal_threads = IO_UINT32(r);
+    if (!r->io_failure) {
+        r->last_ticks = ticks;
+    }
+    if (VISITING) EVENT(ALEE_RESOURCE_SAMPLE, resource_sample, ticks, rss, usertime, systime, threads, openal_threads);
+}
 
-            case ALEE_NEW_CALLSTACK_SYMS:
-                decode_callstack_syms_event();
-                break;
+static void decode_device_clock_latency(TraceReader *r)
+{
+    ALCdevice *dev = (ALCdevice *) IO_PTR(r);
+    const uint32 ticks = IO_UINT32(r);
+    const int64 clock = (int64) IO_UINT64(r);
+    const int64 latency = (int64) IO_UINT64(r);
+    if (VISITING) EVENT(ALEE_DEVICE_CLOCK_LATENCY, device_clock_latency, dev, ticks, clock, latency);
+}
 
-            case ALEE_ALERROR_TRIGGERED:
-                decode_al_error_event();
-                break;
+static void decode_source_latency(TraceReader *r)
+{
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALuint name = IO_UINT32(r);
+    const int64 offset = (int64) IO_UINT64(r);
+    const int64 latency = (int64) IO_UINT64(r);
+    if (VISITING) EVENT(ALEE_SOURCE_LATENCY, source_latency, ctx, name, offset, latency);
+}
 
-            case ALEE_ALCERROR_TRIGGERED:
-                decode_alc_error_event();
-                break;
+static void decode_motion_channel(TraceReader *r)
+{
+    const uint32 id = IO_UINT32(r);
+    const uint32 target = IO_UINT32(r);
+    ALCcontext *ctx = (ALCcontext *) IO_PTR(r);
+    const ALuint name = IO_UINT32(r);
+    const ALenum param = IO_ENUM(r);
+    const uint32 numvals = IO_UINT32(r);
+    const double quantum = IO_DOUBLE(r);
+    MotionChannel *ch;
 
-            case ALEE_DEVICE_STATE_CHANGED_INT:
-                decode_device_state_changed_int();
-                break;
+    if (r->io_failure) {
+        return;
+    } else if ((numvals != 3) && (numvals != 6)) {
+        if (!r->validating) {
+            fprintf(stderr, "%s: Bogus motion channel at offset %llu, log is probably corrupt.\n", GAppName, (unsigned long long) r->event_offset);
+        }
+        r->io_failure = 1;
+        return;
+    }
 
-            case ALEE_CONTEXT_STATE_CHANGED_ENUM:
-                decode_context_state_changed_enum();
-                break;
+    // a channel gets defined again after checkpoints, etc, so decoding can
+    //  start there; keep what we last reported, though.
+    ch = get_mapped_motion(&r->motion_map, id);
+    if (!ch) {
+        ch = (MotionChannel *) calloc(1, sizeof (MotionChannel));
+        if (!ch) {
+            out_of_memory();
+        }
+        add_motion_to_map(&r->motion_map, id, ch);
+    }
 
-            case ALEE_CONTEXT_STATE_CHANGED_FLOAT:
-                decode_context_state_changed_float();
-                break;
+    ch->target = (MotionTarget) target;
+    ch->ctx = ctx;
+    ch->name = name;
+    ch->param = param;
+    ch->numvals = numvals;
+    ch->quantum = quantum;
+    memset(ch->quantized, '\0', sizeof (ch->quantized));
+}
 
-            case ALEE_CONTEXT_STATE_CHANGED_STRING:
-                decode_context_state_changed_string();
-                break;
+static void decode_motion_update(TraceReader *r)
+{
+    const uint32 id = IO_UINT32(r);
+    const uint32 wait_until = IO_UINT32(r);
+    const uint64 logthreadid = IO_UINT64(r);
+    MotionChannel *ch = r->io_failure ? NULL : get_mapped_motion(&r->motion_map, id);
+    CallerInfo *callerinfo = &r->events[0].callerinfo;
+    ALfloat *values;
+    int changed;
+    uint32 i;
 
-            case ALEE_LISTENER_STATE_CHANGED_FLOATV:
-                decode_listener_state_changed_floatv();
-                break;
+    if (r->io_failure) {
+        return;
+    } else if (!ch) {
+        if (!r->validating) {
+            fprintf(stderr, "%s: Motion update for unknown channel at offset %llu, log is probably corrupt.\n", GAppName, (unsigned long long) r->event_offset);
+        }
+        r->io_failure = 1;
+        return;
+    }
 
-            case ALEE_SOURCE_STATE_CHANGED_BOOL:
-                decode_source_state_changed_bool();
-                break;
+    values = (ALfloat *) arena_alloc(&r->arena, sizeof (ALfloat) * ch->numvals);
+    for (i = 0; i < ch->numvals; i++) {
+        ch->quantized[i] += IO_VARINT(r);
+        values[i] = (ALfloat) (((double) ch->quantized[i]) * ch->quantum);
+    }
 
-            case ALEE_SOURCE_STATE_CHANGED_ENUM:
-                decode_source_state_changed_enum();
-                break;
+    if (r->io_failure) {
+        return;
+    }
 
-            case ALEE_SOURCE_STATE_CHANGED_INT:
-                decode_source_state_changed_int();
-                break;
+    changed = !ch->have_values || (memcmp(ch->values, values, sizeof (ALfloat) * ch->numvals) != 0);
+    memcpy(ch->values, values, sizeof (ALfloat) * ch->numvals);
+    ch->have_values = 1;
 
-            case ALEE_SOURCE_STATE_CHANGED_UINT:
-                decode_source_state_changed_uint();
-                break;
+    init_callerinfo(r, callerinfo, wait_until, logthreadid);
+    callerinfo->fdoffset = tell(r);
 
-            case ALEE_SOURCE_STATE_CHANGED_FLOAT:
-                decode_source_state_changed_float();
-                break;
+    if (!VISITING) {
+        return;
+    }
 
-            case ALEE_SOURCE_STATE_CHANGED_FLOAT3:
-                decode_source_state_changed_float3();
-                break;
+    // the recorder skips its state checks for these, so report the change
+    //  it would have seen.
+    if (ch->target == ALTRACE_MOTION_SOURCE) {
+        CALL_EVENT(alSource3f, callerinfo, ch->name, ch->param, values[0], values[1], values[2]);
+        if (changed) {
+            EVENT(ALEE_SOURCE_STATE_CHANGED_FLOAT3, source_state_changed_float3, ch->ctx, ch->name, ch->param, values[0], values[1], values[2]);
+        }
+    } else {
+        if (ch->numvals == 3) {
+            CALL_EVENT(alListener3f, callerinfo, ch->param, values[0], values[1], values[2]);
+        } else {
+            CALL_EVENT(alListenerfv, callerinfo, ch->param, NULL, ch->numvals, values);  // the app's pointer isn't recorded; NULL with (values) says so.
+        }
+        if (changed) {
+            EVENT(ALEE_LISTENER_STATE_CHANGED_FLOATV, listener_state_changed_floatv, ch->ctx, ch->param, ch->numvals, values);
+        }
+    }
+}
 
-            case ALEE_BUFFER_STATE_CHANGED_INT:
-                decode_buffer_state_changed_int();
-                break;
+static void decode_eos(TraceReader *r)
+{
+    const uint32 ticks = IO_UINT32(r);
+    if (VISITING) EVENT(ALEE_EOS, eos, AL_TRUE, ticks);
+}
 
-            case ALEE_EOS:
-                decode_eos();
-                eos = 1;
-                break;
+// decodes (and visits, if we're visiting) everything after the event id.
+//  Returns zero if (ev) isn't something we know about.
+static int decode_event(TraceReader *r, const EventEnum ev)
+{
+    switch (ev) {
+        #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) case ALEE_##name: decode_##name(r); break;
+        #include "altrace_entrypoints.h"
 
-            default:
-                if (!io_failure) {
-                    visit_eos(guserdata, AL_FALSE, 0);
-                }
-                retval = 0;
-                eos = 1;
+        case ALEE_NEW_CALLSTACK_SYMS:
+            decode_callstack_syms_event(r);
+            break;
+
+        case ALEE_CHUNK_CONTEXT:
+            decode_chunk_context(r);
+            break;
+
+        case ALEE_ALERROR_TRIGGERED:
+            decode_al_error_event(r);
+            break;
+
+        case ALEE_ALCERROR_TRIGGERED:
+            decode_alc_error_event(r);
+            break;
+
+        case ALEE_DEVICE_STATE_CHANGED_INT:
+            decode_device_state_changed_int(r);
+            break;
+
+        case ALEE_CONTEXT_STATE_CHANGED_ENUM:
+            decode_context_state_changed_enum(r);
+            break;
+
+        case ALEE_CONTEXT_STATE_CHANGED_FLOAT:
+            decode_context_state_changed_float(r);
+            break;
+
+        case ALEE_CONTEXT_STATE_CHANGED_STRING:
+            decode_context_state_changed_string(r);
+            break;
+
+        case ALEE_LISTENER_STATE_CHANGED_FLOATV:
+            decode_listener_state_changed_floatv(r);
+            break;
+
+        case ALEE_SOURCE_STATE_CHANGED_BOOL:
+            decode_source_state_changed_bool(r);
+            break;
+
+        case ALEE_SOURCE_STATE_CHANGED_ENUM:
+            decode_source_state_changed_enum(r);
+            break;
+
+        case ALEE_SOURCE_STATE_CHANGED_INT:
+            decode_source_state_changed_int(r);
+            break;
+
+        case ALEE_SOURCE_STATE_CHANGED_UINT:
+            decode_source_state_changed_uint(r);
+            break;
+
+        case ALEE_SOURCE_STATE_CHANGED_FLOAT:
+            decode_source_state_changed_float(r);
+            break;
+
+        case ALEE_SOURCE_STATE_CHANGED_FLOAT3:
+            decode_source_state_changed_float3(r);
+            break;
+
+        case ALEE_BUFFER_STATE_CHANGED_INT:
+            decode_buffer_state_changed_int(r);
+            break;
+
+        case ALEE_PROCESS_FORKED:
+            decode_process_forked(r);
+            break;
+
+        case ALEE_CHECKPOINT:
+            decode_checkpoint(r);
+            break;
+
+        case ALEE_PERF_COUNTERS:
+            decode_perf_counters(r);
+            break;
+
+        case ALEE_SCHED_CONTEXT:
+            decode_sched_context(r);
+            break;
+
+        case ALEE_RESOURCE_SAMPLE:
+            decode_resource_sample(r);
+            break;
+
+        case ALEE_DEVICE_CLOCK_LATENCY:
+            decode_device_clock_latency(r);
+            break;
+
+        case ALEE_SOURCE_LATENCY:
+            decode_source_latency(r);
+            break;
+
+        case ALEE_MOTION_CHANNEL:
+            decode_motion_channel(r);
+            break;
+
+        case ALEE_MOTION_UPDATE:
+            decode_motion_update(r);
+            break;
+
+        case ALEE_CONTEXT_ATTRIBUTES:
+            decode_context_attributes(r);
+            break;
+
+        case ALEE_EOS:
+            decode_eos(r);
+            break;
+
+        default:
+            return 0;
+    }
+
+    return 1;
+}
+
+// events that leave something behind for the rest of the log to use:
+//  symbols, names, labels (and the calls that clear them), scopes.
+static int is_context_event(const EventEnum ev)
+{
+    switch (ev) {
+        case ALEE_NEW_CALLSTACK_SYMS:
+        case ALEE_alcOpenDevice:
+        case ALEE_alcCaptureOpenDevice:
+        case ALEE_alcCreateContext:
+        case ALEE_alGenSources:
+        case ALEE_alGenBuffers:
+        case ALEE_alTracePushScope:
+        case ALEE_alTracePopScope:
+        case ALEE_alTraceBufferLabel:
+        case ALEE_alTraceSourceLabel:
+        case ALEE_alcTraceDeviceLabel:
+        case ALEE_alcTraceContextLabel:
+        case ALEE_alTraceRegisterZone:
+        case ALEE_alTraceRegisterCounter:
+            return 1;
+        default: break;
+    }
+    return 0;
+}
+
+static int is_call_event(const EventEnum ev)
+{
+    switch (ev) {
+        #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) case ALEE_##name:
+        #include "altrace_entrypoints.h"
+            return 1;
+        default: break;
+    }
+    return 0;
+}
+
+// events that have to be decoded even if nobody wants them, because they
+//  change what we know about the rest of the log.
+static int has_side_effects(const EventEnum ev)
+{
+    switch (ev) {
+        case ALEE_EOS:
+        case ALEE_SCHED_CONTEXT:
+        case ALEE_CHECKPOINT:
+        case ALEE_MOTION_CHANNEL:
+        case ALEE_MOTION_UPDATE:
+        case ALEE_CHUNK_CONTEXT:
+        case ALEE_alcCaptureCloseDevice:
+        case ALEE_alcCloseDevice:
+        case ALEE_alcDestroyContext:
+        case ALEE_alDeleteSources:
+        case ALEE_alDeleteBuffers:
+            return 1;
+        default: break;
+    }
+    return is_context_event(ev);
+}
+
+// every event is its id, the length of the rest of it, then its fields.
+static EventEnum IO_RECORD(TraceReader *r)
+{
+    const EventEnum ev = IO_EVENTENUM(r);
+    const uint32 len = IO_UINT32(r);
+    r->event_end = r->event_offset + 8 + (off_t) len;
+    return ev;
+}
+
+// decodes the rest of a record. Anything past what we know how to decode
+//  (an event we've never heard of, or fields a newer recorder added to one
+//  we have) is skipped.
+static int decode_record(TraceReader *r, const EventEnum ev)
+{
+    off_t pos;
+
+    if (!decode_event(r, ev) && !r->io_failure) {
+        skipbytes(r, r->event_end - tell(r));  // don't know this one.
+    }
+
+    if (r->io_failure) {
+        return 0;
+    }
+
+    pos = tell(r);
+    if (pos > r->event_end) {
+        if (!r->validating) {
+            fprintf(stderr, "%s: Event at offset %llu overran its record, log is probably corrupt.\n", GAppName, (unsigned long long) r->event_offset);
+        }
+        r->io_failure = 1;
+        return 0;
+    } else if (pos < r->event_end) {
+        skipbytes(r, r->event_end - pos);
+    }
+
+    return !r->io_failure;
+}
+
+// steps over a record nobody wants without decoding it. Calls still get
+//  their thread numbered, so later ones are numbered the same as if
+//  everything had been decoded.
+static int skip_record(TraceReader *r, const EventEnum ev)
+{
+    if (is_call_event(ev)) {
+        const uint32 wait_until = IO_UINT32(r);
+        const uint64 logthreadid = IO_UINT64(r);
+        CallerInfo callerinfo;
+        if (!r->io_failure) {
+            init_callerinfo(r, &callerinfo, wait_until, logthreadid);
+        }
+    }
+    skipbytes(r, r->event_end - tell(r));
+    return !r->io_failure;
+}
+
+static int process_record(TraceReader *r, const EventEnum ev)
+{
+    if ((ev < ALEE_MAX) && r->unwanted[ev] && !r->indexio && !has_side_effects(ev)) {
+        return skip_record(r, ev);
+    }
+    return decode_record(r, ev);
+}
+
+// a record bigger than the shared memory ring can't stay in it while we
+//  decode it, so it gets copied out whole first, giving the space back to
+//  the producer as we go (nothing in it has been handed out yet), and then
+//  decoded from the copy as if it were a mapped file.
+static int process_shm_record_copy(TraceReader *r, const EventEnum ev)
+{
+    const off_t event_end = r->event_end;
+    const size_t len = (size_t) (event_end - tell(r));
+    const size_t chunksize = (size_t) (shmring_size(r->shmring) / 2);
+    uint8 *buf = (uint8 *) arena_alloc(&r->arena, len);
+    size_t pos;
+    int retval;
+
+    for (pos = 0; pos < len; pos += chunksize) {
+        const size_t cpy = ((len - pos) < chunksize) ? (len - pos) : chunksize;
+        shmring_release(r->shmring);
+        if (!shmring_read(r->shmring, buf + pos, cpy)) {
+            IO_READ_FAIL(r, 1);
+            return 0;
+        }
+    }
+
+    r->logmap = buf;
+    r->logmaplen = len;
+    r->logmappos = 0;
+    r->event_end = (off_t) len;
+    retval = process_record(r, ev);
+    r->logmap = NULL;
+    r->logmaplen = r->logmappos = 0;
+    r->event_end = event_end;
+    return retval;
+}
+
+static void write_index_entry(TraceReader *r, const EventEnum ev);
+
+// decodes the next record, queueing up its events if we're visiting (plenty
+//  of records don't have any). Returns zero if it didn't decode.
+static int decode_next_event(TraceReader *r, EventEnum *_ev)
+{
+    EventEnum ev;
+
+    start_event(r);
+
+    if (r->shmring) {
+        // everything from the last event has been handed out, let the producer
+        //  reuse that space. Only records too big for the ring give any back
+        //  before this, so nothing we hand out moves under anyone.
+        shmring_release(r->shmring);
+    }
+
+    if (r->io_failure) {
+        return 0;
+    }
+
+    r->event_offset = tell(r);
+    if (r->event_offset == -1) {
+        fprintf(stderr, "%s: Failed to get current file offset: %s\n", GAppName, strerror(errno));
+        r->io_failure = 1;
+        return 0;
+    }
+
+    ev = IO_RECORD(r);
+    r->event_threadid = 0;
+
+    if (r->io_failure) {
+        return 0;
+    } else if (r->shmring && ((uint64) (r->event_end - r->event_offset) > shmring_size(r->shmring))) {
+        if (!process_shm_record_copy(r, ev)) {
+            return 0;
+        }
+    } else if (!process_record(r, ev)) {
+        return 0;
+    }
+
+    if (r->indexio) {
+        write_index_entry(r, ev);
+    }
+
+    *_ev = ev;
+    return 1;
+}
+
+// decodes, without handing anything out, until the log ends. Returns 1 if
+//  it ended cleanly; either way, (r->event_offset) is where it stopped.
+static int validate_tracelog(TraceReader *r)
+{
+    int retval = 0;
+    EventEnum ev;
+
+    r->validating = 1;
+    while (decode_next_event(r, &ev)) {
+        if (ev == ALEE_EOS) {
+            retval = 1;
+            break;
+        }
+    }
+    r->validating = 0;
+
+    return retval;
+}
+
+int altrace_next_event(TraceReader *r, TraceEvent **_event)
+{
+    EventEnum ev;
+
+    visiting_reader = r;
+    arena_use(&r->arena);  // so the *String() functions' results go when the event does.
+
+    while (r->nextevent >= r->numevents) {
+        r->numevents = r->nextevent = 0;
+        if (r->finished) {
+            return 0;
+        } else if (r->chunk_end && (tell(r) >= r->chunk_end)) {
+            r->finished = 1;
+            if (r->chunk_end == (off_t) r->logmaplen) {  // the last one should have ended with ALEE_EOS.
+                IO_READ_FAIL(r, 1);
+                EVENT(ALEE_EOS, eos, AL_FALSE, 0);
+            }
+        } else if (!decode_next_event(r, &ev)) {
+            r->finished = 1;
+            r->numevents = 0;
+            EVENT(ALEE_EOS, eos, AL_FALSE, 0);
+        } else {
+            r->finished = (ev == ALEE_EOS);
+            if (r->events_to_skip) {
+                r->events_to_skip--;
+            }
+        }
+    }
+
+    *_event = &r->events[r->nextevent++];
+    return 1;
+}
+
+off_t altrace_tell(TraceReader *r)
+{
+    return tell(r);
+}
+
+off_t altrace_size(TraceReader *r)
+{
+    if (r->logmap) {
+        return (off_t) r->logmaplen;
+    } else if (r->shmring) {
+        return (off_t) (shmring_position(r->shmring) + shmring_available(r->shmring));
+    }
+    return r->logsize;
+}
+
+void altrace_want_event(TraceReader *r, const EventEnum type, const int wanted)
+{
+    if ((type != ALEE_EOS) && (((int) type) >= 0) && (type < ALEE_MAX)) {  // you always get the end.
+        r->unwanted[type] = wanted ? 0 : 1;
+    }
+}
+
+void altrace_keep_events(TraceReader *r, const int keep)
+{
+    r->keep_events = keep;
+}
+
+void altrace_take_events(TraceReader *r, Arena *arena)
+{
+    forget_pending_labels(r);  // the deleted names it needs are about to go with the events.
+    *arena = r->arena;
+    memset(&r->arena, '\0', sizeof (r->arena));
+}
+
+void altrace_copy_event(TraceEvent *dst, const TraceEvent *src)
+{
+    memcpy(dst, src, sizeof (TraceEvent));
+    switch (src->type) {  // calls point at their own callerinfo, which isn't always (src)'s.
+        #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) \
+            case ALEE_##name: \
+                memcpy(&dst->callerinfo, src->u.name.callerinfo, sizeof (CallerInfo)); \
+                dst->u.name.callerinfo = &dst->callerinfo; \
                 break;
+        #include "altrace_entrypoints.h"
+        default: break;
+    }
+}
+
+static void add_snapshot_label(TraceLabels *labels, const LabelKind kind, const uint64 key, const char *str, uint32 *allocated)
+{
+    const size_t len = strlen(str) + 1;
+    char *dup;
+
+    if (!key) {
+        return;
+    } else if (labels->numitems[kind] >= allocated[kind]) {
+        const uint32 newalloc = allocated[kind] ? (allocated[kind] * 2) : 16;
+        void *ptr = realloc(labels->items[kind], newalloc * sizeof (LabelItem));
+        if (!ptr) {
+            out_of_memory();
+        }
+        labels->items[kind] = (LabelItem *) ptr;
+        allocated[kind] = newalloc;
+    }
+
+    dup = (char *) arena_alloc(&labels->arena, len);
+    memcpy(dup, str, len);
+    labels->items[kind][labels->numitems[kind]].key = key;
+    labels->items[kind][labels->numitems[kind]].str = dup;
+    labels->numitems[kind]++;
+}
+
+TraceLabels *altrace_snapshot_labels(TraceReader *r)
+{
+    TraceLabels *labels = r->labels_snapshot;
+    uint32 allocated[LABEL_MAX];
+    uint32 i;
+
+    if (labels && (labels->generation == r->labels_generation)) {
+        __atomic_add_fetch(&labels->refcount, 1, __ATOMIC_RELAXED);
+        return labels;
+    }
+
+    labels = (TraceLabels *) calloc(1, sizeof (TraceLabels));
+    if (!labels) {
+        out_of_memory();
+    }
+    labels->refcount = 2;  // one for the caller, one for the reader to hand out again.
+    labels->generation = r->labels_generation;
+    memset(allocated, '\0', sizeof (allocated));
+
+    #define SNAPSHOT_SIMPLE_MAP(kind, maptype) \
+        for (i = 0; i < r->maptype##_map.size; i++) { \
+            if (r->maptype##_map.items[i].to) { \
+                add_snapshot_label(labels, kind, (uint64) (size_t) r->maptype##_map.items[i].from, r->maptype##_map.items[i].to, allocated); \
+            } \
+        }
+    #define SNAPSHOT_HASH_MAP(kind, maptype) \
+        for (i = 0; i < 256; i++) { \
+            const HashMapItem_##maptype *item; \
+            for (item = r->maptype##_map.buckets[i]; item; item = item->next) { \
+                if (item->to) { \
+                    add_snapshot_label(labels, kind, (uint64) item->from, item->to, allocated); \
+                } \
+            } \
+        }
+
+    SNAPSHOT_SIMPLE_MAP(LABEL_DEVICE, devicelabel);
+    SNAPSHOT_SIMPLE_MAP(LABEL_CONTEXT, contextlabel);
+    SNAPSHOT_HASH_MAP(LABEL_SOURCE, sourcelabel);
+    SNAPSHOT_HASH_MAP(LABEL_BUFFER, bufferlabel);
+    SNAPSHOT_HASH_MAP(LABEL_ZONE, zonename);
+    SNAPSHOT_HASH_MAP(LABEL_COUNTER, countername);
+
+    #undef SNAPSHOT_SIMPLE_MAP
+    #undef SNAPSHOT_HASH_MAP
+
+    for (i = 0; i < LABEL_MAX; i++) {
+        if (labels->numitems[i] > 0) {  // (items[i]) is NULL if there aren't any.
+            qsort(labels->items[i], labels->numitems[i], sizeof (LabelItem), compare_label_items);
         }
     }
 
-    if (io_failure) {
-        visit_eos(guserdata, AL_FALSE, 0);
+    altrace_free_labels(r->labels_snapshot);
+    r->labels_snapshot = labels;
+    return labels;
+}
+
+void altrace_free_labels(TraceLabels *labels)
+{
+    if (labels && (__atomic_sub_fetch(&labels->refcount, 1, __ATOMIC_ACQ_REL) == 0)) {
+        int i;
+        for (i = 0; i < LABEL_MAX; i++) {
+            free(labels->items[i]);
+        }
+        arena_free(&labels->arena);
+        free(labels);
     }
+}
 
-    quit_altrace_playback();
+void altrace_use_labels(TraceLabels *labels)
+{
+    visiting_labels = labels;
+}
+
+const void *altrace_blob_map(TraceReader *r, const TraceBlob *blob)
+{
+    uint8 *buf;
+
+    if (!blob) {
+        return NULL;
+    } else if (r->logmap) {
+        if ((blob->offset < 0) || (blob->len > r->logmaplen) || (((uint64) blob->offset) > (r->logmaplen - blob->len))) {
+            fprintf(stderr, "%s: Blob at offset %llu is past the end of the log.\n", GAppName, (unsigned long long) blob->offset);
+            return NULL;
+        }
+        return r->logmap + blob->offset;
+    } else if (blob->data) {
+        return blob->data;
+    }
+
+    buf = (uint8 *) arena_alloc(&r->arena, (size_t) blob->len);
+    return altrace_blob_read(r, blob, buf) ? buf : NULL;
+}
+
+int altrace_blob_read(TraceReader *r, const TraceBlob *blob, void *buf)
+{
+    uint8 *dst = (uint8 *) buf;
+    uint64 len;
+    off_t pos;
+
+    if (!blob) {
+        return 0;
+    } else if (r->logmap || blob->data) {
+        const void *ptr = altrace_blob_map(r, blob);
+        if (ptr) {
+            memcpy(buf, ptr, (size_t) blob->len);
+        }
+        return (ptr != NULL);
+    } else if (r->logfd == -1) {
+        fprintf(stderr, "%s: Can't get back to earlier data in a live trace.\n", GAppName);
+        return 0;
+    }
+
+    len = blob->len;
+    pos = blob->offset;
+    while (len > 0) {
+        const ssize_t br = pread(r->logfd, dst, (size_t) len, pos);
+        if (br <= 0) {
+            fprintf(stderr, "%s: Failed to read from log: %s\n", GAppName, (br == 0) ? "end of file" : strerror(errno));
+            return 0;
+        }
+        dst += br;
+        pos += (off_t) br;
+        len -= (uint64) br;
+    }
+    return 1;
+}
+
+static void put_le32(uint8 *ptr, const uint32 val) { const uint32 x = swap32(val); memcpy(ptr, &x, sizeof (x)); }
+static void put_le64(uint8 *ptr, const uint64 val) { const uint64 x = swap64(val); memcpy(ptr, &x, sizeof (x)); }
+static uint32 get_le32(const uint8 *ptr) { uint32 x; memcpy(&x, ptr, sizeof (x)); return swap32(x); }
+static uint64 get_le64(const uint8 *ptr) { uint64 x; memcpy(&x, ptr, sizeof (x)); return swap64(x); }
+
+// A chunked tracefile (ALTRACE_CHUNKED) can be cut at every checkpoint that
+//  is followed by a chunk context, and each piece decoded from scratch, on
+//  its own reader. Chunks start at a checkpoint that says it's where it is,
+//  followed by a chunk context.
+static int is_chunk_start(const uint8 *map, const size_t maplen, const size_t pos)
+{
+    return ( ((maplen - pos) >= 40) &&
+             (get_le32(map + pos) == ALEE_CHECKPOINT) &&
+             (get_le64(map + pos + 8) == ALTRACE_CHECKPOINT_MAGIC) &&
+             (get_le64(map + pos + 24) == (uint64) pos) &&
+             (get_le32(map + pos + 36) == ALEE_CHUNK_CONTEXT) );
+}
+
+// memmem() isn't everywhere.
+static const uint8 *find_bytes(const uint8 *haystack, size_t len, const void *needle, const size_t needlelen)
+{
+    const uint8 first = *((const uint8 *) needle);
+    while (len >= needlelen) {
+        const uint8 *ptr = (const uint8 *) memchr(haystack, first, len - needlelen + 1);
+        if (!ptr) {
+            break;
+        } else if (memcmp(ptr, needle, needlelen) == 0) {
+            return ptr;
+        }
+        len -= (size_t) ((ptr + 1) - haystack);
+        haystack = ptr + 1;
+    }
+    return NULL;
+}
+
+// fills in (r->chunks) with where each chunk starts, and where the last one ends.
+static void find_chunks(TraceReader *r)
+{
+    const uint64 magic = swap64(ALTRACE_CHECKPOINT_MAGIC);
+    const uint8 *map = r->logmap;
+    const size_t maplen = r->logmaplen;
+    size_t start = 8;  // past the file header.
+    size_t pos = start;
+    void *ptr;
+
+    r->found_chunks = 1;
+    while (1) {
+        const uint8 *hit = find_bytes(map + pos, (pos < maplen) ? (maplen - pos) : 0, &magic, sizeof (magic));
+        const size_t end = hit ? ((size_t) (hit - map)) - 8 : maplen;
+        if (hit && ((end <= start) || !is_chunk_start(map, maplen, end))) {
+            pos = ((size_t) (hit - map)) + 1;
+            continue;
+        }
+
+        ptr = realloc(r->chunks, (r->numchunks + 2) * sizeof (off_t));
+        if (!ptr) {
+            out_of_memory();
+        }
+        r->chunks = (off_t *) ptr;
+        r->chunks[r->numchunks++] = (off_t) start;
+        r->chunks[r->numchunks] = (off_t) end;
+
+        if (!hit) {
+            break;
+        }
+        start = end;
+        pos = ((size_t) (hit - map)) + 1;
+    }
+}
 
+uint64 altrace_num_chunks(TraceReader *r)
+{
+    if (!r->logmap || r->borrowed_map) {
+        return 0;  // we need the whole file mapped to look for them.
+    } else if (!r->found_chunks) {
+        find_chunks(r);
+    }
+    return (r->numchunks < 2) ? 0 : r->numchunks;
+}
+
+// each chunk gets a reader of its own, starting from scratch; that's the point.
+TraceReader *altrace_open_chunk(TraceReader *whole, const uint64 chunknum)
+{
+    TraceReader *r;
+
+    if (chunknum >= altrace_num_chunks(whole)) {
+        return NULL;
+    }
+
+    r = new_reader();
+    r->logmap = whole->logmap;
+    r->logmaplen = whole->logmaplen;
+    r->logmappos = (size_t) whole->chunks[chunknum];
+    r->borrowed_map = 1;
+    r->format = whole->format;
+    r->chunk_end = whole->chunks[chunknum + 1];
+    return r;
+}
+
+// The sidecar index (filename.idx) notes where every event in a tracefile
+//  starts, so we can jump into the middle of it without decoding everything
+//  before. It's a header, then a fixed-size entry per event, then the log
+//  thread ids in the order playback numbers them, all little endian:
+//
+//  header: u32 magic, u32 version, u32 log format, u32 numthreads,
+//          u64 tracefile size, u64 tracefile mtime, u64 numevents
+//  entry:  u64 offset, u32 event id, u32 thread (0 if not a call), u32 ticks
+#define ALTRACE_INDEX_MAGIC 0x58444941  // "AIDX"
+#define ALTRACE_INDEX_VERSION 1
+#define ALTRACE_INDEX_HEADER_LEN 40
+#define ALTRACE_INDEX_ENTRY_LEN 20
+
+typedef struct TraceIndex
+{
+    const uint8 *map;
+    size_t maplen;
+    uint64 numevents;
+    uint32 numthreads;
+    const uint8 *entries;
+    const uint8 *threads;
+} TraceIndex;
+
+static void write_index_entry(TraceReader *r, const EventEnum ev)
+{
+    uint8 entry[ALTRACE_INDEX_ENTRY_LEN];
+    put_le64(entry, (uint64) r->event_offset);
+    put_le32(entry + 8, (uint32) ev);
+    put_le32(entry + 12, r->event_threadid);
+    put_le32(entry + 16, r->last_ticks);
+    if (fwrite(entry, sizeof (entry), 1, r->indexio) != 1) {
+        fprintf(stderr, "%s: Failed to write index: %s\n", GAppName, strerror(errno));
+        r->io_failure = 1;
+    }
+    r->index_numevents++;
+}
+
+static char *index_filename(const char *fname, const char *ext)
+{
+    const size_t len = strlen(fname) + strlen(ext) + 1;
+    char *retval = (char *) malloc(len);
+    if (!retval) {
+        out_of_memory();
+    }
+    snprintf(retval, len, "%s%s", fname, ext);
     return retval;
 }
 
+// Builds the index for (fname) in one pass over it. If the tracefile doesn't
+//  end cleanly, the index covers everything up to where it stopped decoding.
+int build_tracelog_index(const char *fname)
+{
+    char *idxname = index_filename(fname, ".idx");
+    char *tmpname = index_filename(fname, ".idx.tmp");
+    TraceReader *r = altrace_open(fname);
+    uint8 header[ALTRACE_INDEX_HEADER_LEN];
+    struct stat statbuf;
+    int complete = 0;
+    int okay = 0;
+    FILE *io = NULL;
+    uint32 i;
+
+    if (!r) {
+        free(idxname);
+        free(tmpname);
+        return 0;
+    }
+
+    if (fstat(r->logfd, &statbuf) == -1) {
+        fprintf(stderr, "%s: Failed to stat '%s': %s\n", GAppName, fname, strerror(errno));
+    } else if ((io = fopen(tmpname, "wb")) == NULL) {
+        fprintf(stderr, "%s: Failed to open '%s': %s\n", GAppName, tmpname, strerror(errno));
+    } else {
+        memset(header, '\0', sizeof (header));
+        if (fwrite(header, sizeof (header), 1, io) == 1) {  // placeholder until we know the counts.
+            r->indexio = io;
+            r->index_numevents = 0;
+            complete = validate_tracelog(r);
+            r->indexio = NULL;
+
+            okay = 1;
+            for (i = 0; okay && (i < r->index_numthreads); i++) {
+                uint8 buf[8];
+                put_le64(buf, r->index_threads[i]);
+                okay = (fwrite(buf, sizeof (buf), 1, io) == 1);
+            }
+
+            put_le32(header, ALTRACE_INDEX_MAGIC);
+            put_le32(header + 4, ALTRACE_INDEX_VERSION);
+            put_le32(header + 8, ALTRACE_LOG_FILE_FORMAT);
+            put_le32(header + 12, r->index_numthreads);
+            put_le64(header + 16, (uint64) statbuf.st_size);
+            put_le64(header + 24, (uint64) statbuf.st_mtime);
+            put_le64(header + 32, r->index_numevents);
+            okay = okay && (fseek(io, 0, SEEK_SET) == 0) && (fwrite(header, sizeof (header), 1, io) == 1);
+        }
+
+        if ((fclose(io) == EOF) || !okay) {
+            fprintf(stderr, "%s: Failed to write '%s': %s\n", GAppName, tmpname, strerror(errno));
+            okay = 0;
+        } else if (rename(tmpname, idxname) == -1) {
+            fprintf(stderr, "%s: Failed to rename '%s' to '%s': %s\n", GAppName, tmpname, idxname, strerror(errno));
+            okay = 0;
+        }
+
+        if (!okay) {
+            unlink(tmpname);
+        }
+    }
+
+    if (okay) {
+        fprintf(stderr, "%s: Indexed %llu events in '%s'%s.\n", GAppName, (unsigned long long) r->index_numevents, fname, complete ? "" : " (it didn't end cleanly, try --salvage)");
+    }
+
+    altrace_close(r);
+    free(idxname);
+    free(tmpname);
+    return okay;
+}
+
+static void close_tracelog_index(TraceIndex *idx)
+{
+    if (idx->map) {
+        munmap((void *) idx->map, idx->maplen);
+    }
+    memset(idx, '\0', sizeof (*idx));
+}
+
+// maps the index for (fname), if there is one that matches the tracefile.
+static int load_tracelog_index(const char *fname, TraceIndex *idx)
+{
+    char *idxname = index_filename(fname, ".idx");
+    struct stat logstat, idxstat;
+    const uint8 *ptr;
+    void *map = MAP_FAILED;
+    int fd = -1;
+
+    memset(idx, '\0', sizeof (*idx));
+
+    if ((stat(fname, &logstat) == -1) || ((fd = open(idxname, O_RDONLY)) == -1) || (fstat(fd, &idxstat) == -1)) {
+        // missing, we'll build it.
+    } else if (idxstat.st_size >= ALTRACE_INDEX_HEADER_LEN) {
+        map = mmap(NULL, (size_t) idxstat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    if (fd != -1) {
+        close(fd);
+    }
+    free(idxname);
+
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+
+    ptr = (const uint8 *) map;
+    idx->map = ptr;
+    idx->maplen = (size_t) idxstat.st_size;
+    idx->numthreads = get_le32(ptr + 12);
+    idx->numevents = get_le64(ptr + 32);
+    idx->entries = ptr + ALTRACE_INDEX_HEADER_LEN;
+    idx->threads = idx->entries + (idx->numevents * ALTRACE_INDEX_ENTRY_LEN);
+
+    if ( (get_le32(ptr) != ALTRACE_INDEX_MAGIC) ||
+         (get_le32(ptr + 4) != ALTRACE_INDEX_VERSION) ||
+         (get_le32(ptr + 8) != ALTRACE_LOG_FILE_FORMAT) ||
+         (get_le64(ptr + 16) != (uint64) logstat.st_size) ||
+         (get_le64(ptr + 24) != (uint64) logstat.st_mtime) ||
+         (idx->numevents > ((idx->maplen - ALTRACE_INDEX_HEADER_LEN) / ALTRACE_INDEX_ENTRY_LEN)) ||
+         ((ALTRACE_INDEX_HEADER_LEN + (idx->numevents * ALTRACE_INDEX_ENTRY_LEN) + (((uint64) idx->numthreads) * 8)) != (uint64) idx->maplen) ) {
+        close_tracelog_index(idx);  // stale or bogus, we'll rebuild it.
+        return 0;
+    }
+
+    return 1;
+}
+
+static int open_tracelog_index(const char *fname, TraceIndex *idx)
+{
+    if (load_tracelog_index(fname, idx)) {
+        return 1;
+    } else if (!build_tracelog_index(fname)) {
+        return 0;
+    } else if (!load_tracelog_index(fname, idx)) {
+        fprintf(stderr, "%s: Couldn't load the index we just built for '%s'.\n", GAppName, fname);
+        return 0;
+    }
+    return 1;
+}
+
+static uint64 index_offset(const TraceIndex *idx, const uint64 i) { return get_le64(idx->entries + (i * ALTRACE_INDEX_ENTRY_LEN)); }
+static EventEnum index_event(const TraceIndex *idx, const uint64 i) { return (EventEnum) get_le32(idx->entries + (i * ALTRACE_INDEX_ENTRY_LEN) + 8); }
+static uint32 index_ticks(const TraceIndex *idx, const uint64 i) { return get_le32(idx->entries + (i * ALTRACE_INDEX_ENTRY_LEN) + 16); }
+
+// Start over at event (eventnum). Rather than decode everything before it,
+//  we replay just the events that set up names and labels, then decode
+//  (without handing anything out) from the last checkpoint, since motion
+//  mode restarts its channels there.
+static int seek_from_index(TraceReader *r, const TraceIndex *idx, const uint64 eventnum)
+{
+    uint64 checkpoint = eventnum;
+    uint64 i;
+
+    if (eventnum >= idx->numevents) {
+        fprintf(stderr, "%s: '%s' only has %llu events.\n", GAppName, r->filename, (unsigned long long) idx->numevents);
+        return 0;
+    }
+
+    forget_decoder_state(r);
+
+    for (i = 0; i < idx->numthreads; i++) {  // number threads the same as a full run would.
+        add_threadid_to_map(&r->threadid_map, get_le64(idx->threads + (i * 8)), (uint32) (i + 1));
+    }
+    r->next_mapped_threadid = idx->numthreads;
+
+    while ((checkpoint > 0) && (index_event(idx, checkpoint) != ALEE_CHECKPOINT)) {
+        checkpoint--;
+    }
+
+    r->validating = 1;
+    for (i = 0; (i < checkpoint) && !r->io_failure; i++) {
+        const EventEnum ev = index_event(idx, i);
+        if (is_context_event(ev)) {
+            start_event(r);
+            r->event_offset = (off_t) index_offset(idx, i);
+            if (!seek(r, r->event_offset) || (IO_RECORD(r) != ev) || !decode_record(r, ev)) {
+                r->io_failure = 1;
+            }
+        }
+    }
+    r->validating = 0;
+
+    r->event_offset = (off_t) index_offset(idx, checkpoint);
+    if (r->io_failure || !seek(r, r->event_offset)) {
+        fprintf(stderr, "%s: Index doesn't match '%s' at offset %llu, try rebuilding it with --index.\n", GAppName, r->filename, (unsigned long long) r->event_offset);
+        r->io_failure = 1;  // we've lost our place, so the reader is done.
+        return 0;
+    }
+
+    r->events_to_skip = eventnum - checkpoint;
+    return 1;
+}
+
+static int open_reader_index(TraceReader *r, TraceIndex *idx)
+{
+    if (!r->filename) {
+        fprintf(stderr, "%s: Can only seek in a tracefile.\n", GAppName);
+        return 0;
+    }
+    return open_tracelog_index(r->filename, idx);
+}
+
+int altrace_seek_event(TraceReader *r, const uint64 eventnum)
+{
+    TraceIndex idx;
+    int retval;
+    if (!open_reader_index(r, &idx)) {
+        return 0;
+    }
+    retval = seek_from_index(r, &idx, eventnum);
+    close_tracelog_index(&idx);
+    return retval;
+}
+
+// (ticks) is milliseconds since the recording started, like CallerInfo::wait_until.
+int altrace_seek_time(TraceReader *r, const uint32 ticks)
+{
+    TraceIndex idx;
+    uint64 lo, hi;
+    int retval;
+
+    if (!open_reader_index(r, &idx)) {
+        return 0;
+    }
+
+    // events are recorded in order under the API lock, so ticks never go
+    //  backwards; find the first event at or after (ticks).
+    lo = 0;
+    hi = idx.numevents;
+    while (lo < hi) {
+        const uint64 mid = lo + ((hi - lo) / 2);
+        if (index_ticks(&idx, mid) < ticks) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    retval = seek_from_index(r, &idx, lo);
+    close_tracelog_index(&idx);
+    return retval;
+}
+
+// Scan backwards from the end of the file for the last checkpoint that is
+//  where it says it is. Returns the offset of the checkpoint event, or -1.
+static off_t find_last_checkpoint(TraceReader *r, const off_t fdsize, uint64 *_eventcount)
+{
+    const off_t headerlen = 8;
+    const size_t recordlen = 4 + 4 + 8 + 8 + 8;  // event id, length, magic, event count, offset.
+    const size_t buflen = 256 * 1024;
+    uint8 *buf = (uint8 *) malloc(buflen);
+    off_t retval = -1;
+    off_t end = fdsize;
+
+    if (!buf) {
+        out_of_memory();
+    }
+
+    while ((end - headerlen) >= (off_t) recordlen) {
+        const off_t start = ((end - headerlen) > (off_t) buflen) ? (end - (off_t) buflen) : headerlen;
+        const size_t len = (size_t) (end - start);
+        size_t i;
+
+        if (pread(r->logfd, buf, len, start) != (ssize_t) len) {
+            fprintf(stderr, "%s: Failed to read from log: %s\n", GAppName, strerror(errno));
+            break;
+        }
+
+        for (i = len - recordlen + 1; i > 0; i--) {
+            const uint8 *ptr = buf + (i - 1);
+            uint32 eventid;
+            uint64 magic, eventcount, offset;
+            memcpy(&eventid, ptr, 4);
+            memcpy(&magic, ptr + 8, 8);
+            memcpy(&eventcount, ptr + 16, 8);
+            memcpy(&offset, ptr + 24, 8);
+            if ( (swap32(eventid) == ALEE_CHECKPOINT) &&
+                 (swap64(magic) == ALTRACE_CHECKPOINT_MAGIC) &&
+                 (swap64(offset) == (uint64) (start + (off_t) (i - 1))) ) {
+                *_eventcount = swap64(eventcount);
+                retval = start + (off_t) (i - 1);
+                break;
+            }
+        }
+
+        if (retval != -1) {
+            break;
+        }
+
+        end = start + (off_t) (recordlen - 1);  // overlap, in case a record straddles the two reads.
+        if (start == headerlen) {
+            break;
+        }
+    }
+
+    free(buf);
+    return retval;
+}
+
+// Make a usable copy of a tracefile that didn't get a proper ending (the app
+//  crashed, etc): find the last checkpoint, make sure every event after it
+//  decodes, and write out everything up to the first one that doesn't,
+//  followed by an EOS. Anything before the last checkpoint is trusted as-is,
+//  so this doesn't have to parse the whole file.
+int salvage_tracelog(const char *fname, const char *outfname)
+{
+    const size_t buflen = 1024 * 1024;
+    TraceReader *r = altrace_open(fname);
+    uint8 *buf;
+    struct stat instat, outstat;
+    uint64 eventcount = 0;
+    off_t fdsize, checkpoint, goodlen, pos;
+    uint32 eos[3];
+    int complete;
+    int outfd;
+
+    if (!r) {
+        return 0;
+    }
+
+    if ((fstat(r->logfd, &instat) == 0) && (stat(outfname, &outstat) == 0) &&
+        (instat.st_dev == outstat.st_dev) && (instat.st_ino == outstat.st_ino)) {
+        fprintf(stderr, "%s: Salvaged tracefile needs to go somewhere other than '%s'.\n", GAppName, fname);
+        altrace_close(r);
+        return 0;
+    }
+
+    fdsize = r->logmap ? (off_t) r->logmaplen : lseek(r->logfd, 0, SEEK_END);
+    checkpoint = (fdsize == -1) ? -1 : find_last_checkpoint(r, fdsize, &eventcount);
+    if (checkpoint == -1) {
+        fprintf(stderr, "%s: No usable checkpoints in '%s', checking the whole file.\n", GAppName, fname);
+    }
+
+    if (!seek(r, (checkpoint == -1) ? 8 : checkpoint)) {
+        fprintf(stderr, "%s: Failed to seek in file: %s\n", GAppName, strerror(errno));
+        altrace_close(r);
+        return 0;
+    }
+
+    complete = validate_tracelog(r);
+    goodlen = r->event_offset;  // start of the EOS, or of the first event that didn't decode.
+
+    outfd = open(outfname, O_WRONLY | O_TRUNC | O_CREAT, 0644);
+    if (outfd == -1) {
+        fprintf(stderr, "%s: Failed to open '%s': %s\n", GAppName, outfname, strerror(errno));
+        altrace_close(r);
+        return 0;
+    }
+
+    buf = (uint8 *) malloc(buflen);
+    if (!buf) {
+        out_of_memory();
+    }
+
+    for (pos = 0; pos < goodlen; ) {
+        const size_t len = ((goodlen - pos) < (off_t) buflen) ? (size_t) (goodlen - pos) : buflen;
+        if ((pread(r->logfd, buf, len, pos) != (ssize_t) len) || (write(outfd, buf, len) != (ssize_t) len)) {
+            break;
+        }
+        pos += (off_t) len;
+    }
+
+    free(buf);
+
+    eos[0] = swap32((uint32) ALEE_EOS);
+    eos[1] = swap32(4);  // its length.
+    eos[2] = swap32(r->last_ticks);
+    if ((pos != goodlen) || (write(outfd, eos, sizeof (eos)) != (ssize_t) sizeof (eos)) || (close(outfd) == -1)) {
+        fprintf(stderr, "%s: Failed to write '%s': %s\n", GAppName, outfname, strerror(errno));
+        altrace_close(r);
+        return 0;
+    }
+
+    if (complete) {
+        fprintf(stderr, "%s: '%s' was already complete, copied it as-is.\n", GAppName, fname);
+    } else if (checkpoint == -1) {
+        fprintf(stderr, "%s: Salvaged %llu of %llu bytes.\n", GAppName, (unsigned long long) goodlen, (unsigned long long) fdsize);
+    } else {
+        fprintf(stderr, "%s: Salvaged %llu of %llu bytes (checked from a checkpoint after %llu calls).\n", GAppName, (unsigned long long) goodlen, (unsigned long long) fdsize, (unsigned long long) eventcount);
+    }
+
+    altrace_close(r);
+    return 1;
+}
+
 // end of altrace_playback.c ...
 
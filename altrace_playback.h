@@ -38,18 +38,25 @@ typedef struct CallerInfo
     uint32 wait_until;
     off_t fdoffset;
     void *userdata;
+    int has_sched_context;  // rest of these are only valid if this is non-zero.
+    uint32 cpu;  // 0xFFFFFFFF if unknown.
+    uint32 sched_policy;
+    uint32 sched_priority;
+    uint32 voluntary_csw;
+    uint32 involuntary_csw;
 } CallerInfo;
 
-MAP_DECL(device, ALCdevice *, ALCdevice *);
-MAP_DECL(context, ALCcontext *, ALCcontext *);
-MAP_DECL(devicelabel, ALCdevice *, char *);
-MAP_DECL(contextlabel, ALCcontext *, char *);
-MAP_DECL(source, ALuint, ALuint);
-MAP_DECL(buffer, ALuint, ALuint);
-MAP_DECL(sourcelabel, ALuint, char *);
-MAP_DECL(bufferlabel, ALuint, char *);
-MAP_DECL(stackframe, void *, char *);
-MAP_DECL(threadid, uint64, uint32);
+// Audio data (alBufferData's upload, what alcCaptureSamples got back) isn't
+//  read in while decoding; visitors get one of these, and can pull the data
+//  in with altrace_blob_map() or altrace_blob_read() if they want it. A NULL
+//  TraceBlob means the app passed a NULL pointer.
+typedef struct TraceBlob
+{
+    off_t offset;  // where the data starts in the tracefile.
+    uint64 len;  // in bytes.
+    uint64 hash;  // hash_blob() of the data, to tell uploads apart without reading them. 0 if unknown.
+    const void *data;  // where it already is in memory, if it is, until the next event. Otherwise NULL.
+} TraceBlob;
 
 #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) void visit_##name visitparams;
 #include "altrace_entrypoints.h"
@@ -60,15 +67,24 @@ void visit_device_state_changed_int(void *userdata, ALCdevice *dev, const ALCenu
 void visit_context_state_changed_enum(void *userdata, ALCcontext *ctx, const ALenum param, const ALenum newval);
 void visit_context_state_changed_float(void *userdata, ALCcontext *ctx, const ALenum param, const ALfloat newval);
 void visit_context_state_changed_string(void *userdata, ALCcontext *ctx, const ALenum param, const ALchar *str);
+void visit_context_attributes(void *userdata, ALCcontext *ctx, const uint32 numattrs, const ALCint *attrs);
 void visit_listener_state_changed_floatv(void *userdata, ALCcontext *ctx, const ALenum param, const uint32 numfloats, const ALfloat *values);
-void visit_source_state_changed_bool(void *userdata, const ALuint name, const ALenum param, const ALboolean newval);
-void visit_source_state_changed_enum(void *userdata, const ALuint name, const ALenum param, const ALenum newval);
-void visit_source_state_changed_int(void *userdata, const ALuint name, const ALenum param, const ALint newval);
-void visit_source_state_changed_uint(void *userdata, const ALuint name, const ALenum param, const ALuint newval);
-void visit_source_state_changed_float(void *userdata, const ALuint name, const ALenum param, const ALfloat newval);
-void visit_source_state_changed_float3(void *userdata, const ALuint name, const ALenum param, const ALfloat newval1, const ALfloat newval2, const ALfloat newval3);
+void visit_source_state_changed_bool(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALboolean newval);
+void visit_source_state_changed_enum(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALenum newval);
+void visit_source_state_changed_int(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALint newval);
+void visit_source_state_changed_uint(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALuint newval);
+void visit_source_state_changed_float(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat newval);
+void visit_source_state_changed_float3(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat newval1, const ALfloat newval2, const ALfloat newval3);
 void visit_buffer_state_changed_int(void *userdata, const ALuint name, const ALenum param, const ALint newval);
+void visit_process_forked(void *userdata, const uint32 ticks, const uint32 parentpid, const uint32 childpid, const char *parentfile, const uint64 parentoffset);
+void visit_checkpoint(void *userdata, const uint64 eventcount, const uint64 offset, const uint32 ticks);
+void visit_perf_counters(void *userdata, const uint32 kind, const uint64 value1, const uint64 value2);
+void visit_resource_sample(void *userdata, const uint32 ticks, const uint64 rss, const uint64 usertime, const uint64 systime, const uint32 threads, const uint32 openal_threads);
+void visit_device_clock_latency(void *userdata, ALCdevice *device, const uint32 ticks, const int64 clock, const int64 latency);
+void visit_source_latency(void *userdata, ALCcontext *ctx, const ALuint name, const int64 offset, const int64 latency);
 void visit_eos(void *userdata, const ALboolean okay, const uint32 wait_until);
+void *visit_chunk_begin(void *userdata, const uint64 chunknum);  // process_tracelog_parallel() only; runs on a decoding thread.
+void visit_chunk_end(void *userdata, void *chunkdata, const ALboolean keep);  // ...and this runs in chunk order, on the calling thread.
 int visit_progress(void *userdata, const off_t current, const off_t total);
 
 const char *alcboolString(const ALCboolean x);
@@ -76,13 +92,195 @@ const char *alboolString(const ALCboolean x);
 const char *alcenumString(const ALCenum x);
 const char *alenumString(const ALCenum x);
 const char *litString(const char *str);
+const char *schedPolicyString(const uint32 policy);
 const char *ptrString(const void *ptr);
 const char *ctxString(ALCcontext *ctx);
 const char *deviceString(ALCdevice *device);
 const char *sourceString(const ALuint name);
 const char *bufferString(const ALuint name);
+const char *zoneString(const ALuint zone);
+const char *counterString(const ALuint counter);
+const char *counterName(const ALuint counter);  // what it was registered as, NULL if nothing.
+
+// A TraceReader is a tracefile (or live stream) being decoded, and everything
+//  decoding has learned from it so far, so you can have as many going at
+//  once as you like, even on different threads. The *String() functions
+//  above use whatever the last reader to hand out an event on the calling
+//  thread knows.
+typedef struct TraceReader TraceReader;
+TraceReader *altrace_open(const char *filename);
+TraceReader *altrace_attach(const char *shmname);  // live trace from a process recording with ALTRACE_SHM set.
+void altrace_close(TraceReader *reader);
+
+// You can pull events out of a reader one at a time with altrace_next_event()
+//  instead of having them pushed at the visit_*() functions. It returns zero
+//  when there's nothing left; the last event is always an ALEE_EOS, whose
+//  (okay) says if the trace ended cleanly. (type) says which part of (u) is
+//  filled in: calls have their entry point's ALEE_* and the same arguments
+//  their visitor gets, and the rest are noted below. The event, and anything
+//  it points to, is only good until the next one.
+#define ALTRACE_NARGS(...) ALTRACE_NARGS_(__VA_ARGS__, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define ALTRACE_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, n, ...) n
+#define ALTRACE_CAT(a, b) ALTRACE_CAT_(a, b)
+#define ALTRACE_CAT_(a, b) a##b
+#define ALTRACE_UNPAREN(...) __VA_ARGS__
+
+// ALTRACE_FIELDS(int a, float b) is "int a; float b;"
+#define ALTRACE_FIELDS(...) ALTRACE_CAT(ALTRACE_FIELDS_, ALTRACE_NARGS(__VA_ARGS__))(__VA_ARGS__)
+#define ALTRACE_FIELDS_1(a) a;
+#define ALTRACE_FIELDS_2(a, ...) a; ALTRACE_FIELDS_1(__VA_ARGS__)
+#define ALTRACE_FIELDS_3(a, ...) a; ALTRACE_FIELDS_2(__VA_ARGS__)
+#define ALTRACE_FIELDS_4(a, ...) a; ALTRACE_FIELDS_3(__VA_ARGS__)
+#define ALTRACE_FIELDS_5(a, ...) a; ALTRACE_FIELDS_4(__VA_ARGS__)
+#define ALTRACE_FIELDS_6(a, ...) a; ALTRACE_FIELDS_5(__VA_ARGS__)
+#define ALTRACE_FIELDS_7(a, ...) a; ALTRACE_FIELDS_6(__VA_ARGS__)
+#define ALTRACE_FIELDS_8(a, ...) a; ALTRACE_FIELDS_7(__VA_ARGS__)
+#define ALTRACE_FIELDS_9(a, ...) a; ALTRACE_FIELDS_8(__VA_ARGS__)
+#define ALTRACE_FIELDS_10(a, ...) a; ALTRACE_FIELDS_9(__VA_ARGS__)
+#define ALTRACE_FIELDS_11(a, ...) a; ALTRACE_FIELDS_10(__VA_ARGS__)
+#define ALTRACE_FIELDS_12(a, ...) a; ALTRACE_FIELDS_11(__VA_ARGS__)
+
+// ALTRACE_MEMBERS(p, a, b) is "p->a, p->b"
+#define ALTRACE_MEMBERS(p, ...) ALTRACE_CAT(ALTRACE_MEMBERS_, ALTRACE_NARGS(__VA_ARGS__))(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_1(p, a) p->a
+#define ALTRACE_MEMBERS_2(p, a, ...) p->a, ALTRACE_MEMBERS_1(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_3(p, a, ...) p->a, ALTRACE_MEMBERS_2(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_4(p, a, ...) p->a, ALTRACE_MEMBERS_3(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_5(p, a, ...) p->a, ALTRACE_MEMBERS_4(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_6(p, a, ...) p->a, ALTRACE_MEMBERS_5(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_7(p, a, ...) p->a, ALTRACE_MEMBERS_6(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_8(p, a, ...) p->a, ALTRACE_MEMBERS_7(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_9(p, a, ...) p->a, ALTRACE_MEMBERS_8(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_10(p, a, ...) p->a, ALTRACE_MEMBERS_9(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_11(p, a, ...) p->a, ALTRACE_MEMBERS_10(p, __VA_ARGS__)
+#define ALTRACE_MEMBERS_12(p, a, ...) p->a, ALTRACE_MEMBERS_11(p, __VA_ARGS__)
+
+#define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) typedef struct TraceArgs_##name { ALTRACE_FIELDS visitparams } TraceArgs_##name;
+#include "altrace_entrypoints.h"
+
+typedef struct TraceArgs_al_error_event { ALenum err; } TraceArgs_al_error_event;
+typedef struct TraceArgs_alc_error_event { ALCdevice *device; ALCenum err; } TraceArgs_alc_error_event;
+typedef struct TraceArgs_device_state_changed_int { ALCdevice *dev; ALCenum param; ALCint newval; } TraceArgs_device_state_changed_int;
+typedef struct TraceArgs_context_state_changed_enum { ALCcontext *ctx; ALenum param; ALenum newval; } TraceArgs_context_state_changed_enum;
+typedef struct TraceArgs_context_state_changed_float { ALCcontext *ctx; ALenum param; ALfloat newval; } TraceArgs_context_state_changed_float;
+typedef struct TraceArgs_context_state_changed_string { ALCcontext *ctx; ALenum param; const ALchar *str; } TraceArgs_context_state_changed_string;
+typedef struct TraceArgs_context_attributes { ALCcontext *ctx; uint32 numattrs; const ALCint *attrs; } TraceArgs_context_attributes;
+typedef struct TraceArgs_listener_state_changed_floatv { ALCcontext *ctx; ALenum param; uint32 numfloats; const ALfloat *values; } TraceArgs_listener_state_changed_floatv;
+typedef struct TraceArgs_source_state_changed_bool { ALCcontext *ctx; ALuint name; ALenum param; ALboolean newval; } TraceArgs_source_state_changed_bool;
+typedef struct TraceArgs_source_state_changed_enum { ALCcontext *ctx; ALuint name; ALenum param; ALenum newval; } TraceArgs_source_state_changed_enum;
+typedef struct TraceArgs_source_state_changed_int { ALCcontext *ctx; ALuint name; ALenum param; ALint newval; } TraceArgs_source_state_changed_int;
+typedef struct TraceArgs_source_state_changed_uint { ALCcontext *ctx; ALuint name; ALenum param; ALuint newval; } TraceArgs_source_state_changed_uint;
+typedef struct TraceArgs_source_state_changed_float { ALCcontext *ctx; ALuint name; ALenum param; ALfloat newval; } TraceArgs_source_state_changed_float;
+typedef struct TraceArgs_source_state_changed_float3 { ALCcontext *ctx; ALuint name; ALenum param; ALfloat newval1; ALfloat newval2; ALfloat newval3; } TraceArgs_source_state_changed_float3;
+typedef struct TraceArgs_buffer_state_changed_int { ALuint name; ALenum param; ALint newval; } TraceArgs_buffer_state_changed_int;
+typedef struct TraceArgs_process_forked { uint32 ticks; uint32 parentpid; uint32 childpid; const char *parentfile; uint64 parentoffset; } TraceArgs_process_forked;
+typedef struct TraceArgs_checkpoint { uint64 eventcount; uint64 offset; uint32 ticks; } TraceArgs_checkpoint;
+typedef struct TraceArgs_perf_counters { uint32 kind; uint64 value1; uint64 value2; } TraceArgs_perf_counters;
+typedef struct TraceArgs_resource_sample { uint32 ticks; uint64 rss; uint64 usertime; uint64 systime; uint32 threads; uint32 openal_threads; } TraceArgs_resource_sample;
+typedef struct TraceArgs_device_clock_latency { ALCdevice *device; uint32 ticks; int64 clock; int64 latency; } TraceArgs_device_clock_latency;
+typedef struct TraceArgs_source_latency { ALCcontext *ctx; ALuint name; int64 offset; int64 latency; } TraceArgs_source_latency;
+typedef struct TraceArgs_eos { ALboolean okay; uint32 wait_until; } TraceArgs_eos;
+
+typedef struct TraceEvent
+{
+    EventEnum type;
+    off_t offset;  // where its record starts in the tracefile.
+    CallerInfo callerinfo;  // calls only; their (callerinfo) points here.
+    union
+    {
+        #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) TraceArgs_##name name;
+        #include "altrace_entrypoints.h"
+        TraceArgs_al_error_event al_error_event;  // ALEE_ALERROR_TRIGGERED
+        TraceArgs_alc_error_event alc_error_event;  // ALEE_ALCERROR_TRIGGERED
+        TraceArgs_device_state_changed_int device_state_changed_int;  // ALEE_DEVICE_STATE_CHANGED_INT
+        TraceArgs_context_state_changed_enum context_state_changed_enum;  // ALEE_CONTEXT_STATE_CHANGED_ENUM
+        TraceArgs_context_state_changed_float context_state_changed_float;  // ALEE_CONTEXT_STATE_CHANGED_FLOAT
+        TraceArgs_context_state_changed_string context_state_changed_string;  // ALEE_CONTEXT_STATE_CHANGED_STRING
+        TraceArgs_context_attributes context_attributes;  // ALEE_CONTEXT_ATTRIBUTES
+        TraceArgs_listener_state_changed_floatv listener_state_changed_floatv;  // ALEE_LISTENER_STATE_CHANGED_FLOATV
+        TraceArgs_source_state_changed_bool source_state_changed_bool;  // ALEE_SOURCE_STATE_CHANGED_BOOL
+        TraceArgs_source_state_changed_enum source_state_changed_enum;  // ALEE_SOURCE_STATE_CHANGED_ENUM
+        TraceArgs_source_state_changed_int source_state_changed_int;  // ALEE_SOURCE_STATE_CHANGED_INT
+        TraceArgs_source_state_changed_uint source_state_changed_uint;  // ALEE_SOURCE_STATE_CHANGED_UINT
+        TraceArgs_source_state_changed_float source_state_changed_float;  // ALEE_SOURCE_STATE_CHANGED_FLOAT
+        TraceArgs_source_state_changed_float3 source_state_changed_float3;  // ALEE_SOURCE_STATE_CHANGED_FLOAT3
+        TraceArgs_buffer_state_changed_int buffer_state_changed_int;  // ALEE_BUFFER_STATE_CHANGED_INT
+        TraceArgs_process_forked process_forked;  // ALEE_PROCESS_FORKED
+        TraceArgs_checkpoint checkpoint;  // ALEE_CHECKPOINT
+        TraceArgs_perf_counters perf_counters;  // ALEE_PERF_COUNTERS
+        TraceArgs_resource_sample resource_sample;  // ALEE_RESOURCE_SAMPLE
+        TraceArgs_device_clock_latency device_clock_latency;  // ALEE_DEVICE_CLOCK_LATENCY
+        TraceArgs_source_latency source_latency;  // ALEE_SOURCE_LATENCY
+        TraceArgs_eos eos;  // ALEE_EOS
+    } u;
+} TraceEvent;
+
+int altrace_next_event(TraceReader *reader, TraceEvent **event);
+off_t altrace_size(TraceReader *reader);  // bytes in the trace so far; a live one keeps growing.
+off_t altrace_tell(TraceReader *reader);  // where the next event's record starts.
+
+// Events you say you don't want (all of them are wanted to start with)
+//  aren't handed out, and most are stepped over without being decoded at
+//  all, so a reader that only wants a few kinds of event only has to touch
+//  those. Events that change what the reader knows about the rest of the
+//  trace, like labels and deletes, still get decoded.
+void altrace_want_event(TraceReader *reader, const EventEnum type, const int wanted);
+
+// These fetch a TraceBlob's data. altrace_blob_map() hands back a pointer
+//  that's good until the next event (or until the reader is closed, for a
+//  memory-mapped tracefile), or NULL on error. altrace_blob_read() copies
+//  (blob->len) bytes into (buf) and returns non-zero on success. A reader
+//  of the same tracefile opened later can fetch them too, but a live trace
+//  can only fetch the current event's blobs.
+const void *altrace_blob_map(TraceReader *reader, const TraceBlob *blob);
+int altrace_blob_read(TraceReader *reader, const TraceBlob *blob, void *buf);
+
+// these use (and build, if needed) a sidecar index, filename.idx, to start
+//  over at an event (or a point in time, milliseconds since recording
+//  started), as if everything before it was read but not handed out.
+int altrace_seek_event(TraceReader *reader, const uint64 eventnum);
+int altrace_seek_time(TraceReader *reader, const uint32 ticks);
 
+// A chunked tracefile (ALTRACE_CHUNKED) can be cut at its checkpoints, and
+//  each piece read by a reader of its own, on any thread, without reading
+//  anything before it. Close the chunks' readers before the whole one's.
+uint64 altrace_num_chunks(TraceReader *reader);  // 0 if it can't be cut up.
+TraceReader *altrace_open_chunk(TraceReader *reader, const uint64 chunknum);
+
+// To hand events to another thread, copy them out with altrace_copy_event(),
+//  after telling the reader to altrace_keep_events(): then what they point
+//  to piles up in the reader, instead of going away with the next event,
+//  until altrace_take_events() moves it all into (arena), for you to
+//  arena_free() when you're done with those events. Callstack symbols last
+//  as long as the reader does. Labels are another matter, since they can
+//  change from one event to the next: altrace_snapshot_labels() is a copy of
+//  them as of the last event handed out (the same copy, if nothing changed
+//  since last time), and altrace_use_labels() has the *String() functions
+//  on the calling thread look there, instead of in the reader they were
+//  last visiting. Pass NULL to go back.
+typedef struct TraceLabels TraceLabels;
+void altrace_keep_events(TraceReader *reader, const int keep);
+void altrace_take_events(TraceReader *reader, Arena *arena);
+void altrace_copy_event(TraceEvent *dst, const TraceEvent *src);
+TraceLabels *altrace_snapshot_labels(TraceReader *reader);
+void altrace_free_labels(TraceLabels *labels);
+void altrace_use_labels(TraceLabels *labels);
+
+// Or have a reader's events pushed at the visit_*() functions, which you
+//  have to write. This returns 1 if it got to the end cleanly, -1 if
+//  visit_progress() cancelled it, 0 otherwise. (altrace_visit.c)
+int altrace_process(TraceReader *reader, void *userdata);
+void altrace_visit_event(TraceEvent *event, void *userdata);  // just the one.
+
+// these open a reader, process it, and close it.
 int process_tracelog(const char *filename, void *userdata);
+int process_shm_tracelog(const char *shmname, void *userdata);
+int process_tracelog_parallel(const char *filename, void *userdata, const int numthreads);  // chunked (ALTRACE_CHUNKED) traces only; otherwise it's process_tracelog().
+int process_tracelog_from_event(const char *filename, void *userdata, const uint64 eventnum);
+int process_tracelog_from_time(const char *filename, void *userdata, const uint32 ticks);
+
+int salvage_tracelog(const char *filename, const char *outfilename);
+int build_tracelog_index(const char *filename);
 
 #ifdef __cplusplus
 }
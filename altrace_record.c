@@ -6,6 +6,10 @@
  *  This file written by Ryan C. Gordon.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE 1  // for O_DIRECT, sched_getcpu() and RUSAGE_THREAD
+#endif
+
 #ifdef __linux__
 #include <execinfo.h>
 #endif
@@ -31,6 +35,26 @@ const char *GAppName = "altrace_record";
 
 #include "altrace_common.h"
 
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <poll.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+#ifdef ALTRACE_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#endif
+
 // not in the headers, natch.
 AL_API void AL_APIENTRY alTracePushScope(const ALchar *str);
 AL_API void AL_APIENTRY alTracePopScope(void);
@@ -39,13 +63,74 @@ AL_API void AL_APIENTRY alTraceBufferLabel(ALuint name, const ALchar *str);
 AL_API void AL_APIENTRY alTraceSourceLabel(ALuint name, const ALchar *str);
 AL_API void AL_APIENTRY alcTraceDeviceLabel(ALCdevice *device, const ALCchar *str);
 AL_API void AL_APIENTRY alcTraceContextLabel(ALCcontext *ctx, const ALCchar *str);
+AL_API ALuint AL_APIENTRY alTraceRegisterZone(const ALchar *str);
+AL_API void AL_APIENTRY alTraceZoneBegin(ALuint zone);
+AL_API void AL_APIENTRY alTraceZoneEnd(ALuint zone);
+AL_API void AL_APIENTRY alTraceFrameMark(void);
+AL_API ALuint AL_APIENTRY alTraceRegisterCounter(const ALchar *str);
+AL_API void AL_APIENTRY alTraceCounter(ALuint counter, ALdouble value);
 
 
 static int logfd = -1;
+static uint64 logbytes = 0;  // total written to logfd so far.
+static char *logfilename = NULL;
+static const char *procname = NULL;
+static ShmRing *shmring = NULL;
+static uint64 eventcount = 0;  // API calls recorded so far.
+static uint32 checkpoint_interval = 0;
+static int chunked = 0;  // ALTRACE_CHUNKED: each checkpoint starts a chunk that can be decoded on its own.
+static uint32 latency_sample_interval = 100;  // milliseconds between device clock/source latency samples.
+static uint32 latency_last_sample = 0;
+static int fork_locked = 0;
+static uint64 fork_parent_offset = 0;
+static double motion_quantum = 0.0;  // non-zero if recording in motion mode.
+static uint32 motion_generation = 1;  // bumped whenever the stream needs motion channels redefined.
+
+// Live metrics (ALTRACE_METRICS), see metrics_init(). These only change with
+//  the API lock held, so they don't need a locked add; the atomics just keep
+//  the server thread from seeing a torn value when it reads them.
+typedef struct Metrics
+{
+    uint64 calls[ALEE_MAX];
+    uint64 al_errors;
+    uint64 alc_errors;
+    uint64 upload_bytes;
+    uint64 overhead_ns;
+    uint64 trace_bytes;
+} Metrics;
+
+static int metrics_enabled = 0;
+static Metrics metrics;
+static uint64 metrics_call_start = 0;
+static __thread uint64 metrics_real_start = 0;  // thread-local, since alGen* call in before taking the API lock.
+static __thread uint64 metrics_real_ns = 0;
+
+static inline void metric_add(uint64 *metric, const uint64 amount)
+{
+    __atomic_store_n(metric, __atomic_load_n(metric, __ATOMIC_RELAXED) + amount, __ATOMIC_RELAXED);
+}
 
 static pthread_mutex_t _apilock;
 static pthread_mutex_t *apilock;
 
+// a stream of 3D updates to one source or listener parameter, for motion
+//  mode (ALTRACE_MOTION); see record_motion().
+typedef struct MotionChannel
+{
+    uint32 id;  // 0 until first used.
+    uint32 generation;  // if this isn't motion_generation, the stream needs the channel defined again.
+    uint32 target;  // ALTRACE_MOTION_SOURCE or ALTRACE_MOTION_LISTENER
+    ALCcontext *ctx;
+    ALuint name;
+    ALenum param;
+    uint32 numvals;
+    int64 quantized[6];  // last value written, in units of motion_quantum.
+    ALfloat pending[6];  // per-frame mode: the latest value, not written yet.
+    uint64 pending_threadid;
+    int dirty;
+    int queued;
+} MotionChannel;
+
 typedef struct BufferWrapper
 {
     ALuint name;
@@ -57,8 +142,11 @@ typedef struct BufferWrapper
     struct BufferWrapper *hash_next;  /* next item in same hash bucket. */
 } BufferWrapper;
 
+struct ContextWrapper;
+
 typedef struct SourceWrapper
 {
+    struct ContextWrapper *ctx;
     ALuint name;
     ALenum state;
     ALenum type;
@@ -83,14 +171,14 @@ typedef struct SourceWrapper
     ALfloat position[3];
     ALfloat velocity[3];
     ALfloat direction[3];
+    MotionChannel motion_position;
+    MotionChannel motion_velocity;
     struct SourceWrapper *playlist_next;
     struct SourceWrapper *playlist_prev;
     struct SourceWrapper *hash_prev;  /* previous item in same hash bucket. */
     struct SourceWrapper *hash_next;  /* next item in same hash bucket. */
 } SourceWrapper;
 
-struct ContextWrapper;
-
 typedef struct DeviceWrapper
 {
     ALCdevice *device;
@@ -98,6 +186,7 @@ typedef struct DeviceWrapper
     ALCboolean iscapture;
     ALCboolean connected;
     ALCboolean supports_disconnect_ext;
+    void (*alcGetInteger64vSOFT)(ALCdevice *, ALCenum, ALsizei, int64 *);  // non-NULL if ALC_SOFT_device_clock is supported.
     ALCint capture_samples;
     int samplesize;   /* size of a capture device sample in bytes */
     char *extension_string;
@@ -114,6 +203,7 @@ typedef struct ContextWrapper
     char *extension_string;
     ALenum errorlatch;
     ALboolean checked_static_state;
+    void (*alGetSourcei64vSOFT)(ALuint, ALenum, int64 *);  // non-NULL if AL_SOFT_source_latency is supported.
     SourceWrapper *wrapped_source_hash[256];
     ALenum distance_model;
     ALfloat doppler_factor;
@@ -123,6 +213,9 @@ typedef struct ContextWrapper
     ALfloat listener_velocity[3];
     ALfloat listener_orientation[6];
     ALfloat listener_gain;
+    MotionChannel listener_motion_position;
+    MotionChannel listener_motion_velocity;
+    MotionChannel listener_motion_orientation;
     SourceWrapper *playlist;
     struct ContextWrapper *next;
     struct ContextWrapper *prev;
@@ -134,6 +227,9 @@ static ContextWrapper *current_context;
 
 
 static void quit_altrace_record(void) __attribute__((destructor));
+static void free_trace_names(void);
+static void write_chunk_context(void);
+static void remember_label(const EventEnum kind, const uint64 key, const char *str);
 
 void out_of_memory(void)
 {
@@ -145,8 +241,9 @@ void out_of_memory(void)
 }
 
 // override _exit(), which terminates the process without running library
-//  destructors, so we can close our log file, etc.
-void _exit(int status)
+//  destructors, so we can close our log file, etc. This has to be exported,
+//  or the app never sees it (fork()ed children usually leave through here).
+__attribute__((visibility("default"))) void _exit(int status)
 {
     quit_altrace_record();
     _Exit(status);  // just use _Exit(), which does the same thing but no one really uses.  :P
@@ -160,20 +257,422 @@ NORETURN static void IO_WRITE_FAIL(void)
     _exit(42);
 }
 
+#ifdef ALTRACE_HAVE_IO_URING
+// Optional asynchronous output engine (ALTRACE_IO_URING=1): events are
+//  copied into large aligned buffers, and full buffers are handed to the
+//  kernel through io_uring, so the app never waits on the disk unless every
+//  buffer is still in flight. With ALTRACE_O_DIRECT=1 as well, the tracefile
+//  bypasses the page cache entirely. If io_uring isn't available, we fall
+//  back to plain write() calls.
+#define URING_NUM_BUFFERS 8
+#define URING_BUFFER_SIZE (1024 * 1024)
+#define URING_ALIGNMENT 4096  // covers the block size of anything we're likely to see for O_DIRECT.
+
+typedef struct UringWriter
+{
+    int ringfd;
+    int fd;
+    int direct;
+    void *sqptr;
+    size_t sqsize;
+    void *cqptr;
+    size_t cqsize;
+    struct io_uring_sqe *sqes;
+    size_t sqessize;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+    uint8 *buffers[URING_NUM_BUFFERS];
+    struct iovec iov[URING_NUM_BUFFERS];
+    int inflight[URING_NUM_BUFFERS];
+    int num_inflight;
+    int current;   // buffer we're currently filling.
+    size_t used;   // bytes used in the current buffer.
+    uint64 offset; // file offset of the next submission.
+} UringWriter;
+
+static UringWriter *uring = NULL;
+
+static void uring_destroy(UringWriter *w)
+{
+    if (w) {
+        int i;
+        if (w->sqes) { munmap(w->sqes, w->sqessize); }
+        if (w->cqptr) { munmap(w->cqptr, w->cqsize); }
+        if (w->sqptr) { munmap(w->sqptr, w->sqsize); }
+        if (w->ringfd != -1) { close(w->ringfd); }
+        for (i = 0; i < URING_NUM_BUFFERS; i++) {
+            free(w->buffers[i]);
+        }
+        free(w);
+    }
+}
+
+static void *uring_mmap(const int ringfd, const size_t len, const off_t offset)
+{
+    void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, offset);
+    return (ptr == MAP_FAILED) ? NULL : ptr;
+}
+
+static UringWriter *uring_create(void)
+{
+    UringWriter *w = (UringWriter *) calloc(1, sizeof (UringWriter));
+    struct io_uring_params params;
+    int i;
+
+    if (!w) {
+        return NULL;
+    }
+
+    memset(&params, '\0', sizeof (params));
+    w->fd = -1;
+    w->ringfd = (int) syscall(__NR_io_uring_setup, URING_NUM_BUFFERS, &params);
+    if (w->ringfd < 0) {
+        w->ringfd = -1;
+        uring_destroy(w);
+        return NULL;
+    }
+
+    w->sqsize = params.sq_off.array + (params.sq_entries * sizeof (unsigned));
+    w->cqsize = params.cq_off.cqes + (params.cq_entries * sizeof (struct io_uring_cqe));
+    w->sqessize = params.sq_entries * sizeof (struct io_uring_sqe);
+    w->sqptr = uring_mmap(w->ringfd, w->sqsize, IORING_OFF_SQ_RING);
+    w->cqptr = uring_mmap(w->ringfd, w->cqsize, IORING_OFF_CQ_RING);
+    w->sqes = (struct io_uring_sqe *) uring_mmap(w->ringfd, w->sqessize, IORING_OFF_SQES);
+    if (!w->sqptr || !w->cqptr || !w->sqes) {
+        uring_destroy(w);
+        return NULL;
+    }
+
+    w->sq_tail = (unsigned *) (((uint8 *) w->sqptr) + params.sq_off.tail);
+    w->sq_mask = (unsigned *) (((uint8 *) w->sqptr) + params.sq_off.ring_mask);
+    w->sq_array = (unsigned *) (((uint8 *) w->sqptr) + params.sq_off.array);
+    w->cq_head = (unsigned *) (((uint8 *) w->cqptr) + params.cq_off.head);
+    w->cq_tail = (unsigned *) (((uint8 *) w->cqptr) + params.cq_off.tail);
+    w->cq_mask = (unsigned *) (((uint8 *) w->cqptr) + params.cq_off.ring_mask);
+    w->cqes = (struct io_uring_cqe *) (((uint8 *) w->cqptr) + params.cq_off.cqes);
+
+    for (i = 0; i < URING_NUM_BUFFERS; i++) {
+        void *ptr = NULL;
+        if (posix_memalign(&ptr, URING_ALIGNMENT, URING_BUFFER_SIZE) != 0) {
+            uring_destroy(w);
+            return NULL;
+        }
+        w->buffers[i] = (uint8 *) ptr;
+    }
+
+    return w;
+}
+
+// hand buffer (idx) to the kernel. Returns zero on failure, with errno set.
+static int uring_submit(UringWriter *w, const int idx, const size_t len)
+{
+    const unsigned tail = *w->sq_tail;
+    const unsigned slot = tail & *w->sq_mask;
+    struct io_uring_sqe *sqe = &w->sqes[slot];
+
+    w->iov[idx].iov_base = w->buffers[idx];
+    w->iov[idx].iov_len = len;
+
+    memset(sqe, '\0', sizeof (*sqe));
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = w->fd;
+    sqe->addr = (uint64) (size_t) &w->iov[idx];
+    sqe->len = 1;
+    sqe->off = w->offset;
+    sqe->user_data = (uint64) idx;
+    w->sq_array[slot] = slot;
+    __atomic_store_n(w->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    w->inflight[idx] = 1;
+    w->num_inflight++;
+    w->offset += len;
+
+    while (syscall(__NR_io_uring_enter, w->ringfd, 1, 0, 0, NULL, 0) < 0) {
+        if (errno != EINTR) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// collect finished writes, optionally waiting for at least one. Returns zero on failure, with errno set.
+static int uring_reap(UringWriter *w, const int wait)
+{
+    unsigned head = *w->cq_head;
+    int okay = 1;
+
+    if (wait) {
+        while (syscall(__NR_io_uring_enter, w->ringfd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+            if (errno != EINTR) {
+                return 0;
+            }
+        }
+    }
+
+    while (head != __atomic_load_n(w->cq_tail, __ATOMIC_ACQUIRE)) {
+        const struct io_uring_cqe *cqe = &w->cqes[head & *w->cq_mask];
+        const int idx = (int) cqe->user_data;
+        if (cqe->res != (int) w->iov[idx].iov_len) {
+            errno = (cqe->res < 0) ? -cqe->res : EIO;  // !!! FIXME: resubmit short writes?
+            okay = 0;
+        }
+        w->inflight[idx] = 0;
+        w->num_inflight--;
+        head++;
+    }
+    __atomic_store_n(w->cq_head, head, __ATOMIC_RELEASE);
+
+    return okay;
+}
+
+static int uring_write(UringWriter *w, const void *data, size_t len)
+{
+    const uint8 *src = (const uint8 *) data;
+    while (len > 0) {
+        const size_t avail = URING_BUFFER_SIZE - w->used;
+        const size_t cpy = (len < avail) ? len : avail;
+        memcpy(w->buffers[w->current] + w->used, src, cpy);
+        w->used += cpy;
+        src += cpy;
+        len -= cpy;
+
+        if (w->used == URING_BUFFER_SIZE) {
+            if (!uring_submit(w, w->current, w->used)) {
+                return 0;
+            }
+            w->current = (w->current + 1) % URING_NUM_BUFFERS;
+            w->used = 0;
+            if (!uring_reap(w, 0)) {
+                return 0;
+            }
+            while (w->inflight[w->current]) {  // out of buffers; wait on the disk.
+                if (!uring_reap(w, 1)) {
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+// write out whatever is left and wait for everything to land. (total) is the
+//  real length of the file, since O_DIRECT makes us pad out the last block.
+static int uring_finish(UringWriter *w, const uint64 total)
+{
+    int okay = 1;
+    if (w->used > 0) {
+        size_t len = w->used;
+        if (w->direct) {
+            len = ((len + URING_ALIGNMENT - 1) / URING_ALIGNMENT) * URING_ALIGNMENT;
+            memset(w->buffers[w->current] + w->used, '\0', len - w->used);
+        }
+        okay = uring_submit(w, w->current, len);
+        w->used = 0;
+    }
+
+    while (okay && (w->num_inflight > 0)) {
+        okay = uring_reap(w, 1);
+    }
+
+    if (okay && w->direct && (ftruncate(w->fd, (off_t) total) == -1)) {
+        okay = 0;
+    }
+
+    return okay;
+}
+#endif
+
+static int open_tracefile(const char *filename)
+{
+    const int flags = O_WRONLY | O_TRUNC | O_CREAT;
+    int fd = -1;
+
+    #ifdef ALTRACE_HAVE_IO_URING
+    if (getenv("ALTRACE_IO_URING")) {
+        uring = uring_create();
+        if (!uring) {
+            fprintf(stderr, "%s: io_uring unavailable (%s), falling back to write()\n", GAppName, strerror(errno));
+        } else if (getenv("ALTRACE_O_DIRECT")) {
+            fd = open(filename, flags | O_DIRECT, 0644);  // not every filesystem allows this.
+            uring->direct = (fd != -1);
+        }
+    }
+    #else
+    if (getenv("ALTRACE_IO_URING")) {
+        fprintf(stderr, "%s: io_uring isn't supported on this platform, using write()\n", GAppName);
+    }
+    #endif
+
+    if (fd == -1) {
+        fd = open(filename, flags, 0644);
+    }
+
+    #ifdef ALTRACE_HAVE_IO_URING
+    if (uring) {
+        if (fd == -1) {
+            const int err = errno;
+            uring_destroy(uring);
+            uring = NULL;
+            errno = err;
+        } else {
+            uring->fd = fd;
+        }
+    }
+    #endif
+
+    logbytes = 0;
+    return fd;
+}
+
+// everything we output goes through here, so it can go to the tracefile,
+//  the shared memory ring, or both.
+static void outputbytes(const void *data, const size_t len)
+{
+    if (logfd != -1) {
+        #ifdef ALTRACE_HAVE_IO_URING
+        if (uring) {
+            if (!uring_write(uring, data, len)) {
+                IO_WRITE_FAIL();
+            }
+        } else
+        #endif
+        if (write(logfd, data, len) != len) {
+            IO_WRITE_FAIL();
+        }
+        logbytes += len;
+    }
+    if (shmring) {
+        shmring_write(shmring, data, len);
+    }
+    if (metrics_enabled) {
+        metric_add(&metrics.trace_bytes, (uint64) len);
+    }
+}
+
+// Every event is written as its id, the length of everything after that,
+//  and then its fields, so playback can step over events it doesn't want (or
+//  doesn't know about) without decoding them. We don't know the length until
+//  the event is done, so its fields collect here first, and it goes out when
+//  the next event starts or the API lock is released. Big blobs aren't
+//  copied; we just note where they go, since they're the app's data and it
+//  can't touch them until the call returns.
+#define RECORD_HEADER_LEN 8
+#define RECORD_MAX_BLOBS 4
+#define RECORD_BLOB_MINIMUM 4096
+
+typedef struct RecordBlob
+{
+    size_t pos;  // offset in (record) this goes before.
+    const uint8 *data;
+    size_t len;
+} RecordBlob;
+
+static uint8 *record = NULL;
+static size_t record_len = 0;
+static size_t record_alloc = 0;
+static int record_open = 0;
+static RecordBlob record_blobs[RECORD_MAX_BLOBS];
+static int record_num_blobs = 0;
+static uint64 record_blob_bytes = 0;
+
+static void end_record(void)
+{
+    uint32 payloadlen;
+    size_t pos = 0;
+    int i;
+
+    if (!record_open) {
+        return;
+    }
+
+    record_open = 0;  // in case writing fails and we end up back here on the way out.
+    payloadlen = swap32((uint32) ((record_len - RECORD_HEADER_LEN) + record_blob_bytes));
+    memcpy(record + 4, &payloadlen, sizeof (payloadlen));
+
+    for (i = 0; i < record_num_blobs; i++) {
+        const RecordBlob *blob = &record_blobs[i];
+        if (blob->pos > pos) {
+            outputbytes(record + pos, blob->pos - pos);
+            pos = blob->pos;
+        }
+        outputbytes(blob->data, blob->len);
+    }
+    outputbytes(record + pos, record_len - pos);
+
+    record_len = 0;
+    record_num_blobs = 0;
+    record_blob_bytes = 0;
+}
+
+static void begin_record(const EventEnum ev)
+{
+    const uint32 id = swap32((uint32) ev);
+    end_record();
+    if (record_alloc < RECORD_HEADER_LEN) {
+        record_alloc = 4096;
+        record = (uint8 *) malloc(record_alloc);
+        if (!record) {
+            out_of_memory();
+        }
+    }
+    memcpy(record, &id, sizeof (id));
+    record_len = RECORD_HEADER_LEN;  // the length gets filled in at the end.
+    record_open = 1;
+}
+
+static void writebytes(const void *data, const size_t len)
+{
+    if (!record_open) {  // the file header isn't an event.
+        outputbytes(data, len);
+        return;
+    }
+
+    if ((record_alloc - record_len) < len) {
+        size_t newalloc = record_alloc * 2;
+        void *ptr;
+        while ((newalloc - record_len) < len) {
+            newalloc *= 2;
+        }
+        ptr = realloc(record, newalloc);
+        if (!ptr) {
+            out_of_memory();
+        }
+        record = (uint8 *) ptr;
+        record_alloc = newalloc;
+    }
+
+    memcpy(record + record_len, data, len);
+    record_len += len;
+}
+
+static void writeblob(const uint8 *data, const size_t len)
+{
+    if (!record_open || (len < RECORD_BLOB_MINIMUM) || (record_num_blobs >= RECORD_MAX_BLOBS)) {
+        writebytes(data, len);
+    } else {
+        RecordBlob *blob = &record_blobs[record_num_blobs++];
+        blob->pos = record_len;
+        blob->data = data;
+        blob->len = len;
+        record_blob_bytes += (uint64) len;
+    }
+}
+
 static void writele32(const uint32 x)
 {
     const uint32 y = swap32(x);
-    if (write(logfd, &y, sizeof (y)) != sizeof (y)) {
-        IO_WRITE_FAIL();
-    }
+    writebytes(&y, sizeof (y));
 }
 
 static void writele64(const uint64 x)
 {
     const uint64 y = swap64(x);
-    if (write(logfd, &y, sizeof (y)) != sizeof (y)) {
-        IO_WRITE_FAIL();
-    }
+    writebytes(&y, sizeof (y));
 }
 
 static void IO_INT32(const int32 x)
@@ -217,6 +716,8 @@ static void IO_DOUBLE(const double x)
     IO_UINT64(cvt.ui64);
 }
 
+// the null terminator is written too (but not counted in the length), so
+//  playback can use strings in place.
 static void IO_STRING(const char *str)
 {
     if (!str) {
@@ -224,9 +725,7 @@ static void IO_STRING(const char *str)
     } else {
         const size_t len = strlen(str);
         IO_UINT64((uint64) len);
-        if (len > 0) {
-            if (write(logfd, str, len) != len) IO_WRITE_FAIL();
-        }
+        writebytes(str, len + 1);
     }
 }
 
@@ -238,14 +737,15 @@ static void IO_BLOB(const uint8 *data, const uint64 len)
         const size_t slen = (size_t) len;
         IO_UINT64(len);
         if (len > 0) {
-            if (write(logfd, data, slen) != slen) IO_WRITE_FAIL();
+            writeblob(data, slen);
         }
+        IO_UINT64(hash_blob(data, slen));  // so playback can tell blobs apart without reading them.
     }
 }
 
 static void IO_EVENTENUM(const EventEnum x)
 {
-    IO_UINT32((uint32) x);
+    begin_record(x);
 }
 
 static void IO_PTR(const void *ptr)
@@ -274,6 +774,217 @@ static void IO_BOOLEAN(ALboolean b)
 }
 
 
+// Optional per-call performance counters (ALTRACE_PERF_COUNTERS=1). Each
+//  thread opens its own counters the first time it calls into OpenAL: CPU
+//  cycles and instructions if the hardware and kernel.perf_event_paranoid
+//  allow it, otherwise the software task clock and context switch counts,
+//  which work in an unprivileged container, too. PERF_BEGIN() and PERF_END()
+//  go around the real OpenAL call in each entry point, and IO_END() writes
+//  the difference out as an event that follows the call.
+static int perf_counters_enabled = 0;
+static __thread int perf_pending = 0;  // thread-local, since alGen* call in before taking the API lock.
+static __thread uint32 perf_pending_kind = 0;
+static __thread uint64 perf_pending_values[2];
+
+#ifdef __linux__
+static __thread int perf_fd = -1;  // group leader; the second counter rides along with it.
+static __thread int perf_fd2 = -1;
+static __thread int perf_tried = 0;
+static __thread uint32 perf_kind = 0;
+static __thread uint64 perf_start[2];
+static pthread_key_t perf_thread_key;
+
+static int perf_open(const uint32 type, const uint64 config, const int group, const int exclude_kernel)
+{
+    struct perf_event_attr attr;
+    memset(&attr, '\0', sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+static int perf_open_pair(const uint32 type, const uint64 config1, const uint64 config2)
+{
+    int exclude_kernel;
+    // counting kernel time needs privileges we might not have; context
+    //  switches only show up if we have them, though, so try that first.
+    for (exclude_kernel = 0; exclude_kernel <= 1; exclude_kernel++) {
+        perf_fd = perf_open(type, config1, -1, exclude_kernel);
+        if (perf_fd != -1) {
+            perf_fd2 = perf_open(type, config2, perf_fd, exclude_kernel);
+            if (perf_fd2 != -1) {
+                return 1;
+            }
+            close(perf_fd);
+            perf_fd = -1;
+        }
+    }
+    return 0;
+}
+
+static void perf_close_thread(void)
+{
+    if (perf_fd2 != -1) { close(perf_fd2); }
+    if (perf_fd != -1) { close(perf_fd); }
+    perf_fd = perf_fd2 = -1;
+    perf_tried = 0;
+}
+
+static void perf_thread_destructor(void *unused)
+{
+    perf_close_thread();
+}
+
+static void perf_init_thread(void)
+{
+    perf_tried = 1;
+    if (perf_open_pair(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS)) {
+        perf_kind = ALTRACE_PERF_CYCLES_INSTRUCTIONS;
+    } else if (perf_open_pair(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, PERF_COUNT_SW_CONTEXT_SWITCHES)) {
+        perf_kind = ALTRACE_PERF_TASKCLOCK_CSWITCHES;
+    } else {
+        fprintf(stderr, "%s: Couldn't open performance counters for this thread: %s\n", GAppName, strerror(errno));
+        return;
+    }
+    pthread_setspecific(perf_thread_key, &perf_fd);  // just so the destructor runs at thread exit.
+}
+
+static int perf_read(uint64 *values)
+{
+    uint64 buf[3];  // number of counters, then each value.
+    if ((read(perf_fd, buf, sizeof (buf)) != sizeof (buf)) || (buf[0] != 2)) {
+        return 0;
+    }
+    values[0] = buf[1];
+    values[1] = buf[2];
+    return 1;
+}
+
+static void perf_begin(void)
+{
+    if (perf_counters_enabled) {
+        if (!perf_tried) {
+            perf_init_thread();
+        }
+        if ((perf_fd != -1) && !perf_read(perf_start)) {
+            perf_close_thread();
+            perf_tried = 1;  // don't keep trying.
+        }
+    }
+}
+
+static void perf_end(void)
+{
+    uint64 values[2];
+    if (perf_counters_enabled && (perf_fd != -1) && perf_read(values)) {
+        perf_pending = 1;
+        perf_pending_kind = perf_kind;
+        perf_pending_values[0] = values[0] - perf_start[0];
+        perf_pending_values[1] = values[1] - perf_start[1];
+    }
+}
+
+static int perf_init(void)
+{
+    const int rc = pthread_key_create(&perf_thread_key, perf_thread_destructor);
+    if (rc != 0) {
+        fprintf(stderr, "%s: Failed to create thread-local storage: %s\n", GAppName, strerror(rc));
+        return 0;
+    }
+    return 1;
+}
+
+#else
+static int perf_init(void)
+{
+    fprintf(stderr, "%s: performance counters aren't supported on this platform.\n", GAppName);
+    return 1;
+}
+static void perf_begin(void) {}
+static void perf_end(void) {}
+#endif
+
+// the live metrics want to know how long the real call took, too, so they
+//  can report how much time the tracer itself added.
+static void metrics_real_begin(void)
+{
+    if (metrics_enabled) {
+        metrics_real_start = now_ns();
+    }
+}
+
+static void metrics_real_end(void)
+{
+    if (metrics_enabled) {
+        metrics_real_ns += now_ns() - metrics_real_start;
+    }
+}
+
+#define PERF_BEGIN() do { perf_begin(); metrics_real_begin(); } while (0)
+#define PERF_END() do { metrics_real_end(); perf_end(); } while (0)
+
+static void check_perf_counters(void)
+{
+    if (perf_pending) {
+        perf_pending = 0;
+        IO_EVENTENUM(ALEE_PERF_COUNTERS);
+        IO_UINT32(perf_pending_kind);
+        IO_UINT64(perf_pending_values[0]);
+        IO_UINT64(perf_pending_values[1]);
+    }
+}
+
+// Optional scheduler context (ALTRACE_SCHED_SAMPLE=N): every Nth call from
+//  each thread (starting with its first) is preceded by the CPU it ran on,
+//  its scheduling policy and priority, and how many voluntary and
+//  involuntary context switches it took since its last sample. This is what
+//  you want when an audio thread is getting migrated or preempted.
+static uint32 sched_sample_interval = 0;
+static __thread uint32 sched_calls = 0;
+static __thread uint64 sched_last_nvcsw = 0;
+static __thread uint64 sched_last_nivcsw = 0;
+
+static void check_sched_context(void)
+{
+    #ifdef __linux__
+    struct sched_param param;
+    struct rusage usage;
+    int policy = 0;
+    uint32 cpu, nvcsw = 0, nivcsw = 0;
+    int cpunum;
+
+    if (!sched_sample_interval || ((sched_calls++ % sched_sample_interval) != 0)) {
+        return;
+    }
+
+    cpunum = sched_getcpu();
+    cpu = (cpunum < 0) ? 0xFFFFFFFF : (uint32) cpunum;
+
+    if (pthread_getschedparam(pthread_self(), &policy, &param) != 0) {
+        policy = 0;
+        param.sched_priority = 0;
+    }
+
+    if (getrusage(RUSAGE_THREAD, &usage) == 0) {
+        nvcsw = (uint32) (((uint64) usage.ru_nvcsw) - sched_last_nvcsw);
+        nivcsw = (uint32) (((uint64) usage.ru_nivcsw) - sched_last_nivcsw);
+        sched_last_nvcsw = (uint64) usage.ru_nvcsw;
+        sched_last_nivcsw = (uint64) usage.ru_nivcsw;
+    }
+
+    IO_EVENTENUM(ALEE_SCHED_CONTEXT);
+    IO_UINT32(cpu);
+    IO_UINT32((((uint32) policy) << 16) | (((uint32) param.sched_priority) & 0xFFFF));
+    IO_UINT32(nvcsw);
+    IO_UINT32(nivcsw);
+    #endif
+}
+
+
 static void free_hash_item_stackframe(void *from, char *to) { free(to); }
 static uint8 hash_stackframe(void *from) {
     // everything is going to end in a multiple of pointer size, so flatten down.
@@ -308,6 +1019,42 @@ static char *get_callstack_sym(void *frame, int *_seen_before)
     return retval;
 }
 
+// Playback numbers threads in the order the tracefile first mentions them,
+//  so a chunk decoded on its own (or a live stream that starts partway)
+//  needs that list to number them the same way.
+static uint64 *log_threads = NULL;
+static uint32 num_log_threads = 0;
+
+static void note_log_thread(const uint64 threadid)
+{
+    void *ptr;
+    uint32 i;
+
+    if (!chunked && !shmring) {
+        return;
+    }
+
+    for (i = num_log_threads; i > 0; i--) {  // newest first; it's usually the same few threads.
+        if (log_threads[i - 1] == threadid) {
+            return;
+        }
+    }
+
+    ptr = realloc(log_threads, (num_log_threads + 1) * sizeof (uint64));
+    if (!ptr) {
+        out_of_memory();
+    }
+    log_threads = (uint64 *) ptr;
+    log_threads[num_log_threads++] = threadid;
+}
+
+static void forget_log_threads(void)
+{
+    free(log_threads);
+    log_threads = NULL;
+    num_log_threads = 0;
+}
+
 __attribute__((noinline)) static void IO_ENTRYINFO(const EventEnum entryid)
 {
     const uint32 currentms = now();
@@ -348,9 +1095,12 @@ __attribute__((noinline)) static void IO_ENTRYINFO(const EventEnum entryid)
         }
     }
 
+    check_sched_context();
+
     IO_EVENTENUM(entryid);
     IO_UINT32(currentms);
     IO_UINT64((uint64) pthread_self());
+    note_log_thread((uint64) pthread_self());
 
     IO_UINT32((uint32) frames);
     for (i = 0; i < frames; i++) {
@@ -370,7 +1120,9 @@ static void APILOCK(void)
 
 static void APIUNLOCK(void)
 {
-    const int rc = pthread_mutex_unlock(apilock);
+    int rc;
+    end_record();  // it has to go out before another thread can start one.
+    rc = pthread_mutex_unlock(apilock);
     if (rc != 0) {
         fprintf(stderr, "%s: Failed to release API lock: %s\n", GAppName, strerror(rc));
         quit_altrace_record();
@@ -386,46 +1138,834 @@ static ALenum check_al_error_events(void)
         ALenum *errorlatch = current_context ? &current_context->errorlatch : &null_context_errorlatch;
         IO_EVENTENUM(ALEE_ALERROR_TRIGGERED);
         IO_ENUM(alerr);
+        if (metrics_enabled) {
+            metric_add(&metrics.al_errors, 1);
+        }
         if (*errorlatch == AL_NO_ERROR) {
             *errorlatch = alerr;
         }
     }
-    return alerr;
+    return alerr;
+}
+
+static ALCenum check_alc_error_events(DeviceWrapper *device)
+{
+    ALCenum alcerr = ALC_NO_ERROR;
+    if (device) {
+        alcerr = REAL_alcGetError(device->device);
+        if (alcerr != ALC_NO_ERROR) {
+            IO_EVENTENUM(ALEE_ALCERROR_TRIGGERED);
+            IO_PTR(device);
+            IO_ALCENUM(alcerr);
+            if (metrics_enabled) {
+                metric_add(&metrics.alc_errors, 1);
+            }
+            if (device->errorlatch == ALC_NO_ERROR) {
+                device->errorlatch = alcerr;
+            }
+        }
+    }
+    return alcerr;
+}
+
+// A consumer might have attached to (or left) the shared memory ring since
+//  the last call. If it's new, it gets a fresh stream starting right here,
+//  along with the same catching up a chunked tracefile does at a checkpoint
+//  (scope depth, labels, names, thread numbering), which only it needs.
+static void check_shmring(void)
+{
+    if (shmring && (shmring_begin_event(shmring) == 2)) {
+        const uint32 magic = swap32(ALTRACE_LOG_FILE_MAGIC);
+        const uint32 format = swap32(ALTRACE_LOG_FILE_FORMAT);
+        const int fd = logfd;
+        shmring_write(shmring, &magic, sizeof (magic));
+        shmring_write(shmring, &format, sizeof (format));
+        logfd = -1;  // so outputbytes() leaves the tracefile alone.
+        write_chunk_context();
+        end_record();
+        logfd = fd;
+        free_stackframe_map();  // so the new consumer gets callstack symbols, too.
+        motion_generation++;  // ...and motion channels.
+    }
+}
+
+// Every so often, drop a marker that a salvage tool can find by scanning
+//  backwards through a tracefile that never got an EOS, so it doesn't have
+//  to parse everything from the start to know where a valid event begins.
+static void check_checkpoint(void)
+{
+    if (checkpoint_interval && ((eventcount % checkpoint_interval) == 0)) {
+        uint64 offset;
+        end_record();  // so (logbytes) is where this one starts.
+        offset = logbytes;
+        IO_EVENTENUM(ALEE_CHECKPOINT);
+        IO_UINT64(ALTRACE_CHECKPOINT_MAGIC);
+        IO_UINT64(eventcount);
+        IO_UINT64(offset);
+        IO_UINT32(now());
+        motion_generation++;  // so decoding can start here without the deltas that came before.
+        if (chunked) {
+            write_chunk_context();
+            free_stackframe_map();  // ...and without the callstack symbols that came before.
+        }
+    }
+    eventcount++;
+}
+
+// Optional resource sampling (ALTRACE_RESOURCE_SAMPLE=<milliseconds>): at
+//  most that often, the next API call is preceded by the process's resident
+//  set size, CPU time, and thread counts, so they share a clock with the
+//  calls around them. Since this rides along with API calls, a program that
+//  stops talking to OpenAL stops getting sampled, too.
+// We can't ask the OS which threads belong to the OpenAL library, so we
+//  remember any threads that appeared while the real alcOpenDevice,
+//  alcCaptureOpenDevice, or alcCreateContext ran, and count the survivors.
+static uint32 resource_sample_interval = 0;
+static uint32 resource_last_sample = 0;
+static int resource_sampled = 0;
+#ifdef __linux__
+static pid_t *openal_tids = NULL;
+static uint32 num_openal_tids = 0;
+
+static uint32 list_threads(pid_t **_tids)
+{
+    DIR *dirp = opendir("/proc/self/task");
+    pid_t *tids = NULL;
+    uint32 count = 0;
+    uint32 allocated = 0;
+    struct dirent *dent;
+
+    if (!dirp) {
+        *_tids = NULL;
+        return 0;
+    }
+
+    while ((dent = readdir(dirp)) != NULL) {
+        if (dent->d_name[0] == '.') {
+            continue;
+        }
+        if (count >= allocated) {
+            void *ptr;
+            allocated = allocated ? (allocated * 2) : 16;
+            ptr = realloc(tids, allocated * sizeof (pid_t));
+            if (!ptr) {
+                out_of_memory();
+            }
+            tids = (pid_t *) ptr;
+        }
+        tids[count++] = (pid_t) strtol(dent->d_name, NULL, 10);
+    }
+    closedir(dirp);
+
+    *_tids = tids;
+    return count;
+}
+
+static int find_thread(const pid_t *tids, const uint32 count, const pid_t tid)
+{
+    uint32 i;
+    for (i = 0; i < count; i++) {
+        if (tids[i] == tid) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static uint32 track_openal_threads_begin(pid_t **tids)
+{
+    if (!resource_sample_interval) {
+        *tids = NULL;
+        return 0;
+    }
+    return list_threads(tids);
+}
+
+static void track_openal_threads_end(pid_t *before, const uint32 numbefore)
+{
+    pid_t *after = NULL;
+    uint32 numafter, i;
+
+    if (!resource_sample_interval) {
+        return;
+    }
+
+    numafter = list_threads(&after);
+    for (i = 0; i < numafter; i++) {
+        if (!find_thread(before, numbefore, after[i]) && !find_thread(openal_tids, num_openal_tids, after[i])) {
+            void *ptr = realloc(openal_tids, (num_openal_tids + 1) * sizeof (pid_t));
+            if (!ptr) {
+                out_of_memory();
+            }
+            openal_tids = (pid_t *) ptr;
+            openal_tids[num_openal_tids++] = after[i];
+        }
+    }
+    free(after);
+    free(before);
+}
+
+static void forget_openal_threads(void)
+{
+    free(openal_tids);
+    openal_tids = NULL;
+    num_openal_tids = 0;
+}
+
+static void check_resource_sample(void)
+{
+    const uint32 ticks = now();
+    uint64 rss = 0;
+    uint64 usertime = 0;
+    uint64 systime = 0;
+    uint32 numalive = 0;
+    pid_t *tids = NULL;
+    uint32 numtids, i;
+    struct rusage usage;
+    FILE *io;
+
+    if (!resource_sample_interval) {
+        return;
+    } else if (resource_sampled && ((ticks - resource_last_sample) < resource_sample_interval)) {
+        return;
+    }
+
+    resource_sampled = 1;
+    resource_last_sample = ticks;
+
+    io = fopen("/proc/self/statm", "r");
+    if (io) {
+        unsigned long long pages_total, pages_resident;
+        if (fscanf(io, "%llu %llu", &pages_total, &pages_resident) == 2) {
+            rss = ((uint64) pages_resident) * ((uint64) sysconf(_SC_PAGESIZE));
+        }
+        fclose(io);
+    }
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        usertime = (((uint64) usage.ru_utime.tv_sec) * 1000000) + ((uint64) usage.ru_utime.tv_usec);
+        systime = (((uint64) usage.ru_stime.tv_sec) * 1000000) + ((uint64) usage.ru_stime.tv_usec);
+    }
+
+    // drop OpenAL threads that have exited while we're counting the living.
+    numtids = list_threads(&tids);
+    for (i = 0; i < num_openal_tids; i++) {
+        if (find_thread(tids, numtids, openal_tids[i])) {
+            openal_tids[numalive++] = openal_tids[i];
+        }
+    }
+    num_openal_tids = numalive;
+    free(tids);
+
+    IO_EVENTENUM(ALEE_RESOURCE_SAMPLE);
+    IO_UINT32(ticks);
+    IO_UINT64(rss);
+    IO_UINT64(usertime);
+    IO_UINT64(systime);
+    IO_UINT32(numtids);
+    IO_UINT32(numalive);
+}
+
+#define TRACK_OPENAL_THREADS_BEGIN() pid_t *tids_before = NULL; const uint32 numtids_before = track_openal_threads_begin(&tids_before)
+#define TRACK_OPENAL_THREADS_END() track_openal_threads_end(tids_before, numtids_before)
+#else
+static void forget_openal_threads(void) {}
+static void check_resource_sample(void) {}
+#define TRACK_OPENAL_THREADS_BEGIN()
+#define TRACK_OPENAL_THREADS_END()
+#endif
+
+// Optional live metrics (ALTRACE_METRICS=<port> or <socket path>): a thread
+//  serves Prometheus-style text over HTTP on a loopback TCP port, or on a
+//  Unix socket if the value isn't a number, so a dashboard can scrape
+//  OpenAL's health without anyone parsing a tracefile. The counters are
+//  bumped as calls go by; playing sources are counted at scrape time, which
+//  means briefly taking the API lock.
+static int metrics_fd = -1;
+static char *metrics_socket_path = NULL;
+static pthread_t metrics_thread;
+static int metrics_thread_running = 0;
+static int metrics_stop = 0;
+
+static void metrics_begin_call(const EventEnum entryid)
+{
+    if (metrics_enabled) {
+        metric_add(&metrics.calls[entryid], 1);
+        metrics_call_start = now_ns();
+        metrics_real_ns = 0;
+    }
+}
+
+static void metrics_end_call(void)
+{
+    if (metrics_enabled) {
+        const uint64 elapsed = now_ns() - metrics_call_start;
+        if (elapsed > metrics_real_ns) {
+            metric_add(&metrics.overhead_ns, elapsed - metrics_real_ns);
+        }
+    }
+}
+
+static uint64 metric_get(const uint64 *metric)
+{
+    return __atomic_load_n(metric, __ATOMIC_RELAXED);
+}
+
+// we can't block on the API lock outright: if something calls
+//  quit_altrace_record() while holding it, it'll wait for us to stop.
+static int metrics_lock(void)
+{
+    while (pthread_mutex_trylock(apilock) != 0) {
+        if (__atomic_load_n(&metrics_stop, __ATOMIC_RELAXED)) {
+            return 0;
+        }
+        usleep(1000);
+    }
+    return 1;
+}
+
+static char *metrics_build_page(size_t *_len)
+{
+    char *page = NULL;
+    size_t len = 0;
+    FILE *io = open_memstream(&page, &len);
+
+    if (!io) {
+        return NULL;
+    }
+
+    fprintf(io, "# HELP altrace_calls_total OpenAL calls made, by entry point.\n");
+    fprintf(io, "# TYPE altrace_calls_total counter\n");
+    #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) { \
+        const uint64 val = metric_get(&metrics.calls[ALEE_##name]); \
+        if (val) { fprintf(io, "altrace_calls_total{entrypoint=\"%s\"} %llu\n", #name, (unsigned long long) val); } \
+    }
+    #include "altrace_entrypoints.h"
+
+    fprintf(io, "# HELP altrace_al_errors_total AL errors generated.\n");
+    fprintf(io, "# TYPE altrace_al_errors_total counter\n");
+    fprintf(io, "altrace_al_errors_total %llu\n", (unsigned long long) metric_get(&metrics.al_errors));
+    fprintf(io, "# HELP altrace_alc_errors_total ALC errors generated.\n");
+    fprintf(io, "# TYPE altrace_alc_errors_total counter\n");
+    fprintf(io, "altrace_alc_errors_total %llu\n", (unsigned long long) metric_get(&metrics.alc_errors));
+    fprintf(io, "# HELP altrace_upload_bytes_total Bytes handed to alBufferData.\n");
+    fprintf(io, "# TYPE altrace_upload_bytes_total counter\n");
+    fprintf(io, "altrace_upload_bytes_total %llu\n", (unsigned long long) metric_get(&metrics.upload_bytes));
+    fprintf(io, "# HELP altrace_overhead_seconds_total Time spent in the tracer, not counting the real OpenAL calls.\n");
+    fprintf(io, "# TYPE altrace_overhead_seconds_total counter\n");
+    fprintf(io, "altrace_overhead_seconds_total %.9f\n", metric_get(&metrics.overhead_ns) / 1000000000.0);
+    fprintf(io, "# HELP altrace_trace_bytes_total Bytes of trace data written.\n");
+    fprintf(io, "# TYPE altrace_trace_bytes_total counter\n");
+    fprintf(io, "altrace_trace_bytes_total %llu\n", (unsigned long long) metric_get(&metrics.trace_bytes));
+
+    fprintf(io, "# HELP altrace_playing_sources Sources currently playing, by context.\n");
+    fprintf(io, "# TYPE altrace_playing_sources gauge\n");
+    if (metrics_lock()) {
+        DeviceWrapper *device;
+        for (device = null_device.next; device != NULL; device = device->next) {
+            ContextWrapper *ctx;
+            for (ctx = device->contexts; ctx != NULL; ctx = ctx->next) {
+                const SourceWrapper *src;
+                uint32 playing = 0;
+                for (src = ctx->playlist; src != NULL; src = src->playlist_next) {
+                    if (src->state == AL_PLAYING) {
+                        playing++;
+                    }
+                }
+                fprintf(io, "altrace_playing_sources{context=\"%p\"} %u\n", ctx->ctx, (uint) playing);
+            }
+        }
+        APIUNLOCK();
+    }
+
+    if (fclose(io) != 0) {
+        free(page);
+        return NULL;
+    }
+
+    *_len = len;
+    return page;
+}
+
+static int metrics_send(const int fd, const char *data, size_t len)
+{
+    #ifdef MSG_NOSIGNAL
+    const int flags = MSG_NOSIGNAL;  // a scraper hanging up early shouldn't SIGPIPE the app.
+    #else
+    const int flags = 0;  // !!! FIXME: SO_NOSIGPIPE on Apple platforms.
+    #endif
+
+    while (len > 0) {
+        const ssize_t rc = send(fd, data, len, flags);
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        data += rc;
+        len -= (size_t) rc;
+    }
+    return 1;
+}
+
+static void metrics_respond(const int fd)
+{
+    struct timeval tv;
+    char request[1024];
+    char header[128];
+    size_t len = 0;
+    char *page;
+
+    // we don't care what they asked for, everything gets the metrics page,
+    //  but let the request arrive so the client doesn't see a reset.
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof (tv));
+    if (recv(fd, request, sizeof (request), 0) < 0) {
+        return;
+    }
+
+    page = metrics_build_page(&len);
+    if (!page) {
+        static const char failure[] = "HTTP/1.0 500 Internal Server Error\r\nConnection: close\r\n\r\n";
+        metrics_send(fd, failure, sizeof (failure) - 1);
+        return;
+    }
+
+    snprintf(header, sizeof (header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %llu\r\nConnection: close\r\n\r\n", (unsigned long long) len);
+    if (metrics_send(fd, header, strlen(header))) {
+        metrics_send(fd, page, len);
+    }
+    free(page);
+}
+
+static void *metrics_server(void *unused)
+{
+    while (!__atomic_load_n(&metrics_stop, __ATOMIC_RELAXED)) {
+        struct pollfd pfd;
+        int fd;
+
+        // wake up now and then to see if we're shutting down.
+        pfd.fd = metrics_fd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, 250) <= 0) {
+            continue;
+        }
+
+        fd = accept(metrics_fd, NULL, NULL);
+        if (fd != -1) {
+            metrics_respond(fd);
+            close(fd);
+        }
+    }
+    return NULL;
+}
+
+static int metrics_listen(const char *where)
+{
+    const int is_port = (*where != '\0') && (strspn(where, "0123456789") == strlen(where));
+    int fd;
+
+    if (is_port) {
+        struct sockaddr_in addr;
+        const int one = 1;
+        memset(&addr, '\0', sizeof (addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t) strtoul(where, NULL, 10));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);  // never anything but loopback; this isn't authenticated.
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd != -1) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+            if (bind(fd, (struct sockaddr *) &addr, sizeof (addr)) == -1) {
+                close(fd);
+                fd = -1;
+            }
+        }
+    } else {
+        struct sockaddr_un addr;
+        struct stat statbuf;
+        if (strlen(where) >= sizeof (addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        memset(&addr, '\0', sizeof (addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, where);
+        if ((stat(where, &statbuf) == 0) && S_ISSOCK(statbuf.st_mode)) {
+            unlink(where);  // probably left behind by a previous run.
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd != -1) {
+            if (bind(fd, (struct sockaddr *) &addr, sizeof (addr)) == -1) {
+                close(fd);
+                fd = -1;
+            } else {
+                metrics_socket_path = strdup(where);
+            }
+        }
+    }
+
+    if ((fd != -1) && (listen(fd, 8) == -1)) {
+        close(fd);
+        fd = -1;
+    }
+
+    if (fd != -1) {
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    return fd;
+}
+
+static int metrics_init(const char *where)
+{
+    int rc;
+
+    metrics_fd = metrics_listen(where);
+    if (metrics_fd == -1) {
+        fprintf(stderr, "%s: Failed to serve metrics on '%s': %s\n", GAppName, where, strerror(errno));
+        return 0;
+    }
+
+    metrics_enabled = 1;
+    rc = pthread_create(&metrics_thread, NULL, metrics_server, NULL);
+    if (rc != 0) {
+        fprintf(stderr, "%s: Failed to start metrics thread: %s\n", GAppName, strerror(rc));
+        metrics_enabled = 0;
+        return 0;
+    }
+    metrics_thread_running = 1;
+
+    fprintf(stderr, "%s: Serving live metrics on %s '%s'\n", GAppName, metrics_socket_path ? "socket" : "loopback port", where);
+    return 1;
+}
+
+static void metrics_quit(void)
+{
+    metrics_enabled = 0;
+    if (metrics_thread_running) {
+        __atomic_store_n(&metrics_stop, 1, __ATOMIC_RELAXED);
+        pthread_join(metrics_thread, NULL);
+        metrics_thread_running = 0;
+    }
+    if (metrics_fd != -1) {
+        close(metrics_fd);
+        metrics_fd = -1;
+    }
+    if (metrics_socket_path) {
+        unlink(metrics_socket_path);
+        free(metrics_socket_path);
+        metrics_socket_path = NULL;
+    }
+}
+
+// Optional motion mode (ALTRACE_MOTION=<max error>): the position and
+//  velocity of sources and the listener, and the listener's orientation,
+//  tend to change for every object every frame, and make up most of a
+//  game's trace. In this mode, those updates are written as compact events
+//  on a per-object channel instead: each value is quantized so it's never
+//  off by more than the given error, and written as the varint-encoded
+//  difference from the channel's previous value. The callstack and the
+//  state checks are skipped. Playback turns these back into alSource3f,
+//  alListener3f, and alListenerfv calls.
+// With ALTRACE_MOTION_PER_FRAME=1 as well, only the last update to each
+//  channel between alTraceFrameMark() calls is written, when the frame ends
+//  (or sooner, before anything else that touches the same source or the
+//  listener, or changes the current context, so the updates still land
+//  where they apply). They're timestamped when they're written, so time in
+//  the trace never goes backwards.
+static int motion_per_frame = 0;
+static double motion_limit = 0.0;  // quantizing values this big would overflow.
+static uint32 motion_next_channel = 1;
+static MotionChannel **motion_queue = NULL;
+static uint32 motion_queue_len = 0;
+static uint32 motion_queue_alloc = 0;
+
+static SourceWrapper *source_wrapped_lookup(const ALuint name);
+static void check_al_async_states(void);
+
+static int motion_quantizable(const ALfloat *values, const uint32 numvals)
+{
+    uint32 i;
+    for (i = 0; i < numvals; i++) {
+        if (!((values[i] > -motion_limit) && (values[i] < motion_limit))) {  // this catches NaNs, too.
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void write_motion_update(MotionChannel *ch, const ALfloat *values, const uint32 ticks, const uint64 threadid)
+{
+    uint8 buf[6 * 10];  // up to six 64-bit varints.
+    size_t len = 0;
+    uint32 i;
+
+    if (ch->generation != motion_generation) {
+        ch->generation = motion_generation;
+        memset(ch->quantized, '\0', sizeof (ch->quantized));
+        IO_EVENTENUM(ALEE_MOTION_CHANNEL);
+        IO_UINT32(ch->id);
+        IO_UINT32(ch->target);
+        IO_PTR(ch->ctx);
+        IO_UINT32(ch->name);
+        IO_ENUM(ch->param);
+        IO_UINT32(ch->numvals);
+        IO_DOUBLE(motion_quantum);
+    }
+
+    for (i = 0; i < ch->numvals; i++) {
+        const double scaled = values[i] / motion_quantum;
+        const int64 q = (scaled >= 0.0) ? (int64) (scaled + 0.5) : -((int64) (-scaled + 0.5));
+        const int64 delta = q - ch->quantized[i];
+        uint64 zigzag = (((uint64) delta) << 1) ^ ((uint64) (delta >> 63));
+        ch->quantized[i] = q;
+        while (zigzag >= 0x80) {
+            buf[len++] = (uint8) ((zigzag & 0x7F) | 0x80);
+            zigzag >>= 7;
+        }
+        buf[len++] = (uint8) zigzag;
+    }
+
+    IO_EVENTENUM(ALEE_MOTION_UPDATE);
+    IO_UINT32(ch->id);
+    IO_UINT32(ticks);
+    IO_UINT64(threadid);
+    note_log_thread(threadid);
+    writebytes(buf, len);
+}
+
+// a channel that's flushed early stays queued; it's just not dirty anymore.
+static void flush_motion_channel(MotionChannel *ch)
+{
+    if (ch->dirty) {
+        write_motion_update(ch, ch->pending, now(), ch->pending_threadid);
+        ch->dirty = 0;
+    }
+}
+
+static void flush_motion(void)
+{
+    uint32 i;
+    for (i = 0; i < motion_queue_len; i++) {
+        MotionChannel *ch = motion_queue[i];
+        flush_motion_channel(ch);
+        ch->queued = 0;
+    }
+    motion_queue_len = 0;
+}
+
+static void flush_listener_motion(void)
+{
+    ContextWrapper *ctx = current_context;  // anything queued for another context was flushed when it stopped being current.
+    if (ctx) {
+        flush_motion_channel(&ctx->listener_motion_position);
+        flush_motion_channel(&ctx->listener_motion_velocity);
+        flush_motion_channel(&ctx->listener_motion_orientation);
+    }
+}
+
+// pending per-frame updates have to be written before anything that would
+//  change what they apply to, or see their effects. Source calls name their
+//  sources with IO_START_SOURCES instead; see flush_source_motion().
+static void check_motion_flush(const EventEnum entryid)
+{
+    if (motion_queue_len) {
+        switch (entryid) {
+            case ALEE_alTraceFrameMark:
+            case ALEE_alcMakeContextCurrent:
+            case ALEE_alcDestroyContext:
+            case ALEE_alDeleteSources:
+                flush_motion();
+                break;
+            case ALEE_alListenerfv:
+            case ALEE_alListenerf:
+            case ALEE_alListener3f:
+            case ALEE_alListeneriv:
+            case ALEE_alListeneri:
+            case ALEE_alListener3i:
+            case ALEE_alGetListenerfv:
+            case ALEE_alGetListenerf:
+            case ALEE_alGetListener3f:
+            case ALEE_alGetListeneriv:
+            case ALEE_alGetListeneri:
+            case ALEE_alGetListener3i:
+                flush_listener_motion();
+                break;
+            default: break;
+        }
+    }
+}
+
+static void flush_source_motion(const ALsizei n, const ALuint *names)
+{
+    ALsizei i;
+    if (motion_queue_len && names) {
+        for (i = 0; i < n; i++) {
+            SourceWrapper *src = source_wrapped_lookup(names[i]);
+            if (src) {
+                flush_motion_channel(&src->motion_position);
+                flush_motion_channel(&src->motion_velocity);
+            }
+        }
+    }
+}
+
+// the channel's update has been quantized or queued, and its wrapper state
+//  updated; now do the rest of what IO_START and IO_END would have done.
+static void record_motion(MotionChannel *ch, const uint32 target, const ALuint name, const ALenum param, const ALfloat *values, const uint32 numvals)
+{
+    if (!ch->id) {
+        ch->id = motion_next_channel++;
+    }
+    ch->target = target;
+    ch->ctx = (ALCcontext *) current_context;  // the trace knows contexts by our wrapper's address.
+    ch->name = name;
+    ch->param = param;
+    ch->numvals = numvals;
+
+    if (!motion_per_frame) {
+        write_motion_update(ch, values, now(), (uint64) pthread_self());
+        return;
+    }
+
+    memcpy(ch->pending, values, numvals * sizeof (ALfloat));
+    ch->pending_threadid = (uint64) pthread_self();
+    ch->dirty = 1;
+    if (!ch->queued) {
+        if (motion_queue_len >= motion_queue_alloc) {
+            const uint32 newalloc = motion_queue_alloc ? (motion_queue_alloc * 2) : 64;
+            void *ptr = realloc(motion_queue, newalloc * sizeof (MotionChannel *));
+            if (!ptr) {
+                out_of_memory();
+            }
+            motion_queue = (MotionChannel **) ptr;
+            motion_queue_alloc = newalloc;
+        }
+        motion_queue[motion_queue_len++] = ch;
+        ch->queued = 1;
+    }
+}
+
+// an update that can't go through motion mode (non-finite values, unknown
+//  source, etc) will be recorded normally, and it supersedes anything queued.
+static void cancel_motion(MotionChannel *ch)
+{
+    if (ch) {
+        ch->dirty = 0;
+    }
+}
+
+static void motion_end_call(void)
+{
+    check_al_error_events();
+    check_al_async_states();
+    metrics_end_call();
+    APIUNLOCK();
+}
+
+// Returns non-zero if this update went through motion mode, in which case
+//  the real call has been made, too.
+static int motion_source(const EventEnum entryid, const ALuint name, const ALenum param, const ALfloat *values)
+{
+    SourceWrapper *src;
+    MotionChannel *ch;
+
+    if (!motion_quantum || ((param != AL_POSITION) && (param != AL_VELOCITY))) {
+        return 0;
+    }
+
+    APILOCK();
+    src = source_wrapped_lookup(name);
+    ch = src ? ((param == AL_POSITION) ? &src->motion_position : &src->motion_velocity) : NULL;
+    if (!ch || !values || !motion_quantizable(values, 3)) {
+        cancel_motion(ch);
+        APIUNLOCK();
+        return 0;
+    }
+
+    metrics_begin_call(entryid);
+    check_shmring();
+    check_checkpoint();
+    check_resource_sample();
+    record_motion(ch, ALTRACE_MOTION_SOURCE, name, param, values, 3);
+    metrics_real_begin();
+    REAL_alSource3f(name, param, values[0], values[1], values[2]);
+    metrics_real_end();
+    memcpy((param == AL_POSITION) ? src->position : src->velocity, values, sizeof (ALfloat) * 3);
+    motion_end_call();
+    return 1;
 }
 
-static ALCenum check_alc_error_events(DeviceWrapper *device)
+static int motion_listener(const EventEnum entryid, const ALenum param, const ALfloat *values)
 {
-    ALCenum alcerr = ALC_NO_ERROR;
-    if (device) {
-        alcerr = REAL_alcGetError(device->device);
-        if (alcerr != ALC_NO_ERROR) {
-            IO_EVENTENUM(ALEE_ALCERROR_TRIGGERED);
-            IO_PTR(device);
-            IO_ALCENUM(alcerr);
-            if (device->errorlatch == ALC_NO_ERROR) {
-                device->errorlatch = alcerr;
-            }
+    ContextWrapper *ctx;
+    MotionChannel *ch = NULL;
+    ALfloat *current = NULL;
+    uint32 numvals = 3;
+
+    if (!motion_quantum) {
+        return 0;
+    }
+
+    APILOCK();
+    ctx = current_context;
+    if (ctx) {
+        switch (param) {
+            case AL_POSITION: ch = &ctx->listener_motion_position; current = ctx->listener_position; break;
+            case AL_VELOCITY: ch = &ctx->listener_motion_velocity; current = ctx->listener_velocity; break;
+            case AL_ORIENTATION: ch = &ctx->listener_motion_orientation; current = ctx->listener_orientation; numvals = 6; break;
+            default: break;
         }
     }
-    return alcerr;
-}
 
-static void check_al_async_states(void);
+    if (!ch || !values || !motion_quantizable(values, numvals)) {
+        cancel_motion(ch);
+        APIUNLOCK();
+        return 0;
+    }
+
+    metrics_begin_call(entryid);
+    check_shmring();
+    check_checkpoint();
+    check_resource_sample();
+    record_motion(ch, ALTRACE_MOTION_LISTENER, 0, param, values, numvals);
+    metrics_real_begin();
+    REAL_alListenerfv(param, values);
+    metrics_real_end();
+    memcpy(current, values, sizeof (ALfloat) * numvals);
+    motion_end_call();
+    return 1;
+}
 
-#define IO_START(e) \
+#define IO_START_FLUSHING(e, flush) \
     { \
         APILOCK(); \
+        metrics_begin_call(ALEE_##e); \
+        check_shmring(); \
+        check_checkpoint(); \
+        check_resource_sample(); \
+        flush; \
         IO_ENTRYINFO(ALEE_##e)
 
+#define IO_START(e) IO_START_FLUSHING(e, check_motion_flush(ALEE_##e))
+#define IO_START_SOURCES(e, n, names) IO_START_FLUSHING(e, flush_source_motion(n, names))
+
 #define IO_END() \
+        check_perf_counters(); \
         check_al_error_events(); \
         check_al_async_states(); \
+        metrics_end_call(); \
         APIUNLOCK(); \
     }
 
 #define IO_END_ALC(dev) \
+        check_perf_counters(); \
         check_alc_error_events(dev); \
         check_al_async_states(); \
+        metrics_end_call(); \
         APIUNLOCK(); \
     }
 
@@ -439,9 +1979,8 @@ static const char *get_procname(const int argc, char **argv)
     return procname;
 }
 
-static char *choose_tracefile_name(const int argc, char **argv)
+static char *choose_tracefile_name(void)
 {
-    const char *procname = get_procname(argc, argv);
     char *retval = sprintf_alloc("%s.altrace", procname);
     int i = 1;
 
@@ -452,13 +1991,122 @@ static char *choose_tracefile_name(const int argc, char **argv)
         }
 
         fclose(f);
-        free(retval);
         retval = sprintf_alloc("%s.%d.altrace", procname, i);
         i++;
     }
     return retval;
 }
 
+static void write_process_forked_event(const uint32 parentpid, const char *parentfile, const uint64 parentoffset)
+{
+    IO_EVENTENUM(ALEE_PROCESS_FORKED);
+    IO_UINT32(now());
+    IO_UINT32(parentpid);
+    IO_UINT32((uint32) getpid());
+    IO_STRING(parentfile);
+    IO_UINT64(parentoffset);
+}
+
+// fork() support. If the child kept using our logfd, both processes would
+//  interleave writes into the same file and corrupt it, so the child gets a
+//  tracefile of its own, which starts with a note pointing back at the
+//  parent's. We hold the API lock across the fork, so neither process can be
+//  halfway through writing an event when it happens.
+static void atfork_prepare(void)
+{
+    if (apilock) {
+        APILOCK();
+        fork_locked = 1;
+        fork_parent_offset = logbytes;
+    }
+}
+
+static void atfork_parent(void)
+{
+    if (fork_locked) {
+        fork_locked = 0;
+        APIUNLOCK();
+    }
+}
+
+static void atfork_child(void)
+{
+    const uint32 parentpid = (uint32) getppid();
+    char *parentfile = logfilename;
+
+    if (!fork_locked) {
+        return;  // we had already shut down.
+    }
+
+    // atfork_prepare() took the API lock on the thread that called fork(),
+    //  which is the only thread the child has, so we still hold it here.
+    //  Everything else is the parent's, though.
+
+    // the shared memory ring and the tracefile both belong to the parent.
+    if (shmring) {
+        shmring_forget(shmring);
+        shmring = NULL;
+    }
+
+    #ifdef ALTRACE_HAVE_IO_URING
+    // unsubmitted buffers are the parent's data; it'll write them out itself.
+    uring_destroy(uring);
+    uring = NULL;
+    #endif
+
+    if (logfd != -1) {
+        close(logfd);
+    }
+
+    logfilename = sprintf_alloc("%s.fork%d.altrace", procname, (int) getpid());
+    logfilename = logfilename ? strdup(logfilename) : NULL;
+    logfd = logfilename ? open_tracefile(logfilename) : -1;
+    if (logfd == -1) {
+        fprintf(stderr, "%s: Failed to open OpenAL log file '%s' for forked process: %s\n", GAppName, logfilename, logfilename ? strerror(errno) : "Out of memory");
+    } else {
+        fprintf(stderr, "%s: Forked process %d is recording OpenAL session to log file '%s'\n", GAppName, (int) getpid(), logfilename);
+    }
+    fflush(stderr);
+
+    free_stackframe_map();  // the new file needs its own copy of callstack symbols.
+    forget_log_threads();  // ...and numbers its threads from scratch.
+    eventcount = 0;
+
+    #ifdef __linux__
+    perf_close_thread();  // these were counting the parent's thread.
+    #endif
+    perf_pending = 0;
+    sched_calls = 0;  // the child's thread starts fresh.
+    sched_last_nvcsw = sched_last_nivcsw = 0;
+    forget_openal_threads();  // the child only has the thread that called fork().
+    resource_sampled = 0;
+    motion_generation++;  // the new file needs motion channels defined again...
+    while (motion_queue_len) {  // ...and anything still queued belongs to the parent's.
+        motion_queue[--motion_queue_len]->queued = 0;
+    }
+
+    // the metrics thread didn't come along, and the socket belongs to the parent.
+    // !!! FIXME: serve the child's metrics somewhere, too?
+    metrics_enabled = 0;
+    metrics_thread_running = 0;
+    if (metrics_fd != -1) {
+        close(metrics_fd);
+        metrics_fd = -1;
+    }
+    free(metrics_socket_path);
+    metrics_socket_path = NULL;
+
+    IO_UINT32(ALTRACE_LOG_FILE_MAGIC);
+    IO_UINT32(ALTRACE_LOG_FILE_FORMAT);
+    write_process_forked_event(parentpid, parentfile, (uint64) fork_parent_offset);
+    end_record();
+
+    free(parentfile);
+
+    fork_locked = 0;
+    APIUNLOCK();
+}
+
 static void init_altrace_record(int argc, char **argv) __attribute__((constructor));
 static void init_altrace_record(int argc, char **argv)
 {
@@ -486,15 +2134,99 @@ static void init_altrace_record(int argc, char **argv)
     }
 
     if (okay) {
-        char *filename = choose_tracefile_name(argc, argv);
-        logfd = filename ? open(filename, O_WRONLY | O_TRUNC | O_CREAT, 0644) : -1;
+        const int rc = pthread_atfork(atfork_prepare, atfork_parent, atfork_child);
+        if (rc != 0) {
+            fprintf(stderr, "%s: Failed to install fork handlers: %s\n", GAppName, strerror(rc));
+            okay = 0;
+        }
+    }
+
+    procname = get_procname(argc, argv);
+
+    if (okay) {
+        const char *envr = getenv("ALTRACE_CHECKPOINT_INTERVAL");
+        checkpoint_interval = envr ? (uint32) strtoul(envr, NULL, 10) : 1000;
+        envr = getenv("ALTRACE_CHUNKED");
+        chunked = (envr && (atoi(envr) != 0));
+        if (chunked && !checkpoint_interval) {
+            fprintf(stderr, "%s: ALTRACE_CHUNKED needs checkpoints; ignoring ALTRACE_CHECKPOINT_INTERVAL=0.\n", GAppName);
+            checkpoint_interval = 1000;
+        }
+    }
+
+    if (okay && getenv("ALTRACE_PERF_COUNTERS")) {
+        okay = perf_init();
+        perf_counters_enabled = okay;
+    }
+
+    if (okay) {
+        const char *envr = getenv("ALTRACE_RESOURCE_SAMPLE");
+        resource_sample_interval = envr ? (uint32) strtoul(envr, NULL, 10) : 0;
+        #ifndef __linux__
+        if (resource_sample_interval) {
+            fprintf(stderr, "%s: resource sampling isn't supported on this platform.\n", GAppName);
+            resource_sample_interval = 0;
+        }
+        #endif
+    }
+
+    if (okay) {
+        const char *envr = getenv("ALTRACE_LATENCY_SAMPLE");
+        latency_sample_interval = envr ? (uint32) strtoul(envr, NULL, 10) : 100;
+    }
+
+    if (okay) {
+        const char *envr = getenv("ALTRACE_SCHED_SAMPLE");
+        sched_sample_interval = envr ? (uint32) strtoul(envr, NULL, 10) : 0;
+        #ifndef __linux__
+        if (sched_sample_interval) {
+            fprintf(stderr, "%s: scheduler sampling isn't supported on this platform.\n", GAppName);
+            sched_sample_interval = 0;
+        }
+        #endif
+    }
+
+    if (okay) {
+        const char *shmname = getenv("ALTRACE_SHM");
+        if (shmname && *shmname) {
+            const char *envr = getenv("ALTRACE_SHM_SIZE");
+            const uint64 size = envr ? (((uint64) strtoull(envr, NULL, 10)) * 1024 * 1024) : ALTRACE_SHM_DEFAULT_SIZE;
+            shmring = shmring_create(shmname, size ? size : ALTRACE_SHM_DEFAULT_SIZE);
+            if (!shmring) {
+                okay = 0;
+            } else {
+                fprintf(stderr, "%s: Publishing OpenAL session to shared memory ring '%s'\n", GAppName, shmname);
+            }
+        }
+    }
+
+    if (okay) {
+        const char *envr = getenv("ALTRACE_MOTION");
+        motion_quantum = envr ? (strtod(envr, NULL) * 2.0) : 0.0;  // rounding is off by at most half a step.
+        if (motion_quantum < 0.0) {
+            motion_quantum = 0.0;
+        }
+        motion_limit = motion_quantum * 4503599627370496.0;  // 2^52, so deltas can't overflow, either.
+        motion_per_frame = (motion_quantum > 0.0) && (getenv("ALTRACE_MOTION_PER_FRAME") != NULL);
+    }
+
+    if (okay) {
+        const char *envr = getenv("ALTRACE_METRICS");
+        if (envr && *envr) {
+            okay = metrics_init(envr);
+        }
+    }
+
+    if (okay && !(shmring && getenv("ALTRACE_SHM_ONLY"))) {
+        char *filename = choose_tracefile_name();
+        logfd = filename ? open_tracefile(filename) : -1;
         if (logfd == -1) {
             fprintf(stderr, "%s: Failed to open OpenAL log file '%s': %s\n", GAppName, filename, filename ? strerror(errno) : "Out of memory");
             okay = 0;
         } else {
             fprintf(stderr, "%s: Recording OpenAL session to log file '%s'\n\n\n", GAppName, filename);
+            logfilename = strdup(filename);
         }
-        free(filename);
     }
 
     fflush(stderr);
@@ -511,18 +2243,50 @@ static void init_altrace_record(int argc, char **argv)
 static void quit_altrace_record(void)
 {
     const int io = logfd;
+    ShmRing *ring = shmring;
     pthread_mutex_t *mutex = apilock;
+    #ifdef ALTRACE_HAVE_IO_URING
+    UringWriter *wr = uring;
+    uring = NULL;
+    #endif
+
+    metrics_quit();  // before the API lock goes away.
+
+    // write whatever the last frame left behind. If the lock is taken, we're
+    //  probably bailing out from inside an entry point, so don't bother.
+    if (mutex && (pthread_mutex_trylock(mutex) == 0)) {
+        flush_motion();
+        end_record();
+        pthread_mutex_unlock(mutex);
+    }
+    free(motion_queue);
+    motion_queue = NULL;
+    motion_queue_len = motion_queue_alloc = 0;
 
     logfd = -1;
+    shmring = NULL;
     apilock = NULL;
 
+    free(logfilename);
+    logfilename = NULL;
+
     fprintf(stderr, "%s: Shutting down...\n", GAppName);
     fflush(stderr);
 
     if (io != -1) {
-        const uint32 eos = swap32((uint32) ALEE_EOS);
-        const uint32 ticks = swap32(now());
-        if ((write(io, &eos, 4) != 4) || (write(io, &ticks, 4) != 4)) {
+        uint32 eos[3];
+        eos[0] = swap32((uint32) ALEE_EOS);
+        eos[1] = swap32(4);  // its length.
+        eos[2] = swap32(now());
+        #ifdef ALTRACE_HAVE_IO_URING
+        if (wr) {
+            if (!uring_write(wr, eos, sizeof (eos)) || !uring_finish(wr, logbytes + sizeof (eos))) {
+                fprintf(stderr, "%s: Failed to write EOS to OpenAL log file: %s\n", GAppName, strerror(errno));
+            }
+            uring_destroy(wr);
+        } else
+        #endif
+        if (write(io, eos, sizeof (eos)) != sizeof (eos)) {
             fprintf(stderr, "%s: Failed to write EOS to OpenAL log file: %s\n", GAppName, strerror(errno));
         }
         if (close(io) < 0) {
@@ -530,15 +2294,41 @@ static void quit_altrace_record(void)
         }
     }
 
+    if (ring) {
+        const int rc = shmring_begin_event(ring);
+        if (rc) {
+            const uint32 magic = swap32(ALTRACE_LOG_FILE_MAGIC);
+            const uint32 format = swap32(ALTRACE_LOG_FILE_FORMAT);
+            uint32 eos[3];
+            eos[0] = swap32((uint32) ALEE_EOS);
+            eos[1] = swap32(4);
+            eos[2] = swap32(now());
+            if (rc == 2) {  // consumer showed up just in time to see us leave.
+                shmring_write(ring, &magic, sizeof (magic));
+                shmring_write(ring, &format, sizeof (format));
+            }
+            shmring_write(ring, eos, sizeof (eos));
+        }
+        shmring_close(ring);
+    }
+
     if (mutex) {
         pthread_mutex_destroy(mutex);
     }
 
+    #ifndef ALTRACE_STATIC_RECORDER
     #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) REAL_##name = NULL;
     #include "altrace_entrypoints.h"
+    #endif
 
     close_real_openal();
     free_stackframe_map();
+    forget_openal_threads();
+    forget_log_threads();
+    free_trace_names();
+    free(record);
+    record = NULL;
+    record_len = record_alloc = 0;
 
     fflush(stderr);
 }
@@ -549,7 +2339,9 @@ ALCcontext *alcGetCurrentContext(void)
 {
     ALCcontext *retval;
     IO_START(alcGetCurrentContext);
+    PERF_BEGIN();
     retval = REAL_alcGetCurrentContext();
+    PERF_END();
     (void) retval; // !!! FIXME: assert this hasn't gone out of sync with current_context...
     IO_PTR(current_context);
     IO_END_ALC(NULL);
@@ -562,7 +2354,9 @@ ALCdevice *alcGetContextsDevice(ALCcontext *_ctx)
     ALCdevice *retval;
     IO_START(alcGetContextsDevice);
     IO_PTR(ctx);
+    PERF_BEGIN();
     retval = REAL_alcGetContextsDevice(ctx->ctx);
+    PERF_END();
     (void) retval; // !!! FIXME: assert this hasn't gone out of sync with current_context...
     IO_PTR(ctx->device);
     IO_END_ALC(ctx->device);
@@ -580,7 +2374,9 @@ ALCboolean alcIsExtensionPresent(ALCdevice *_device, const ALCchar *extname)
         retval = ALC_TRUE;
 } else if (strcasecmp(extname, "ALC_EXT_EFX") == 0) { retval = ALC_FALSE;  // !!! FIXME
     } else {
+        PERF_BEGIN();
         retval = REAL_alcIsExtensionPresent(device->device, extname);
+        PERF_END();
     }
     IO_ALCBOOLEAN(retval);
     IO_END_ALC(device);
@@ -616,7 +2412,9 @@ ALCenum alcGetEnumValue(ALCdevice *_device, const ALCchar *enumname)
     IO_START(alcGetEnumValue);
     IO_PTR(_device);
     IO_STRING(enumname);
+    PERF_BEGIN();
     retval = REAL_alcGetEnumValue(device->device, enumname);
+    PERF_END();
     IO_ALCENUM(retval);
     IO_END_ALC(device);
     return retval;
@@ -629,7 +2427,9 @@ const ALCchar *alcGetString(ALCdevice *_device, ALCenum param)
     IO_START(alcGetString);
     IO_PTR(_device);
     IO_ALCENUM(param);
+    PERF_BEGIN();
     retval = REAL_alcGetString(device->device, param);
+    PERF_END();
 
     if ((param == ALC_EXTENSIONS) && retval) {
         const char *addstr = "ALC_EXT_trace_info";
@@ -661,7 +2461,11 @@ ALCdevice *alcCaptureOpenDevice(const ALCchar *devicename, ALCuint frequency, AL
     IO_UINT32(frequency);
     IO_ALCENUM(format);
     IO_ALSIZEI(buffersize);
+    TRACK_OPENAL_THREADS_BEGIN();
+    PERF_BEGIN();
     retval = REAL_alcCaptureOpenDevice(devicename, frequency, format, buffersize);
+    PERF_END();
+    TRACK_OPENAL_THREADS_END();
     IO_PTR(retval ? device : NULL);
 
     if (!retval) {
@@ -712,7 +2516,10 @@ ALCboolean alcCaptureCloseDevice(ALCdevice *_device)
     ALCboolean retval;
     IO_START(alcCaptureCloseDevice);
     IO_PTR(_device);
+    remember_label(ALEE_alcTraceDeviceLabel, (uint64) (size_t) _device, NULL);
+    PERF_BEGIN();
     retval = REAL_alcCaptureCloseDevice(device->device);
+    PERF_END();
     IO_ALCBOOLEAN(retval);
 
     if (retval == ALC_TRUE) {
@@ -743,7 +2550,11 @@ ALCdevice *alcOpenDevice(const ALCchar *devicename)
 
     IO_START(alcOpenDevice);
     IO_STRING(devicename);
+    TRACK_OPENAL_THREADS_BEGIN();
+    PERF_BEGIN();
     retval = REAL_alcOpenDevice(devicename);
+    PERF_END();
+    TRACK_OPENAL_THREADS_END();
     IO_PTR(retval ? device : NULL);
 
     if (!retval) {
@@ -756,6 +2567,9 @@ ALCdevice *alcOpenDevice(const ALCchar *devicename)
         device->iscapture = ALC_FALSE;
         device->connected = ALC_TRUE;
         device->supports_disconnect_ext = REAL_alcIsExtensionPresent(device->device, "ALC_EXT_disconnect");
+        if (REAL_alcIsExtensionPresent(device->device, "ALC_SOFT_device_clock")) {
+            device->alcGetInteger64vSOFT = (void (*)(ALCdevice *, ALCenum, ALsizei, int64 *)) REAL_alcGetProcAddress(device->device, "alcGetInteger64vSOFT");
+        }
 
         device->next = null_device.next;
         device->prev = &null_device;
@@ -784,7 +2598,10 @@ ALCboolean alcCloseDevice(ALCdevice *_device)
     ALCboolean retval;
     IO_START(alcCloseDevice);
     IO_PTR(_device);
+    remember_label(ALEE_alcTraceDeviceLabel, (uint64) (size_t) _device, NULL);
+    PERF_BEGIN();
     retval = REAL_alcCloseDevice(device->device);
+    PERF_END();
     IO_ALCBOOLEAN(retval);
 
     if (retval == ALC_TRUE) {
@@ -880,6 +2697,40 @@ static void check_context_state(void)
     }
 }
 
+/* ALC_ALL_ATTRIBUTES is what the device actually gave us (mixing rate,
+   refresh, voice limits, etc), which isn't necessarily what the app asked
+   for in its attrlist, so record it once when the context is created. */
+static void query_context_attribs(ContextWrapper *ctx)
+{
+    ALCdevice *device = ctx->device->device;
+    ALCint *attrs = NULL;
+    ALCint size = 0;
+    uint32 count = 0;
+    uint32 i;
+
+    REAL_alcGetIntegerv(device, ALC_ATTRIBUTES_SIZE, 1, &size);
+    if (size > 0) {
+        attrs = (ALCint *) calloc(size, sizeof (ALCint));
+        if (!attrs) {
+            out_of_memory();
+        }
+        REAL_alcGetIntegerv(device, ALC_ALL_ATTRIBUTES, size, attrs);
+        while ((count < ((uint32) size) - 1) && (attrs[count] != 0)) { count += 2; }
+    }
+
+    /* don't let our queries show up as the app's errors. */
+    REAL_alcGetError(device);
+
+    IO_EVENTENUM(ALEE_CONTEXT_ATTRIBUTES);
+    IO_PTR(ctx);
+    IO_UINT32(count);
+    for (i = 0; i < count; i++) {
+        IO_INT32(attrs[i]);
+    }
+
+    free(attrs);
+}
+
 ALCcontext *alcCreateContext(ALCdevice *_device, const ALCint* attrlist)
 {
     DeviceWrapper *device = _device ? (DeviceWrapper *) _device : &null_device;
@@ -905,7 +2756,11 @@ ALCcontext *alcCreateContext(ALCdevice *_device, const ALCint* attrlist)
             IO_INT32(attrlist[i]);
         }
     }
+    TRACK_OPENAL_THREADS_BEGIN();
+    PERF_BEGIN();
     retval = REAL_alcCreateContext(device->device, attrlist);
+    PERF_END();
+    TRACK_OPENAL_THREADS_END();
     IO_PTR(retval ? ctx : NULL);
 
     if (retval == NULL) {
@@ -927,6 +2782,8 @@ ALCcontext *alcCreateContext(ALCdevice *_device, const ALCint* attrlist)
         if (ctx->next) {
             ctx->next->prev = ctx;
         }
+
+        query_context_attribs(ctx);
     }
 
     IO_END_ALC(device);
@@ -945,17 +2802,6 @@ static void query_context_string(ContextWrapper *ctx, const ALenum param)
     IO_STRING(str);
 }
 
-static void query_context_attribs(ContextWrapper *ctx)
-{
-/* !!! FIXME
-    if (!ctx->device->iscapture) {
-        ALint numattr = 0;
-        REAL_a
-        case ALC_ATTRIBUTES_SIZE:
-        case ALC_ALL_ATTRIBUTES:
-*/
-}
-
 static void check_context_static_state(ContextWrapper *ctx)
 {
     if (ctx && !ctx->checked_static_state) {
@@ -964,7 +2810,9 @@ static void check_context_static_state(ContextWrapper *ctx)
         query_context_string(ctx, AL_RENDERER);
         query_context_string(ctx, AL_VENDOR);
         query_context_string(ctx, AL_EXTENSIONS);
-        query_context_attribs(ctx);
+        if (REAL_alIsExtensionPresent("AL_SOFT_source_latency")) {
+            ctx->alGetSourcei64vSOFT = (void (*)(ALuint, ALenum, int64 *)) REAL_alGetProcAddress("alGetSourcei64vSOFT");
+        }
     }
 }
 
@@ -974,7 +2822,9 @@ ALCboolean alcMakeContextCurrent(ALCcontext *_ctx)
     ALCboolean retval;
     IO_START(alcMakeContextCurrent);
     IO_PTR(ctx);
+    PERF_BEGIN();
     retval = REAL_alcMakeContextCurrent(ctx ? ctx->ctx : NULL);
+    PERF_END();
     IO_ALCBOOLEAN(retval);
     if (retval) {
         current_context = ctx;
@@ -992,7 +2842,9 @@ void alcProcessContext(ALCcontext *_ctx)
     ContextWrapper *ctx = (ContextWrapper *) _ctx;
     IO_START(alcProcessContext);
     IO_PTR(ctx);
+    PERF_BEGIN();
     REAL_alcProcessContext(ctx ? ctx->ctx : NULL);
+    PERF_END();
     IO_END_ALC(ctx ? ctx->device : NULL);
 }
 
@@ -1001,7 +2853,9 @@ void alcSuspendContext(ALCcontext *_ctx)
     ContextWrapper *ctx = (ContextWrapper *) _ctx;
     IO_START(alcSuspendContext);
     IO_PTR(ctx);
+    PERF_BEGIN();
     REAL_alcSuspendContext(ctx ? ctx->ctx : NULL);
+    PERF_END();
     IO_END_ALC(ctx ? ctx->device : NULL);
 }
 
@@ -1011,7 +2865,10 @@ void alcDestroyContext(ALCcontext *_ctx)
     DeviceWrapper *device = NULL;
     IO_START(alcDestroyContext);
     IO_PTR(ctx);
+    remember_label(ALEE_alcTraceContextLabel, (uint64) (size_t) ctx, NULL);
+    PERF_BEGIN();
     REAL_alcDestroyContext(ctx ? ctx->ctx : NULL);
+    PERF_END();
 // !!! FIXME: see if this triggered an error and don't clean up if so.
     if (ctx) {
         device = ctx->device;
@@ -1058,7 +2915,9 @@ void alcGetIntegerv(ALCdevice *_device, ALCenum param, ALCsizei size, ALCint *va
         memset(values, '\0', size * sizeof (ALCint));
     }
 
+    PERF_BEGIN();
     REAL_alcGetIntegerv(device->device, param, size, values);
+    PERF_END();
 
     if (values) {
         for (i = 0; i < size; i++) {
@@ -1074,7 +2933,9 @@ void alcCaptureStart(ALCdevice *_device)
     DeviceWrapper *device = _device ? (DeviceWrapper *) _device : &null_device;
     IO_START(alcCaptureStart);
     IO_PTR(_device);
+    PERF_BEGIN();
     REAL_alcCaptureStart(device->device);
+    PERF_END();
     IO_END_ALC(device);
 }
 
@@ -1083,7 +2944,9 @@ void alcCaptureStop(ALCdevice *_device)
     DeviceWrapper *device = _device ? (DeviceWrapper *) _device : &null_device;
     IO_START(alcCaptureStop);
     IO_PTR(_device);
+    PERF_BEGIN();
     REAL_alcCaptureStop(device->device);
+    PERF_END();
     IO_END_ALC(device);
 }
 
@@ -1097,7 +2960,9 @@ void alcCaptureSamples(ALCdevice *_device, ALCvoid *buffer, ALCsizei samples)
     if (samples && device->samplesize) {
         memset(buffer, '\0', samples * device->samplesize);
     }
+    PERF_BEGIN();
     REAL_alcCaptureSamples(device->device, buffer, samples);
+    PERF_END();
     IO_BLOB(buffer, samples * device->samplesize);
     IO_END_ALC(device);
 }
@@ -1106,7 +2971,9 @@ void alDopplerFactor(ALfloat value)
 {
     IO_START(alDopplerFactor);
     IO_FLOAT(value);
+    PERF_BEGIN();
     REAL_alDopplerFactor(value);
+    PERF_END();
     if (current_context) { check_context_state_float(AL_DOPPLER_FACTOR, &current_context->doppler_factor); }
     IO_END();
 }
@@ -1115,7 +2982,9 @@ void alDopplerVelocity(ALfloat value)
 {
     IO_START(alDopplerVelocity);
     IO_FLOAT(value);
+    PERF_BEGIN();
     REAL_alDopplerVelocity(value);
+    PERF_END();
     if (current_context) { check_context_state_float(AL_DOPPLER_VELOCITY, &current_context->doppler_velocity); }
     IO_END();
 }
@@ -1124,7 +2993,9 @@ void alSpeedOfSound(ALfloat value)
 {
     IO_START(alSpeedOfSound);
     IO_FLOAT(value);
+    PERF_BEGIN();
     REAL_alSpeedOfSound(value);
+    PERF_END();
     if (current_context) { check_context_state_float(AL_SPEED_OF_SOUND, &current_context->speed_of_sound); }
     IO_END();
 }
@@ -1133,7 +3004,9 @@ void alDistanceModel(ALenum model)
 {
     IO_START(alDistanceModel);
     IO_ENUM(model);
+    PERF_BEGIN();
     REAL_alDistanceModel(model);
+    PERF_END();
     if (current_context) { check_context_state_enum(AL_DISTANCE_MODEL, &current_context->distance_model); }
     IO_END();
 }
@@ -1142,7 +3015,9 @@ void alEnable(ALenum capability)
 {
     IO_START(alEnable);
     IO_ENUM(capability);
+    PERF_BEGIN();
     REAL_alEnable(capability);
+    PERF_END();
     IO_END();
 }
 
@@ -1150,7 +3025,9 @@ void alDisable(ALenum capability)
 {
     IO_START(alDisable);
     IO_ENUM(capability);
+    PERF_BEGIN();
     REAL_alDisable(capability);
+    PERF_END();
     IO_END();
 }
 
@@ -1159,7 +3036,9 @@ ALboolean alIsEnabled(ALenum capability)
     ALboolean retval;
     IO_START(alIsEnabled);
     IO_ENUM(capability);
+    PERF_BEGIN();
     retval = REAL_alIsEnabled(capability);
+    PERF_END();
     IO_BOOLEAN(retval);
     IO_END();
     return retval;
@@ -1170,7 +3049,9 @@ const ALchar *alGetString(const ALenum param)
     const ALchar *retval;
     IO_START(alGetString);
     IO_ENUM(param);
+    PERF_BEGIN();
     retval = REAL_alGetString(param);
+    PERF_END();
 
     if (param == AL_EXTENSIONS) {
         if (retval && current_context) {
@@ -1203,7 +3084,9 @@ void alGetBooleanv(ALenum param, ALboolean *values)
     if (numvals) {
         memset(values, '\0', numvals * sizeof (ALboolean));
     }
+    PERF_BEGIN();
     REAL_alGetBooleanv(param, values);
+    PERF_END();
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
         IO_BOOLEAN(values[i]);
@@ -1227,7 +3110,9 @@ void alGetIntegerv(ALenum param, ALint *values)
     if (numvals) {
         memset(values, '\0', numvals * sizeof (ALint));
     }
+    PERF_BEGIN();
     REAL_alGetIntegerv(param, values);
+    PERF_END();
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
         IO_INT32(values[i]);
@@ -1253,7 +3138,9 @@ void alGetFloatv(ALenum param, ALfloat *values)
     if (numvals) {
         memset(values, '\0', numvals * sizeof (ALfloat));
     }
+    PERF_BEGIN();
     REAL_alGetFloatv(param, values);
+    PERF_END();
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
         IO_FLOAT(values[i]);
@@ -1273,7 +3160,9 @@ void alGetDoublev(ALenum param, ALdouble *values)
     if (numvals) {
         memset(values, '\0', numvals * sizeof (ALdouble));
     }
+    PERF_BEGIN();
     REAL_alGetDoublev(param, values);
+    PERF_END();
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
         IO_DOUBLE(values[i]);
@@ -1286,7 +3175,9 @@ ALboolean alGetBoolean(ALenum param)
     ALboolean retval;
     IO_START(alGetBoolean);
     IO_ENUM(param);
+    PERF_BEGIN();
     retval = REAL_alGetBoolean(param);
+    PERF_END();
     IO_BOOLEAN(retval);
     IO_END();
     return retval;
@@ -1297,7 +3188,9 @@ ALint alGetInteger(ALenum param)
     ALint retval;
     IO_START(alGetInteger);
     IO_ENUM(param);
+    PERF_BEGIN();
     retval = REAL_alGetInteger(param);
+    PERF_END();
     IO_INT32(retval);
     IO_END();
     return retval;
@@ -1308,7 +3201,9 @@ ALfloat alGetFloat(ALenum param)
     ALfloat retval;
     IO_START(alGetFloat);
     IO_ENUM(param);
+    PERF_BEGIN();
     retval = REAL_alGetFloat(param);
+    PERF_END();
     IO_FLOAT(retval);
     IO_END();
     return retval;
@@ -1319,7 +3214,9 @@ ALdouble alGetDouble(ALenum param)
     ALdouble retval;
     IO_START(alGetDouble);
     IO_ENUM(param);
+    PERF_BEGIN();
     retval = REAL_alGetDouble(param);
+    PERF_END();
     IO_DOUBLE(retval);
     IO_END();
     return retval;
@@ -1333,7 +3230,9 @@ ALboolean alIsExtensionPresent(const ALchar *extname)
     if (strcasecmp(extname, "AL_EXT_trace_info") == 0) {
         retval = AL_TRUE;
     } else {
+        PERF_BEGIN();
         retval = REAL_alIsExtensionPresent(extname);
+        PERF_END();
     }
     IO_BOOLEAN(retval);
     IO_END();
@@ -1382,7 +3281,9 @@ ALenum alGetEnumValue(const ALchar *enumname)
     ALenum retval;
     IO_START(alGetEnumValue);
     IO_STRING(enumname);
+    PERF_BEGIN();
     retval = REAL_alGetEnumValue(enumname);
+    PERF_END();
     IO_ENUM(retval);
     IO_END();
     return retval;
@@ -1392,6 +3293,9 @@ void alListenerfv(ALenum param, const ALfloat *values)
 {
     uint32 numvals = 1;
     uint32 i;
+    if (motion_listener(ALEE_alListenerfv, param, values)) {
+        return;
+    }
     IO_START(alListenerfv);
     IO_ENUM(param);
     IO_PTR(values);
@@ -1411,7 +3315,9 @@ void alListenerfv(ALenum param, const ALfloat *values)
         IO_FLOAT(values[i]);
     }
 
+    PERF_BEGIN();
     REAL_alListenerfv(param, values);
+    PERF_END();
 
     check_listener_state();
 
@@ -1423,19 +3329,29 @@ void alListenerf(ALenum param, ALfloat value)
     IO_START(alListenerf);
     IO_ENUM(param);
     IO_FLOAT(value);
+    PERF_BEGIN();
     REAL_alListenerf(param, value);
+    PERF_END();
     check_listener_state();
     IO_END();
 }
 
 void alListener3f(ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
 {
+    if ((param == AL_POSITION) || (param == AL_VELOCITY)) {
+        const ALfloat values[3] = { value1, value2, value3 };
+        if (motion_listener(ALEE_alListener3f, param, values)) {
+            return;
+        }
+    }
     IO_START(alListener3f);
     IO_ENUM(param);
     IO_FLOAT(value1);
     IO_FLOAT(value2);
     IO_FLOAT(value3);
+    PERF_BEGIN();
     REAL_alListener3f(param, value1, value2, value3);
+    PERF_END();
     check_listener_state();
     IO_END();
 }
@@ -1460,7 +3376,9 @@ void alListeneriv(ALenum param, const ALint *values)
         IO_INT32(values[i]);
     }
 
+    PERF_BEGIN();
     REAL_alListeneriv(param, values);
+    PERF_END();
 
     check_listener_state();
 
@@ -1472,7 +3390,9 @@ void alListeneri(ALenum param, ALint value)
     IO_START(alListeneri);
     IO_ENUM(param);
     IO_INT32(value);
+    PERF_BEGIN();
     REAL_alListeneri(param, value);
+    PERF_END();
     check_listener_state();
     IO_END();
 }
@@ -1484,7 +3404,9 @@ void alListener3i(ALenum param, ALint value1, ALint value2, ALint value3)
     IO_INT32(value1);
     IO_INT32(value2);
     IO_INT32(value3);
+    PERF_BEGIN();
     REAL_alListener3i(param, value1, value2, value3);
+    PERF_END();
     check_listener_state();
     IO_END();
 }
@@ -1509,7 +3431,9 @@ void alGetListenerfv(ALenum param, ALfloat *values)
         memset(values, '\0', numvals * sizeof (ALfloat));
     }
 
+    PERF_BEGIN();
     REAL_alGetListenerfv(param, values);
+    PERF_END();
 
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
@@ -1524,7 +3448,9 @@ void alGetListenerf(ALenum param, ALfloat *value)
     IO_START(alGetListenerf);
     IO_ENUM(param);
     IO_PTR(value);
+    PERF_BEGIN();
     REAL_alGetListenerf(param, value);
+    PERF_END();
     IO_FLOAT(value ? *value : 0.0f);
     IO_END();
 }
@@ -1536,7 +3462,9 @@ void alGetListener3f(ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *va
     IO_PTR(value1);
     IO_PTR(value2);
     IO_PTR(value3);
+    PERF_BEGIN();
     REAL_alGetListener3f(param, value1, value2, value3);
+    PERF_END();
     IO_FLOAT(value1 ? *value1 : 0.0f);
     IO_FLOAT(value2 ? *value2 : 0.0f);
     IO_FLOAT(value3 ? *value3 : 0.0f);
@@ -1563,7 +3491,9 @@ void alGetListeneriv(ALenum param, ALint *values)
         memset(values, '\0', numvals * sizeof (ALdouble));
     }
 
+    PERF_BEGIN();
     REAL_alGetListeneriv(param, values);
+    PERF_END();
 
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
@@ -1578,7 +3508,9 @@ void alGetListeneri(ALenum param, ALint *value)
     IO_START(alGetListeneri);
     IO_ENUM(param);
     IO_PTR(value);
+    PERF_BEGIN();
     REAL_alGetListeneri(param, value);
+    PERF_END();
     IO_INT32(value ? *value : 0);
     IO_END();
 }
@@ -1590,7 +3522,9 @@ void alGetListener3i(ALenum param, ALint *value1, ALint *value2, ALint *value3)
     IO_PTR(value1);
     IO_PTR(value2);
     IO_PTR(value3);
+    PERF_BEGIN();
     REAL_alGetListener3i(param, value1, value2, value3);
+    PERF_END();
     IO_INT32(value1 ? *value1 : 0);
     IO_INT32(value2 ? *value2 : 0);
     IO_INT32(value3 ? *value3 : 0);
@@ -1626,6 +3560,7 @@ static void check_source_state_bool(SourceWrapper *src, const ALenum param, ALbo
     newval = ival ? AL_TRUE : AL_FALSE;
     if (newval != *current) {
         IO_EVENTENUM(ALEE_SOURCE_STATE_CHANGED_BOOL);
+        IO_PTR(src->ctx);
         IO_UINT32(src->name);
         IO_ENUM(param);
         IO_BOOLEAN(newval);
@@ -1641,6 +3576,7 @@ static void check_source_state_enum(SourceWrapper *src, const ALenum param, ALen
     newval = (ALenum) ival;
     if (newval != *current) {
         IO_EVENTENUM(ALEE_SOURCE_STATE_CHANGED_ENUM);
+        IO_PTR(src->ctx);
         IO_UINT32(src->name);
         IO_ENUM(param);
         IO_ENUM(newval);
@@ -1654,6 +3590,7 @@ static void check_source_state_int(SourceWrapper *src, const ALenum param, ALint
     REAL_alGetSourcei(src->name, param, &ival);
     if (ival != *current) {
         IO_EVENTENUM(ALEE_SOURCE_STATE_CHANGED_INT);
+        IO_PTR(src->ctx);
         IO_UINT32(src->name);
         IO_ENUM(param);
         IO_INT32(ival);
@@ -1669,6 +3606,7 @@ static void check_source_state_uint(SourceWrapper *src, const ALenum param, ALui
     newval = (ALuint) ival;
     if (newval != *current) {
         IO_EVENTENUM(ALEE_SOURCE_STATE_CHANGED_UINT);
+        IO_PTR(src->ctx);
         IO_UINT32(src->name);
         IO_ENUM(param);
         IO_UINT32(newval);
@@ -1682,6 +3620,7 @@ static void check_source_state_float(SourceWrapper *src, const ALenum param, ALf
     REAL_alGetSourcef(src->name, param, &fval);
     if (fval != *current) {
         IO_EVENTENUM(ALEE_SOURCE_STATE_CHANGED_FLOAT);
+        IO_PTR(src->ctx);
         IO_UINT32(src->name);
         IO_ENUM(param);
         IO_FLOAT(fval);
@@ -1696,6 +3635,7 @@ static void check_source_state_float3(SourceWrapper *src, const ALenum param, AL
     REAL_alGetSourcefv(src->name, param, fval);
     if (memcmp(fval, current, size) != 0) {
         IO_EVENTENUM(ALEE_SOURCE_STATE_CHANGED_FLOAT3);
+        IO_PTR(src->ctx);
         IO_UINT32(src->name);
         IO_ENUM(param);
         IO_FLOAT(fval[0]);
@@ -1742,9 +3682,10 @@ static void check_source_state_from_name(const ALuint name)
     check_source_state(source_wrapped_lookup(name));
 }
 
-static void init_source_state(SourceWrapper *src, const ALuint name)
+static void init_source_state(SourceWrapper *src, ContextWrapper *ctx, const ALuint name)
 {
     memset(src, '\0', sizeof (*src));
+    src->ctx = ctx;
     src->name = name;
     src->state = AL_INITIAL;
     src->type = AL_UNDETERMINED;
@@ -1768,7 +3709,9 @@ void alGenSources(ALsizei n, ALuint *names)
     ALsizei i;
 
     memset(names, 0, n * sizeof (ALuint));
+    PERF_BEGIN();
     REAL_alGenSources(n, names);
+    PERF_END();
 
     IO_START(alGenSources);
     IO_ALSIZEI(n);
@@ -1787,7 +3730,7 @@ void alGenSources(ALsizei n, ALuint *names)
                     out_of_memory();
                 }
             
-                init_source_state(src, name);
+                init_source_state(src, ctx, name);
                 src->hash_next = ctx->wrapped_source_hash[hash];
                 if (ctx->wrapped_source_hash[hash]) {
                     ctx->wrapped_source_hash[hash]->hash_prev = src;
@@ -1810,8 +3753,11 @@ void alDeleteSources(ALsizei n, const ALuint *names)
     IO_PTR(names);
     for (i = 0; i < n; i++) {
         IO_UINT32(names[i]);
+        remember_label(ALEE_alTraceSourceLabel, names[i], NULL);
     }
+    PERF_BEGIN();
     REAL_alDeleteSources(n, names);
+    PERF_END();
 
     // objects are only deleted if there are no errors.
     if (check_al_error_events() == AL_NO_ERROR) {
@@ -1852,7 +3798,9 @@ ALboolean alIsSource(ALuint name)
     ALboolean retval;
     IO_START(alIsSource);
     IO_UINT32(name);
+    PERF_BEGIN();
     retval = REAL_alIsSource(name);
+    PERF_END();
     IO_BOOLEAN(retval);
     IO_END();
     return retval;
@@ -1862,7 +3810,10 @@ void alSourcefv(ALuint name, ALenum param, const ALfloat *values)
 {
     uint32 numvals = 1;
     uint32 i;
-    IO_START(alSourcefv);
+    if (motion_source(ALEE_alSourcefv, name, param, values)) {
+        return;
+    }
+    IO_START_SOURCES(alSourcefv, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(values);
@@ -1889,31 +3840,41 @@ void alSourcefv(ALuint name, ALenum param, const ALfloat *values)
         IO_FLOAT(values[i]);
     }
 
+    PERF_BEGIN();
     REAL_alSourcefv(name, param, values);
+    PERF_END();
     check_source_state_from_name(name);
     IO_END();
 }
 
 void alSourcef(ALuint name, ALenum param, ALfloat value)
 {
-    IO_START(alSourcef);
+    IO_START_SOURCES(alSourcef, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_FLOAT(value);
+    PERF_BEGIN();
     REAL_alSourcef(name, param, value);
+    PERF_END();
     check_source_state_from_name(name);
     IO_END();
 }
 
 void alSource3f(ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3)
 {
-    IO_START(alSource3f);
+    const ALfloat values[3] = { value1, value2, value3 };
+    if (motion_source(ALEE_alSource3f, name, param, values)) {
+        return;
+    }
+    IO_START_SOURCES(alSource3f, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_FLOAT(value1);
     IO_FLOAT(value2);
     IO_FLOAT(value3);
+    PERF_BEGIN();
     REAL_alSource3f(name, param, value1, value2, value3);
+    PERF_END();
     check_source_state_from_name(name);
     IO_END();
 }
@@ -1922,7 +3883,7 @@ void alSourceiv(ALuint name, ALenum param, const ALint *values)
 {
     uint32 numvals = 1;
     uint32 i;
-    IO_START(alSourceiv);
+    IO_START_SOURCES(alSourceiv, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(values);
@@ -1948,31 +3909,37 @@ void alSourceiv(ALuint name, ALenum param, const ALint *values)
         IO_INT32(values[i]);
     }
 
+    PERF_BEGIN();
     REAL_alSourceiv(name, param, values);
+    PERF_END();
     check_source_state_from_name(name);
     IO_END();
 }
 
 void alSourcei(ALuint name, ALenum param, ALint value)
 {
-    IO_START(alSourcei);
+    IO_START_SOURCES(alSourcei, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_INT32(value);
+    PERF_BEGIN();
     REAL_alSourcei(name, param, value);
+    PERF_END();
     check_source_state_from_name(name);
     IO_END();
 }
 
 void alSource3i(ALuint name, ALenum param, ALint value1, ALint value2, ALint value3)
 {
-    IO_START(alSource3i);
+    IO_START_SOURCES(alSource3i, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_INT32(value1);
     IO_INT32(value2);
     IO_INT32(value3);
+    PERF_BEGIN();
     REAL_alSource3i(name, param, value1, value2, value3);
+    PERF_END();
     check_source_state_from_name(name);
     IO_END();
 }
@@ -1981,7 +3948,7 @@ void alGetSourcefv(ALuint name, ALenum param, ALfloat *values)
 {
     uint32 numvals = 1;
     uint32 i;
-    IO_START(alGetSourcefv);
+    IO_START_SOURCES(alGetSourcefv, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(values);
@@ -2011,7 +3978,9 @@ void alGetSourcefv(ALuint name, ALenum param, ALfloat *values)
         memset(values, '\0', numvals * sizeof (ALfloat));
     }
 
+    PERF_BEGIN();
     REAL_alGetSourcefv(name, param, values);
+    PERF_END();
 
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
@@ -2023,24 +3992,28 @@ void alGetSourcefv(ALuint name, ALenum param, ALfloat *values)
 
 void alGetSourcef(ALuint name, ALenum param, ALfloat *value)
 {
-    IO_START(alGetSourcef);
+    IO_START_SOURCES(alGetSourcef, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(value);
+    PERF_BEGIN();
     REAL_alGetSourcef(name, param, value);
+    PERF_END();
     IO_FLOAT(value ? *value : 0.0f);
     IO_END();
 }
 
 void alGetSource3f(ALuint name, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
 {
-    IO_START(alGetSource3f);
+    IO_START_SOURCES(alGetSource3f, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(value1);
     IO_PTR(value2);
     IO_PTR(value3);
+    PERF_BEGIN();
     REAL_alGetSource3f(name, param, value1, value2, value3);
+    PERF_END();
     IO_FLOAT(value1 ? *value1 : 0.0f);
     IO_FLOAT(value2 ? *value2 : 0.0f);
     IO_FLOAT(value3 ? *value3 : 0.0f);
@@ -2051,7 +4024,7 @@ void alGetSourceiv(ALuint name, ALenum param, ALint *values)
 {
     uint32 numvals = 1;
     uint32 i;
-    IO_START(alGetSourceiv);
+    IO_START_SOURCES(alGetSourceiv, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(values);
@@ -2080,7 +4053,9 @@ void alGetSourceiv(ALuint name, ALenum param, ALint *values)
         memset(values, '\0', numvals * sizeof (ALint));
     }
 
+    PERF_BEGIN();
     REAL_alGetSourceiv(name, param, values);
+    PERF_END();
 
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
@@ -2092,24 +4067,28 @@ void alGetSourceiv(ALuint name, ALenum param, ALint *values)
 
 void alGetSourcei(ALuint name, ALenum param, ALint *value)
 {
-    IO_START(alGetSourcei);
+    IO_START_SOURCES(alGetSourcei, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(value);
+    PERF_BEGIN();
     REAL_alGetSourcei(name, param, value);
+    PERF_END();
     IO_INT32(value ? *value : 0);
     IO_END();
 }
 
 void alGetSource3i(ALuint name, ALenum param, ALint *value1, ALint *value2, ALint *value3)
 {
-    IO_START(alGetSource3i);
+    IO_START_SOURCES(alGetSource3i, 1, &name);
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(value1);
     IO_PTR(value2);
     IO_PTR(value3);
+    PERF_BEGIN();
     REAL_alGetSource3i(name, param, value1, value2, value3);
+    PERF_END();
     IO_INT32(value1 ? *value1 : 0);
     IO_INT32(value2 ? *value2 : 0);
     IO_INT32(value3 ? *value3 : 0);
@@ -2132,9 +4111,11 @@ static void add_source_to_playlist(const ALuint name)
 
 void alSourcePlay(ALuint name)
 {
-    IO_START(alSourcePlay);
+    IO_START_SOURCES(alSourcePlay, 1, &name);
     IO_UINT32(name);
+    PERF_BEGIN();
     REAL_alSourcePlay(name);
+    PERF_END();
 
     add_source_to_playlist(name);
 
@@ -2148,14 +4129,16 @@ void alSourcePlayv(ALsizei n, const ALuint *names)
 {
     ALsizei i;
 
-    IO_START(alSourcePlayv);
+    IO_START_SOURCES(alSourcePlayv, n, names);
     IO_ALSIZEI(n);
     IO_PTR(names);
     for (i = 0; i < n; i++) {
         IO_UINT32(names[i]);
     }
 
+    PERF_BEGIN();
     REAL_alSourcePlayv(n, names);
+    PERF_END();
 
     for (i = 0; i < n; i++) {
         add_source_to_playlist(names[i]);
@@ -2168,9 +4151,11 @@ void alSourcePlayv(ALsizei n, const ALuint *names)
 
 void alSourcePause(ALuint name)
 {
-    IO_START(alSourcePause);
+    IO_START_SOURCES(alSourcePause, 1, &name);
     IO_UINT32(name);
+    PERF_BEGIN();
     REAL_alSourcePause(name);
+    PERF_END();
     check_source_state_from_name(name);
     IO_END();
 }
@@ -2179,14 +4164,16 @@ void alSourcePausev(ALsizei n, const ALuint *names)
 {
     ALsizei i;
 
-    IO_START(alSourcePausev);
+    IO_START_SOURCES(alSourcePausev, n, names);
     IO_ALSIZEI(n);
     IO_PTR(names);
     for (i = 0; i < n; i++) {
         IO_UINT32(names[i]);
     }
 
+    PERF_BEGIN();
     REAL_alSourcePausev(n, names);
+    PERF_END();
 
     for (i = 0; i < n; i++) {
         check_source_state_from_name(names[i]);
@@ -2197,9 +4184,11 @@ void alSourcePausev(ALsizei n, const ALuint *names)
 
 void alSourceRewind(ALuint name)
 {
-    IO_START(alSourceRewind);
+    IO_START_SOURCES(alSourceRewind, 1, &name);
     IO_UINT32(name);
+    PERF_BEGIN();
     REAL_alSourceRewind(name);
+    PERF_END();
     check_source_state_from_name(name);
     IO_END();
 }
@@ -2208,14 +4197,16 @@ void alSourceRewindv(ALsizei n, const ALuint *names)
 {
     ALsizei i;
 
-    IO_START(alSourceRewindv);
+    IO_START_SOURCES(alSourceRewindv, n, names);
     IO_ALSIZEI(n);
     IO_PTR(names);
     for (i = 0; i < n; i++) {
         IO_UINT32(names[i]);
     }
 
+    PERF_BEGIN();
     REAL_alSourceRewindv(n, names);
+    PERF_END();
 
     for (i = 0; i < n; i++) {
         check_source_state_from_name(names[i]);
@@ -2226,9 +4217,11 @@ void alSourceRewindv(ALsizei n, const ALuint *names)
 
 void alSourceStop(ALuint name)
 {
-    IO_START(alSourceStop);
+    IO_START_SOURCES(alSourceStop, 1, &name);
     IO_UINT32(name);
+    PERF_BEGIN();
     REAL_alSourceStop(name);
+    PERF_END();
     check_source_state_from_name(name);
 
     IO_END();
@@ -2238,14 +4231,16 @@ void alSourceStopv(ALsizei n, const ALuint *names)
 {
     ALsizei i;
 
-    IO_START(alSourceStopv);
+    IO_START_SOURCES(alSourceStopv, n, names);
     IO_ALSIZEI(n);
     IO_PTR(names);
     for (i = 0; i < n; i++) {
         IO_UINT32(names[i]);
     }
 
+    PERF_BEGIN();
     REAL_alSourceStopv(n, names);
+    PERF_END();
 
     for (i = 0; i < n; i++) {
         check_source_state_from_name(names[i]);
@@ -2257,7 +4252,7 @@ void alSourceStopv(ALsizei n, const ALuint *names)
 void alSourceQueueBuffers(ALuint name, ALsizei nb, const ALuint *bufnames)
 {
     ALsizei i;
-    IO_START(alSourceQueueBuffers);
+    IO_START_SOURCES(alSourceQueueBuffers, 1, &name);
     IO_UINT32(name);
     IO_ALSIZEI(nb);
     IO_PTR(bufnames);
@@ -2265,7 +4260,9 @@ void alSourceQueueBuffers(ALuint name, ALsizei nb, const ALuint *bufnames)
         IO_UINT32(bufnames[i]);
     }
 
+    PERF_BEGIN();
     REAL_alSourceQueueBuffers(name, nb, bufnames);
+    PERF_END();
 
     check_source_state_from_name(name);
 
@@ -2275,12 +4272,14 @@ void alSourceQueueBuffers(ALuint name, ALsizei nb, const ALuint *bufnames)
 void alSourceUnqueueBuffers(ALuint name, ALsizei nb, ALuint *bufnames)
 {
     ALsizei i;
-    IO_START(alSourceUnqueueBuffers);
+    IO_START_SOURCES(alSourceUnqueueBuffers, 1, &name);
     IO_UINT32(name);
     IO_ALSIZEI(nb);
     IO_PTR(bufnames);
     memset(bufnames, 0, nb * sizeof (ALuint));
+    PERF_BEGIN();
     REAL_alSourceUnqueueBuffers(name, nb, bufnames);
+    PERF_END();
     for (i = 0; i < nb; i++) {
         IO_UINT32(bufnames[i]);
     }
@@ -2355,7 +4354,9 @@ void alGenBuffers(ALsizei n, ALuint *names)
     ALsizei i;
 
     memset(names, 0, n * sizeof (ALuint));
+    PERF_BEGIN();
     REAL_alGenBuffers(n, names);
+    PERF_END();
 
     IO_START(alGenBuffers);
     IO_ALSIZEI(n);
@@ -2397,9 +4398,12 @@ void alDeleteBuffers(ALsizei n, const ALuint *names)
     IO_PTR(names);
     for (i = 0; i < n; i++) {
         IO_UINT32(names[i]);
+        remember_label(ALEE_alTraceBufferLabel, names[i], NULL);
     }
 
+    PERF_BEGIN();
     REAL_alDeleteBuffers(n, names);
+    PERF_END();
 
     // objects are only deleted if there are no errors.
     if (check_al_error_events() == AL_NO_ERROR) {
@@ -2430,7 +4434,9 @@ ALboolean alIsBuffer(ALuint name)
     ALboolean retval;
     IO_START(alIsBuffer);
     IO_UINT32(name);
+    PERF_BEGIN();
     retval = REAL_alIsBuffer(name);
+    PERF_END();
     IO_BOOLEAN(retval);
     IO_END();
     return retval;
@@ -2444,7 +4450,12 @@ void alBufferData(ALuint name, ALenum alfmt, const ALvoid *data, ALsizei size, A
     IO_ALSIZEI(freq);
     IO_PTR(data);
     IO_BLOB(data, size);
+    PERF_BEGIN();
     REAL_alBufferData(name, alfmt, data, size, freq);
+    PERF_END();
+    if (metrics_enabled && (size > 0)) {
+        metric_add(&metrics.upload_bytes, (uint64) size);
+    }
     check_buffer_state_from_name(name);
     IO_END();
 }
@@ -2462,7 +4473,9 @@ void alBufferfv(ALuint name, ALenum param, const ALfloat *values)
     for (i = 0; i < numvals; i++) {
         IO_FLOAT(values[i]);
     }
+    PERF_BEGIN();
     REAL_alBufferfv(name, param, values);
+    PERF_END();
     check_buffer_state_from_name(name);
     IO_END();
 }
@@ -2473,7 +4486,9 @@ void alBufferf(ALuint name, ALenum param, ALfloat value)
     IO_UINT32(name);
     IO_ENUM(param);
     IO_FLOAT(value);
+    PERF_BEGIN();
     REAL_alBufferf(name, param, value);
+    PERF_END();
     check_buffer_state_from_name(name);
     IO_END();
 }
@@ -2486,7 +4501,9 @@ void alBuffer3f(ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALflo
     IO_FLOAT(value1);
     IO_FLOAT(value2);
     IO_FLOAT(value3);
+    PERF_BEGIN();
     REAL_alBuffer3f(name, param, value1, value2, value3);
+    PERF_END();
     check_buffer_state_from_name(name);
     IO_END();
 }
@@ -2504,7 +4521,9 @@ void alBufferiv(ALuint name, ALenum param, const ALint *values)
     for (i = 0; i < numvals; i++) {
         IO_INT32(values[i]);
     }
+    PERF_BEGIN();
     REAL_alBufferiv(name, param, values);
+    PERF_END();
     check_buffer_state_from_name(name);
     IO_END();
 }
@@ -2515,7 +4534,9 @@ void alBufferi(ALuint name, ALenum param, ALint value)
     IO_UINT32(name);
     IO_ENUM(param);
     IO_INT32(value);
+    PERF_BEGIN();
     REAL_alBufferi(name, param, value);
+    PERF_END();
     check_buffer_state_from_name(name);
     IO_END();
 }
@@ -2528,7 +4549,9 @@ void alBuffer3i(ALuint name, ALenum param, ALint value1, ALint value2, ALint val
     IO_INT32(value1);
     IO_INT32(value2);
     IO_INT32(value3);
+    PERF_BEGIN();
     REAL_alBuffer3i(name, param, value1, value2, value3);
+    PERF_END();
     IO_END();
 }
 
@@ -2548,7 +4571,9 @@ void alGetBufferfv(ALuint name, ALenum param, ALfloat *values)
         memset(values, '\0', numvals * sizeof (ALfloat));
     }
 
+    PERF_BEGIN();
     REAL_alGetBufferfv(name, param, values);
+    PERF_END();
 
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
@@ -2564,7 +4589,9 @@ void alGetBufferf(ALuint name, ALenum param, ALfloat *value)
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(value);
+    PERF_BEGIN();
     REAL_alGetBufferf(name, param, value);
+    PERF_END();
     IO_FLOAT(value ? *value : 0.0f);
     IO_END();
 }
@@ -2577,7 +4604,9 @@ void alGetBuffer3f(ALuint name, ALenum param, ALfloat *value1, ALfloat *value2,
     IO_PTR(value1);
     IO_PTR(value2);
     IO_PTR(value3);
+    PERF_BEGIN();
     REAL_alGetBuffer3f(name, param, value1, value2, value3);
+    PERF_END();
     IO_FLOAT(value1 ? *value1 : 0.0f);
     IO_FLOAT(value2 ? *value2 : 0.0f);
     IO_FLOAT(value3 ? *value3 : 0.0f);
@@ -2590,7 +4619,9 @@ void alGetBufferi(ALuint name, ALenum param, ALint *value)
     IO_UINT32(name);
     IO_ENUM(param);
     IO_PTR(value);
+    PERF_BEGIN();
     REAL_alGetBufferi(name, param, value);
+    PERF_END();
     IO_INT32(value ? *value : 0);
     IO_END();
 }
@@ -2603,7 +4634,9 @@ void alGetBuffer3i(ALuint name, ALenum param, ALint *value1, ALint *value2, ALin
     IO_PTR(value1);
     IO_PTR(value2);
     IO_PTR(value3);
+    PERF_BEGIN();
     REAL_alGetBuffer3i(name, param, value1, value2, value3);
+    PERF_END();
     IO_INT32(value1 ? *value1 : 0);
     IO_INT32(value2 ? *value2 : 0);
     IO_INT32(value3 ? *value3 : 0);
@@ -2632,7 +4665,9 @@ void alGetBufferiv(ALuint name, ALenum param, ALint *values)
         memset(values, '\0', numvals * sizeof (ALint));
     }
 
+    PERF_BEGIN();
     REAL_alGetBufferiv(name, param, values);
+    PERF_END();
 
     IO_UINT32(numvals);
     for (i = 0; i < numvals; i++) {
@@ -2642,16 +4677,22 @@ void alGetBufferiv(ALuint name, ALenum param, ALint *values)
     IO_END();
 }
 
+static uint32 trace_scope = 0;  // how deep in alTracePushScope() we are, for chunk contexts.
+
 void alTracePushScope(const ALchar *str)
 {
     IO_START(alTracePushScope);
     IO_STRING(str);
+    trace_scope++;
     IO_END();
 }
 
 void alTracePopScope(void)
 {
     IO_START(alTracePopScope);
+    if (trace_scope > 0) {  // don't wrap around on an unmatched pop.
+        trace_scope--;
+    }
     IO_END();
 }
 
@@ -2667,6 +4708,7 @@ void alTraceBufferLabel(ALuint name, const ALchar *str)
     IO_START(alTraceBufferLabel);
     IO_UINT32(name);
     IO_STRING(str);
+    remember_label(ALEE_alTraceBufferLabel, name, str);
     IO_END();
 }
 
@@ -2675,6 +4717,7 @@ void alTraceSourceLabel(ALuint name, const ALchar *str)
     IO_START(alTraceSourceLabel);
     IO_UINT32(name);
     IO_STRING(str);
+    remember_label(ALEE_alTraceSourceLabel, name, str);
     IO_END();
 }
 
@@ -2683,6 +4726,7 @@ void alcTraceDeviceLabel(ALCdevice *_device, const ALCchar *str)
     IO_START(alcTraceDeviceLabel);
     IO_PTR(_device);
     IO_STRING(str);
+    remember_label(ALEE_alcTraceDeviceLabel, (uint64) (size_t) _device, str);
     IO_END();
 }
 
@@ -2691,6 +4735,200 @@ void alcTraceContextLabel(ALCcontext *_ctx, const ALCchar *str)
     IO_START(alcTraceContextLabel);
     IO_PTR(_ctx);
     IO_STRING(str);
+    remember_label(ALEE_alcTraceContextLabel, (uint64) (size_t) _ctx, str);
+    IO_END();
+}
+
+// Zones and counters are registered once by name up front, so the hot path
+//  only has to write an integer and a value. Registering the same name twice
+//  gets the same id back. Id 0 is never handed out.
+typedef struct NameRegistry
+{
+    char **names;
+    ALuint count;
+} NameRegistry;
+
+static NameRegistry zone_registry;
+static NameRegistry counter_registry;
+
+static ALuint register_name(NameRegistry *registry, const char *str)
+{
+    char *dup;
+    void *ptr;
+    ALuint i;
+
+    if (!str) {
+        return 0;
+    }
+
+    for (i = 0; i < registry->count; i++) {
+        if (strcmp(registry->names[i], str) == 0) {
+            return i + 1;
+        }
+    }
+
+    dup = strdup(str);
+    ptr = realloc(registry->names, (registry->count + 1) * sizeof (char *));
+    if (!dup || !ptr) {
+        out_of_memory();
+    }
+    registry->names = (char **) ptr;
+    registry->names[registry->count++] = dup;
+    return registry->count;
+}
+
+static void free_name_registry(NameRegistry *registry)
+{
+    ALuint i;
+    for (i = 0; i < registry->count; i++) {
+        free(registry->names[i]);
+    }
+    free(registry->names);
+    registry->names = NULL;
+    registry->count = 0;
+}
+
+// labels currently set, for chunk contexts. Only kept if chunked or publishing to a shared memory ring.
+typedef struct TraceLabel
+{
+    EventEnum kind;  // the alTrace*Label call that set it.
+    uint64 key;  // the object name, or device/context pointer.
+    char *str;
+} TraceLabel;
+
+static TraceLabel *trace_labels = NULL;
+static uint32 num_trace_labels = 0;
+
+// (str) == NULL forgets the label, like deleting the object does during playback.
+static void remember_label(const EventEnum kind, const uint64 key, const char *str)
+{
+    TraceLabel *label;
+    uint32 i;
+
+    if ((!chunked && !shmring) || !key) {  // playback ignores labels on object zero, too.
+        return;
+    }
+
+    for (i = 0; i < num_trace_labels; i++) {
+        label = &trace_labels[i];
+        if ((label->kind == kind) && (label->key == key)) {
+            free(label->str);
+            *label = trace_labels[--num_trace_labels];  // order doesn't matter.
+            break;
+        }
+    }
+
+    if (str) {
+        char *dup = strdup(str);
+        void *ptr = realloc(trace_labels, (num_trace_labels + 1) * sizeof (TraceLabel));
+        if (!dup || !ptr) {
+            out_of_memory();
+        }
+        trace_labels = (TraceLabel *) ptr;
+        label = &trace_labels[num_trace_labels++];
+        label->kind = kind;
+        label->key = key;
+        label->str = dup;
+    }
+}
+
+static void free_trace_names(void)
+{
+    uint32 i;
+    free_name_registry(&zone_registry);
+    free_name_registry(&counter_registry);
+    for (i = 0; i < num_trace_labels; i++) {
+        free(trace_labels[i].str);
+    }
+    free(trace_labels);
+    trace_labels = NULL;
+    num_trace_labels = 0;
+}
+
+// Written right after a checkpoint in chunked tracefiles (ALTRACE_CHUNKED):
+//  everything playback would otherwise have had to read the whole tracefile
+//  up to here to know, so decoding can start at the checkpoint. Callstack
+//  symbols and motion channels are written again as the chunk needs them.
+static void write_chunk_context(void)
+{
+    uint32 i;
+
+    IO_EVENTENUM(ALEE_CHUNK_CONTEXT);
+    IO_UINT32(trace_scope);
+
+    IO_UINT32(num_log_threads);
+    for (i = 0; i < num_log_threads; i++) {
+        IO_UINT64(log_threads[i]);
+    }
+
+    IO_UINT32(num_trace_labels);
+    for (i = 0; i < num_trace_labels; i++) {
+        IO_UINT32((uint32) trace_labels[i].kind);  // not IO_EVENTENUM, that would start a new record.
+        IO_UINT64(trace_labels[i].key);
+        IO_STRING(trace_labels[i].str);
+    }
+
+    IO_UINT32(zone_registry.count);
+    for (i = 0; i < zone_registry.count; i++) {
+        IO_STRING(zone_registry.names[i]);
+    }
+
+    IO_UINT32(counter_registry.count);
+    for (i = 0; i < counter_registry.count; i++) {
+        IO_STRING(counter_registry.names[i]);
+    }
+}
+
+ALuint alTraceRegisterZone(const ALchar *str)
+{
+    ALuint retval;
+    IO_START(alTraceRegisterZone);
+    IO_STRING(str);
+    retval = register_name(&zone_registry, str);
+    IO_UINT32(retval);
+    IO_END();
+    return retval;
+}
+
+void alTraceZoneBegin(ALuint zone)
+{
+    IO_START(alTraceZoneBegin);
+    IO_UINT32(zone);
+    IO_UINT64(now_ns());
+    IO_END();
+}
+
+void alTraceZoneEnd(ALuint zone)
+{
+    IO_START(alTraceZoneEnd);
+    IO_UINT32(zone);
+    IO_UINT64(now_ns());
+    IO_END();
+}
+
+void alTraceFrameMark(void)
+{
+    IO_START(alTraceFrameMark);
+    IO_UINT64(now_ns());
+    IO_END();
+}
+
+ALuint alTraceRegisterCounter(const ALchar *str)
+{
+    ALuint retval;
+    IO_START(alTraceRegisterCounter);
+    IO_STRING(str);
+    retval = register_name(&counter_registry, str);
+    IO_UINT32(retval);
+    IO_END();
+    return retval;
+}
+
+void alTraceCounter(ALuint counter, ALdouble value)
+{
+    IO_START(alTraceCounter);
+    IO_UINT32(counter);
+    IO_DOUBLE(value);
     IO_END();
 }
 
@@ -2723,12 +4961,132 @@ static void check_device_state_int(DeviceWrapper *device, const ALCenum param, A
 }
 
 
+/* Device clocks and source latency move constantly, so rather than reporting
+   them as state changes, we sample them every ALTRACE_LATENCY_SAMPLE
+   milliseconds (100 by default, 0 to disable) where the AL supports it. */
+static int check_latency_sample_due(void)
+{
+    const uint32 ticks = now();
+    if (!latency_sample_interval || ((ticks - latency_last_sample) < latency_sample_interval)) {
+        return 0;
+    }
+    latency_last_sample = ticks;
+    return 1;
+}
+
+static void sample_device_clock_latency(DeviceWrapper *device)
+{
+    int64 values[2] = { 0, 0 };  // clock, latency; both in nanoseconds.
+    device->alcGetInteger64vSOFT(device->device, ALC_DEVICE_CLOCK_LATENCY_SOFT, 2, values);
+    IO_EVENTENUM(ALEE_DEVICE_CLOCK_LATENCY);
+    IO_PTR(device);
+    IO_UINT32(now());
+    IO_UINT64((uint64) values[0]);
+    IO_UINT64((uint64) values[1]);
+}
+
+static void sample_source_latency(ContextWrapper *ctx, SourceWrapper *src)
+{
+    int64 values[2] = { 0, 0 };  // 32.32 fixed-point sample offset, latency in nanoseconds.
+    ctx->alGetSourcei64vSOFT(src->name, AL_SAMPLE_OFFSET_LATENCY_SOFT, values);
+    IO_EVENTENUM(ALEE_SOURCE_LATENCY);
+    IO_PTR(ctx);
+    IO_UINT32(src->name);
+    IO_UINT64((uint64) values[0]);
+    IO_UINT64((uint64) values[1]);
+}
+
+/* sources can only be queried on the current context, so this expects (ctx)
+   to be current already. */
+static void check_context_async_states(ContextWrapper *ctx, const int sample_latency)
+{
+    SourceWrapper *src;
+    SourceWrapper *next;
+    for (src = ctx->playlist; src != NULL; src = next) {
+        next = src->playlist_next;
+        check_source_state(src);
+        if (sample_latency && ctx->alGetSourcei64vSOFT && (src->state == AL_PLAYING)) {
+            sample_source_latency(ctx, src);
+        }
+        if (src->state != AL_PLAYING) {
+            /* source has stopped for whatever reason, take it out of the playlist. */
+            if (next) {
+                next->playlist_prev = src->playlist_prev;
+            }
+            if (src->playlist_prev) {
+                src->playlist_prev->playlist_next = next;
+            } else {
+                ctx->playlist = next;
+            }
+            src->playlist_prev = NULL;
+            src->playlist_next = NULL;
+        }
+    }
+}
+
+/* To poll a context that isn't current, we have to make it current for a
+   moment. With ALC_EXT_thread_local_context, that only affects this thread
+   and we put back whatever thread context it had; otherwise we switch the
+   process-wide context, and put the app's back when we're done. Either way,
+   we only switch once per context that has something to check, and the
+   current context goes first without switching at all, so most apps never
+   switch. */
+static int checked_thread_local_context = 0;
+static ALCboolean (*set_thread_context_fn)(ALCcontext *) = NULL;
+static ALCcontext *(*get_thread_context_fn)(void) = NULL;
+
+static int switch_to_poll_context(ContextWrapper *ctx, int *_switched, ALCcontext **_prev_thread_context)
+{
+    if (!checked_thread_local_context) {
+        checked_thread_local_context = 1;
+        if (REAL_alcIsExtensionPresent(NULL, "ALC_EXT_thread_local_context")) {
+            set_thread_context_fn = (ALCboolean (*)(ALCcontext *)) REAL_alcGetProcAddress(NULL, "alcSetThreadContext");
+            get_thread_context_fn = (ALCcontext *(*)(void)) REAL_alcGetProcAddress(NULL, "alcGetThreadContext");
+            if (!set_thread_context_fn || !get_thread_context_fn) {
+                set_thread_context_fn = NULL;
+                get_thread_context_fn = NULL;
+            }
+        }
+    }
+
+    if (set_thread_context_fn) {
+        if (!*_switched) {
+            *_prev_thread_context = get_thread_context_fn();
+        }
+        if (!set_thread_context_fn(ctx->ctx)) {
+            return 0;
+        }
+    } else if (!REAL_alcMakeContextCurrent(ctx->ctx)) {
+        return 0;
+    }
+
+    *_switched = 1;
+    return 1;
+}
+
+static void restore_poll_context(ALCcontext *prev_thread_context)
+{
+    if (set_thread_context_fn) {
+        set_thread_context_fn(prev_thread_context);
+    } else {
+        REAL_alcMakeContextCurrent(current_context ? current_context->ctx : NULL);
+    }
+}
+
 /* this call checks for state changes that can happen outside of an entry
    point: sources that are playing change state in the mixer, devices can
    disconnect, captured samples accumulate, etc. */
 static void check_al_async_states(void)
 {
+    const int sample_latency = check_latency_sample_due();
+    ALCcontext *prev_thread_context = NULL;
+    int switched = 0;
     DeviceWrapper *device;
+
+    if (current_context && current_context->playlist) {
+        check_context_async_states(current_context, sample_latency);
+    }
+
     for (device = null_device.next; device != NULL; device = device->next) {
         if (device->supports_disconnect_ext) {
             check_device_state_bool(device, ALC_CONNECTED, &device->connected);
@@ -2737,31 +5095,23 @@ static void check_al_async_states(void)
         if (device->iscapture) {
             check_device_state_int(device, ALC_CAPTURE_SAMPLES, &device->capture_samples);
         } else {
-            #pragma warning FIXME have to make these contexts current
             ContextWrapper *ctx;
+
+            if (sample_latency && device->alcGetInteger64vSOFT) {
+                sample_device_clock_latency(device);
+            }
+
             for (ctx = device->contexts; ctx != NULL; ctx = ctx->next) {
-                SourceWrapper *src;
-                SourceWrapper *next;
-                for (src = ctx->playlist; src != NULL; src = next) {
-                    next = src->playlist_next;
-                    check_source_state(src);
-                    if (src->state != AL_PLAYING) {
-                        /* source has stopped for whatever reason, take it out of the playlist. */
-                        if (next) {
-                            next->playlist_prev = src->playlist_prev;
-                        }
-                        if (src->playlist_prev) {
-                            src->playlist_prev->playlist_next = next;
-                        } else {
-                            ctx->playlist = next;
-                        }
-                        src->playlist_prev = NULL;
-                        src->playlist_next = NULL;
-                    }
+                if ((ctx != current_context) && ctx->playlist && switch_to_poll_context(ctx, &switched, &prev_thread_context)) {
+                    check_context_async_states(ctx, sample_latency);
                 }
             }
         }
     }
+
+    if (switched) {
+        restore_poll_context(prev_thread_context);
+    }
 }
 
 // end of altrace_record.c ...
@@ -0,0 +1,32 @@
+/**
+ * alTrace; a debugging tool for OpenAL.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+// This is the static recorder with tracing compiled out (configure with
+//  -DALTRACE_STATIC_TRACING=OFF). Nothing is wrapped, so the app's OpenAL
+//  calls go straight to the real library, and our extension does nothing,
+//  so apps can leave their alTrace*() calls in shipping builds.
+
+#include "AL/al.h"
+#include "AL/alc.h"
+
+void alTracePushScope(const ALchar *str) {}
+void alTracePopScope(void) {}
+void alTraceMessage(const ALchar *str) {}
+void alTraceBufferLabel(ALuint name, const ALchar *str) {}
+void alTraceSourceLabel(ALuint name, const ALchar *str) {}
+void alcTraceDeviceLabel(ALCdevice *device, const ALCchar *str) {}
+void alcTraceContextLabel(ALCcontext *ctx, const ALCchar *str) {}
+ALuint alTraceRegisterZone(const ALchar *str) { return 0; }
+void alTraceZoneBegin(ALuint zone) {}
+void alTraceZoneEnd(ALuint zone) {}
+void alTraceFrameMark(void) {}
+ALuint alTraceRegisterCounter(const ALchar *str) { return 0; }
+void alTraceCounter(ALuint counter, ALdouble value) {}
+
+// end of altrace_record_null.c ...
+
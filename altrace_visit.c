@@ -0,0 +1,423 @@
+/**
+ * alTrace; a debugging tool for OpenAL.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+// This pushes a TraceReader's events at the visit_*() functions. It's kept
+//  out of altrace_playback.c, so things that only pull events with
+//  altrace_next_event() don't have to write visitors to link.
+
+#include "altrace_playback.h"
+
+void altrace_visit_event(TraceEvent *ev, void *userdata)
+{
+    switch (ev->type) {
+        #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) \
+            case ALEE_##name: { \
+                TraceArgs_##name *a = &ev->u.name; \
+                ev->callerinfo.userdata = userdata; \
+                visit_##name(ALTRACE_MEMBERS(a, ALTRACE_UNPAREN visitargs)); \
+                break; \
+            }
+        #include "altrace_entrypoints.h"
+
+        case ALEE_ALERROR_TRIGGERED: {
+            TraceArgs_al_error_event *a = &ev->u.al_error_event;
+            visit_al_error_event(userdata, a->err);
+            break;
+        }
+
+        case ALEE_ALCERROR_TRIGGERED: {
+            TraceArgs_alc_error_event *a = &ev->u.alc_error_event;
+            visit_alc_error_event(userdata, a->device, a->err);
+            break;
+        }
+
+        case ALEE_DEVICE_STATE_CHANGED_INT: {
+            TraceArgs_device_state_changed_int *a = &ev->u.device_state_changed_int;
+            visit_device_state_changed_int(userdata, a->dev, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_CONTEXT_STATE_CHANGED_ENUM: {
+            TraceArgs_context_state_changed_enum *a = &ev->u.context_state_changed_enum;
+            visit_context_state_changed_enum(userdata, a->ctx, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_CONTEXT_STATE_CHANGED_FLOAT: {
+            TraceArgs_context_state_changed_float *a = &ev->u.context_state_changed_float;
+            visit_context_state_changed_float(userdata, a->ctx, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_CONTEXT_STATE_CHANGED_STRING: {
+            TraceArgs_context_state_changed_string *a = &ev->u.context_state_changed_string;
+            visit_context_state_changed_string(userdata, a->ctx, a->param, a->str);
+            break;
+        }
+
+        case ALEE_CONTEXT_ATTRIBUTES: {
+            TraceArgs_context_attributes *a = &ev->u.context_attributes;
+            visit_context_attributes(userdata, a->ctx, a->numattrs, a->attrs);
+            break;
+        }
+
+        case ALEE_LISTENER_STATE_CHANGED_FLOATV: {
+            TraceArgs_listener_state_changed_floatv *a = &ev->u.listener_state_changed_floatv;
+            visit_listener_state_changed_floatv(userdata, a->ctx, a->param, a->numfloats, a->values);
+            break;
+        }
+
+        case ALEE_SOURCE_STATE_CHANGED_BOOL: {
+            TraceArgs_source_state_changed_bool *a = &ev->u.source_state_changed_bool;
+            visit_source_state_changed_bool(userdata, a->ctx, a->name, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_SOURCE_STATE_CHANGED_ENUM: {
+            TraceArgs_source_state_changed_enum *a = &ev->u.source_state_changed_enum;
+            visit_source_state_changed_enum(userdata, a->ctx, a->name, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_SOURCE_STATE_CHANGED_INT: {
+            TraceArgs_source_state_changed_int *a = &ev->u.source_state_changed_int;
+            visit_source_state_changed_int(userdata, a->ctx, a->name, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_SOURCE_STATE_CHANGED_UINT: {
+            TraceArgs_source_state_changed_uint *a = &ev->u.source_state_changed_uint;
+            visit_source_state_changed_uint(userdata, a->ctx, a->name, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_SOURCE_STATE_CHANGED_FLOAT: {
+            TraceArgs_source_state_changed_float *a = &ev->u.source_state_changed_float;
+            visit_source_state_changed_float(userdata, a->ctx, a->name, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_SOURCE_STATE_CHANGED_FLOAT3: {
+            TraceArgs_source_state_changed_float3 *a = &ev->u.source_state_changed_float3;
+            visit_source_state_changed_float3(userdata, a->ctx, a->name, a->param, a->newval1, a->newval2, a->newval3);
+            break;
+        }
+
+        case ALEE_BUFFER_STATE_CHANGED_INT: {
+            TraceArgs_buffer_state_changed_int *a = &ev->u.buffer_state_changed_int;
+            visit_buffer_state_changed_int(userdata, a->name, a->param, a->newval);
+            break;
+        }
+
+        case ALEE_PROCESS_FORKED: {
+            TraceArgs_process_forked *a = &ev->u.process_forked;
+            visit_process_forked(userdata, a->ticks, a->parentpid, a->childpid, a->parentfile, a->parentoffset);
+            break;
+        }
+
+        case ALEE_CHECKPOINT: {
+            TraceArgs_checkpoint *a = &ev->u.checkpoint;
+            visit_checkpoint(userdata, a->eventcount, a->offset, a->ticks);
+            break;
+        }
+
+        case ALEE_PERF_COUNTERS: {
+            TraceArgs_perf_counters *a = &ev->u.perf_counters;
+            visit_perf_counters(userdata, a->kind, a->value1, a->value2);
+            break;
+        }
+
+        case ALEE_RESOURCE_SAMPLE: {
+            TraceArgs_resource_sample *a = &ev->u.resource_sample;
+            visit_resource_sample(userdata, a->ticks, a->rss, a->usertime, a->systime, a->threads, a->openal_threads);
+            break;
+        }
+
+        case ALEE_DEVICE_CLOCK_LATENCY: {
+            TraceArgs_device_clock_latency *a = &ev->u.device_clock_latency;
+            visit_device_clock_latency(userdata, a->device, a->ticks, a->clock, a->latency);
+            break;
+        }
+
+        case ALEE_SOURCE_LATENCY: {
+            TraceArgs_source_latency *a = &ev->u.source_latency;
+            visit_source_latency(userdata, a->ctx, a->name, a->offset, a->latency);
+            break;
+        }
+
+        case ALEE_EOS: {
+            TraceArgs_eos *a = &ev->u.eos;
+            visit_eos(userdata, a->okay, a->wait_until);
+            break;
+        }
+
+        default: break;  // nothing else gets handed out.
+    }
+}
+
+int altrace_process(TraceReader *r, void *userdata)
+{
+    int retval = 0;
+    TraceEvent *ev;
+
+    while (1) {
+        if (!visit_progress(userdata, altrace_tell(r), altrace_size(r))) {
+            fprintf(stderr, "%s: Application cancelled file processing!\n", GAppName);
+            visit_eos(userdata, AL_FALSE, 0);
+            return -1;
+        } else if (!altrace_next_event(r, &ev)) {
+            break;
+        }
+
+        altrace_visit_event(ev, userdata);
+        if (ev->type == ALEE_EOS) {
+            retval = ev->u.eos.okay ? 1 : 0;
+        }
+    }
+
+    return retval;
+}
+
+int process_tracelog(const char *fname, void *userdata)
+{
+    TraceReader *r = altrace_open(fname);
+    int retval;
+    if (!r) {
+        return 0;
+    }
+    retval = altrace_process(r, userdata);
+    altrace_close(r);
+    return retval;
+}
+
+int process_shm_tracelog(const char *shmname, void *userdata)
+{
+    TraceReader *r = altrace_attach(shmname);
+    int retval;
+    if (!r) {
+        return 0;
+    }
+    retval = altrace_process(r, userdata);
+    altrace_close(r);
+    return retval;
+}
+
+int process_tracelog_from_event(const char *fname, void *userdata, const uint64 eventnum)
+{
+    TraceReader *r = altrace_open(fname);
+    int retval = 0;
+    if (!r) {
+        return 0;
+    } else if (altrace_seek_event(r, eventnum)) {
+        retval = altrace_process(r, userdata);
+    }
+    altrace_close(r);
+    return retval;
+}
+
+int process_tracelog_from_time(const char *fname, void *userdata, const uint32 ticks)
+{
+    TraceReader *r = altrace_open(fname);
+    int retval = 0;
+    if (!r) {
+        return 0;
+    } else if (altrace_seek_time(r, ticks)) {
+        retval = altrace_process(r, userdata);
+    }
+    altrace_close(r);
+    return retval;
+}
+
+// Each chunk of a chunked tracefile gets decoded on whatever thread picks
+//  it up. Its events reach the visitors in order, on that thread, with the
+//  userdata visit_chunk_begin() returned for it; then visit_chunk_end() gets
+//  the chunks one at a time, in order, on the thread that called
+//  process_tracelog_parallel(), to stitch together.
+typedef struct TraceChunk
+{
+    void *chunkdata;
+    off_t end;  // where decoding it stopped.
+    int result;  // -1 until it's decoded, then 1 if it decoded cleanly, 0 if not.
+} TraceChunk;
+
+typedef struct ParallelDecode
+{
+    TraceReader *whole;
+    void *userdata;
+    TraceChunk *chunks;
+    uint64 numchunks;
+    uint64 next_chunk;  // next one a thread should start on.
+    uint64 delivered;  // how many visit_chunk_end() has had so far.
+    uint64 window;  // threads don't get further than this ahead of (delivered).
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} ParallelDecode;
+
+static int decode_chunk(ParallelDecode *pd, TraceChunk *chunk, const uint64 chunknum)
+{
+    TraceReader *r = altrace_open_chunk(pd->whole, chunknum);
+    int retval = 1;
+    TraceEvent *ev;
+
+    chunk->chunkdata = visit_chunk_begin(pd->userdata, chunknum);
+    while (altrace_next_event(r, &ev)) {
+        altrace_visit_event(ev, chunk->chunkdata);
+        if ((ev->type == ALEE_EOS) && !ev->u.eos.okay) {
+            retval = 0;
+        }
+    }
+
+    chunk->end = altrace_tell(r);
+    altrace_close(r);
+    return retval;
+}
+
+static void *parallel_decode_thread(void *arg)
+{
+    ParallelDecode *pd = (ParallelDecode *) arg;
+
+    pthread_mutex_lock(&pd->lock);
+    while (1) {
+        TraceChunk *chunk;
+        uint64 chunknum;
+        int result;
+
+        while (!pd->stop && (pd->next_chunk < pd->numchunks) && (pd->next_chunk >= (pd->delivered + pd->window))) {
+            pthread_cond_wait(&pd->cond, &pd->lock);
+        }
+
+        if (pd->stop || (pd->next_chunk >= pd->numchunks)) {
+            break;
+        }
+
+        chunknum = pd->next_chunk++;
+        chunk = &pd->chunks[chunknum];
+        pthread_mutex_unlock(&pd->lock);
+        result = decode_chunk(pd, chunk, chunknum);
+        pthread_mutex_lock(&pd->lock);
+        chunk->result = result;
+        if (!result) {
+            pd->stop = 1;  // a serial decode wouldn't have gotten any further.
+        }
+        pthread_cond_broadcast(&pd->cond);
+    }
+    pthread_mutex_unlock(&pd->lock);
+
+    free_scratch();
+    return NULL;
+}
+
+int process_tracelog_parallel(const char *fname, void *userdata, const int numthreads)
+{
+    TraceReader *r = altrace_open(fname);
+    pthread_t *threads = NULL;
+    ParallelDecode pd;
+    int retval = 1;
+    int created = 0;
+    uint64 i;
+
+    if (!r) {
+        return 0;
+    } else if (numthreads < 2) {
+        retval = altrace_process(r, userdata);  // don't want to split it up.
+        altrace_close(r);
+        return retval;
+    }
+
+    memset(&pd, '\0', sizeof (pd));
+    pd.whole = r;
+    pd.userdata = userdata;
+    pd.numchunks = altrace_num_chunks(r);
+    pd.window = ((uint64) numthreads) * 4;
+
+    if (!pd.numchunks) {
+        fprintf(stderr, "%s: '%s' isn't chunked (record with ALTRACE_CHUNKED=1), decoding it on one thread.\n", GAppName, fname);
+        retval = altrace_process(r, userdata);
+        altrace_close(r);
+        return retval;
+    }
+
+    pd.chunks = (TraceChunk *) calloc(pd.numchunks, sizeof (TraceChunk));
+    threads = (pthread_t *) calloc(numthreads, sizeof (pthread_t));
+    if (!pd.chunks || !threads) {
+        out_of_memory();
+    }
+
+    for (i = 0; i < pd.numchunks; i++) {
+        pd.chunks[i].result = -1;
+    }
+
+    pthread_mutex_init(&pd.lock, NULL);
+    pthread_cond_init(&pd.cond, NULL);
+    for (created = 0; created < numthreads; created++) {
+        if (pthread_create(&threads[created], NULL, parallel_decode_thread, &pd) != 0) {
+            break;
+        }
+    }
+
+    if (!created) {
+        fprintf(stderr, "%s: Couldn't start any decoding threads, decoding on one thread.\n", GAppName);
+        pthread_cond_destroy(&pd.cond);
+        pthread_mutex_destroy(&pd.lock);
+        free(threads);
+        free(pd.chunks);
+        retval = altrace_process(r, userdata);
+        altrace_close(r);
+        return retval;
+    }
+
+    pthread_mutex_lock(&pd.lock);
+    for (i = 0; i < pd.numchunks; i++) {
+        TraceChunk *chunk = &pd.chunks[i];
+        ALboolean keep;
+
+        while ((chunk->result == -1) && (i < pd.next_chunk || !pd.stop)) {
+            pthread_cond_wait(&pd.cond, &pd.lock);
+        }
+
+        if (chunk->result == -1) {
+            break;  // stopped before anyone started on this one.
+        }
+
+        keep = (retval == 1) ? AL_TRUE : AL_FALSE;
+        pthread_mutex_unlock(&pd.lock);
+
+        visit_chunk_end(userdata, chunk->chunkdata, keep);  // throws it away if something before it failed.
+        if (keep) {
+            if (!chunk->result) {
+                retval = 0;
+            } else if (!visit_progress(userdata, chunk->end, altrace_size(r))) {
+                fprintf(stderr, "%s: Application cancelled file processing!\n", GAppName);
+                visit_eos(userdata, AL_FALSE, 0);
+                retval = -1;
+            }
+        }
+
+        pthread_mutex_lock(&pd.lock);
+        pd.delivered = i + 1;
+        if (retval != 1) {
+            pd.stop = 1;
+        }
+        pthread_cond_broadcast(&pd.cond);
+    }
+    pthread_mutex_unlock(&pd.lock);
+
+    while (created > 0) {
+        pthread_join(threads[--created], NULL);
+    }
+
+    pthread_cond_destroy(&pd.cond);
+    pthread_mutex_destroy(&pd.lock);
+    free(threads);
+    free(pd.chunks);
+    altrace_close(r);
+    return retval;
+}
+
+// end of altrace_visit.c ...
@@ -95,7 +95,8 @@ enum ApiArgType
     ARG_alenum,
     ARG_aldouble,
     ARG_alcbool,
-    ARG_albool
+    ARG_albool,
+    ARG_unrecorded  // the tracefile doesn't know what the app passed here.
 };
 
 struct ApiArgInfo
@@ -242,7 +243,16 @@ struct ApiCallInfo
         , generated_alc_error(AL_FALSE)
         , reported_failure(AL_FALSE)
         , inefficient_state_change(AL_FALSE)
+        , has_perf_counters(AL_FALSE)
+        , perf_kind(0)
+        , has_sched_context(callerinfo->has_sched_context ? AL_TRUE : AL_FALSE)
+        , cpu(callerinfo->has_sched_context ? callerinfo->cpu : 0)
+        , sched_policy(callerinfo->has_sched_context ? callerinfo->sched_policy : 0)
+        , sched_priority(callerinfo->has_sched_context ? callerinfo->sched_priority : 0)
+        , voluntary_csw(callerinfo->has_sched_context ? callerinfo->voluntary_csw : 0)
+        , involuntary_csw(callerinfo->has_sched_context ? callerinfo->involuntary_csw : 0)
     {
+        perf_counters[0] = perf_counters[1] = 0;
         CallstackFrame *stack = const_cast<CallstackFrame *>(callstack);
         memcpy(stack, callerinfo->callstack, num_callstack_frames * sizeof (CallstackFrame));
         for (int i = 0; i < num_callstack_frames; i++) {
@@ -279,6 +289,15 @@ struct ApiCallInfo
     ALboolean generated_alc_error;
     ALboolean reported_failure;
     ALboolean inefficient_state_change;
+    ALboolean has_perf_counters;
+    uint32 perf_kind;
+    uint64 perf_counters[2];
+    const ALboolean has_sched_context;
+    const uint32 cpu;
+    const uint32 sched_policy;
+    const uint32 sched_priority;
+    const uint32 voluntary_csw;
+    const uint32 involuntary_csw;
 };
 
 
@@ -1488,6 +1507,7 @@ static wxString htmlizeArgument(const ApiCallInfo *info, const ApiArgInfo *arg)
         case ARG_aldouble: return fontColorString("#FF0000", wxString::FromDouble(arg->aldouble));
         case ARG_alcbool: return fontColorString("#CCCCCC", alcboolString(arg->alcbool));
         case ARG_albool: return fontColorString("#CCCCCC", alboolString(arg->albool));
+        case ARG_unrecorded: return fontColorString("#CCCCCC", wxT("(unrecorded)"));
         default: break;
     }
     return wxT("???");
@@ -1575,6 +1595,56 @@ void ALTraceCallInfoPage::updateCallInfoPage(const ApiCallInfo *info)
         html << wxT("</li></ul></font></p>");
     }
 
+    if (info->has_perf_counters) {
+        const unsigned long long val1 = (unsigned long long) info->perf_counters[0];
+        const unsigned long long val2 = (unsigned long long) info->perf_counters[1];
+        html << wxT("<p><h1>Performance counters</h1></p><p><font size='+1'><ul>");
+        if (info->perf_kind == ALTRACE_PERF_CYCLES_INSTRUCTIONS) {
+            html << wxString::Format("<li>%llu CPU cycles</li><li>%llu instructions</li>", val1, val2);
+        } else if (info->perf_kind == ALTRACE_PERF_TASKCLOCK_CSWITCHES) {
+            html << wxString::Format("<li>%llu nanoseconds on the CPU</li><li>%llu context switches</li>", val1, val2);
+        } else {
+            html << wxString::Format("<li>Unknown counters #%u: %llu, %llu</li>", (uint) info->perf_kind, val1, val2);
+        }
+        html << wxT("</ul></font></p>");
+    }
+
+    if (info->has_sched_context) {
+        html << wxT("<p><h1>Scheduling</h1></p><p><font size='+1'><ul>");
+        if (info->cpu == 0xFFFFFFFF) {
+            html << wxT("<li>Running on an unknown CPU</li>");
+        } else {
+            html << wxString::Format("<li>Running on CPU %u</li>", (uint) info->cpu);
+        }
+        html << wxString::Format("<li>Policy %s, priority %u</li>", schedPolicyString(info->sched_policy), (uint) info->sched_priority);
+        html << wxString::Format("<li>%u voluntary and %u involuntary context switches since the last sample on this thread</li>", (uint) info->voluntary_csw, (uint) info->involuntary_csw);
+        html << wxT("</ul></font></p>");
+    }
+
+    // !!! FIXME: plot these over time instead of just listing where they stand.
+    const uint64 *numcounters = info->state ? info->state->getGlobalState("numcounters") : NULL;
+    if (numcounters && *numcounters) {
+        html << wxT("<p><h1>Counters</h1></p><p><font size='+1'><ul>");
+        for (uint64 i = 1; i <= *numcounters; i++) {
+            char buf[64];
+            snprintf(buf, sizeof (buf), "counter/%u/name", (uint) i);
+            const uint64 *name = info->state->getGlobalState(buf);
+            snprintf(buf, sizeof (buf), "counter/%u/value", (uint) i);
+            const uint64 *val = info->state->getGlobalState(buf);
+            const char *str = name ? (const char *) ((size_t) *name) : NULL;
+            html << wxT("<li>") << (str ? str : "???") << wxT(": ");
+            if (val) {
+                union { ALdouble d; uint64 ui64; } cvt;
+                cvt.ui64 = *val;
+                html << wxString::FromDouble(cvt.d);
+            } else {
+                html << wxT("(not set yet)");
+            }
+            html << wxT("</li>");
+        }
+        html << wxT("</ul></font></p>");
+    }
+
     html << wxT("<p><h1>Callstack</h1></p><p><font size='+1'><ul>\n");
     for (int i = 0; i < info->num_callstack_frames; i++) {
         void *ptr = info->callstack[i].frame;
@@ -1626,6 +1696,18 @@ void ALTraceDeviceInfoPage::updateItemListImpl()
     }
 }
 
+// The state trie only notes where a buffer's (or a capture's) audio data is
+//  in the tracefile, so we go back for it when someone wants to hear it.
+static bool readTraceBlob(TraceReader *reader, const uint64 offset, const uint64 len, void *buf)
+{
+    TraceBlob blob;
+    blob.offset = (off_t) offset;
+    blob.len = len;
+    blob.hash = 0;
+    blob.data = NULL;
+    return reader && altrace_blob_read(reader, &blob, buf);
+}
+
 void ALTraceDeviceInfoPage::updateDetails(const wxUIntPtr data)
 {
     const StateTrie *trie = apiinfo->state;
@@ -1662,6 +1744,13 @@ void ALTraceDeviceInfoPage::updateDetails(const wxUIntPtr data)
         html << alcboolString(val ? ((ALCboolean) *val) : ALC_TRUE);
         html << wxT("</li>");
 
+        val = trie->getDeviceState(dev, "ALC_DEVICE_LATENCY_SOFT");
+        if (val) {
+            html << wxString::Format("<li><strong>ALC_DEVICE_LATENCY_SOFT</strong>: %.3fms</li>", ((int64) *val) / 1000000.0);
+            val = trie->getDeviceState(dev, "ALC_DEVICE_CLOCK_SOFT");
+            html << wxString::Format("<li><strong>ALC_DEVICE_CLOCK_SOFT</strong>: %.6fs</li>", (val ? (int64) *val : 0) / 1000000000.0);
+        }
+
         html << wxT("<li><strong>Created contexts</strong>:");
         val = trie->getDeviceState(dev, "numcontexts");
         const uint64 numcontexts = val ? *val : 0;
@@ -1757,10 +1846,10 @@ void ALTraceDeviceInfoPage::updateDetails(const wxUIntPtr data)
                 uint8 *pcm = new uint8[bufferlen];
                 uint8 *pcmptr = pcm;
                 const wxCharBuffer utf8path = frame->getTracefilePath().ToUTF8();
-                FILE *f = fopen(utf8path.data(), "rb");  // !!! FIXME: don't use fopen.
+                TraceReader *reader = altrace_open(utf8path.data());
                 uint64 pcmoffset = 0;
                 bool okay = false;
-                if (f) {
+                if (reader) {
                     for (uint64 i = 0; i < numcaptures; i++) {
                         okay = false;
                         snprintf(buf, sizeof (buf), "capturedatalen/%u", (uint) i);
@@ -1770,18 +1859,16 @@ void ALTraceDeviceInfoPage::updateDetails(const wxUIntPtr data)
                             snprintf(buf, sizeof (buf), "capturedata/%u", (uint) i);
                             val = trie->getDeviceState(dev, buf);
                             pcmoffset = val ? *val : 0;
-                            if (fseek(f, (long) pcmoffset, SEEK_SET) != -1) {
-                                if (fread(pcmptr, len, 1, f) == 1) {
-                                    pcmptr += len;
-                                    okay = true;
-                                }
+                            if (readTraceBlob(reader, pcmoffset, len, pcmptr)) {
+                                pcmptr += len;
+                                okay = true;
                             }
                             if (!okay) {
                                 break;
                             }
                         }
                     }
-                    fclose(f);
+                    altrace_close(reader);
                 }
                 if (!okay) {
                     frame->clearAudio();
@@ -2019,6 +2106,31 @@ void ALTraceContextInfoPage::updateDetails(const wxUIntPtr data)
         }
         html << wxT("</li>");
 
+        html << wxT("<li><strong>Device attributes</strong>:");
+        val = trie->getContextState(ctx, "numattributes");
+        if (!val) {
+            html << wxT(" <i>not recorded</i>");
+        } else if (!*val) {
+            html << wxT(" <i>none reported</i>");
+        } else {
+            const uint64 numattrs = *val;
+            html << wxT("<ul>");
+            for (uint64 i = 0; i < numattrs; i++) {
+                snprintf(buf, sizeof (buf), "attribute/%u/name", (uint) i);
+                val = trie->getContextState(ctx, buf);
+                html << wxT("<li><strong>");
+                html << alcenumString(val ? (ALCenum) *val : 0);
+                html << wxT("</strong>: ");
+                snprintf(buf, sizeof (buf), "attribute/%u/value", (uint) i);
+                val = trie->getContextState(ctx, buf);
+                union { ALCint i; uint64 ui64; } attrcvt; attrcvt.ui64 = val ? *val : 0;
+                html << (int) attrcvt.i;
+                html << wxT("</li>");
+            }
+            html << wxT("</ul>");
+        }
+        html << wxT("</li>");
+
         html << wxT("<li><strong>AL_VERSION</strong>: ");
         val = trie->getContextState(ctx, "AL_VERSION");
         if (!val) {
@@ -2351,6 +2463,13 @@ void ALTraceSourceInfoPage::updateDetails(const wxUIntPtr data)
         html << cvti.i;
         html << wxT("</li>");
 
+        val = trie->getSourceState(ctx, name, "AL_SAMPLE_OFFSET_LATENCY_SOFT/latency");
+        if (val) {
+            html << wxString::Format("<li><strong>AL_SAMPLE_OFFSET_LATENCY_SOFT</strong>: latency %.3fms", ((int64) *val) / 1000000.0);
+            val = trie->getSourceState(ctx, name, "AL_SAMPLE_OFFSET_LATENCY_SOFT/offset");
+            html << wxString::Format(" at sample offset %.3f</li>", (val ? (int64) *val : 0) / 4294967296.0);
+        }
+
         html << wxT("<li><strong>AL_SOURCE_RELATIVE</strong>: ");
         val = trie->getSourceState(ctx, name, "AL_SOURCE_RELATIVE");
         html << alboolString(val ? *val : AL_FALSE);
@@ -2574,14 +2693,10 @@ void ALTraceBufferInfoPage::updateDetails(const wxUIntPtr data)
             }
             if (pcm) {
                 const wxCharBuffer utf8path = frame->getTracefilePath().ToUTF8();
-                FILE *f = fopen(utf8path.data(), "rb");  // !!! FIXME: don't use fopen.
-                if (f) {
-                    if (fseek(f, (long) pcmoffset, SEEK_SET) != -1) {
-                        if (fread(pcm, pcmlen, 1, f) == 1) {
-                            okay = true;
-                        }
-                    }
-                    fclose(f);
+                TraceReader *reader = altrace_open(utf8path.data());
+                if (reader) {
+                    okay = readTraceBlob(reader, pcmoffset, pcmlen, pcm);
+                    altrace_close(reader);
                 }
 
                 if (okay) {
@@ -2652,6 +2767,7 @@ void ALTraceGridTable::appendApiCall(ApiCallInfo *info, const CallerInfo *caller
             case ARG_aldouble: str << arg->aldouble; break;
             case ARG_alcbool: str << alcboolString(arg->alcbool); break;
             case ARG_albool: str << alboolString(arg->albool); break;
+            case ARG_unrecorded: str << wxT("(unrecorded)"); break;
             default: str << wxT("???"); break;
         }
 
@@ -3288,7 +3404,7 @@ static void make_state_alcCaptureStop(CallerInfo *callerinfo, ALCdevice *device)
     }
 }
 
-static void make_state_alcCaptureSamples(CallerInfo *callerinfo, ALCdevice *device, ALCvoid *origbuffer, ALCvoid *buffer, ALCsizei bufferlen, ALCsizei samples)
+static void make_state_alcCaptureSamples(CallerInfo *callerinfo, ALCdevice *device, ALCvoid *origbuffer, const TraceBlob *buffer, ALCsizei bufferlen, ALCsizei samples)
 {
     START_ARGS();
     SET_ARGINFO(device, device, "device to capture from");
@@ -3311,7 +3427,7 @@ static void make_state_alcCaptureSamples(CallerInfo *callerinfo, ALCdevice *devi
             snprintf(buf, sizeof (buf), "capturedatalen/%u", (uint) numcaptures);
             trie->addDeviceStateRevision(device, buf, (uint64) bufferlen);
             snprintf(buf, sizeof (buf), "capturedata/%u", (uint) numcaptures);
-            trie->addDeviceStateRevision(device, buf, (uint64) (callerinfo->fdoffset + 32));
+            trie->addDeviceStateRevision(device, buf, (uint64) (buffer ? buffer->offset : 0));
             trie->addDeviceStateRevision(device, "numcaptures", numcaptures + 1);
         }
     } else {
@@ -3504,7 +3620,13 @@ static void make_state_alListenerfv(CallerInfo *callerinfo, ALenum param, const
 {
     START_ARGS();
     SET_ARGINFO(alenum, param, "parameter");
-    SET_ARGINFO(ptr, origvalues, "buffer of new values");
+    if (!origvalues && values) {  // motion updates don't have the app's pointer.
+        ApiArgInfo *arg = &info->arginfo[argidx++];
+        arg->name = "buffer of new values";
+        arg->type = ARG_unrecorded;
+    } else {
+        SET_ARGINFO(ptr, origvalues, "buffer of new values");
+    }
     info->inefficient_state_change = AL_TRUE;  // will reset to AL_FALSE if we get a state change event.
 }
 
@@ -3982,7 +4104,7 @@ static void make_state_alIsBuffer(CallerInfo *callerinfo, ALboolean retval, ALui
     SET_RETINFO(albool);
 }
 
-static void make_state_alBufferData(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const ALvoid *data, ALsizei size, ALsizei freq)
+static void make_state_alBufferData(CallerInfo *callerinfo, ALuint name, ALenum alfmt, const ALvoid *origdata, const TraceBlob *data, ALsizei size, ALsizei freq)
 {
     START_ARGS();
     SET_ARGINFO(buffer, name, "buffer");
@@ -3990,16 +4112,25 @@ static void make_state_alBufferData(CallerInfo *callerinfo, ALuint name, ALenum
     SET_ARGINFO(ptr, origdata, "buffer of audio data");
     SET_ARGINFO(sizei, size, "size of buffer in bytes (not samples!)");
     SET_ARGINFO(sizei, freq, "frequency of audio data in Hz");
-    // !!! FIXME: compare existing data and mark as an inefficient state change if the data is identical.
 
     if (name) {
         StateTrie *trie = visitargs->frame->getStateTrie();
         ALCdevice *dev = NULL;
         ALCcontext *ctx = trie->getCurrentContext(&dev);
         if (ctx && dev) {
+            // uploading exactly what the buffer already had is a waste of time.
+            const uint64 *oldfmt = trie->getBufferState(dev, name, "format");
+            const uint64 *oldfreq = trie->getBufferState(dev, name, "datafreq");
+            const uint64 *oldlen = trie->getBufferState(dev, name, "datalen");
+            const uint64 *oldhash = trie->getBufferState(dev, name, "datahash");
+            if (data && oldfmt && oldfreq && oldlen && oldhash && (*oldfmt == (uint64) alfmt) && (*oldfreq == (uint64) freq) && (*oldlen == data->len) && data->hash && (*oldhash == data->hash)) {
+                info->inefficient_state_change = AL_TRUE;
+            }
             trie->addBufferStateRevision(dev, name, "format", (uint64) alfmt);
-            trie->addBufferStateRevision(dev, name, "data", (uint64) (origdata ? (callerinfo->fdoffset + 32) : 0));
-            trie->addBufferStateRevision(dev, name, "datalen", (uint64) (origdata ? size : 0));
+            trie->addBufferStateRevision(dev, name, "datafreq", (uint64) freq);
+            trie->addBufferStateRevision(dev, name, "data", (uint64) (data ? data->offset : 0));
+            trie->addBufferStateRevision(dev, name, "datalen", (uint64) (data ? data->len : 0));
+            trie->addBufferStateRevision(dev, name, "datahash", data ? data->hash : 0);
         }
     }
 }
@@ -4204,6 +4335,66 @@ static void make_state_alcTraceContextLabel(CallerInfo *callerinfo, ALCcontext *
     trie->addContextStateRevision(ctx, "label", (uint64) ((size_t) str));
 }
 
+static void make_state_alTraceRegisterZone(CallerInfo *callerinfo, ALuint retval, const ALchar *str)
+{
+    str = cache_string(str);
+    START_ARGS();
+    SET_ARGINFO(string, str, "zone name");
+    SET_RETINFO(aluint);
+}
+
+// !!! FIXME: show the zone's name, and chart zones and frames over time.
+static void make_state_alTraceZoneBegin(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds)
+{
+    START_ARGS();
+    SET_ARGINFO(aluint, zone, "zone");
+}
+
+static void make_state_alTraceZoneEnd(CallerInfo *callerinfo, ALuint zone, uint64 nanoseconds)
+{
+    START_ARGS();
+    SET_ARGINFO(aluint, zone, "zone");
+}
+
+static void make_state_alTraceFrameMark(CallerInfo *callerinfo, uint64 nanoseconds)
+{
+    START_ARGS();
+}
+
+static void make_state_alTraceRegisterCounter(CallerInfo *callerinfo, ALuint retval, const ALchar *str)
+{
+    str = cache_string(str);
+    START_ARGS();
+    SET_ARGINFO(string, str, "counter name");
+    SET_RETINFO(aluint);
+
+    if (retval) {
+        StateTrie *trie = visitargs->frame->getStateTrie();
+        const uint64 *val = trie->getGlobalState("numcounters");
+        char buf[64];
+        if (!val || (*val < retval)) {
+            trie->addGlobalStateRevision("numcounters", retval);
+        }
+        snprintf(buf, sizeof (buf), "counter/%u/name", (uint) retval);
+        trie->addGlobalStateRevision(buf, (uint64) ((size_t) str));
+    }
+}
+
+static void make_state_alTraceCounter(CallerInfo *callerinfo, ALuint counter, ALdouble value)
+{
+    START_ARGS();
+    SET_ARGINFO(aluint, counter, "counter");
+    SET_ARGINFO(aldouble, value, "value");
+
+    if (counter) {
+        union { ALdouble d; uint64 ui64; } cvt;
+        char buf[64];
+        cvt.d = value;
+        snprintf(buf, sizeof (buf), "counter/%u/value", (uint) counter);
+        visitargs->frame->getStateTrie()->addGlobalStateRevision(buf, cvt.ui64);
+    }
+}
+
 
 #define ENTRYPOINT(ret,name,params,args,numargs,visitparams,visitargs) \
     void visit_##name visitparams { \
@@ -4287,6 +4478,23 @@ void visit_context_state_changed_string(void *userdata, ALCcontext *ctx, const A
     trie->addContextStateRevision(ctx, alenumString(param), (uint64) newval);
 }
 
+void visit_context_attributes(void *userdata, ALCcontext *ctx, const uint32 numattrs, const ALCint *attrs)
+{
+    VisitArgs *visitargs = ((VisitArgs *) userdata);
+    mark_visit_as_changed_state(visitargs);
+    StateTrie *trie = visitargs->frame->getStateTrie();
+    char buf[64];
+    uint32 i;
+    trie->addContextStateRevision(ctx, "numattributes", (uint64) (numattrs / 2));
+    for (i = 0; (i + 1) < numattrs; i += 2) {
+        union { ALCint i; uint64 ui64; } cvt; cvt.i = attrs[i+1];
+        snprintf(buf, sizeof (buf), "attribute/%u/name", (uint) (i / 2));
+        trie->addContextStateRevision(ctx, buf, (uint64) attrs[i]);
+        snprintf(buf, sizeof (buf), "attribute/%u/value", (uint) (i / 2));
+        trie->addContextStateRevision(ctx, buf, cvt.ui64);
+    }
+}
+
 void visit_listener_state_changed_floatv(void *userdata, ALCcontext *ctx, const ALenum param, const uint32 numfloats, const ALfloat *values)
 {
     VisitArgs *visitargs = ((VisitArgs *) userdata);
@@ -4306,72 +4514,65 @@ void visit_listener_state_changed_floatv(void *userdata, ALCcontext *ctx, const
     }
 }
 
-void visit_source_state_changed_bool(void *userdata, const ALuint name, const ALenum param, const ALboolean newval)
+void visit_source_state_changed_bool(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALboolean newval)
 {
     VisitArgs *visitargs = ((VisitArgs *) userdata);
     mark_visit_as_changed_state(visitargs);
     StateTrie *trie = visitargs->frame->getStateTrie();
-    ALCcontext *ctx = trie->getCurrentContext();
     if (ctx) {
         trie->addSourceStateRevision(ctx, name, alenumString(param), (uint64) newval);
     }
 }
 
-// !!! FIXME: state change events need to specify context if it's something that the mixer changes (AL_STOPPED, offsets, etc).
-void visit_source_state_changed_enum(void *userdata, const ALuint name, const ALenum param, const ALenum newval)
+void visit_source_state_changed_enum(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALenum newval)
 {
     VisitArgs *visitargs = ((VisitArgs *) userdata);
     mark_visit_as_changed_state(visitargs);
     StateTrie *trie = visitargs->frame->getStateTrie();
-    ALCcontext *ctx = trie->getCurrentContext();
     if (ctx) {
         trie->addSourceStateRevision(ctx, name, alenumString(param), (uint64) newval);
     }
 }
 
-void visit_source_state_changed_int(void *userdata, const ALuint name, const ALenum param, const ALint newval)
+void visit_source_state_changed_int(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALint newval)
 {
     VisitArgs *visitargs = ((VisitArgs *) userdata);
     mark_visit_as_changed_state(visitargs);
     union { ALint i; uint64 ui64; } cvt; cvt.i = newval;
     StateTrie *trie = visitargs->frame->getStateTrie();
-    ALCcontext *ctx = trie->getCurrentContext();
     if (ctx) {
         trie->addSourceStateRevision(ctx, name, alenumString(param), cvt.ui64);
     }
 }
 
-void visit_source_state_changed_uint(void *userdata, const ALuint name, const ALenum param, const ALuint newval)
+void visit_source_state_changed_uint(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALuint newval)
 {
     VisitArgs *visitargs = ((VisitArgs *) userdata);
     mark_visit_as_changed_state(visitargs);
     StateTrie *trie = visitargs->frame->getStateTrie();
-    ALCcontext *ctx = trie->getCurrentContext();
     if (ctx) {
         trie->addSourceStateRevision(ctx, name, alenumString(param), (uint64) newval);
     }
 }
 
-void visit_source_state_changed_float(void *userdata, const ALuint name, const ALenum param, const ALfloat newval)
+void visit_source_state_changed_float(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat newval)
 {
     VisitArgs *visitargs = ((VisitArgs *) userdata);
     mark_visit_as_changed_state(visitargs);
     union { ALfloat f; uint64 ui64; } cvt; cvt.f = newval;
     StateTrie *trie = visitargs->frame->getStateTrie();
-    ALCcontext *ctx = trie->getCurrentContext();
     if (ctx) {
         trie->addSourceStateRevision(ctx, name, alenumString(param), cvt.ui64);
     }
 }
 
-void visit_source_state_changed_float3(void *userdata, const ALuint name, const ALenum param, const ALfloat newval1, const ALfloat newval2, const ALfloat newval3)
+void visit_source_state_changed_float3(void *userdata, ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat newval1, const ALfloat newval2, const ALfloat newval3)
 {
     VisitArgs *visitargs = ((VisitArgs *) userdata);
     mark_visit_as_changed_state(visitargs);
     const char *paramstr = alenumString(param);
     const ALfloat values[3] = { newval1, newval2, newval3 };
     StateTrie *trie = visitargs->frame->getStateTrie();
-    ALCcontext *ctx = trie->getCurrentContext();
     if (ctx) {
         for (int i = 0; i < 3; i++) {
             char key[128];
@@ -4395,6 +4596,61 @@ void visit_buffer_state_changed_int(void *userdata, const ALuint name, const ALe
     }
 }
 
+void visit_process_forked(void *userdata, const uint32 ticks, const uint32 parentpid, const uint32 childpid, const char *parentfile, const uint64 parentoffset)
+{
+    // !!! FIXME: offer to open the parent's tracefile?
+}
+
+void visit_checkpoint(void *userdata, const uint64 eventcount, const uint64 offset, const uint32 ticks)
+{
+    // nothing to do with these; they're for altrace_cli --salvage.
+}
+
+// we build the UI as we go, so we only use process_tracelog(), never process_tracelog_parallel().
+void *visit_chunk_begin(void *userdata, const uint64 chunknum)
+{
+    return userdata;
+}
+
+void visit_chunk_end(void *userdata, void *chunkdata, const ALboolean keep)
+{
+}
+
+void visit_perf_counters(void *userdata, const uint32 kind, const uint64 value1, const uint64 value2)
+{
+    VisitArgs *visitargs = ((VisitArgs *) userdata);
+    if (visitargs->info) {
+        visitargs->info->has_perf_counters = AL_TRUE;
+        visitargs->info->perf_kind = kind;
+        visitargs->info->perf_counters[0] = value1;
+        visitargs->info->perf_counters[1] = value2;
+    }
+}
+
+void visit_resource_sample(void *userdata, const uint32 ticks, const uint64 rss, const uint64 usertime, const uint64 systime, const uint32 threads, const uint32 openal_threads)
+{
+    // !!! FIXME: chart these; for now, use altrace_cli --chart-resources.
+}
+
+// these don't progress because of API calls, so they don't mark the call as changing state.
+void visit_device_clock_latency(void *userdata, ALCdevice *device, const uint32 ticks, const int64 clock, const int64 latency)
+{
+    VisitArgs *visitargs = ((VisitArgs *) userdata);
+    StateTrie *trie = visitargs->frame->getStateTrie();
+    trie->addDeviceStateRevision(device, "ALC_DEVICE_CLOCK_SOFT", (uint64) clock);
+    trie->addDeviceStateRevision(device, "ALC_DEVICE_LATENCY_SOFT", (uint64) latency);
+}
+
+void visit_source_latency(void *userdata, ALCcontext *ctx, const ALuint name, const int64 offset, const int64 latency)
+{
+    VisitArgs *visitargs = ((VisitArgs *) userdata);
+    StateTrie *trie = visitargs->frame->getStateTrie();
+    if (ctx) {
+        trie->addSourceStateRevision(ctx, name, "AL_SAMPLE_OFFSET_LATENCY_SOFT/offset", (uint64) offset);
+        trie->addSourceStateRevision(ctx, name, "AL_SAMPLE_OFFSET_LATENCY_SOFT/latency", (uint64) latency);
+    }
+}
+
 void visit_eos(void *userdata, const ALboolean okay, const uint32 wait_until)
 {
     VisitArgs *visitargs = ((VisitArgs *) userdata);
@@ -4753,7 +5009,7 @@ bool ALTraceApp::OnInit()
 
 int ALTraceApp::OnExit()
 {
-    free_ioblobs();
+    free_scratch();
     stringcache_destroy(appstringcache);
     appstringcache = NULL;
 